@@ -58,6 +58,7 @@ Taxi::Taxi()
 	Drivers = nullptr;
 	Addresses = nullptr;
 	DriversCount = 0;
+	FreeDriversCount = 0;
 	AddressesCount = 0;
 }
 
@@ -72,6 +73,7 @@ Taxi::Taxi(const char* InPassenger,
 
 	DriversCount = (InDrivers && InDriversCount > 0) ? InDriversCount : 0;
 	Drivers = CopyDrivers(InDrivers, DriversCount);
+	RecountFreeDrivers();
 	AddressesCount = (InAddresses && InAddressesCount > 0) ? InAddressesCount : 0;
 	Addresses = CopyAddresses(InAddresses, AddressesCount);
 }
@@ -83,12 +85,32 @@ Taxi::Taxi(const Taxi& Other)
 	std::strcpy(Passenger, Other.Passenger);
 
 	DriversCount = Other.DriversCount;
+	FreeDriversCount = Other.FreeDriversCount;
 	AddressesCount = Other.AddressesCount;
 
 	Drivers = CopyDrivers(Other.Drivers, DriversCount);
 	Addresses = CopyAddresses(Other.Addresses, AddressesCount);
 }
 
+Taxi::Taxi(Taxi&& Other) noexcept
+{
+	std::cout << "[LOG] Taxi move constructor called. Current number of taxi's classes - " << ++Count << std::endl;
+
+	std::strcpy(Passenger, Other.Passenger);
+
+	// steal the arrays, the moved-from taxi is left empty
+	Drivers = Other.Drivers;
+	DriversCount = Other.DriversCount;
+	FreeDriversCount = Other.FreeDriversCount;
+	Addresses = Other.Addresses;
+	AddressesCount = Other.AddressesCount;
+	Other.Drivers = nullptr;
+	Other.DriversCount = 0;
+	Other.FreeDriversCount = 0;
+	Other.Addresses = nullptr;
+	Other.AddressesCount = 0;
+}
+
 Taxi::~Taxi()
 {
 	std::cout << "[LOG] Taxi destructor called. Current number of taxi's classes - " << --Count << ". Freeing memory.\n";
@@ -97,6 +119,42 @@ Taxi::~Taxi()
 	delete[] Addresses;
 }
 
+Taxi& Taxi::operator=(const Taxi& Other)
+{
+	if (this == &Other)
+		return *this;
+	std::strcpy(Passenger, Other.Passenger);
+
+	int* NewDrivers = CopyDrivers(Other.Drivers, Other.DriversCount);
+	char (*NewAddresses)[MAX_STR_LEN] = CopyAddresses(Other.Addresses, Other.AddressesCount);
+	delete[] Drivers;
+	delete[] Addresses;
+	Drivers = NewDrivers;
+	DriversCount = Other.DriversCount;
+	FreeDriversCount = Other.FreeDriversCount;
+	Addresses = NewAddresses;
+	AddressesCount = Other.AddressesCount;
+	return *this;
+}
+
+Taxi& Taxi::operator=(Taxi&& Other) noexcept
+{
+	// Other frees our old arrays when it is destroyed
+	if (this != &Other)
+		Swap(Other);
+	return *this;
+}
+
+void Taxi::Swap(Taxi& Other) noexcept
+{
+	std::swap(Passenger, Other.Passenger);
+	std::swap(Drivers, Other.Drivers);
+	std::swap(DriversCount, Other.DriversCount);
+	std::swap(FreeDriversCount, Other.FreeDriversCount);
+	std::swap(Addresses, Other.Addresses);
+	std::swap(AddressesCount, Other.AddressesCount);
+}
+
 int Taxi::GetDriverState(int Index) const
 {
 	if (Index < 0 || Index >= DriversCount || !Drivers) return -1;
@@ -106,9 +164,18 @@ int Taxi::GetDriverState(int Index) const
 void Taxi::SetDriverState(int Index, int State)
 {
 	if (Index < 0 || Index >= DriversCount || !Drivers) return;
+	FreeDriversCount += (State == DRIVER_FREE) - (Drivers[Index] == DRIVER_FREE);
 	Drivers[Index] = State;
 }
 
+void Taxi::RecountFreeDrivers()
+{
+	FreeDriversCount = 0;
+	for (int i = 0; i < DriversCount; i++)
+		if (Drivers[i] == DRIVER_FREE)
+			FreeDriversCount++;
+}
+
 const char* Taxi::GetAddress(int Index) const
 {
 	if (Index < 0 || Index >= AddressesCount || !Addresses)
@@ -123,16 +190,6 @@ void Taxi::SetAddress(int Index, const char* NewAddress)
 	Addresses[Index][MAX_STR_LEN - 1] = '\0';
 }
 
-int Taxi::Order()
-{
-	if (!Drivers) return 0;
-	int FreeDriversNum = 0;
-	for (int i = 0; i < DriversCount; i++)
-		if (Drivers[i] == DRIVER_FREE)
-			FreeDriversNum++;
-	return FreeDriversNum;
-}
-
 bool Taxi::Order(const char* InAddress)
 {
 	if (!Drivers || !Addresses || !InAddress || std::strlen(InAddress) == 0)
@@ -144,7 +201,7 @@ bool Taxi::Order(const char* InAddress)
 			KnownAddress = true; break;
 		}
 	}
-	if (!KnownAddress)
+	if (!KnownAddress || FreeDriversCount == 0)
 		return false;
 	// find a free driver
 	for (int i = 0; i < DriversCount; i++)
@@ -165,6 +222,7 @@ bool Taxi::Order(int DriverIndex, const char* InAddress)
 	for (int i = 0; i < AddressesCount; i++) {
 		if (!std::strcmp(Addresses[i], InAddress)) {
 			Drivers[DriverIndex] = DRIVER_BUSY;
+			FreeDriversCount--;
 			return true;
 		}
 	}
@@ -197,6 +255,7 @@ void Taxi::InputFromConsole()
 			State = DRIVER_FREE;
 		Drivers[i] = State;
 	}
+	RecountFreeDrivers();
 	std::cout << "How many addresses: ";
 	AddressesCount = ReadStrictInt();
 	if (AddressesCount < 0) 
@@ -267,6 +326,7 @@ void Taxi::LoadFromFile(const char* FileName)
 			st = DRIVER_FREE;
 		Drivers[i] = st;
 	}
+	RecountFreeDrivers();
 	fin >> AddressesCount;
 	fin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
 	delete[] Addresses;
@@ -413,18 +473,9 @@ std::ofstream& operator<<(std::ofstream& OutFile, const Taxi& Obj)
 
 bool Taxi::operator==(const Taxi& Other) const
 {
-	// match passenger name & # of free drivers
-	if (std::strcmp(Passenger, Other.Passenger) != 0)
-		return false;
-	int freeThis = 0; // compare free drivers
-	for (int i = 0; i < GetDriversCount(); i++)
-		if (GetDriverState(i) == DRIVER_FREE)
-			freeThis++;
-	int freeOther = 0;
-	for (int i = 0; i < Other.GetDriversCount(); i++)
-		if (Other.GetDriverState(i) == DRIVER_FREE)
-			freeOther++;
-	return freeThis == freeOther;
+	// match # of free drivers first, it is cached, then the passenger name
+	return FreeDriversCount == Other.FreeDriversCount
+		&& std::strcmp(Passenger, Other.Passenger) == 0;
 }
 
 bool Taxi::operator<(const Taxi& Other) const
@@ -433,20 +484,14 @@ bool Taxi::operator<(const Taxi& Other) const
 	int cmp = std::strcmp(Passenger, Other.Passenger);
 	if (cmp < 0) return true;
 	if (cmp > 0) return false;
-	int freeThis = 0; // if equal names, compare free drivers ascending
-	for (int i = 0; i < GetDriversCount(); i++)
-		if (GetDriverState(i) == DRIVER_FREE)
-			freeThis++;
-	int freeOther = 0;
-	for (int j = 0; j < Other.GetDriversCount(); j++)
-		if (Other.GetDriverState(j) == DRIVER_FREE)
-			freeOther++;
-	return freeThis < freeOther;
+	// if equal names, compare free drivers ascending
+	return FreeDriversCount < Other.FreeDriversCount;
 }
 
 void Taxi::SetDriversCount(int NewCount)
 {
 	AllocateDrivers(Drivers, DriversCount, NewCount);
+	FreeDriversCount = DriversCount;
 }
 
 void Taxi::SetAddressesCount(int NewCount)
@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <fstream>
+#include <utility>
 
 const int MAX_STR_LEN = 64;
 
@@ -17,10 +18,17 @@ public:
         const int* InDrivers, int InDriversCount,
         const char (*InAddresses)[MAX_STR_LEN], int InAddressesCount);
     Taxi(const Taxi& Other);
+    Taxi(Taxi&& Other) noexcept;
     ~Taxi();
 
-    // Return number of free drivers
-    int Order();
+    Taxi& operator=(const Taxi& Other);
+    Taxi& operator=(Taxi&& Other) noexcept;
+
+    // Exchange all state with another taxi
+    void Swap(Taxi& Other) noexcept;
+
+    // Return number of free drivers, kept up to date by every driver state change
+    int Order() const { return FreeDriversCount; }
 
     // Check if given address is in the array of addresses
     bool Order(const char* InAddress);
@@ -39,6 +47,7 @@ public:
     int  GetDriverState(int Index) const;
     void SetDriverState(int Index, int State);
     int GetDriversCount() const { return DriversCount; }
+    int GetFreeDriversCount() const { return FreeDriversCount; }
     void SetDriversCount(int NewCount);
 
     const char* GetAddress(int Index) const;
@@ -68,9 +77,13 @@ protected:
     char (*Addresses)[MAX_STR_LEN];
 
 private:
+    // Recount FreeDriversCount after the drivers were written directly
+    void RecountFreeDrivers();
+
     int* Drivers;
 
     int DriversCount;
+    int FreeDriversCount;
     int AddressesCount;
 
     static int Count;
@@ -86,6 +86,23 @@ Taxi::Taxi(const Taxi& Other)
 	Addresses = CopyAddresses(Other.Addresses, AddressesCount);
 }
 
+Taxi::Taxi(Taxi&& Other) noexcept
+{
+	std::cout << "[LOG] Taxi move constructor called. Current number of taxi's classes - " << ++Count << std::endl;
+
+	std::strcpy(Passenger, Other.Passenger);
+
+	// steal the arrays, the moved-from taxi is left empty
+	Drivers = Other.Drivers;
+	DriversCount = Other.DriversCount;
+	Addresses = Other.Addresses;
+	AddressesCount = Other.AddressesCount;
+	Other.Drivers = nullptr;
+	Other.DriversCount = 0;
+	Other.Addresses = nullptr;
+	Other.AddressesCount = 0;
+}
+
 Taxi::~Taxi()
 {
 	std::cout << "[LOG] Taxi destructor called. Current number of taxi's classes - " << --Count << ". Freeing memory.\n";
@@ -93,6 +110,40 @@ Taxi::~Taxi()
 	delete[] Addresses;
 }
 
+Taxi& Taxi::operator=(const Taxi& Other)
+{
+	if (this == &Other)
+		return *this;
+	std::strcpy(Passenger, Other.Passenger);
+
+	int* NewDrivers = CopyDrivers(Other.Drivers, Other.DriversCount);
+	char (*NewAddresses)[MAX_STR_LEN] = CopyAddresses(Other.Addresses, Other.AddressesCount);
+	delete[] Drivers;
+	delete[] Addresses;
+	Drivers = NewDrivers;
+	DriversCount = Other.DriversCount;
+	Addresses = NewAddresses;
+	AddressesCount = Other.AddressesCount;
+	return *this;
+}
+
+Taxi& Taxi::operator=(Taxi&& Other) noexcept
+{
+	// Other frees our old arrays when it is destroyed
+	if (this != &Other)
+		Swap(Other);
+	return *this;
+}
+
+void Taxi::Swap(Taxi& Other) noexcept
+{
+	std::swap(Passenger, Other.Passenger);
+	std::swap(Drivers, Other.Drivers);
+	std::swap(DriversCount, Other.DriversCount);
+	std::swap(Addresses, Other.Addresses);
+	std::swap(AddressesCount, Other.AddressesCount);
+}
+
 int Taxi::GetDriverState(int Index) const
 {
 	if (Index < 0 || Index >= DriversCount || !Drivers) return -1;
@@ -3,6 +3,7 @@
 #include "AbstractTaxi.h"
 #include <iostream>
 #include <fstream>
+#include <utility>
 
 // Possible driver states
 const int DRIVER_FREE = 0;
@@ -16,8 +17,15 @@ public:
         const int* InDrivers, int InDriversCount,
         const char (*InAddresses)[MAX_STR_LEN], int InAddressesCount);
     Taxi(const Taxi& Other);
+    Taxi(Taxi&& Other) noexcept;
     ~Taxi();
 
+    Taxi& operator=(const Taxi& Other);
+    Taxi& operator=(Taxi&& Other) noexcept;
+
+    // Exchange all state with another taxi
+    void Swap(Taxi& Other) noexcept;
+
     // Return number of free drivers
     int Order();
 
@@ -1,2 +1,56 @@
 #include "AbstractTaxi.h"
-int AbstractTaxi::Count = 0;
\ No newline at end of file
+#include <atomic>
+#include <thread>
+
+namespace
+{
+	// Object numbers a thread takes from the shared counter at once
+	const int NUMBER_BLOCK_SIZE = 256;
+	const int COUNT_SHARDS = 16;
+
+	struct alignas(64) CountShard
+	{
+		std::atomic<long long> Value{ 0 };
+	};
+
+	std::atomic<int> NextNumberBlock{ 1 };
+	CountShard LiveShards[COUNT_SHARDS];
+	std::atomic<int> NextShard{ 0 };
+
+	struct NumberBlock
+	{
+		int Next = 0;
+		int End = 0;
+	};
+
+	CountShard& LocalShard()
+	{
+		thread_local CountShard& Shard = LiveShards[NextShard.fetch_add(1, std::memory_order_relaxed) % COUNT_SHARDS];
+		return Shard;
+	}
+}
+
+int ObjectAccounting::Acquire()
+{
+	thread_local NumberBlock Block;
+	if (Block.Next == Block.End)
+	{
+		Block.Next = NextNumberBlock.fetch_add(NUMBER_BLOCK_SIZE, std::memory_order_relaxed);
+		Block.End = Block.Next + NUMBER_BLOCK_SIZE;
+	}
+	LocalShard().Value.fetch_add(1, std::memory_order_relaxed);
+	return Block.Next++;
+}
+
+void ObjectAccounting::Release()
+{
+	LocalShard().Value.fetch_sub(1, std::memory_order_relaxed);
+}
+
+int ObjectAccounting::GetLiveCount()
+{
+	long long Total = 0;
+	for (const CountShard& Shard : LiveShards)
+		Total += Shard.Value.load(std::memory_order_relaxed);
+	return static_cast<int>(Total);
+}
@@ -1,8 +1,24 @@
 #pragma once
 #include <iostream>
+#include <string>
 
 const int MAX_STR_LEN = 64;
 
+// Object numbers and the live object count, safe to use from any thread.
+// Numbers are never reused: each thread takes a block of them from one shared
+// atomic and hands them out without further synchronization. The live count is
+// spread over cache line sized shards so concurrent constructors do not contend.
+class ObjectAccounting
+{
+public:
+	// Registers a new object and returns its unique number
+	static int Acquire();
+	// Unregisters an object
+	static void Release();
+	// Number of registered objects, exact once no object is being created or destroyed
+	static int GetLiveCount();
+};
+
 class IAutoNumber
 {
 public:
@@ -19,6 +35,8 @@ public:
 	virtual ~IStringConvertible() = default;
 	// Convert object to string
 	virtual std::string ToString() const = 0;
+	// Appends the ToString text to Out, so a caller converting many objects can reuse one buffer
+	virtual void AppendString(std::string& Out) const { Out += ToString(); }
 	// Parse the string to set the object's state
 	virtual void FromString(const std::string& InStr) = 0;
 };
@@ -26,13 +44,20 @@ public:
 class AbstractTaxi : public IAutoNumber, public IStringConvertible
 {
 public:
-	virtual ~AbstractTaxi() = default;
+	virtual ~AbstractTaxi() { ObjectAccounting::Release(); }
 	// A pure virtual function to be overridden by all derived classes
 	virtual void PrintInfo() const = 0;
+	// Appends the PrintInfo text to Out. TotalCount is the object count shown in it,
+	// so a caller printing many objects reads the live count only once.
+	virtual void AppendInfo(std::string& Out, int TotalCount) const = 0;
 
-	static const int GetCount() { return Count; };
+	static const int GetCount() { return ObjectAccounting::GetLiveCount(); };
 
 protected:
-	static int Count;
+	AbstractTaxi() : ObjectNumber(ObjectAccounting::Acquire()) {}
+	// A copy is a new object, so it gets its own number
+	AbstractTaxi(const AbstractTaxi&) : AbstractTaxi() {}
+	AbstractTaxi& operator=(const AbstractTaxi&) { return *this; }
+
 	int ObjectNumber;
 };
\ No newline at end of file
@@ -0,0 +1,179 @@
+#pragma once
+
+#include "AbstractTaxi.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Fixed address catalogs of a service area, declared as constexpr tables with a perfect
+// hash built by the compiler:
+//   constexpr AddressCatalog Downtown({ "MainStreet", "Broadway", "ParkAvenue" });
+//   static_assert(Downtown.IsValid() && Downtown.Find("Broadway") == 1);
+// Find hashes the address once, picks the only slot it can be in and compares one
+// string. Nothing is built or allocated at run time. See Taxi::UseCatalog.
+//
+// The hash is hash-and-displace: the address hash chooses a bucket, and every bucket
+// has a seed, found at compile time, that sends its addresses to free slots.
+
+// FNV-1a of the address, the same at compile time and at run time
+constexpr std::uint64_t CatalogHash(std::string_view Address)
+{
+	std::uint64_t Hash = 14695981039346656037ull;
+	for (char C : Address)
+		Hash = (Hash ^ static_cast<unsigned char>(C)) * 1099511628211ull;
+	return Hash;
+}
+
+// Slot of an address hash under a bucket seed
+constexpr std::uint32_t CatalogSlot(std::uint64_t Hash, std::uint32_t Seed, std::uint32_t SlotMask)
+{
+	std::uint64_t Value = Hash + Seed * 0x9e3779b97f4a7c15ull;
+	Value = (Value ^ (Value >> 30)) * 0xbf58476d1ce4e5b9ull;
+	Value = (Value ^ (Value >> 27)) * 0x94d049bb133111ebull;
+	return static_cast<std::uint32_t>(Value ^ (Value >> 31)) & SlotMask;
+}
+
+// What every catalog has, whatever its size. Taxi keeps a pointer to this part.
+class AddressCatalogView
+{
+public:
+	AddressCatalogView(const AddressCatalogView&) = delete;
+	AddressCatalogView& operator=(const AddressCatalogView&) = delete;
+
+	// False if the addresses repeat, are empty or longer than MAX_STR_LEN - 1
+	constexpr bool IsValid() const { return Valid; }
+	constexpr int GetSize() const { return Size; }
+	constexpr const char* Get(int Index) const { return Index >= 0 && Index < Size ? Addresses[Index] : nullptr; }
+
+	// Index of the address in the catalog or -1
+	constexpr int Find(std::string_view Address) const
+	{
+		if (!Valid)
+			return -1;
+		std::uint64_t Hash = CatalogHash(Address);
+		int Index = Slots[CatalogSlot(Hash, Seeds[Hash & BucketMask], SlotMask)];
+		return Index >= 0 && std::string_view(Addresses[Index], Lengths[Index]) == Address ? Index : -1;
+	}
+
+	// Same for a zero terminated address, cut at MAX_STR_LEN - 1 like AddressPool does
+	constexpr int Find(const char* Address) const
+	{
+		if (!Address)
+			return -1;
+		std::size_t Length = 0;
+		while (Length < MAX_STR_LEN - 1 && Address[Length])
+			Length++;
+		return Find(std::string_view(Address, Length));
+	}
+
+protected:
+	constexpr AddressCatalogView() = default;
+
+	const char* const* Addresses = nullptr;
+	const std::uint32_t* Lengths = nullptr;
+	const std::uint32_t* Seeds = nullptr;
+	const std::int32_t* Slots = nullptr;
+	std::uint64_t BucketMask = 0;
+	std::uint32_t SlotMask = 0;
+	int Size = 0;
+	bool Valid = false;
+};
+
+template <std::size_t N>
+class AddressCatalog : public AddressCatalogView
+{
+	static_assert(N > 0, "an address catalog needs an address");
+
+	static constexpr std::size_t PowerOfTwo(std::size_t Minimum)
+	{
+		std::size_t Value = 1;
+		while (Value < Minimum)
+			Value *= 2;
+		return Value;
+	}
+
+public:
+	// Twice as many slots as addresses and about two addresses per bucket, so a seed
+	// turns up within a few tries
+	static constexpr std::size_t SlotCount = PowerOfTwo(2 * N);
+	static constexpr std::size_t BucketCount = PowerOfTwo((N + 1) / 2);
+
+	// Seeds tried per bucket before the catalog is given up as invalid
+	static constexpr std::uint32_t MAX_SEED = 1u << 16;
+
+	constexpr AddressCatalog(const char* const (&InAddresses)[N])
+	{
+		std::array<std::uint64_t, N> Hashes{};
+		Valid = true;
+		for (std::size_t i = 0; i < N; i++)
+		{
+			Table[i] = InAddresses[i];
+			std::string_view Address(InAddresses[i]);
+			Valid = Valid && !Address.empty() && Address.size() < static_cast<std::size_t>(MAX_STR_LEN);
+			LengthTable[i] = static_cast<std::uint32_t>(Address.size());
+			Hashes[i] = CatalogHash(Address);
+			// equal hashes can not be told apart by any seed, equal addresses among them
+			for (std::size_t j = 0; j < i; j++)
+				Valid = Valid && Hashes[j] != Hashes[i];
+		}
+		SlotTable.fill(-1);
+		SeedTable.fill(0);
+
+		// buckets with more addresses are harder to place, they go first
+		std::array<std::uint32_t, BucketCount> BucketSizes{};
+		for (std::size_t i = 0; i < N; i++)
+			BucketSizes[Hashes[i] & (BucketCount - 1)]++;
+		std::array<std::uint32_t, BucketCount> Order{};
+		for (std::size_t b = 0; b < BucketCount; b++)
+			Order[b] = static_cast<std::uint32_t>(b);
+		for (std::size_t b = 1; b < BucketCount; b++)
+			for (std::size_t j = b; j > 0 && BucketSizes[Order[j - 1]] < BucketSizes[Order[j]]; j--)
+			{
+				std::uint32_t Swapped = Order[j];
+				Order[j] = Order[j - 1];
+				Order[j - 1] = Swapped;
+			}
+
+		for (std::size_t b = 0; Valid && b < BucketCount && BucketSizes[Order[b]] > 0; b++)
+		{
+			std::uint32_t Bucket = Order[b];
+			bool Placed = false;
+			for (std::uint32_t Seed = 0; !Placed && Seed < MAX_SEED; Seed++)
+			{
+				// every address of the bucket needs a free slot of its own
+				Placed = true;
+				for (std::size_t i = 0; Placed && i < N; i++)
+				{
+					if ((Hashes[i] & (BucketCount - 1)) != Bucket)
+						continue;
+					std::uint32_t Slot = CatalogSlot(Hashes[i], Seed, SlotCount - 1);
+					Placed = SlotTable[Slot] < 0;
+					for (std::size_t j = 0; Placed && j < i; j++)
+						Placed = (Hashes[j] & (BucketCount - 1)) != Bucket || CatalogSlot(Hashes[j], Seed, SlotCount - 1) != Slot;
+				}
+				if (!Placed)
+					continue;
+				SeedTable[Bucket] = Seed;
+				for (std::size_t i = 0; i < N; i++)
+					if ((Hashes[i] & (BucketCount - 1)) == Bucket)
+						SlotTable[CatalogSlot(Hashes[i], Seed, SlotCount - 1)] = static_cast<std::int32_t>(i);
+			}
+			Valid = Placed;
+		}
+
+		Addresses = Table.data();
+		Lengths = LengthTable.data();
+		Seeds = SeedTable.data();
+		Slots = SlotTable.data();
+		BucketMask = BucketCount - 1;
+		SlotMask = static_cast<std::uint32_t>(SlotCount - 1);
+		Size = static_cast<int>(N);
+	}
+
+private:
+	std::array<const char*, N> Table{};
+	std::array<std::uint32_t, N> LengthTable{};
+	std::array<std::uint32_t, BucketCount> SeedTable{};
+	std::array<std::int32_t, SlotCount> SlotTable{};
+};
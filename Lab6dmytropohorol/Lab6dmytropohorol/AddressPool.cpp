@@ -0,0 +1,169 @@
+#include "AddressPool.h"
+#include "AbstractTaxi.h"
+#include "Log.h"
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+
+namespace
+{
+	// Ids index a two level table, chunks are never moved once allocated
+	// so Get can read them without taking the lock
+	const int CHUNK_BITS = 12;
+	const int CHUNK_SIZE = 1 << CHUNK_BITS;
+	const int MAX_CHUNKS = MAX_POOL_ADDRESSES >> CHUNK_BITS;
+
+	struct PoolState
+	{
+		PoolState()
+		{
+			// the placeholder takes id 0 before anything else can fill the pool
+			Add(std::string_view(UNKNOWN_ADDRESS));
+		}
+
+		// Stores a new address, under the lock
+		AddressId Add(std::string_view Key)
+		{
+			AddressId Id = Size.load(std::memory_order_relaxed);
+			if (Id >= Limit.load(std::memory_order_relaxed))
+				return INVALID_ADDRESS_ID;
+			const char** Chunk = Chunks[Id >> CHUNK_BITS].load(std::memory_order_relaxed);
+			if (!Chunk)
+			{
+				Chunk = new const char* [CHUNK_SIZE]();
+				Chunks[Id >> CHUNK_BITS].store(Chunk, std::memory_order_release);
+			}
+			char* Copy = new char[Key.size() + 1];
+			std::memcpy(Copy, Key.data(), Key.size());
+			Copy[Key.size()] = '\0';
+			Chunk[Id & (CHUNK_SIZE - 1)] = Copy;
+			Ids.emplace(std::string_view(Copy, Key.size()), Id);
+			Size.store(Id + 1, std::memory_order_release);
+			return Id;
+		}
+
+		std::mutex Lock;
+		std::unordered_map<std::string_view, AddressId> Ids;
+		std::atomic<const char**> Chunks[MAX_CHUNKS] = {};
+		std::atomic<AddressId> Size{ 0 };
+		std::atomic<AddressId> Limit{ MAX_POOL_ADDRESSES };
+	};
+
+	PoolState& State()
+	{
+		static PoolState Pool;
+		return Pool;
+	}
+
+	// Ids never change once assigned, so every thread can remember the ones it
+	// has seen and skip the lock. The keys point into the pool's own copies.
+	std::unordered_map<std::string_view, AddressId>& LocalIds()
+	{
+		thread_local std::unordered_map<std::string_view, AddressId> Ids;
+		return Ids;
+	}
+
+	std::string_view Truncated(const char* Address)
+	{
+		std::size_t Len = 0;
+		while (Len < MAX_STR_LEN - 1 && Address[Len])
+			Len++;
+		return std::string_view(Address, Len);
+	}
+
+	std::string_view Truncated(const char* Address, std::size_t Length)
+	{
+		return std::string_view(Address, Length < MAX_STR_LEN - 1 ? Length : MAX_STR_LEN - 1);
+	}
+}
+
+AddressId AddressPool::Intern(const char* Address)
+{
+	if (!Address)
+		return INVALID_ADDRESS_ID;
+	return Intern(Address, Truncated(Address).size());
+}
+
+AddressId AddressPool::Intern(const char* Address, std::size_t Length)
+{
+	if (!Address)
+		return INVALID_ADDRESS_ID;
+	std::string_view Key = Truncated(Address, Length);
+	std::unordered_map<std::string_view, AddressId>& Local = LocalIds();
+	auto Cached = Local.find(Key);
+	if (Cached != Local.end())
+		return Cached->second;
+
+	PoolState& Pool = State();
+	std::lock_guard<std::mutex> Guard(Pool.Lock);
+	auto Found = Pool.Ids.find(Key);
+	if (Found != Pool.Ids.end())
+	{
+		Local.emplace(Found->first, Found->second);
+		return Found->second;
+	}
+
+	AddressId Id = Pool.Add(Key);
+	if (Id != INVALID_ADDRESS_ID)
+		Local.emplace(std::string_view(AddressPool::Get(Id), Key.size()), Id);
+	return Id;
+}
+
+AddressId AddressPool::InternOrUnknown(const char* Address)
+{
+	return Address ? InternOrUnknown(Address, Truncated(Address).size()) : UNKNOWN_ADDRESS_ID;
+}
+
+AddressId AddressPool::InternOrUnknown(const char* Address, std::size_t Length)
+{
+	AddressId Id = Intern(Address, Length);
+	if (Id != INVALID_ADDRESS_ID)
+		return Id;
+	if (Address)
+		TAXI_LOG(LogLevel::Warning, "Address pool is full, address stored as ", UNKNOWN_ADDRESS);
+	return UNKNOWN_ADDRESS_ID;
+}
+
+AddressId AddressPool::Find(const char* Address)
+{
+	if (!Address)
+		return INVALID_ADDRESS_ID;
+	std::string_view Key = Truncated(Address);
+	std::unordered_map<std::string_view, AddressId>& Local = LocalIds();
+	auto Cached = Local.find(Key);
+	if (Cached != Local.end())
+		return Cached->second;
+
+	PoolState& Pool = State();
+	std::lock_guard<std::mutex> Guard(Pool.Lock);
+	auto Found = Pool.Ids.find(Key);
+	if (Found == Pool.Ids.end())
+		return INVALID_ADDRESS_ID;
+	Local.emplace(Found->first, Found->second);
+	return Found->second;
+}
+
+const char* AddressPool::Get(AddressId Id)
+{
+	PoolState& Pool = State();
+	if (Id >= Pool.Size.load(std::memory_order_acquire))
+		return nullptr;
+	return Pool.Chunks[Id >> CHUNK_BITS].load(std::memory_order_acquire)[Id & (CHUNK_SIZE - 1)];
+}
+
+int AddressPool::GetSize()
+{
+	return static_cast<int>(State().Size.load(std::memory_order_acquire));
+}
+
+void AddressPool::SetLimit(AddressId Limit)
+{
+	State().Limit.store(Limit < MAX_POOL_ADDRESSES ? Limit : MAX_POOL_ADDRESSES, std::memory_order_relaxed);
+}
+
+AddressId AddressPool::GetLimit()
+{
+	return State().Limit.load(std::memory_order_relaxed);
+}
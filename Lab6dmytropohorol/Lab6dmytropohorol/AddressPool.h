@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Id of an interned address string
+using AddressId = std::uint32_t;
+
+const AddressId INVALID_ADDRESS_ID = 0xFFFFFFFFu;
+
+// Placeholder of a missing address. It is in the pool from the start, so it has an id
+// even when the pool is full.
+const char UNKNOWN_ADDRESS[] = "UnknownAddr";
+const AddressId UNKNOWN_ADDRESS_ID = 0;
+
+// Most addresses the pool can ever hold
+const AddressId MAX_POOL_ADDRESSES = 1u << 24;
+
+// Process-wide pool of address strings. Every distinct address is stored once
+// and referred to by a 32-bit id, so equal addresses compare as equal ids.
+// Interned strings live until the process exits, the pool never shrinks. Processes that
+// intern untrusted input (TaxiCodec strings, the dispatch protocol, journal files) bound
+// it with SetLimit. Once the limit is reached, Intern returns INVALID_ADDRESS_ID for new
+// addresses. Taxi then keeps the old address on SetAddress and stores UNKNOWN_ADDRESS_ID
+// when loading, so a taxi never holds an invalid id.
+class AddressPool
+{
+public:
+	// Returns the id of the address, adding it to the pool if it is new.
+	// Addresses longer than MAX_STR_LEN - 1 are truncated like before.
+	// INVALID_ADDRESS_ID for nullptr or a new address once the pool is full.
+	static AddressId Intern(const char* Address);
+	// Same, for a string that is not zero terminated
+	static AddressId Intern(const char* Address, std::size_t Length);
+	// Intern for loads: a full pool gives UNKNOWN_ADDRESS_ID and a warning instead
+	static AddressId InternOrUnknown(const char* Address);
+	static AddressId InternOrUnknown(const char* Address, std::size_t Length);
+
+	// Returns the id of an already interned address or INVALID_ADDRESS_ID,
+	// never grows the pool
+	static AddressId Find(const char* Address);
+
+	// Returns the string of an id, nullptr for unknown ids. Does not lock.
+	static const char* Get(AddressId Id);
+
+	// Number of distinct addresses stored so far
+	static int GetSize();
+	// Caps the pool at Limit addresses (at most MAX_POOL_ADDRESSES, the default). Addresses
+	// already stored stay, a limit below the size only stops the growth.
+	static void SetLimit(AddressId Limit);
+	static AddressId GetLimit();
+};
@@ -0,0 +1,346 @@
+#pragma once
+
+#include "AbstractTaxi.h"
+#include "AddressPool.h"
+#include "DriverState.h"
+#include "Log.h"
+#include "Taxi.h"
+#include "TaxiCodec.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <utility>
+
+// Taxi for at most MaxDrivers drivers and MaxAddresses addresses, kept inline in the
+// object instead of in heap arrays. A fleet of them is one contiguous block, there is
+// nothing to allocate, copy or null check, and the driver and address loops run over
+// a fixed number of words the compiler can unroll.
+// Counts above the capacity are cut down with a warning. The API follows Taxi, without
+// journals, shared memory and snapshots; convert to Taxi for those (ToTaxi).
+template <int MaxDrivers, int MaxAddresses>
+class BasicTaxi : public AbstractTaxi
+{
+	static_assert(MaxDrivers > 0 && MaxAddresses > 0, "BasicTaxi needs room for a driver and an address");
+
+public:
+	static constexpr int DriverCapacity = MaxDrivers;
+	static constexpr int AddressCapacity = MaxAddresses;
+
+	BasicTaxi()
+	{
+		TAXI_LOG(LogLevel::Debug, "BasicTaxi default constructor called. Current number of taxi's classes - ", GetCount());
+		std::strcpy(Passenger, "Unknown");
+		Addresses.fill(INVALID_ADDRESS_ID);
+	}
+
+	BasicTaxi(const char* InPassenger,
+		const int* InDrivers, int InDriversCount,
+		const char (*InAddresses)[MAX_STR_LEN], int InAddressesCount)
+	{
+		TAXI_LOG(LogLevel::Debug, "BasicTaxi parameterized constructor called. Current number of taxi's classes - ", GetCount());
+		InPassenger ? std::strncpy(Passenger, InPassenger, MAX_STR_LEN - 1) : std::strcpy(Passenger, "Unknown");
+		Passenger[MAX_STR_LEN - 1] = '\0';
+
+		DriversCount = Fit((InDrivers && InDriversCount > 0) ? InDriversCount : 0, MaxDrivers, "drivers");
+		for (int i = 0; i < DriversCount; i++)
+		{
+			int State = InDrivers[i];
+			if (!IsValidDriverState(State))
+			{
+				TAXI_LOG(LogLevel::Warning, "Invalid driver state ", State, " of driver #", i, " stored as FREE");
+				State = DRIVER_FREE;
+			}
+			WriteDriver(i, State);
+		}
+		RecountDriverStates();
+		AddressesCount = Fit((InAddresses && InAddressesCount > 0) ? InAddressesCount : 0, MaxAddresses, "addresses");
+		Addresses.fill(INVALID_ADDRESS_ID);
+		for (int i = 0; i < AddressesCount; i++)
+			Addresses[i] = AddressPool::InternOrUnknown(InAddresses[i]);
+	}
+
+	explicit BasicTaxi(const Taxi& Other)
+	{
+		TAXI_LOG(LogLevel::Debug, "BasicTaxi conversion constructor called. Current number of taxi's classes - ", GetCount());
+		Assign(Other);
+	}
+
+	// The storage is inline, so a copy is a plain member copy with a new object number
+	BasicTaxi(const BasicTaxi& Other) = default;
+	BasicTaxi& operator=(const BasicTaxi& Other) = default;
+
+	// Same as a copy, but like Taxi the moved taxi keeps its identity
+	BasicTaxi(BasicTaxi&& Other) noexcept : BasicTaxi(static_cast<const BasicTaxi&>(Other))
+	{
+		std::swap(ObjectNumber, Other.ObjectNumber);
+	}
+
+	BasicTaxi& operator=(BasicTaxi&& Other) noexcept
+	{
+		*this = static_cast<const BasicTaxi&>(Other);
+		return *this;
+	}
+
+	// A dynamic Taxi with the same passenger, drivers and addresses
+	Taxi ToTaxi() const
+	{
+		Taxi Result;
+		std::strcpy(Result.Passenger, Passenger);
+		Result.SetDriversCount(DriversCount);
+		for (int i = 0; i < DriversCount; i++)
+			if (ReadDriver(i) != DRIVER_FREE)
+				Result.SetDriverState(i, ReadDriver(i));
+		Result.SetAddressesCount(AddressesCount);
+		for (int i = 0; i < AddressesCount; i++)
+			Result.SetAddress(i, AddressPool::Get(Addresses[i]));
+		return Result;
+	}
+
+	// Return number of free drivers
+	int Order() const { return StateCounts[DRIVER_FREE]; }
+
+	// Check if given address is in the array of addresses
+	bool Order(const char* InAddress) { return OrderDriver(InAddress) >= 0; }
+
+	// Same, returns the index of the driver that took the order or -1
+	int OrderDriver(const char* InAddress)
+	{
+		if (!InAddress || !*InAddress || StateCounts[DRIVER_FREE] == 0)
+			return -1;
+		if (!HasAddress(AddressPool::Find(InAddress)))
+			return -1;
+		// first FREE nibble of the used drivers, a word at a time
+		for (int w = 0; w < DriverWordCount; w++)
+		{
+			std::uint64_t Free = ZeroNibbles(Drivers[w]) & UsedMask(w);
+			if (Free)
+			{
+				int Index = w * DRIVERS_PER_WORD + std::countr_zero(Free) / DRIVER_STATE_BITS;
+				SetDriverState(Index, DRIVER_BUSY);
+				return Index;
+			}
+		}
+		return -1;
+	}
+
+	// Orders the driver by address
+	bool Order(int DriverIndex, const char* InAddress)
+	{
+		if (!InAddress || !*InAddress || DriverIndex < 0 || DriverIndex >= DriversCount)
+			return false;
+		if (ReadDriver(DriverIndex) != DRIVER_FREE || !HasAddress(AddressPool::Find(InAddress)))
+			return false;
+		return SetDriverState(DriverIndex, DRIVER_BUSY);
+	}
+
+	// Check if an interned address is one of ours. Unused slots hold INVALID_ADDRESS_ID,
+	// so every slot is compared and the loop has a fixed length.
+	bool HasAddress(AddressId Id) const
+	{
+		if (Id == INVALID_ADDRESS_ID)
+			return false;
+		bool Found = false;
+		for (int i = 0; i < MaxAddresses; i++)
+			Found |= Addresses[i] == Id;
+		return Found;
+	}
+
+	void PrintInfo() const override
+	{
+		std::string Info;
+		AppendInfo(Info, GetCount());
+		std::cout << Info << std::flush;
+	}
+
+	void AppendInfo(std::string& Out, int TotalCount) const override
+	{
+		Out += "Basic taxi:\nPassenger: ";
+		Out += Passenger;
+		Out += ", Total Taxi objects: ";
+		Out += std::to_string(TotalCount);
+		Out += '\n';
+	}
+
+	// State of a driver as an int (see DriverState.h), -1 for a bad index
+	int GetDriverState(int Index) const
+	{
+		if (Index < 0 || Index >= DriversCount)
+			return -1;
+		return ReadDriver(Index);
+	}
+
+	// Sets any valid state without checking the transition, returns false for a bad index or state
+	bool SetDriverState(int Index, int State)
+	{
+		if (Index < 0 || Index >= DriversCount || !IsValidDriverState(State))
+			return false;
+		StateCounts[ReadDriver(Index)]--;
+		StateCounts[State]++;
+		WriteDriver(Index, State);
+		return true;
+	}
+
+	// Moves a driver to another state if IsValidTransition allows it
+	bool TransitionDriver(int Index, DriverState To)
+	{
+		if (Index < 0 || Index >= DriversCount)
+			return false;
+		if (!IsValidTransition(static_cast<DriverState>(ReadDriver(Index)), To))
+			return false;
+		return SetDriverState(Index, static_cast<int>(To));
+	}
+
+	int GetDriversCount() const { return DriversCount; }
+	int GetFreeDriversCount() const { return StateCounts[DRIVER_FREE]; }
+	int GetDriversInState(DriverState State) const { return StateCounts[static_cast<int>(State)]; }
+
+	// Resizes to NewCount FREE drivers, at most MaxDrivers
+	void SetDriversCount(int NewCount)
+	{
+		DriversCount = Fit(NewCount > 0 ? NewCount : 0, MaxDrivers, "drivers");
+		Drivers.fill(0);
+		std::fill(std::begin(StateCounts), std::end(StateCounts), 0);
+		StateCounts[DRIVER_FREE] = DriversCount;
+	}
+
+	const char* GetAddress(int Index) const
+	{
+		if (Index < 0 || Index >= AddressesCount)
+			return nullptr;
+		return AddressPool::Get(Addresses[Index]);
+	}
+
+	// Keeps the old address when the address pool is full, like Taxi
+	void SetAddress(int Index, const char* NewAddress)
+	{
+		if (NewAddress)
+			SetAddress(Index, NewAddress, std::strlen(NewAddress));
+	}
+
+	// Same, for an address that is not zero terminated
+	void SetAddress(int Index, const char* NewAddress, std::size_t Length)
+	{
+		if (Index < 0 || Index >= AddressesCount || !NewAddress) return;
+		AddressId Id = AddressPool::Intern(NewAddress, Length);
+		if (Id != INVALID_ADDRESS_ID)
+			Addresses[Index] = Id;
+	}
+
+	int GetAddressesCount() const { return AddressesCount; }
+
+	// Resizes to NewCount "UnknownAddr" addresses, at most MaxAddresses
+	void SetAddressesCount(int NewCount)
+	{
+		AddressesCount = Fit(NewCount > 0 ? NewCount : 0, MaxAddresses, "addresses");
+		Addresses.fill(INVALID_ADDRESS_ID);
+		if (AddressesCount > 0)
+			std::fill_n(Addresses.begin(), AddressesCount, UNKNOWN_ADDRESS_ID);
+	}
+
+	// Implement IAutoNumber:
+	int GetObjectNumber() const override { return ObjectNumber; }
+	int GetTotalCount() const override { return GetCount(); }
+
+	// Implement IStringConvertible, in the TaxiCodec format. Both go through a Taxi,
+	// they are for files and consoles rather than hot paths.
+	std::string ToString() const override
+	{
+		return ToTaxi().ToString();
+	}
+
+	void AppendString(std::string& Out) const override
+	{
+		AppendTaxiString(ToTaxi(), Out);
+	}
+
+	void FromString(const std::string& InStr) override
+	{
+		Taxi Parsed = ToTaxi();
+		if (ParseTaxiString(InStr, Parsed))
+			Assign(Parsed);
+	}
+
+	char Passenger[MAX_STR_LEN];
+
+private:
+	static constexpr int DriverWordCount = (MaxDrivers + DRIVERS_PER_WORD - 1) / DRIVERS_PER_WORD;
+	// Lowest bit of every driver's nibble
+	static constexpr std::uint64_t NibbleLowBits = 0x1111111111111111ull;
+
+	static int Fit(int Count, int Capacity, const char* What)
+	{
+		if (Count <= Capacity)
+			return Count;
+		TAXI_LOG(LogLevel::Warning, "BasicTaxi holds ", Capacity, " ", What, ", ", Count - Capacity, " dropped");
+		return Capacity;
+	}
+
+	// Low bit of every nibble of Word that is zero
+	static std::uint64_t ZeroNibbles(std::uint64_t Word)
+	{
+		Word |= Word >> 1;
+		Word |= Word >> 2;
+		return ~Word & NibbleLowBits;
+	}
+
+	// Low bit of every nibble of word w that belongs to a driver
+	std::uint64_t UsedMask(int w) const
+	{
+		int Used = DriversCount - w * DRIVERS_PER_WORD;
+		if (Used >= DRIVERS_PER_WORD)
+			return NibbleLowBits;
+		return Used > 0 ? NibbleLowBits & ((std::uint64_t(1) << (Used * DRIVER_STATE_BITS)) - 1) : 0;
+	}
+
+	int ReadDriver(int Index) const
+	{
+		return static_cast<int>((Drivers[Index / DRIVERS_PER_WORD] >> (Index % DRIVERS_PER_WORD * DRIVER_STATE_BITS)) & 0xF);
+	}
+
+	void WriteDriver(int Index, int State)
+	{
+		int Shift = Index % DRIVERS_PER_WORD * DRIVER_STATE_BITS;
+		std::uint64_t& Word = Drivers[Index / DRIVERS_PER_WORD];
+		Word = (Word & ~(std::uint64_t(0xF) << Shift)) | (static_cast<std::uint64_t>(State) << Shift);
+	}
+
+	// Counts every state a word at a time: nibbles equal to State are zero after the xor
+	void RecountDriverStates()
+	{
+		for (int State = 0; State < DRIVER_STATE_COUNT; State++)
+		{
+			int Count = 0;
+			for (int w = 0; w < DriverWordCount; w++)
+				Count += std::popcount(ZeroNibbles(Drivers[w] ^ (State * NibbleLowBits)) & UsedMask(w));
+			StateCounts[State] = Count;
+		}
+	}
+
+	void Assign(const Taxi& Other)
+	{
+		std::strcpy(Passenger, Other.Passenger);
+		DriversCount = Fit(Other.GetDriversCount(), MaxDrivers, "drivers");
+		Drivers.fill(0);
+		for (int i = 0; i < DriversCount; i++)
+			WriteDriver(i, Other.GetDriverState(i));
+		RecountDriverStates();
+		AddressesCount = Fit(Other.GetAddressesCount(), MaxAddresses, "addresses");
+		Addresses.fill(INVALID_ADDRESS_ID);
+		for (int i = 0; i < AddressesCount; i++)
+		{
+			const char* Address = Other.GetAddress(i);
+			Addresses[i] = Address ? AddressPool::InternOrUnknown(Address) : UNKNOWN_ADDRESS_ID;
+		}
+	}
+
+	// Driver states, DRIVER_STATE_BITS each, unused ones stay zero
+	std::array<std::uint64_t, DriverWordCount> Drivers{};
+	std::array<AddressId, MaxAddresses> Addresses;
+	int DriversCount = 0;
+	int StateCounts[DRIVER_STATE_COUNT] = {};
+	int AddressesCount = 0;
+};
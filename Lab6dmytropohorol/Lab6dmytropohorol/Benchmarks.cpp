@@ -0,0 +1,1371 @@
+#include "Benchmarks.h"
+#include "AddressCatalog.h"
+#include "BasicTaxi.h"
+#include "DispatchClient.h"
+#include "DispatchServer.h"
+#include "DriverGrid.h"
+#include "FleetAvailability.h"
+#include "FleetCheckpoint.h"
+#include "FleetFile.h"
+#include "FleetIndex.h"
+#include "FleetJournal.h"
+#include "FleetSort.h"
+#include "Log.h"
+#include "LuxTaxi.h"
+#include "MiniTaxi.h"
+#include "PartitionedFleet.h"
+#include "PendingOrderQueue.h"
+#include "ShardRouter.h"
+#include "SharedFleetState.h"
+#include "StreamPipeline.h"
+#include "Taxi.h"
+#include "TaxiCodec.h"
+#include "TripScheduler.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#define TAXI_PERF_COUNTERS 1
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	double MsSince(Clock::time_point Start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - Start).count();
+	}
+
+	// Hardware cache misses of the calling thread between Start and Stop. Stop returns -1
+	// where the kernel offers no counter (other systems, most VMs and containers).
+	class CacheMissCounter
+	{
+	public:
+		CacheMissCounter()
+		{
+#ifdef TAXI_PERF_COUNTERS
+			perf_event_attr Attr = {};
+			Attr.type = PERF_TYPE_HARDWARE;
+			Attr.size = sizeof(Attr);
+			Attr.config = PERF_COUNT_HW_CACHE_MISSES;
+			Attr.disabled = 1;
+			Attr.exclude_kernel = 1;
+			Attr.exclude_hv = 1;
+			Fd = static_cast<int>(syscall(SYS_perf_event_open, &Attr, 0, -1, -1, 0));
+#endif
+		}
+		~CacheMissCounter()
+		{
+#ifdef TAXI_PERF_COUNTERS
+			if (Fd >= 0)
+				close(Fd);
+#endif
+		}
+		CacheMissCounter(const CacheMissCounter&) = delete;
+		CacheMissCounter& operator=(const CacheMissCounter&) = delete;
+
+		void Start()
+		{
+#ifdef TAXI_PERF_COUNTERS
+			if (Fd >= 0)
+			{
+				ioctl(Fd, PERF_EVENT_IOC_RESET, 0);
+				ioctl(Fd, PERF_EVENT_IOC_ENABLE, 0);
+			}
+#endif
+		}
+		long long Stop()
+		{
+#ifdef TAXI_PERF_COUNTERS
+			long long Count = 0;
+			if (Fd >= 0 && ioctl(Fd, PERF_EVENT_IOC_DISABLE, 0) == 0 && read(Fd, &Count, sizeof(Count)) == sizeof(Count))
+				return Count;
+#endif
+			return -1;
+		}
+
+	private:
+		int Fd = -1;
+	};
+
+	const int BenchDrivers[8] = { DRIVER_FREE, DRIVER_BUSY, DRIVER_FREE, DRIVER_FREE,
+		DRIVER_BUSY, DRIVER_FREE, DRIVER_BUSY, DRIVER_FREE };
+	const char BenchAddresses[4][MAX_STR_LEN] = { "MainStreet", "Broadway", "ParkAvenue", "HighStreet" };
+	const char* BenchPassengers[4] = { "Alice", "Bob", "Charlie", "Dave" };
+
+	// A service area of 32 streets, hashed by the compiler
+	constexpr AddressCatalog BenchCatalog({ "MainStreet", "Broadway", "ParkAvenue", "HighStreet",
+		"ChurchRoad", "StationRoad", "MillLane", "KingStreet", "QueenStreet", "BridgeStreet",
+		"MarketSquare", "VictoriaRoad", "GreenLane", "ManorRoad", "ParkRoad", "SchoolLane",
+		"CastleStreet", "NorthStreet", "SouthStreet", "EastStreet", "WestStreet", "LakeView",
+		"RiverSide", "HillTop", "ElmAvenue", "OakAvenue", "PineAvenue", "MapleAvenue",
+		"CedarRoad", "BirchRoad", "WillowWay", "HarborDrive" });
+	static_assert(BenchCatalog.IsValid() && BenchCatalog.Find("HarborDrive") == 31 && BenchCatalog.Find("Nowhere") < 0,
+		"the bench catalog must hash perfectly");
+
+	Taxi MakeBenchTaxi(int Index)
+	{
+		return Taxi(BenchPassengers[Index % 4], BenchDrivers, 1 + Index % 8, BenchAddresses, 4);
+	}
+
+	struct TaxiLayoutResult
+	{
+		double BuildMs = 0;
+		double QueryNs = 0;
+		long long Misses = -1;
+		long long Checksum = 0;
+	};
+
+	// Builds and destroys TaxiNum taxis of type T, and times QueryNum driver state and
+	// address lookups on them in random order
+	template <typename T>
+	TaxiLayoutResult MeasureTaxiLayout(int TaxiNum, int QueryNum)
+	{
+		TaxiLayoutResult Result;
+		ScopedLogLevel Quiet(LogLevel::Off);
+		AddressId Wanted = AddressPool::Intern(BenchAddresses[3]);
+		Clock::time_point Start = Clock::now();
+		{
+			std::vector<T> Fleet;
+			Fleet.reserve(TaxiNum);
+			for (int i = 0; i < TaxiNum; i++)
+				Fleet.emplace_back(BenchPassengers[i % 4], BenchDrivers, 1 + i % 8, BenchAddresses, 4);
+		}
+		Result.BuildMs = MsSince(Start);
+
+		std::vector<T> Fleet;
+		Fleet.reserve(TaxiNum);
+		for (int i = 0; i < TaxiNum; i++)
+			Fleet.emplace_back(BenchPassengers[i % 4], BenchDrivers, 1 + i % 8, BenchAddresses, 4);
+		CacheMissCounter Misses;
+		unsigned Random = 12345u;
+		Start = Clock::now();
+		Misses.Start();
+		for (int i = 0; i < QueryNum; i++)
+		{
+			Random = Random * 1103515245u + 12345u;
+			const T& Obj = Fleet[(Random >> 4) % static_cast<unsigned>(TaxiNum)];
+			Result.Checksum += Obj.GetDriverState(static_cast<int>(Random >> 28) % Obj.GetDriversCount())
+				+ Obj.HasAddress(Wanted);
+		}
+		Result.Misses = Misses.Stop();
+		Result.QueryNs = MsSince(Start) * 1e6 / QueryNum;
+		return Result;
+	}
+
+	// Checks the index answers against a count over the whole fleet
+	bool IndexMatchesRecount(const FleetIndex& Index, const std::vector<Taxi>& Fleet)
+	{
+		if (Index.GetSize() != static_cast<int>(Fleet.size()))
+			return false;
+		for (int MinFree = 0; MinFree <= 8; MinFree++)
+		{
+			std::size_t Expected = 0;
+			for (const Taxi& Obj : Fleet)
+				Expected += Obj.GetFreeDriversCount() >= MinFree;
+			std::vector<Taxi*> Found = Index.FindWithFreeDrivers(MinFree);
+			if (Found.size() != Expected)
+				return false;
+			for (std::size_t i = 1; i < Found.size(); i++)
+				if (Found[i - 1]->GetFreeDriversCount() < Found[i]->GetFreeDriversCount())
+					return false;
+			for (const char* Passenger : BenchPassengers)
+			{
+				Expected = 0;
+				for (const Taxi& Obj : Fleet)
+					Expected += Obj.GetFreeDriversCount() >= MinFree && std::strcmp(Obj.Passenger, Passenger) == 0;
+				Found = Index.FindByPassenger(Passenger, MinFree);
+				if (Found.size() != Expected)
+					return false;
+				for (const Taxi* Obj : Found)
+					if (std::strcmp(Obj->Passenger, Passenger) != 0 || Obj->GetFreeDriversCount() < MinFree)
+						return false;
+			}
+		}
+		return true;
+	}
+
+	// The ToString/FromString pair the codec replaced, kept as the baseline
+	std::string LegacyToString(const Taxi& Obj)
+	{
+		std::string result = "Passenger=";
+		result += Obj.Passenger;
+		result += ", DriversCount=" + std::to_string(Obj.GetDriversCount());
+		result += ", AddressesCount=" + std::to_string(Obj.GetAddressesCount());
+		return result;
+	}
+
+	void LegacyFromString(const std::string& InStr, Taxi& Obj)
+	{
+		std::size_t pPos = InStr.find("Passenger=");
+		if (pPos != std::string::npos) {
+			std::size_t comma = InStr.find(",", pPos);
+			if (comma == std::string::npos) comma = InStr.size();
+			std::string passVal = InStr.substr(pPos + 10, comma - (pPos + 10));
+			if (!passVal.empty() && passVal.size() < MAX_STR_LEN)
+				std::strcpy(Obj.Passenger, passVal.c_str());
+		}
+		std::size_t dPos = InStr.find("DriversCount=");
+		if (dPos != std::string::npos) {
+			std::size_t comma = InStr.find(",", dPos);
+			if (comma == std::string::npos) comma = InStr.size();
+			std::string dVal = InStr.substr(dPos + 13, comma - (dPos + 13));
+			int val = std::atoi(dVal.c_str());
+			if (val < 0) val = 0;
+			Obj.SetDriversCount(val);
+		}
+		std::size_t aPos = InStr.find("AddressesCount=");
+		if (aPos != std::string::npos) {
+			std::size_t comma = InStr.find(",", aPos);
+			if (comma == std::string::npos) comma = InStr.size();
+			std::string aVal = InStr.substr(aPos + 15, comma - (aPos + 15));
+			int val = std::atoi(aVal.c_str());
+			if (val < 0) val = 0;
+			Obj.SetAddressesCount(val);
+		}
+	}
+}
+
+void BenchmarkVectorGrowth(int TaxiNum)
+{
+	double Ms;
+	{
+		ScopedLogLevel Quiet(LogLevel::Off);
+		Clock::time_point Start = Clock::now();
+		std::vector<Taxi> Fleet;
+		for (int i = 0; i < TaxiNum; i++)
+			Fleet.push_back(MakeBenchTaxi(i));
+		Ms = MsSince(Start);
+	}
+	std::cout << "vector<Taxi> growth, " << TaxiNum << " taxis: " << Ms << " ms\n";
+}
+
+void BenchmarkVectorSort(int TaxiNum)
+{
+	double Ms;
+	{
+		ScopedLogLevel Quiet(LogLevel::Off);
+		std::vector<Taxi> Fleet;
+		Fleet.reserve(TaxiNum);
+		for (int i = 0; i < TaxiNum; i++)
+			Fleet.push_back(MakeBenchTaxi((i * 7919) % TaxiNum));
+		Clock::time_point Start = Clock::now();
+		std::sort(Fleet.begin(), Fleet.end());
+		Ms = MsSince(Start);
+	}
+	std::cout << "vector<Taxi> sort, " << TaxiNum << " taxis: " << Ms << " ms\n";
+}
+
+void BenchmarkFleetCopy(int TaxiNum)
+{
+	double DeepMs, SharedMs;
+	{
+		ScopedLogLevel Quiet(LogLevel::Off);
+		std::vector<Taxi> Fleet;
+		Fleet.reserve(TaxiNum);
+		for (int i = 0; i < TaxiNum; i++)
+			Fleet.push_back(MakeBenchTaxi(i));
+
+		auto CopyFleet = [&Fleet](AddressCopy Mode)
+		{
+			std::vector<Taxi> Copy;
+			Copy.reserve(Fleet.size());
+			for (const Taxi& Obj : Fleet)
+				Copy.emplace_back(Obj, Mode);
+		};
+		Clock::time_point Start = Clock::now();
+		CopyFleet(AddressCopy::Deep);
+		DeepMs = MsSince(Start);
+		Start = Clock::now();
+		CopyFleet(AddressCopy::Shared);
+		SharedMs = MsSince(Start);
+	}
+	std::cout << "vector<Taxi> copy, " << TaxiNum << " taxis: deep " << DeepMs
+		<< " ms, copy-on-write " << SharedMs << " ms\n";
+}
+
+void BenchmarkFleetLoad(int TaxiNum)
+{
+	const char* FileName = "bench_fleet.bin";
+	double SequentialMs, ParallelMs;
+	bool Ok;
+	{
+		ScopedLogLevel Quiet(LogLevel::Off);
+		std::vector<Taxi> Fleet;
+		Fleet.reserve(TaxiNum);
+		for (int i = 0; i < TaxiNum; i++)
+			Fleet.push_back(MakeBenchTaxi(i));
+		Ok = SaveFleet(FileName, Fleet);
+		FleetFile File;
+		Ok = Ok && File.Open(FileName);
+
+		Clock::time_point Start = Clock::now();
+		{
+			std::vector<Taxi> Loaded;
+			Ok = Ok && File.LoadAll(Loaded);
+		}
+		SequentialMs = MsSince(Start);
+
+		Start = Clock::now();
+		{
+			std::vector<Taxi> Loaded;
+			Ok = Ok && File.LoadAllParallel(Loaded);
+		}
+		ParallelMs = MsSince(Start);
+	}
+	std::remove(FileName);
+	if (!Ok)
+	{
+		std::cout << "fleet load benchmark failed\n";
+		return;
+	}
+	std::cout << "fleet file load, " << TaxiNum << " taxis: sequential " << SequentialMs
+		<< " ms, parallel " << ParallelMs << " ms\n";
+}
+
+void BenchmarkSortEngine(int ObjectNum, int TaxiNum)
+{
+	// lightweight numbered objects, so only the sort itself is measured
+	struct NumberedObject : IAutoNumber
+	{
+		int Number = 0;
+		int GetObjectNumber() const override { return Number; }
+		int GetTotalCount() const override { return 0; }
+	};
+	double NumberMs;
+	{
+		std::vector<NumberedObject> Objects(ObjectNum);
+		std::vector<IAutoNumber*> Pointers(ObjectNum);
+		for (int i = 0; i < ObjectNum; i++)
+		{
+			Objects[i].Number = static_cast<int>((i * 2654435761u) % static_cast<unsigned>(ObjectNum));
+			Pointers[i] = &Objects[i];
+		}
+		Clock::time_point Start = Clock::now();
+		SortByObjectNumber(Pointers.data(), ObjectNum);
+		NumberMs = MsSince(Start);
+		for (int i = 1; i < ObjectNum; i++)
+			if (Pointers[i - 1]->GetObjectNumber() > Pointers[i]->GetObjectNumber())
+			{
+				std::cout << "SortByObjectNumber benchmark failed\n";
+				return;
+			}
+	}
+
+	double StdSortMs, EngineMs;
+	{
+		ScopedLogLevel Quiet(LogLevel::Off);
+		// one fleet sorted both ways, a second one of 10M taxis would not fit next to it
+		std::vector<Taxi> Fleet;
+		Fleet.reserve(TaxiNum);
+		for (int i = 0; i < TaxiNum; i++)
+			Fleet.push_back(MakeBenchTaxi((i * 7919) % TaxiNum));
+
+		Clock::time_point Start = Clock::now();
+		std::sort(Fleet.begin(), Fleet.end());
+		StdSortMs = MsSince(Start);
+		bool Sorted = std::is_sorted(Fleet.begin(), Fleet.end());
+
+		for (int i = 0; i < TaxiNum; i++)
+			Fleet[i] = MakeBenchTaxi((i * 7919) % TaxiNum);
+		Start = Clock::now();
+		SortTaxis(Fleet);
+		EngineMs = MsSince(Start);
+		if (!Sorted || !std::is_sorted(Fleet.begin(), Fleet.end()))
+		{
+			std::cout << "Taxi sort benchmark failed\n";
+			return;
+		}
+	}
+	std::cout << "SortByObjectNumber, " << ObjectNum << " objects: " << NumberMs << " ms\n"
+		<< "Taxi sort, " << TaxiNum << " taxis: std::sort " << StdSortMs << " ms, SortTaxis " << EngineMs << " ms\n";
+}
+
+void BenchmarkConstructionLogging(int TaxiNum)
+{
+	const char* FileName = "bench_log.txt";
+	auto BuildFleet = [TaxiNum]()
+	{
+		Clock::time_point Start = Clock::now();
+		{
+			std::vector<Taxi> Fleet;
+			Fleet.reserve(TaxiNum);
+			for (int i = 0; i < TaxiNum; i++)
+				Fleet.emplace_back(BenchPassengers[i % 4], BenchDrivers, 8, BenchAddresses, 4);
+		}
+		return MsSince(Start);
+	};
+
+	double OffMs, SyncMs, AsyncMs;
+	{
+		ScopedLogLevel Quiet(LogLevel::Off);
+		OffMs = BuildFleet();
+	}
+	{
+		std::ofstream LogFile(FileName);
+		Logger::SetStream(LogFile);
+		SyncMs = BuildFleet();
+		Logger::SetAsync(true);
+		AsyncMs = BuildFleet();
+		Logger::Flush();
+		Logger::SetAsync(false);
+		Logger::SetStream(std::cout);
+	}
+	std::remove(FileName);
+	std::cout << "Taxi construction + destruction, " << TaxiNum << " taxis: logging off " << OffMs
+		<< " ms, sync sink " << SyncMs << " ms, async sink " << AsyncMs << " ms"
+		<< " (TAXI_LOG_MIN_LEVEL=" << TAXI_LOG_MIN_LEVEL << ")\n";
+}
+
+void BenchmarkStringCodec(int TaxiNum)
+{
+	double LegacyEncodeMs, LegacyDecodeMs, EncodeMs, ToStringMs, DecodeMs, DecodeLegacyMs;
+	std::size_t LegacyBytes = 0, Bytes = 0;
+	{
+		ScopedLogLevel Quiet(LogLevel::Off);
+		std::vector<Taxi> Fleet;
+		Fleet.reserve(TaxiNum);
+		for (int i = 0; i < TaxiNum; i++)
+			Fleet.push_back(MakeBenchTaxi(i));
+		std::vector<std::string> Lines(TaxiNum);
+		Taxi Target;
+
+		Clock::time_point Start = Clock::now();
+		for (int i = 0; i < TaxiNum; i++)
+			Lines[i] = LegacyToString(Fleet[i]);
+		LegacyEncodeMs = MsSince(Start);
+		for (const std::string& Line : Lines)
+			LegacyBytes += Line.size();
+		Start = Clock::now();
+		for (int i = 0; i < TaxiNum; i++)
+			LegacyFromString(Lines[i], Target);
+		LegacyDecodeMs = MsSince(Start);
+		// same input for both parsers
+		Start = Clock::now();
+		for (int i = 0; i < TaxiNum; i++)
+			ParseTaxiString(Lines[i], Target);
+		DecodeLegacyMs = MsSince(Start);
+
+		// one reused buffer, the way a message bus would encode record after record
+		std::string Buffer;
+		Start = Clock::now();
+		for (int i = 0; i < TaxiNum; i++)
+		{
+			Buffer.clear();
+			Fleet[i].AppendString(Buffer);
+			Bytes += Buffer.size();
+		}
+		EncodeMs = MsSince(Start);
+		// a new string per call, like the legacy encode
+		Start = Clock::now();
+		for (int i = 0; i < TaxiNum; i++)
+			Lines[i] = Fleet[i].ToString();
+		ToStringMs = MsSince(Start);
+		Start = Clock::now();
+		for (int i = 0; i < TaxiNum; i++)
+			ParseTaxiString(Lines[i], Target);
+		DecodeMs = MsSince(Start);
+	}
+	std::cout << "ToString/FromString, " << TaxiNum << " taxis: legacy encode " << LegacyEncodeMs
+		<< " ms, decode " << LegacyDecodeMs << " ms (" << LegacyBytes << " bytes, counts only)\n"
+		<< "  codec encode " << EncodeMs << " ms into one buffer, " << ToStringMs << " ms with ToString, decode " << DecodeMs << " ms (" << Bytes
+		<< " bytes, all fields), decode of the legacy strings " << DecodeLegacyMs << " ms\n";
+}
+
+void BenchmarkStreamConversion(int LineNum)
+{
+	double LineMs, PipelineMs;
+	std::size_t InBytes;
+	{
+		ScopedLogLevel Quiet(LogLevel::Off);
+		std::string Input;
+		for (int i = 0; i < LineNum; i++)
+		{
+			Input += MakeBenchTaxi(i).ToString();
+			Input += '\n';
+		}
+		InBytes = Input.size();
+
+		// the StreamConversion way: getline, then FromString and ToString through the interface
+		std::istringstream In(Input);
+		std::ostringstream Out;
+		LuxTaxi Target;
+		IStringConvertible* Conv = &Target;
+		std::string Line;
+		Clock::time_point Start = Clock::now();
+		while (std::getline(In, Line))
+		{
+			Conv->FromString(Line);
+			Out << Conv->ToString() << "\n";
+		}
+		LineMs = MsSince(Start);
+
+		std::istringstream BulkIn(Input);
+		std::ostringstream BulkOut;
+		Start = Clock::now();
+		StreamConversionBulk<LuxTaxi>(BulkIn, BulkOut);
+		PipelineMs = MsSince(Start);
+	}
+	std::cout << "Stream conversion, " << LineNum << " lines (" << InBytes / (1 << 20) << " MB): line by line "
+		<< LineMs << " ms, pipeline " << PipelineMs << " ms\n";
+}
+
+void BenchmarkPrintInfo(int TaxiNum)
+{
+	const char* FileName = "bench_report.txt";
+	double VirtualMs, BatchMs;
+	{
+		ScopedLogLevel Quiet(LogLevel::Off);
+		PartitionedFleet Fleet;
+		Fleet.Reserve(TaxiNum / 3 + 1, TaxiNum / 3 + 1, TaxiNum / 3 + 1);
+		for (int i = 0; i < TaxiNum; i++)
+		{
+			if (i % 3 == 0)
+				Fleet.Add(MakeBenchTaxi(i));
+			else if (i % 3 == 1)
+				Fleet.Add(LuxTaxi(BenchPassengers[i % 4], BenchDrivers, 8, BenchAddresses, 4));
+			else
+				Fleet.Add(MiniTaxi(BenchPassengers[i % 4], BenchDrivers, 8, BenchAddresses, 4));
+		}
+		// the same objects interleaved behind AbstractTaxi*, the way main() prints them
+		std::vector<AbstractTaxi*> Mixed;
+		Mixed.reserve(TaxiNum);
+		for (int i = 0; i < TaxiNum; i++)
+		{
+			if (i % 3 == 0)
+				Mixed.push_back(&Fleet.GetTaxis()[i / 3]);
+			else if (i % 3 == 1)
+				Mixed.push_back(&Fleet.GetLuxTaxis()[i / 3]);
+			else
+				Mixed.push_back(&Fleet.GetMiniTaxis()[i / 3]);
+		}
+
+		std::ofstream Report(FileName);
+		std::streambuf* OldBuf = std::cout.rdbuf(Report.rdbuf());
+		Clock::time_point Start = Clock::now();
+		for (AbstractTaxi* Obj : Mixed)
+			Obj->PrintInfo();
+		VirtualMs = MsSince(Start);
+		std::cout.rdbuf(OldBuf);
+
+		Start = Clock::now();
+		Fleet.PrintInfo(Report);
+		BatchMs = MsSince(Start);
+	}
+	std::remove(FileName);
+	std::cout << "PrintInfo report, " << TaxiNum << " mixed taxis: virtual per object " << VirtualMs
+		<< " ms, PartitionedFleet " << BatchMs << " ms\n";
+}
+
+void BenchmarkAvailability(int TaxiNum)
+{
+	double ScanMs, AggregateMs, TotalMs;
+	long long ScanFree = 0, BusyTotal = 0;
+	AvailabilityReport Report;
+	{
+		ScopedLogLevel Quiet(LogLevel::Off);
+		std::vector<Taxi> Fleet;
+		Fleet.reserve(TaxiNum);
+		for (int i = 0; i < TaxiNum; i++)
+			Fleet.push_back(MakeBenchTaxi(i));
+		FleetAvailability Availability;
+		Availability.Attach(Fleet);
+
+		// what a caller had to do before: walk every driver of every taxi
+		Clock::time_point Start = Clock::now();
+		for (const Taxi& Obj : Fleet)
+			for (int d = 0; d < Obj.GetDriversCount(); d++)
+				ScanFree += Obj.GetDriverState(d) == DRIVER_FREE;
+		ScanMs = MsSince(Start);
+
+		Start = Clock::now();
+		Report = Availability.Aggregate();
+		AggregateMs = MsSince(Start);
+		Start = Clock::now();
+		for (int r = 0; r < 100; r++)
+			BusyTotal = Availability.CountBusy();
+		TotalMs = MsSince(Start) / 100;
+	}
+	if (Report.FreeDrivers != ScanFree || Report.BusyDrivers != BusyTotal)
+	{
+		std::cout << "Availability benchmark failed\n";
+		return;
+	}
+	std::cout << "Availability, " << TaxiNum << " taxis / " << Report.TotalDrivers << " drivers: per-driver scan "
+		<< ScanMs << " ms; Aggregate " << AggregateMs << " ms; busy total " << TotalMs
+		<< " ms (median free per taxi " << Report.FreePercentile(50) << ")\n";
+}
+
+void BenchmarkTripScheduler(int TripNum)
+{
+	const int DriversPerTaxi = 100;
+	const std::uint32_t MaxDuration = 3600;
+	double StartMs, AdvanceMs;
+	int Started = 0, Released = 0;
+	{
+		ScopedLogLevel Quiet(LogLevel::Off);
+		std::vector<int> Drivers(DriversPerTaxi, DRIVER_FREE);
+		std::vector<Taxi> Fleet;
+		int TaxiNum = TripNum / DriversPerTaxi + 1;
+		Fleet.reserve(TaxiNum);
+		for (int i = 0; i < TaxiNum; i++)
+			Fleet.emplace_back(BenchPassengers[i % 4], Drivers.data(), DriversPerTaxi, BenchAddresses, 4);
+
+		TripScheduler Trips;
+		Clock::time_point Start = Clock::now();
+		for (int i = 0; i < TripNum; i++)
+			if (Trips.StartTrip(Fleet[i / DriversPerTaxi], BenchAddresses[i % 4], 1 + (i * 2654435761u) % MaxDuration))
+				Started++;
+		StartMs = MsSince(Start);
+
+		Start = Clock::now();
+		for (std::uint32_t t = 0; t < MaxDuration; t++)
+			Released += Trips.Advance(1);
+		AdvanceMs = MsSince(Start);
+	}
+	std::cout << "Trip scheduler, " << Started << " trips: start " << StartMs << " ms, "
+		<< MaxDuration << " ticks releasing " << Released << " drivers " << AdvanceMs << " ms\n";
+}
+
+void BenchmarkNearestDriver(int DriverNum)
+{
+	const int DriversPerTaxi = 100;
+	const float CitySize = 10000;
+	const int QueryNum = 1000000;
+	const int LinearQueryNum = 2000;
+	double GridNs, LinearNs;
+	int Mismatches = 0, FreeDrivers;
+	{
+		ScopedLogLevel Quiet(LogLevel::Off);
+		std::mt19937 Random(43);
+		std::uniform_real_distribution<float> Coordinate(0, CitySize);
+		int TaxiNum = (DriverNum + DriversPerTaxi - 1) / DriversPerTaxi;
+		std::vector<Taxi> Fleet;
+		Fleet.reserve(TaxiNum);
+		std::vector<int> Drivers(DriversPerTaxi);
+		for (int i = 0; i < TaxiNum; i++)
+		{
+			for (int& State : Drivers)
+				State = Random() % 2 ? DRIVER_FREE : DRIVER_BUSY;
+			Fleet.emplace_back(BenchPassengers[i % 4], Drivers.data(), DriversPerTaxi, BenchAddresses, 4);
+		}
+		// about two free drivers per cell
+		DriverGrid Grid(GeoPoint{ 0, 0 }, GeoPoint{ CitySize, CitySize }, CitySize / std::sqrt(DriverNum / 4.0f));
+		std::vector<GeoPoint> Positions(DriversPerTaxi);
+		for (Taxi& Obj : Fleet)
+		{
+			for (GeoPoint& Position : Positions)
+				Position = GeoPoint{ Coordinate(Random), Coordinate(Random) };
+			Grid.AddTaxi(Obj, Positions.data());
+		}
+		FreeDrivers = Grid.GetFreeCount();
+		std::vector<GeoPoint> Queries(QueryNum);
+		for (GeoPoint& Query : Queries)
+			Query = GeoPoint{ Coordinate(Random), Coordinate(Random) };
+
+		float Sum = 0;
+		Clock::time_point Start = Clock::now();
+		for (const GeoPoint& Query : Queries)
+			Sum += Grid.FindNearestFree(Query).Distance;
+		GridNs = MsSince(Start) * 1e6 / QueryNum;
+
+		Start = Clock::now();
+		for (int i = 0; i < LinearQueryNum; i++)
+			Sum += Grid.FindNearestFreeLinear(Queries[i]).Distance;
+		LinearNs = MsSince(Start) * 1e6 / LinearQueryNum;
+
+		for (int i = 0; i < LinearQueryNum; i++)
+			Mismatches += Grid.FindNearestFree(Queries[i]).Distance != Grid.FindNearestFreeLinear(Queries[i]).Distance;
+		if (Sum < 0)
+			std::cout << Sum;
+	}
+	std::cout << "Nearest free driver, " << DriverNum << " drivers (" << FreeDrivers << " free): grid "
+		<< GridNs << " ns/query, linear scan " << LinearNs << " ns/query, "
+		<< Mismatches << " mismatches\n";
+}
+
+void BenchmarkJournal(int TaxiNum)
+{
+	const char* BasePath = "bench_journal";
+	const char* TextFileName = "bench_fleet.txt";
+	const int ChangeNum = 1000000;
+	double LogMs, SyncMs, CheckpointMs, TextLoadMs, RecoverMs = 0;
+	std::uint64_t Syncs;
+	JournalRecoveryStats Recovery;
+	bool Ok;
+	{
+		ScopedLogLevel Quiet(LogLevel::Off);
+		std::remove((std::string(BasePath) + ".snap").c_str());
+		std::remove((std::string(BasePath) + ".wal").c_str());
+		std::vector<Taxi> Fleet;
+		FleetJournal Journal;
+		Ok = Journal.Open(BasePath, Fleet);
+		Fleet.reserve(TaxiNum);
+		for (int i = 0; i < TaxiNum; i++)
+			Fleet.push_back(MakeBenchTaxi(i));
+
+		Clock::time_point Start = Clock::now();
+		Ok = Ok && Journal.Checkpoint();
+		CheckpointMs = MsSince(Start);
+
+		Start = Clock::now();
+		for (int i = 0; i < ChangeNum; i++)
+		{
+			Taxi& Obj = Fleet[(i * 7919LL) % TaxiNum];
+			// now and then a resize, logged as the whole taxi
+			if (i % 1000 == 999)
+				Obj.SetDriversCount(Obj.GetDriversCount());
+			else
+				Obj.SetDriverState(i % Obj.GetDriversCount(), i % DRIVER_STATE_COUNT);
+		}
+		LogMs = MsSince(Start);
+		Start = Clock::now();
+		Ok = Ok && Journal.Sync();
+		SyncMs = MsSince(Start);
+		Syncs = Journal.GetSyncCount();
+		Journal.Close();
+
+		// what a restart did before: reload the whole fleet from text
+		Ok = Ok && SaveFleet(TextFileName, Fleet, FleetEncoding::Text);
+		FleetFile TextFile;
+		Ok = Ok && TextFile.Open(TextFileName);
+		Start = Clock::now();
+		{
+			std::vector<Taxi> Loaded;
+			Ok = Ok && TextFile.LoadAll(Loaded);
+		}
+		TextLoadMs = MsSince(Start);
+		TextFile.Close();
+
+		std::vector<Taxi> Recovered;
+		Ok = Ok && Journal.Open(BasePath, Recovered, &Recovery);
+		RecoverMs = Recovery.Milliseconds;
+		Ok = Ok && Recovered.size() == Fleet.size();
+		for (std::size_t i = 0; Ok && i < Fleet.size(); i++)
+			for (int d = 0; Ok && d < Fleet[i].GetDriversCount(); d++)
+				Ok = Recovered[i].GetDriverState(d) == Fleet[i].GetDriverState(d);
+		Journal.Close();
+	}
+	std::remove((std::string(BasePath) + ".snap").c_str());
+	std::remove((std::string(BasePath) + ".wal").c_str());
+	std::remove(TextFileName);
+	if (!Ok)
+	{
+		std::cout << "journal benchmark failed\n";
+		return;
+	}
+	std::cout << "Journal, " << TaxiNum << " taxis: checkpoint " << CheckpointMs << " ms, "
+		<< ChangeNum << " changes logged in " << LogMs << " ms + final sync " << SyncMs << " ms ("
+		<< Syncs << " group commits); recovery " << RecoverMs << " ms (" << Recovery.Records
+		<< " records, " << Recovery.Superseded << " superseded) vs text reload " << TextLoadMs << " ms\n";
+}
+
+void BenchmarkDeltaCheckpoint(int TaxiNum)
+{
+	const char* BasePath = "bench_checkpoint";
+	const int RoundNum = 10;
+	const int ChangesPerRound = 1000;
+	auto RemoveFiles = [BasePath]
+	{
+		std::remove((std::string(BasePath) + ".delta").c_str());
+		for (int i = 1; i <= RoundNum + 2; i++)
+			std::remove((std::string(BasePath) + "." + std::to_string(i) + ".base").c_str());
+	};
+	double FullMs = 0, DeltaMs = 0, CompactMs, LoadMs;
+	std::uint64_t FullBytes = 0, DeltaBytes = 0;
+	bool Ok;
+	{
+		ScopedLogLevel Quiet(LogLevel::Off);
+		RemoveFiles();
+		std::vector<Taxi> Fleet;
+		Fleet.reserve(TaxiNum);
+		for (int i = 0; i < TaxiNum; i++)
+			Fleet.push_back(MakeBenchTaxi(i));
+		FleetCheckpoint Checkpoint(BasePath);
+		Checkpoint.SetCompactionBytes(0);
+		CheckpointStats Stats;
+		Ok = Checkpoint.Save(Fleet, &Stats);
+
+		for (int Round = 0; Ok && Round < RoundNum; Round++)
+		{
+			for (int i = 0; i < ChangesPerRound; i++)
+			{
+				Taxi& Obj = Fleet[((Round * ChangesPerRound + i) * 7919LL) % TaxiNum];
+				Obj.SetDriverState(i % Obj.GetDriversCount(), (Round + i) % DRIVER_STATE_COUNT);
+			}
+			Ok = Checkpoint.Save(Fleet, &Stats) && !Stats.Full;
+			DeltaMs += Stats.Milliseconds;
+			DeltaBytes += Stats.Bytes;
+			// what every checkpoint cost before
+			Ok = Ok && Checkpoint.SaveFull(Fleet, &Stats);
+			FullMs += Stats.Milliseconds;
+			FullBytes += Stats.Bytes;
+		}
+
+		// fold a delta file into a new base while the fleet stays usable
+		for (int i = 0; Ok && i < ChangesPerRound; i++)
+			Fleet[(i * 7919LL) % TaxiNum].SetDriverState(0, DRIVER_BUSY);
+		Ok = Ok && Checkpoint.Save(Fleet);
+		Clock::time_point Start = Clock::now();
+		Ok = Ok && Checkpoint.StartCompaction() && Checkpoint.WaitForCompaction();
+		CompactMs = MsSince(Start);
+
+		std::vector<Taxi> Loaded;
+		Start = Clock::now();
+		Ok = Ok && Checkpoint.Load(Loaded);
+		LoadMs = MsSince(Start);
+		Ok = Ok && Loaded.size() == Fleet.size();
+		for (std::size_t i = 0; Ok && i < Fleet.size(); i++)
+			Ok = Loaded[i].GetDriversInState(DriverState::Offline) == Fleet[i].GetDriversInState(DriverState::Offline)
+				&& Loaded[i].GetFreeDriversCount() == Fleet[i].GetFreeDriversCount();
+	}
+	RemoveFiles();
+	if (!Ok)
+	{
+		std::cout << "delta checkpoint benchmark failed\n";
+		return;
+	}
+	std::cout << "Checkpoint, " << TaxiNum << " taxis, " << ChangesPerRound << " changes per save: delta "
+		<< DeltaMs / RoundNum << " ms / " << DeltaBytes / RoundNum << " bytes vs full "
+		<< FullMs / RoundNum << " ms / " << FullBytes / RoundNum << " bytes; compaction "
+		<< CompactMs << " ms, load " << LoadMs << " ms\n";
+}
+
+void BenchmarkDispatchServer(int RequestNum)
+{
+	const int TaxiNum = 10000;
+	// the fleet lives until the end, keep its destructors quiet too
+	ScopedLogLevel Quiet(LogLevel::Off);
+	std::vector<Taxi> Fleet;
+	Fleet.reserve(TaxiNum);
+	for (int i = 0; i < TaxiNum; i++)
+		Fleet.push_back(MakeBenchTaxi(i));
+	DispatchServer Server(Fleet);
+	if (!Server.ListenTcp(0))
+	{
+		std::cout << "dispatch server benchmark skipped\n";
+		return;
+	}
+	std::thread ServerThread([&Server] { Server.Run(); });
+
+	// one request per round trip against pipelined batches
+	const int Pipelines[] = { 1, 32 };
+	DispatchLoadStats Load[2];
+	bool Ok = true;
+	for (int i = 0; i < 2 && Ok; i++)
+	{
+		DispatchLoadOptions Options;
+		Options.Port = Server.GetPort();
+		Options.Connections = 4;
+		Options.Pipeline = Pipelines[i];
+		Options.Requests = Pipelines[i] == 1 ? RequestNum / 10 : RequestNum;
+		Ok = RunDispatchLoad(Options, Load[i]) && Load[i].BadRequests == 0;
+	}
+	Server.Stop();
+	ServerThread.join();
+	if (!Ok)
+	{
+		std::cout << "dispatch server benchmark failed\n";
+		return;
+	}
+	DispatchServerStats Stats = Server.GetStats();
+	for (int i = 0; i < 2; i++)
+		std::cout << "Dispatch server, " << Load[i].Requests << " requests over 4 connections, pipeline "
+			<< Pipelines[i] << ": " << static_cast<long long>(Load[i].Qps) << " req/s, p50 " << Load[i].P50Us
+			<< " us, p99 " << Load[i].P99Us << " us\n";
+	std::cout << "Dispatch server wrote " << Stats.Requests << " responses in " << Stats.Writes << " writes\n";
+}
+
+void BenchmarkSharedFleet(int TaxiNum)
+{
+	const char* SegmentName = "/bench_shared_fleet";
+	const char* FileName = "bench_shared_fleet.bin";
+	const int ChangeNum = 1000000;
+	const int QueryNum = 1000000;
+	double PlainNs, SharedNs, QueryNs, ScanMs, FileMs;
+	long long SharedFree = 0;
+	bool Ok;
+	{
+		ScopedLogLevel Quiet(LogLevel::Off);
+		std::vector<Taxi> Fleet;
+		Fleet.reserve(TaxiNum);
+		for (int i = 0; i < TaxiNum; i++)
+			Fleet.push_back(MakeBenchTaxi(i));
+		auto Change = [&Fleet, TaxiNum](int Round)
+		{
+			for (int i = 0; i < ChangeNum; i++)
+			{
+				Taxi& Obj = Fleet[(i * 7919LL) % TaxiNum];
+				Obj.SetDriverState(i % Obj.GetDriversCount(), (i + Round) % DRIVER_STATE_COUNT);
+			}
+		};
+		Clock::time_point Start = Clock::now();
+		Change(0);
+		PlainNs = MsSince(Start) * 1e6 / ChangeNum;
+
+		SharedFleetState Writer;
+		SharedFleetReader Reader;
+		Ok = Writer.Create(SegmentName, Fleet) && Reader.Open(SegmentName);
+		Start = Clock::now();
+		Change(1);
+		SharedNs = MsSince(Start) * 1e6 / ChangeNum;
+
+		// what a reader sees without touching the writer
+		int Checksum = 0;
+		Start = Clock::now();
+		for (int i = 0; Ok && i < QueryNum; i++)
+			Checksum += Reader.GetDriverState((i * 7919LL) % TaxiNum, 0);
+		QueryNs = MsSince(Start) * 1e6 / QueryNum;
+		Start = Clock::now();
+		SharedFree = Reader.GetFleetFreeCount();
+		ScanMs = MsSince(Start);
+
+		long long FleetFree = 0;
+		for (const Taxi& Obj : Fleet)
+			FleetFree += Obj.GetFreeDriversCount();
+		Ok = Ok && Checksum >= 0 && SharedFree == FleetFree;
+
+		// what a reader did before: the writer saves, the reader loads the whole file
+		Start = Clock::now();
+		Ok = Ok && SaveFleet(FileName, Fleet);
+		FleetFile File;
+		std::vector<Taxi> Loaded;
+		Ok = Ok && File.Open(FileName) && File.LoadAll(Loaded);
+		long long LoadedFree = 0;
+		for (const Taxi& Obj : Loaded)
+			LoadedFree += Obj.GetFreeDriversCount();
+		FileMs = MsSince(Start);
+		Ok = Ok && LoadedFree == FleetFree;
+		File.Close();
+		Writer.Close();
+	}
+	std::remove(FileName);
+	if (!Ok)
+	{
+		std::cout << "shared fleet benchmark failed\n";
+		return;
+	}
+	std::cout << "Shared fleet, " << TaxiNum << " taxis: driver change " << PlainNs << " ns, published to shared memory "
+		<< SharedNs << " ns; reader query " << QueryNs << " ns, fleet free count " << ScanMs
+		<< " ms vs save + load file " << FileMs << " ms\n";
+}
+
+void BenchmarkShardedDispatch(int TaxiNum, int RequestNum)
+{
+	const int ShardCounts[] = { 1, 2, 4 };
+	const int ThreadNum = 4;
+	// Requests per shard in one Execute. A batch of a fixed total would give every shard
+	// a smaller share as shards are added, and cost each of them a message and a wake-up
+	// for fewer requests.
+	const int PipelinePerShard = 32;
+	const int GatherNum = 1000;
+	// the shard fleets live until the end, keep their destructors quiet too
+	ScopedLogLevel Quiet(LogLevel::Off);
+	for (int ShardCount : ShardCounts)
+	{
+		const int Pipeline = PipelinePerShard * ShardCount;
+		const int PerThread = (RequestNum / ThreadNum + Pipeline - 1) / Pipeline * Pipeline;
+		std::vector<Taxi> Fleet;
+		Fleet.reserve(TaxiNum);
+		for (int i = 0; i < TaxiNum; i++)
+			Fleet.push_back(MakeBenchTaxi(i));
+		std::vector<std::int32_t> DriversCounts;
+		long long FleetFree = 0;
+		for (const Taxi& Obj : Fleet)
+		{
+			DriversCounts.push_back(Obj.GetDriversCount());
+			FleetFree += Obj.GetFreeDriversCount();
+		}
+		const char* Address = Fleet[0].GetAddress(0);
+		std::string OrderAddress = Address ? Address : "";
+
+		auto Directory = std::make_shared<std::vector<ShardLocation>>();
+		std::vector<std::vector<Taxi>> Shards = SplitFleet(Fleet, ShardCount, ShardKey::ObjectNumber, *Directory);
+		ShardWorkers Workers;
+		if (!Workers.Start(Shards, "bench_shard"))
+		{
+			std::cout << "sharded dispatch benchmark skipped\n";
+			return;
+		}
+		// the workers have their own copies now
+		Shards.clear();
+
+		ShardRouter Router(Directory);
+		long long ShardedFree = 0;
+		bool Ok = Router.Connect(Workers.GetPaths()) && Router.GetFleetFreeCount(ShardedFree) && ShardedFree == FleetFree;
+		Clock::time_point Start = Clock::now();
+		for (int i = 0; Ok && i < GatherNum; i++)
+			Ok = Router.GetFleetFreeCount(ShardedFree);
+		double GatherUs = MsSince(Start) * 1000 / GatherNum;
+
+		// same mix as the dispatch load generator, every thread through its own router
+		std::vector<char> ThreadOk(ThreadNum, 0);
+		std::vector<std::thread> Threads;
+		Start = Clock::now();
+		for (int t = 0; t < ThreadNum; t++)
+			Threads.emplace_back([&, t]
+			{
+				ShardRouter Own(Directory);
+				if (!Own.Connect(Workers.GetPaths()))
+					return;
+				std::vector<DispatchResponse> Responses;
+				unsigned Random = 17u + t;
+				for (int Done = 0; Done < PerThread; Done += Pipeline)
+				{
+					for (int i = 0; i < Pipeline; i++)
+					{
+						Random = Random * 1103515245u + 12345u;
+						std::uint32_t TaxiIndex = (Random >> 8) % static_cast<unsigned>(TaxiNum);
+						std::int32_t Driver = static_cast<std::int32_t>((Random >> 4) % static_cast<unsigned>(DriversCounts[TaxiIndex]));
+						unsigned Kind = (Random >> 20) % 100;
+						if (Kind < 40)
+							Own.Add(DispatchOp::FreeCount, TaxiIndex);
+						else if (Kind < 60)
+							Own.Add(DispatchOp::DriverState, TaxiIndex, Driver);
+						else if (Kind < 80)
+							Own.Add(DispatchOp::Order, TaxiIndex, 0, OrderAddress.c_str());
+						else
+							Own.Add(DispatchOp::Release, TaxiIndex, Driver);
+					}
+					if (!Own.Execute(Responses))
+						return;
+					for (const DispatchResponse& Response : Responses)
+						if (Response.Status == static_cast<std::uint8_t>(DispatchStatus::BadRequest))
+							return;
+				}
+				ThreadOk[t] = 1;
+			});
+		for (std::thread& Thread : Threads)
+			Thread.join();
+		double Seconds = MsSince(Start) / 1000;
+		for (char ThreadDone : ThreadOk)
+			Ok = Ok && ThreadDone;
+
+		// the free count the shards keep up to date must match the taxis' own counts
+		std::vector<DispatchResponse> Responses;
+		long long TaxiFree = 0;
+		for (int From = 0; Ok && From < TaxiNum; From += Pipeline)
+		{
+			for (int i = From; i < TaxiNum && i < From + Pipeline; i++)
+				Router.Add(DispatchOp::FreeCount, static_cast<std::uint32_t>(i));
+			Ok = Router.Execute(Responses);
+			for (const DispatchResponse& Response : Responses)
+				TaxiFree += Response.Value;
+		}
+		Ok = Ok && Router.GetFleetFreeCount(ShardedFree) && ShardedFree == TaxiFree;
+		Router.Close();
+		Workers.Stop();
+		if (!Ok)
+		{
+			std::cout << "sharded dispatch benchmark failed\n";
+			return;
+		}
+		std::cout << "Sharded dispatch, " << TaxiNum << " taxis, " << ShardCount << " shards: "
+			<< static_cast<long long>(static_cast<double>(PerThread) * ThreadNum / Seconds) << " req/s over " << ThreadNum << " routers ("
+			<< PipelinePerShard << " requests per shard and batch), fleet free count gathered in "
+			<< GatherUs << " us\n";
+	}
+}
+
+void BenchmarkBasicTaxi(int TaxiNum, int QueryNum)
+{
+	TaxiLayoutResult Dynamic = MeasureTaxiLayout<Taxi>(TaxiNum, QueryNum);
+	TaxiLayoutResult Inline = MeasureTaxiLayout<BasicTaxi<8, 4>>(TaxiNum, QueryNum);
+	if (Dynamic.Checksum != Inline.Checksum)
+	{
+		std::cout << "basic taxi benchmark failed\n";
+		return;
+	}
+	auto PrintMisses = [](long long Misses)
+	{
+		if (Misses < 0)
+			std::cout << "n/a";
+		else
+			std::cout << Misses;
+	};
+	std::cout << "Taxi against BasicTaxi<8, 4>, " << TaxiNum << " taxis: build + destroy " << Dynamic.BuildMs << " ms vs "
+		<< Inline.BuildMs << " ms; random lookup " << Dynamic.QueryNs << " ns vs " << Inline.QueryNs << " ns, cache misses ";
+	PrintMisses(Dynamic.Misses);
+	std::cout << " vs ";
+	PrintMisses(Inline.Misses);
+	std::cout << "\n";
+}
+
+void BenchmarkAddressCatalog(int OrderNum)
+{
+	// orders to every catalog street and to some that are not served
+	const char* Unknown[4] = { "Nowhere", "Broadwa", "OldTown", "MainStreet2" };
+	const int TargetNum = BenchCatalog.GetSize() + 4;
+	double PoolNs, CatalogNs;
+	long long PoolTaken = 0, CatalogTaken = 0;
+	{
+		ScopedLogLevel Quiet(LogLevel::Off);
+		AddressPool::Intern(Unknown[1]);
+		Taxi Pooled;
+		Pooled.SetDriversCount(8);
+		Pooled.SetAddressesCount(BenchCatalog.GetSize());
+		for (int i = 0; i < BenchCatalog.GetSize(); i++)
+			Pooled.SetAddress(i, BenchCatalog.Get(i));
+		Taxi Cataloged;
+		Cataloged.SetDriversCount(8);
+		if (!Cataloged.UseCatalog(BenchCatalog))
+		{
+			std::cout << "address catalog benchmark failed\n";
+			return;
+		}
+		auto Run = [OrderNum, TargetNum, &Unknown](Taxi& Obj, long long& Taken)
+		{
+			for (int i = 0; i < OrderNum; i++)
+			{
+				int Target = i % TargetNum;
+				const char* Address = Target < BenchCatalog.GetSize() ? BenchCatalog.Get(Target) : Unknown[Target - BenchCatalog.GetSize()];
+				int Driver = Obj.OrderDriver(Address);
+				if (Driver >= 0)
+				{
+					Taken++;
+					Obj.SetDriverState(Driver, DRIVER_FREE);
+				}
+			}
+		};
+		Clock::time_point Start = Clock::now();
+		Run(Pooled, PoolTaken);
+		PoolNs = MsSince(Start) * 1e6 / OrderNum;
+		Start = Clock::now();
+		Run(Cataloged, CatalogTaken);
+		CatalogNs = MsSince(Start) * 1e6 / OrderNum;
+	}
+	if (PoolTaken != CatalogTaken || !PoolTaken)
+	{
+		std::cout << "address catalog benchmark failed\n";
+		return;
+	}
+	std::cout << "Order + release against " << BenchCatalog.GetSize() << " addresses, " << OrderNum
+		<< " orders: address pool + scan " << PoolNs << " ns, perfect hash catalog " << CatalogNs << " ns\n";
+}
+
+void BenchmarkFleetIndex(int TaxiNum, int ChangeNum)
+{
+	const int TopK = 10;
+	const int QueryNum = 1000;
+	double ChangeMs, PlainChangeMs, IndexQueryUs, ScanQueryUs;
+	bool Matches = true;
+	long long Checksum = 0;
+	{
+		ScopedLogLevel Quiet(LogLevel::Off);
+		// the same changes to an indexed and to a plain fleet
+		auto Change = [ChangeNum](std::vector<Taxi>& Fleet)
+		{
+			TripScheduler Trips;
+			unsigned Random = 12345u;
+			for (int i = 0; i < ChangeNum; i++)
+			{
+				Random = Random * 1103515245u + 12345u;
+				Taxi& Obj = Fleet[(Random >> 4) % Fleet.size()];
+				switch (i % 4)
+				{
+				case 0:
+					Obj.Order(BenchAddresses[(Random >> 28) % 4]);
+					break;
+				case 1:
+					Trips.StartTrip(Obj, BenchAddresses[(Random >> 28) % 4], 1 + (Random >> 20) % 64);
+					break;
+				case 2:
+					Obj.SetDriverState(static_cast<int>(Random >> 28) % Obj.GetDriversCount(), static_cast<int>(Random >> 24) % DRIVER_STATE_COUNT);
+					break;
+				default:
+					Trips.Advance(1);
+				}
+			}
+			Trips.Advance(64);
+			Fleet[0].SetDriversCount(8);
+			// the taxis change places, SortTaxis publishes every one that moved
+			SortTaxis(Fleet);
+		};
+
+		std::vector<Taxi> Fleet;
+		Fleet.reserve(TaxiNum);
+		for (int i = 0; i < TaxiNum; i++)
+			Fleet.push_back(MakeBenchTaxi(i));
+		std::vector<Taxi> Plain(Fleet);
+		FleetIndex Index;
+		Index.InsertAll(Fleet);
+
+		Clock::time_point Start = Clock::now();
+		Change(Fleet);
+		ChangeMs = MsSince(Start);
+		Start = Clock::now();
+		Change(Plain);
+		PlainChangeMs = MsSince(Start);
+		Matches = IndexMatchesRecount(Index, Fleet);
+
+		Start = Clock::now();
+		for (int q = 0; q < QueryNum; q++)
+			for (Taxi* Obj : Index.TopAvailable(TopK))
+				Checksum += Obj->GetFreeDriversCount();
+		IndexQueryUs = MsSince(Start) * 1e3 / QueryNum;
+		Start = Clock::now();
+		std::vector<int> Free(Fleet.size());
+		for (int q = 0; q < QueryNum; q++)
+		{
+			for (std::size_t i = 0; i < Fleet.size(); i++)
+				Free[i] = Fleet[i].GetFreeDriversCount();
+			std::partial_sort(Free.begin(), Free.begin() + TopK, Free.end(), [](int A, int B) { return A > B; });
+			for (int k = 0; k < TopK; k++)
+				Checksum -= Free[k];
+		}
+		ScanQueryUs = MsSince(Start) * 1e3 / QueryNum;
+	}
+	if (!Matches || Checksum != 0)
+	{
+		std::cout << "fleet index benchmark failed\n";
+		return;
+	}
+	std::cout << "Fleet index, " << TaxiNum << " taxis: " << ChangeNum << " changes + sort " << ChangeMs << " ms indexed vs "
+		<< PlainChangeMs << " ms plain; top " << TopK << " available " << IndexQueryUs << " us vs scan " << ScanQueryUs
+		<< " us; matches a recount\n";
+}
+
+void BenchmarkPendingOrders(int OrderNum)
+{
+	const int TaxiNum = 2000;
+	const int AddressNum = 64;
+	const int ProducerNum = 4;
+	const int ConsumerNum = 2;
+	const std::size_t Capacity = 1024;
+	double Ms;
+	PendingOrderStats Stats;
+	bool Fifo = true;
+	{
+		ScopedLogLevel Quiet(LogLevel::Off);
+		char Names[AddressNum][MAX_STR_LEN];
+		for (int a = 0; a < AddressNum; a++)
+			std::snprintf(Names[a], MAX_STR_LEN, "QueueStreet%d", a);
+		// every driver starts busy, so orders queue until the consumers release drivers
+		const int Busy[4] = { DRIVER_BUSY, DRIVER_BUSY, DRIVER_BUSY, DRIVER_BUSY };
+		std::vector<Taxi> Fleet;
+		Fleet.reserve(TaxiNum);
+		for (int i = 0; i < TaxiNum; i++)
+		{
+			char Addresses[4][MAX_STR_LEN];
+			for (int a = 0; a < 4; a++)
+				std::memcpy(Addresses[a], Names[(i * 7 + a * 13) % AddressNum], MAX_STR_LEN);
+			Fleet.emplace_back(BenchPassengers[i % 4], Busy, 4, Addresses, 4);
+		}
+
+		PendingOrderQueue Queue(Fleet, Capacity, OverflowPolicy::Block);
+		// runs under the queue lock, so the order of Dispatched is the order of dispatch
+		std::vector<std::uint64_t> Dispatched;
+		Dispatched.reserve(OrderNum);
+		Queue.SetDispatchCallback([&Dispatched](std::uint64_t Id, Taxi*, int) { Dispatched.push_back(Id); });
+
+		std::vector<std::vector<std::pair<std::uint64_t, int>>> QueuedBy(ProducerNum);
+		std::atomic<int> ProducersLeft{ ProducerNum };
+		Clock::time_point Start = Clock::now();
+		std::vector<std::thread> Threads;
+		for (int p = 0; p < ProducerNum; p++)
+			Threads.emplace_back([&, p]()
+			{
+				unsigned Random = 777u + p;
+				for (int i = p; i < OrderNum; i += ProducerNum)
+				{
+					Random = Random * 1103515245u + 12345u;
+					int Address = static_cast<int>((Random >> 16) % AddressNum);
+					std::uint64_t Id = 0;
+					if (Queue.Submit(Names[Address], &Id) == SubmitResult::Queued)
+						QueuedBy[p].emplace_back(Id, Address);
+				}
+				ProducersLeft--;
+			});
+		for (int c = 0; c < ConsumerNum; c++)
+			Threads.emplace_back([&, c]()
+			{
+				unsigned Random = 4242u + c;
+				while (ProducersLeft.load() > 0 || Queue.GetDepth() > 0)
+				{
+					Random = Random * 1103515245u + 12345u;
+					Taxi& Obj = Fleet[(Random >> 8) % TaxiNum];
+					int Driver = static_cast<int>(Random >> 28) % 4;
+					// a trip ended: the driver is free and takes the oldest order it can
+					std::lock_guard<std::mutex> Guard(Queue.GetFleetMutex());
+					if (Obj.GetDriverState(Driver) != DRIVER_FREE)
+					{
+						Obj.SetDriverState(Driver, DRIVER_FREE);
+						Queue.DriverReleasedLocked(Obj, Driver);
+					}
+				}
+			});
+		for (std::thread& Thread : Threads)
+			Thread.join();
+		Ms = MsSince(Start);
+		Stats = Queue.GetStats();
+
+		// orders for one address must be dispatched in the order they were queued
+		std::vector<int> AddressOf(OrderNum + 1, -1);
+		for (const auto& Queued : QueuedBy)
+			for (const auto& Entry : Queued)
+				AddressOf[Entry.first] = Entry.second;
+		std::vector<std::uint64_t> LastId(AddressNum, 0);
+		for (std::uint64_t Id : Dispatched)
+		{
+			int Address = Id < AddressOf.size() ? AddressOf[Id] : -1;
+			if (Address < 0 || Id <= LastId[Address])
+			{
+				Fifo = false;
+				break;
+			}
+			LastId[Address] = Id;
+		}
+		Fifo = Fifo && Dispatched.size() == Stats.Queued;
+	}
+	if (!Fifo || Stats.Submitted != static_cast<std::uint64_t>(OrderNum) || Stats.Rejected || Stats.Dropped
+		|| Stats.ServedAtOnce + Stats.ServedFromQueue != Stats.Submitted || Stats.Depth || Stats.MaxDepth > Capacity)
+	{
+		std::cout << "pending order benchmark failed\n";
+		return;
+	}
+	std::cout << "Pending orders, " << ProducerNum << " producers / " << ConsumerNum << " releasing threads, " << OrderNum
+		<< " orders: " << Ms << " ms, " << Stats.ServedFromQueue << " served from the queue (max depth " << Stats.MaxDepth
+		<< " of " << Capacity << ", average wait " << Stats.AverageWaitMs() << " ms), FIFO per address\n";
+}
+
+void RunBenchmarks()
+{
+	std::cout << "\n--- Benchmarks ---\n";
+	BenchmarkVectorGrowth(100000);
+	BenchmarkVectorSort(100000);
+	BenchmarkFleetCopy(100000);
+	BenchmarkFleetLoad(100000);
+	BenchmarkConstructionLogging(100000);
+	BenchmarkSortEngine(10000000, 10000000);
+	BenchmarkStringCodec(100000);
+	BenchmarkStreamConversion(1000000);
+	BenchmarkPrintInfo(300000);
+	BenchmarkAvailability(1000000);
+	BenchmarkTripScheduler(2000000);
+	BenchmarkNearestDriver(100000);
+	BenchmarkJournal(100000);
+	BenchmarkDeltaCheckpoint(100000);
+	BenchmarkDispatchServer(1000000);
+	BenchmarkSharedFleet(100000);
+	BenchmarkShardedDispatch(100000, 1000000);
+	BenchmarkBasicTaxi(1000000, 10000000);
+	BenchmarkAddressCatalog(10000000);
+	BenchmarkFleetIndex(100000, 1000000);
+	BenchmarkPendingOrders(200000);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+// Runs all benchmarks and prints the timings to std::cout
+void RunBenchmarks();
+
+// Growth of std::vector<Taxi> without reserve, relocations go through the move constructor
+void BenchmarkVectorGrowth(int TaxiNum);
+// std::sort of std::vector<Taxi> by operator<, elements are moved around with move assignment
+void BenchmarkVectorSort(int TaxiNum);
+// Copying a fleet with deep copied and with copy-on-write shared address tables
+void BenchmarkFleetCopy(int TaxiNum);
+// Loading a saved fleet file with FleetFile::LoadAll and FleetFile::LoadAllParallel
+void BenchmarkFleetLoad(int TaxiNum);
+// SortByObjectNumber over plain IAutoNumber objects and SortTaxis against std::sort
+void BenchmarkSortEngine(int ObjectNum, int TaxiNum);
+// Building and destroying a fleet with constructor logging off, to a synchronous and to the async sink
+void BenchmarkConstructionLogging(int TaxiNum);
+// Taxi::ToString/FromString through TaxiCodec against the old find/substr/to_string version
+void BenchmarkStringCodec(int TaxiNum);
+// StreamConversion style line by line conversion against the threaded StreamConversionBulk pipeline
+void BenchmarkStreamConversion(int LineNum);
+// Virtual PrintInfo over an AbstractTaxi* array against PartitionedFleet::PrintInfo, both to a file
+void BenchmarkPrintInfo(int TaxiNum);
+// Per-driver state scan against FleetAvailability aggregation and its busy total
+void BenchmarkAvailability(int TaxiNum);
+// Starting trips on every driver of a fleet and ticking the TripScheduler until all of them ended
+void BenchmarkTripScheduler(int TripNum);
+// Nearest free driver through DriverGrid against a scan of every driver
+void BenchmarkNearestDriver(int DriverNum);
+// Journaled driver state changes, and recovery from snapshot + journal against a text reload
+void BenchmarkJournal(int TaxiNum);
+// Saving only the changed blocks of a mostly unchanged fleet against full saves, compaction and load
+void BenchmarkDeltaCheckpoint(int TaxiNum);
+// Requests per second and latency of DispatchServer over loopback TCP, with and without pipelining
+void BenchmarkDispatchServer(int RequestNum);
+// Driver changes published to shared memory, and what readers pay to see them against reloading a fleet file
+void BenchmarkSharedFleet(int TaxiNum);
+// Requests per second through ShardRouter with the fleet split over 1, 2 and 4 DispatchServer processes
+void BenchmarkShardedDispatch(int TaxiNum, int RequestNum);
+// Building and looking up Taxi with heap arrays against BasicTaxi with inline storage, with cache misses where the CPU counts them
+void BenchmarkBasicTaxi(int TaxiNum, int QueryNum);
+// Order address checks through the address pool and a scan against a constexpr perfect hash catalog
+void BenchmarkAddressCatalog(int OrderNum);
+// Mixed driver changes through Order, TripScheduler and SortTaxis on an indexed fleet, index queries against a scan,
+// and the index checked against a recount
+void BenchmarkFleetIndex(int TaxiNum, int ChangeNum);
+// Threads submitting orders into a full PendingOrderQueue while others release drivers, checked for
+// lost orders and FIFO order per address
+void BenchmarkPendingOrders(int OrderNum);
@@ -0,0 +1,1160 @@
+#include "Checks.h"
+#include "AddressCatalog.h"
+#include "BasicTaxi.h"
+#include "FleetCheckpoint.h"
+#include "FleetFile.h"
+#include "FleetIndex.h"
+#include "FleetJournal.h"
+#include "FleetSort.h"
+#include "Log.h"
+#include "LuxTaxi.h"
+#include "PendingOrderQueue.h"
+#include "Taxi.h"
+#include "TaxiCodec.h"
+#include "TripScheduler.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace
+{
+	// Characters the formats escape or split on, mixed into the names and addresses
+	const char TEXT_CHARS[] = "abcXYZ019 ,|\\=-";
+
+	int Pick(std::mt19937& Random, int Count)
+	{
+		return static_cast<int>(Random() % static_cast<unsigned>(Count));
+	}
+
+	std::string RandomText(std::mt19937& Random, int MinLength, int MaxLength)
+	{
+		std::string Text(MinLength + Pick(Random, MaxLength - MinLength + 1), ' ');
+		for (char& C : Text)
+			C = TEXT_CHARS[Pick(Random, sizeof(TEXT_CHARS) - 1)];
+		return Text;
+	}
+
+	// Up to MaxDrivers drivers in any state and up to 6 addresses
+	Taxi MakeRandomTaxi(std::mt19937& Random, int MaxDrivers)
+	{
+		Taxi Obj;
+		std::string Passenger = RandomText(Random, 1, MAX_STR_LEN - 1);
+		std::memcpy(Obj.Passenger, Passenger.c_str(), Passenger.size() + 1);
+		Obj.SetDriversCount(Pick(Random, MaxDrivers + 1));
+		for (int i = 0; i < Obj.GetDriversCount(); i++)
+			Obj.SetDriverState(i, Pick(Random, DRIVER_STATE_COUNT));
+		Obj.SetAddressesCount(Pick(Random, 7));
+		for (int i = 0; i < Obj.GetAddressesCount(); i++)
+			Obj.SetAddress(i, RandomText(Random, 1, MAX_STR_LEN - 1).c_str());
+		return Obj;
+	}
+
+	// Random driver state or address change, the kind delta records and the journal log
+	void ChangeRandomly(std::mt19937& Random, Taxi& Obj)
+	{
+		if (Pick(Random, 3) && Obj.GetDriversCount())
+			Obj.SetDriverState(Pick(Random, Obj.GetDriversCount()), Pick(Random, DRIVER_STATE_COUNT));
+		else if (Obj.GetAddressesCount())
+			Obj.SetAddress(Pick(Random, Obj.GetAddressesCount()), RandomText(Random, 1, 20).c_str());
+	}
+
+	// Empty when the state counts of the taxi match a recount of its drivers
+	std::string CountDifference(const Taxi& Obj)
+	{
+		int Counts[DRIVER_STATE_COUNT] = {};
+		for (int i = 0; i < Obj.GetDriversCount(); i++)
+			Counts[Obj.GetDriverState(i)]++;
+		for (int State = 0; State < DRIVER_STATE_COUNT; State++)
+			if (Obj.GetDriversInState(static_cast<DriverState>(State)) != Counts[State])
+				return "state " + std::to_string(State) + " counted " + std::to_string(Obj.GetDriversInState(static_cast<DriverState>(State)))
+					+ " times, recount gives " + std::to_string(Counts[State]);
+		return "";
+	}
+
+	// Empty when both taxis hold the same passenger, drivers and addresses, else what differs
+	std::string Difference(const Taxi& Expected, const Taxi& Actual)
+	{
+		if (std::strcmp(Expected.Passenger, Actual.Passenger) != 0)
+			return "passenger \"" + std::string(Actual.Passenger) + "\" instead of \"" + Expected.Passenger + "\"";
+		if (Expected.GetDriversCount() != Actual.GetDriversCount())
+			return std::to_string(Actual.GetDriversCount()) + " drivers instead of " + std::to_string(Expected.GetDriversCount());
+		for (int i = 0; i < Expected.GetDriversCount(); i++)
+			if (Expected.GetDriverState(i) != Actual.GetDriverState(i))
+				return "driver " + std::to_string(i) + " in state " + std::to_string(Actual.GetDriverState(i))
+					+ " instead of " + std::to_string(Expected.GetDriverState(i));
+		std::string Counts = CountDifference(Actual);
+		if (!Counts.empty())
+			return Counts;
+		if (Expected.GetAddressesCount() != Actual.GetAddressesCount())
+			return std::to_string(Actual.GetAddressesCount()) + " addresses instead of " + std::to_string(Expected.GetAddressesCount());
+		for (int i = 0; i < Expected.GetAddressesCount(); i++)
+			if (std::strcmp(Expected.GetAddress(i), Actual.GetAddress(i)) != 0)
+				return "address " + std::to_string(i) + " \"" + Actual.GetAddress(i) + "\" instead of \"" + Expected.GetAddress(i) + "\"";
+		return "";
+	}
+
+	std::string FleetDifference(const std::vector<Taxi>& Expected, const std::vector<Taxi>& Actual)
+	{
+		if (Expected.size() != Actual.size())
+			return std::to_string(Actual.size()) + " taxis instead of " + std::to_string(Expected.size());
+		for (std::size_t i = 0; i < Expected.size(); i++)
+		{
+			std::string Failure = Difference(Expected[i], Actual[i]);
+			if (!Failure.empty())
+				return "taxi " + std::to_string(i) + ": " + Failure;
+		}
+		return "";
+	}
+
+	// Deletes the files a check writes, before it starts and however it returns
+	class ScratchFiles
+	{
+	public:
+		explicit ScratchFiles(std::vector<std::string> InNames) : Names(std::move(InNames)) { RemoveAll(); }
+		~ScratchFiles() { RemoveAll(); }
+		ScratchFiles(const ScratchFiles&) = delete;
+		ScratchFiles& operator=(const ScratchFiles&) = delete;
+
+	private:
+		void RemoveAll() const
+		{
+			for (const std::string& Name : Names)
+				std::remove(Name.c_str());
+		}
+
+		std::vector<std::string> Names;
+	};
+
+	// Files of a FleetCheckpoint: the delta file and the first bases it numbers
+	std::vector<std::string> CheckpointFiles(const std::string& BasePath)
+	{
+		std::vector<std::string> Names = { BasePath + ".delta" };
+		for (int Sequence = 0; Sequence < 32; Sequence++)
+			Names.push_back(BasePath + "." + std::to_string(Sequence) + ".base");
+		return Names;
+	}
+
+	bool Report(const char* Name, const std::string& Failure)
+	{
+		if (Failure.empty())
+			std::cout << Name << " check passed\n";
+		else
+			std::cout << Name << " check failed: " << Failure << "\n";
+		return Failure.empty();
+	}
+
+	std::string SnapshotRoundTrip()
+	{
+		ScratchFiles Files({ "check_taxi.bin", "check_taxi.txt", "check_fleet.bin", "check_fleet.txt" });
+		std::mt19937 Random(1);
+		// a default taxi, then enough taxis for several chunks of a parallel load
+		std::vector<Taxi> Fleet(1);
+		for (int i = 0; i < 5000; i++)
+			Fleet.push_back(MakeRandomTaxi(Random, 100));
+
+		// records back to back, each read at its own size into a taxi of another layout
+		std::vector<char> Records;
+		for (const Taxi& Obj : Fleet)
+			Obj.AppendSnapshot(Records);
+		std::size_t Offset = 0;
+		for (std::size_t i = 0; i < Fleet.size(); i++)
+		{
+			Taxi Loaded = MakeRandomTaxi(Random, 100);
+			std::size_t Size = Loaded.ReadSnapshot(Records.data() + Offset, Records.size() - Offset);
+			if (!Size)
+				return "snapshot record " + std::to_string(i) + " rejected";
+			std::string Failure = Difference(Fleet[i], Loaded);
+			if (!Failure.empty())
+				return "snapshot record " + std::to_string(i) + ": " + Failure;
+			Offset += Size;
+		}
+		if (Offset != Records.size())
+			return std::to_string(Records.size() - Offset) + " bytes left after the snapshot records";
+
+		// a record cut short is rejected
+		std::vector<char> Record;
+		Fleet[1].AppendSnapshot(Record);
+		for (std::size_t Size = 0; Size < Record.size(); Size++)
+		{
+			Taxi Loaded;
+			if (Loaded.ReadSnapshot(Record.data(), Size))
+				return "snapshot record cut to " + std::to_string(Size) + " bytes accepted";
+		}
+
+		// single taxi files, binary and text
+		for (std::size_t i = 0; i < 20; i++)
+		{
+			Taxi Loaded;
+			Fleet[i].SaveToFile("check_taxi.bin");
+			Loaded.LoadFromFile("check_taxi.bin");
+			std::string Failure = Difference(Fleet[i], Loaded);
+			if (!Failure.empty())
+				return "SaveToFile of taxi " + std::to_string(i) + ": " + Failure;
+			Taxi LoadedText;
+			Fleet[i].SaveToTextFile("check_taxi.txt");
+			LoadedText.LoadFromTextFile("check_taxi.txt");
+			Failure = Difference(Fleet[i], LoadedText);
+			if (!Failure.empty())
+				return "SaveToTextFile of taxi " + std::to_string(i) + ": " + Failure;
+		}
+
+		// fleet files in both encodings, loaded whole, in parallel and one by one
+		for (FleetEncoding Encoding : { FleetEncoding::Binary, FleetEncoding::Text })
+		{
+			const char* FileName = Encoding == FleetEncoding::Binary ? "check_fleet.bin" : "check_fleet.txt";
+			std::string Format = Encoding == FleetEncoding::Binary ? "binary fleet file: " : "text fleet file: ";
+			FleetFile File;
+			std::vector<Taxi> Loaded;
+			std::vector<Taxi> LoadedParallel;
+			if (!SaveFleet(FileName, Fleet, Encoding) || !File.Open(FileName))
+				return Format + "save or open failed";
+			if (!File.LoadAll(Loaded) || !File.LoadAllParallel(LoadedParallel, 3))
+				return Format + "load failed";
+			std::string Failure = FleetDifference(Fleet, Loaded);
+			if (!Failure.empty())
+				return Format + "LoadAll " + Failure;
+			Failure = FleetDifference(Fleet, LoadedParallel);
+			if (!Failure.empty())
+				return Format + "LoadAllParallel " + Failure;
+			for (std::size_t i = 0; i < Fleet.size(); i++)
+			{
+				Taxi One;
+				if (!File.LoadBySavedNumber(Fleet[i].GetObjectNumber(), One))
+					return Format + "taxi number " + std::to_string(Fleet[i].GetObjectNumber()) + " not found";
+				Failure = Difference(Fleet[i], One);
+				if (!Failure.empty())
+					return Format + "LoadBySavedNumber " + Failure;
+			}
+		}
+		return "";
+	}
+
+	std::string DeltaRoundTrip()
+	{
+		std::mt19937 Random(2);
+
+		// delta records of single taxis, applied to a copy taken before the changes
+		for (int Round = 0; Round < 200; Round++)
+		{
+			std::string Name = "taxi " + std::to_string(Round) + ": ";
+			Taxi Obj = MakeRandomTaxi(Random, 300);
+			Taxi Copy(Obj, AddressCopy::Deep);
+			Obj.StartDeltaTracking();
+			for (int Changes = Pick(Random, 20); Changes > 0; Changes--)
+				ChangeRandomly(Random, Obj);
+			std::vector<char> Delta;
+			if (!Obj.AppendDelta(Delta))
+				return Name + "no delta while tracking";
+			if (Copy.ReadDelta(Delta.data(), Delta.size()) != Delta.size())
+				return Name + "delta record rejected";
+			std::string Failure = Difference(Obj, Copy);
+			if (!Failure.empty())
+				return Name + Failure;
+
+			Taxi Other(Copy, AddressCopy::Deep);
+			Other.SetDriversCount(Copy.GetDriversCount() + 1);
+			if (Other.ReadDelta(Delta.data(), Delta.size()))
+				return Name + "delta record applied to another layout";
+			Obj.SetDriversCount(Obj.GetDriversCount() + 1);
+			if (Obj.IsDeltaTracking())
+				return Name + "still tracking after a resize";
+		}
+
+		// a move brings another layout, the old dirty blocks must not be used for it
+		Taxi Small;
+		Small.SetDriversCount(10);
+		Small.StartDeltaTracking();
+		Taxi Large;
+		Large.SetDriversCount(20000);
+		Small = std::move(Large);
+		if (Small.IsDeltaTracking() || Large.IsDeltaTracking())
+			return "still tracking after a move";
+		Small.SetDriverState(19999, DRIVER_BUSY);
+		std::vector<char> Moved;
+		if (Small.AppendDelta(Moved))
+			return "delta written for a moved taxi";
+
+		// checkpoints with resized and added taxis and a compaction in between, then a
+		// restart that goes on from the loaded fleet and removes a taxi
+		const std::string BasePath = "check_checkpoint";
+		ScratchFiles Files(CheckpointFiles(BasePath));
+		std::vector<Taxi> Fleet;
+		for (int i = 0; i < 80; i++)
+			Fleet.push_back(MakeRandomTaxi(Random, 100));
+		auto ChangeFleet = [&](int Count)
+		{
+			for (int i = 0; i < Count; i++)
+				ChangeRandomly(Random, Fleet[Pick(Random, static_cast<int>(Fleet.size()))]);
+		};
+		auto Reload = [&](const std::string& Step) -> std::string
+		{
+			FleetCheckpoint Reader(BasePath.c_str());
+			std::vector<Taxi> Loaded;
+			if (!Reader.Load(Loaded))
+				return Step + ": load failed";
+			std::string Failure = FleetDifference(Fleet, Loaded);
+			return Failure.empty() ? "" : Step + ": " + Failure;
+		};
+
+		{
+			FleetCheckpoint Writer(BasePath.c_str());
+			Writer.SetCompactionBytes(0);
+			CheckpointStats Stats;
+			if (!Writer.Save(Fleet, &Stats) || !Stats.Full)
+				return "first checkpoint not saved as a full base";
+			ChangeFleet(300);
+			if (!Writer.Save(Fleet, &Stats) || Stats.Full)
+				return "changes not saved as deltas";
+			Fleet[5].SetDriversCount(Fleet[5].GetDriversCount() + 7);
+			// replaced and exchanged by moves, which do not publish
+			Fleet[6] = MakeRandomTaxi(Random, 100);
+			std::swap(Fleet[7], Fleet[8]);
+			Fleet.push_back(MakeRandomTaxi(Random, 100));
+			ChangeFleet(300);
+			if (!Writer.Save(Fleet))
+				return "checkpoint with a new taxi failed";
+			if (!Writer.StartCompaction())
+				return "compaction not started";
+			ChangeFleet(300);
+			if (!Writer.Save(Fleet) || !Writer.WaitForCompaction())
+				return "checkpoint during compaction failed";
+			ChangeFleet(300);
+			if (!Writer.Save(Fleet))
+				return "checkpoint after compaction failed";
+		}
+		std::string Failure = Reload("first load");
+		if (!Failure.empty())
+			return Failure;
+
+		{
+			FleetCheckpoint Writer(BasePath.c_str());
+			Writer.SetCompactionBytes(0);
+			if (!Writer.Load(Fleet))
+				return "restart load failed";
+			ChangeFleet(300);
+			Fleet.pop_back();
+			CheckpointStats Stats;
+			if (!Writer.Save(Fleet, &Stats) || !Stats.Full)
+				return "removed taxi not saved as a full base";
+			ChangeFleet(300);
+			if (!Writer.Save(Fleet))
+				return "checkpoint after the full base failed";
+		}
+		return Reload("load after restart");
+	}
+
+	std::string CodecRoundTrip()
+	{
+		std::mt19937 Random(3);
+		Taxi Reused;
+		std::string Line;
+		for (int i = 0; i < 2000; i++)
+		{
+			Taxi Obj = MakeRandomTaxi(Random, 100);
+			Line.clear();
+			Obj.AppendString(Line);
+			if (Line != Obj.ToString())
+				return "AppendString and ToString differ for " + Line;
+			Taxi Fresh;
+			if (!ParseTaxiString(Line, Fresh))
+				return "rejected " + Line;
+			std::string Failure = Difference(Obj, Fresh);
+			if (!Failure.empty())
+				return Line + ": " + Failure;
+			// parsing into a taxi that holds the previous one
+			if (!ParseTaxiString(Line, Reused))
+				return "rejected into a used taxi " + Line;
+			Failure = Difference(Obj, Reused);
+			if (!Failure.empty())
+				return Line + " into a used taxi: " + Failure;
+
+			LuxTaxi Lux;
+			Lux.FromString(Line);
+			Failure = Difference(Obj, Lux);
+			if (!Failure.empty())
+				return Line + " into LuxTaxi: " + Failure;
+		}
+
+		// the inline taxi converts through the same format
+		for (int i = 0; i < 200; i++)
+		{
+			Taxi Obj = MakeRandomTaxi(Random, 8);
+			Obj.SetAddressesCount(std::min(Obj.GetAddressesCount(), 4));
+			BasicTaxi<8, 4> Inline;
+			Inline.FromString(Obj.ToString());
+			if (Inline.ToString() != Obj.ToString())
+				return "BasicTaxi gives " + Inline.ToString() + " for " + Obj.ToString();
+		}
+
+		// the older strings without driver states and addresses
+		Taxi Legacy;
+		if (!ParseTaxiString("Passenger=Bob, DriversCount=3, AddressesCount=2", Legacy))
+			return "legacy string rejected";
+		if (std::strcmp(Legacy.Passenger, "Bob") != 0 || Legacy.GetDriversCount() != 3 || Legacy.GetFreeDriversCount() != 3
+			|| Legacy.GetAddressesCount() != 2 || std::strcmp(Legacy.GetAddress(1), UNKNOWN_ADDRESS) != 0)
+			return "legacy string parsed as " + Legacy.ToString();
+
+		// a malformed field fails the parse and leaves the whole taxi as it was
+		Taxi Kept = MakeRandomTaxi(Random, 100);
+		const std::string Before = Kept.ToString();
+		if (ParseTaxiString("Passenger=Ann, DriversCount=x3", Kept))
+			return "malformed drivers count accepted";
+		if (Kept.ToString() != Before)
+			return "malformed drivers count parsed as " + Kept.ToString();
+		if (ParseTaxiString("Passenger=Ann, Drivers=19", Kept))
+			return "invalid driver state accepted";
+		if (Kept.ToString() != Before)
+			return "invalid driver state parsed as " + Kept.ToString();
+		return "";
+	}
+
+	std::string JournalReplay()
+	{
+		const std::string BasePath = "check_journal";
+		ScratchFiles Files({ BasePath + ".snap", BasePath + ".wal" });
+		std::mt19937 Random(4);
+		std::vector<Taxi> Fleet;
+		// driver states and addresses alone, and resizes that log the whole taxi
+		auto ChangeFleet = [&](int Count)
+		{
+			for (int i = 0; i < Count; i++)
+			{
+				Taxi& Obj = Fleet[Pick(Random, static_cast<int>(Fleet.size()))];
+				int Kind = Pick(Random, 20);
+				if (Kind == 0)
+					Obj.SetDriversCount(Pick(Random, 60));
+				else if (Kind == 1)
+					Obj.SetAddressesCount(Pick(Random, 5));
+				else
+					ChangeRandomly(Random, Obj);
+			}
+		};
+		auto Recover = [&](const std::string& Step, JournalRecoveryStats& Stats) -> std::string
+		{
+			FleetJournal Reader;
+			std::vector<Taxi> Recovered;
+			if (!Reader.Open(BasePath.c_str(), Recovered, &Stats))
+				return Step + ": recovery failed";
+			Reader.Close();
+			std::string Failure = FleetDifference(Fleet, Recovered);
+			return Failure.empty() ? "" : Step + ": " + Failure;
+		};
+
+		{
+			FleetJournal Journal;
+			if (!Journal.Open(BasePath.c_str(), Fleet))
+				return "open failed";
+			Fleet.reserve(200);
+			for (int i = 0; i < 100; i++)
+				Fleet.push_back(MakeRandomTaxi(Random, 100));
+			if (!Journal.Checkpoint())
+				return "first checkpoint failed";
+			ChangeFleet(5000);
+			for (int i = 0; i < 5; i++)
+			{
+				Fleet.push_back(MakeRandomTaxi(Random, 100));
+				Journal.Track(static_cast<int>(Fleet.size()) - 1);
+			}
+			ChangeFleet(5000);
+			// driver indexes past the 2^24 a replay entry packs are replayed from the record
+			Taxi Wide;
+			Wide.SetDriversCount((1 << 24) + 64);
+			Fleet.push_back(std::move(Wide));
+			Journal.Track(static_cast<int>(Fleet.size()) - 1);
+			for (int i = 0; i < 200; i++)
+				Fleet.back().SetDriverState(Pick(Random, 2) ? (1 << 24) + Pick(Random, 64) : Pick(Random, 64), Pick(Random, DRIVER_STATE_COUNT));
+			if (!Journal.Sync())
+				return "sync failed";
+		}
+		JournalRecoveryStats Stats;
+		std::string Failure = Recover("replay", Stats);
+		if (!Failure.empty())
+			return Failure;
+		if (!Stats.Records)
+			return "nothing replayed";
+
+		// a record torn while it was written is cut off, the ones before it replay
+		std::FILE* File = std::fopen((BasePath + ".wal").c_str(), "ab");
+		const char Torn[6] = { 9, 0, 0, 0, 1, 2 };
+		if (!File || std::fwrite(Torn, 1, sizeof(Torn), File) != sizeof(Torn))
+			return "could not tear the journal";
+		std::fclose(File);
+		Failure = Recover("replay past a torn record", Stats);
+		if (!Failure.empty())
+			return Failure;
+		if (Stats.DiscardedBytes != sizeof(Torn))
+			return std::to_string(Stats.DiscardedBytes) + " torn bytes discarded instead of " + std::to_string(sizeof(Torn));
+
+		// reopened on the fleet itself, with a checkpoint between the changes
+		{
+			FleetJournal Journal;
+			if (!Journal.Open(BasePath.c_str(), Fleet))
+				return "reopen failed";
+			Fleet.reserve(200);
+			ChangeFleet(3000);
+			if (!Journal.Checkpoint())
+				return "second checkpoint failed";
+			ChangeFleet(3000);
+			Fleet.push_back(MakeRandomTaxi(Random, 100));
+			Journal.Track(static_cast<int>(Fleet.size()) - 1);
+			if (!Journal.Sync())
+				return "sync after reopening failed";
+		}
+		Failure = Recover("replay after a checkpoint", Stats);
+		if (!Failure.empty())
+			return Failure;
+		return Stats.DiscardedBytes ? "torn record still in the journal" : "";
+	}
+
+	// Passengers of the index check, with prefixes longer than the 8 packed characters
+	const char* const INDEX_PASSENGERS[] = { "Ann", "Annabella", "Annabelle", "Bob", "Carl", "Dora" };
+	const int INDEX_PASSENGER_COUNT = static_cast<int>(std::size(INDEX_PASSENGERS));
+
+	std::string FleetIndexCheck()
+	{
+		std::mt19937 Random(5);
+		std::vector<Taxi> Fleet;
+		for (int i = 0; i < 400; i++)
+		{
+			Fleet.push_back(MakeRandomTaxi(Random, 12));
+			std::strcpy(Fleet.back().Passenger, INDEX_PASSENGERS[Pick(Random, INDEX_PASSENGER_COUNT)]);
+		}
+		FleetIndex Index;
+		Index.InsertAll(Fleet);
+		std::vector<bool> Indexed(Fleet.size(), true);
+
+		// the taxis a query has to return, from a scan of the fleet
+		auto Scan = [&](const std::function<bool(const Taxi&)>& Matches)
+		{
+			std::vector<Taxi*> Result;
+			for (std::size_t i = 0; i < Fleet.size(); i++)
+				if (Indexed[i] && Matches(Fleet[i]))
+					Result.push_back(&Fleet[i]);
+			return Result;
+		};
+		auto SameTaxis = [](std::vector<Taxi*> Found, std::vector<Taxi*> Expected)
+		{
+			std::sort(Found.begin(), Found.end());
+			std::sort(Expected.begin(), Expected.end());
+			return Found == Expected;
+		};
+		auto QueryFailure = [&](const std::string& Query, const std::vector<Taxi*>& Found, const std::vector<Taxi*>& Expected, bool Ordered)
+		{
+			if (!SameTaxis(Found, Expected))
+				return Query + " gives other taxis than the scan, " + std::to_string(Found.size()) + " instead of " + std::to_string(Expected.size());
+			return Ordered ? std::string() : Query + " gives the taxis out of order";
+		};
+		auto FreeAscending = [](const std::vector<Taxi*>& Found)
+		{
+			return std::is_sorted(Found.begin(), Found.end(), [](const Taxi* A, const Taxi* B) { return A->Order() < B->Order(); });
+		};
+		auto FreeDescending = [](const std::vector<Taxi*>& Found)
+		{
+			return std::is_sorted(Found.begin(), Found.end(), [](const Taxi* A, const Taxi* B) { return A->Order() > B->Order(); });
+		};
+
+		auto Verify = [&]() -> std::string
+		{
+			if (Index.GetSize() != static_cast<int>(std::count(Indexed.begin(), Indexed.end(), true)))
+				return "index holds " + std::to_string(Index.GetSize()) + " taxis";
+			for (std::size_t i = 0; i < Fleet.size(); i++)
+				if (Index.Contains(&Fleet[i]) != Indexed[i])
+					return "taxi " + std::to_string(i) + " wrongly in or out of the index";
+			const int Ranges[][2] = { { 0, FleetIndex::MAX_FREE }, { 2, 5 }, { 3, 3 } };
+			for (const char* Passenger : INDEX_PASSENGERS)
+				for (const auto& Range : Ranges)
+				{
+					std::vector<Taxi*> Found = Index.FindByPassenger(Passenger, Range[0], Range[1]);
+					std::vector<Taxi*> Expected = Scan([&](const Taxi& Obj)
+						{ return std::strcmp(Obj.Passenger, Passenger) == 0 && Obj.Order() >= Range[0] && Obj.Order() <= Range[1]; });
+					std::string Failure = QueryFailure(std::string("FindByPassenger(") + Passenger + ", " + std::to_string(Range[0]) + ", "
+						+ std::to_string(Range[1]) + ")", Found, Expected, FreeAscending(Found));
+					if (!Failure.empty())
+						return Failure;
+				}
+			const char* const PassengerRanges[][2] = { { "Ann", "Bob" }, { "Annabelle", "" }, { "B", "Carl" }, { "Dora", "Dora" } };
+			for (const auto& Range : PassengerRanges)
+			{
+				std::vector<Taxi*> Found = Index.FindPassengerRange(Range[0], Range[1]);
+				std::vector<Taxi*> Expected = Scan([&](const Taxi& Obj)
+					{ return std::strcmp(Obj.Passenger, Range[0]) >= 0 && (!*Range[1] || std::strcmp(Obj.Passenger, Range[1]) < 0); });
+				bool Ordered = std::is_sorted(Found.begin(), Found.end(), [](const Taxi* A, const Taxi* B)
+					{ return std::strcmp(A->Passenger, B->Passenger) < 0; });
+				std::string Failure = QueryFailure(std::string("FindPassengerRange(") + Range[0] + ", " + Range[1] + ")", Found, Expected, Ordered);
+				if (!Failure.empty())
+					return Failure;
+			}
+			for (int MinFree = 0; MinFree <= 8; MinFree++)
+			{
+				std::vector<Taxi*> Found = Index.FindWithFreeDrivers(MinFree);
+				std::vector<Taxi*> Expected = Scan([&](const Taxi& Obj) { return Obj.Order() >= MinFree; });
+				std::string Failure = QueryFailure("FindWithFreeDrivers(" + std::to_string(MinFree) + ")", Found, Expected, FreeDescending(Found));
+				if (!Failure.empty())
+					return Failure;
+			}
+			std::vector<Taxi*> All = Scan([](const Taxi&) { return true; });
+			std::sort(All.begin(), All.end(), [](const Taxi* A, const Taxi* B) { return A->Order() > B->Order(); });
+			for (int K : { 1, 10, 1000 })
+			{
+				std::vector<Taxi*> Top = Index.TopAvailable(K);
+				std::size_t Expected = std::min<std::size_t>(K, All.size());
+				if (Top.size() != Expected || !FreeDescending(Top))
+					return "TopAvailable(" + std::to_string(K) + ") gives " + std::to_string(Top.size()) + " taxis";
+				for (std::size_t i = 0; i < Expected; i++)
+					if (Top[i]->Order() != All[i]->Order())
+						return "TopAvailable(" + std::to_string(K) + ") taxi " + std::to_string(i) + " has "
+							+ std::to_string(Top[i]->Order()) + " free drivers, the scan " + std::to_string(All[i]->Order());
+			}
+			return "";
+		};
+
+		for (int Step = 1; Step <= 6000; Step++)
+		{
+			int Position = Pick(Random, static_cast<int>(Fleet.size()));
+			Taxi& Obj = Fleet[Position];
+			switch (Pick(Random, 10))
+			{
+			case 0:
+			case 1:
+			case 2:
+				if (Obj.GetDriversCount())
+					Obj.SetDriverState(Pick(Random, Obj.GetDriversCount()), Pick(Random, DRIVER_STATE_COUNT));
+				break;
+			case 3:
+				if (Obj.GetAddressesCount())
+					Obj.Order(Obj.GetAddress(0));
+				break;
+			case 4:
+				if (Obj.GetDriversCount())
+					Obj.TransitionDriver(Pick(Random, Obj.GetDriversCount()), static_cast<DriverState>(Pick(Random, DRIVER_STATE_COUNT)));
+				break;
+			case 5:
+				if (Indexed[Position])
+					Index.SetPassenger(&Obj, INDEX_PASSENGERS[Pick(Random, INDEX_PASSENGER_COUNT)]);
+				break;
+			case 6:
+				if (Indexed[Position] ? !Index.Remove(&Obj) : !Index.Insert(&Obj))
+					return "taxi " + std::to_string(Position) + " not inserted or removed";
+				Indexed[Position] = !Indexed[Position];
+				break;
+			case 7:
+				Obj.SetDriversCount(Pick(Random, 13));
+				break;
+			default:
+				if (Indexed[Position] && !Index.Update(&Obj))
+					return "indexed taxi " + std::to_string(Position) + " not updated";
+				break;
+			}
+			// the sort swaps the contents of indexed and unindexed taxis
+			if (Step % 500 == 0)
+				SortTaxis(Fleet);
+			if (Step % 200 == 0)
+			{
+				std::string Failure = Verify();
+				if (!Failure.empty())
+					return "step " + std::to_string(Step) + ": " + Failure;
+			}
+		}
+		return "";
+	}
+
+	// Runs random submits and releases against a model that keeps the queued order ids
+	// per address, for one overflow policy
+	std::string PendingOrderRun(OverflowPolicy Policy, std::uint32_t Seed)
+	{
+		const char* const Streets[] = { "CheckStreetA", "CheckStreetB", "CheckStreetC", "CheckStreetD", "CheckStreetE" };
+		const int STREET_COUNT = static_cast<int>(std::size(Streets));
+		const std::size_t Capacity = 16;
+		std::mt19937 Random(Seed);
+		std::vector<Taxi> Fleet;
+		Fleet.reserve(13);
+		for (int i = 0; i < 12; i++)
+		{
+			Taxi Obj;
+			Obj.SetDriversCount(1 + Pick(Random, 3));
+			for (int d = 0; d < Obj.GetDriversCount(); d++)
+				Obj.SetDriverState(d, Pick(Random, 2) ? DRIVER_BUSY : DRIVER_FREE);
+			int First = Pick(Random, STREET_COUNT);
+			Obj.SetAddressesCount(1 + Pick(Random, 3));
+			for (int a = 0; a < Obj.GetAddressesCount(); a++)
+				Obj.SetAddress(a, Streets[(First + a) % STREET_COUNT]);
+			Fleet.push_back(std::move(Obj));
+		}
+
+		PendingOrderQueue Queue(Fleet, Capacity, Policy);
+		struct Dispatch
+		{
+			std::uint64_t Id;
+			Taxi* Obj;
+			int DriverIndex;
+		};
+		std::vector<Dispatch> Dispatched;
+		Queue.SetDispatchCallback([&](std::uint64_t Id, Taxi* Obj, int DriverIndex) { Dispatched.push_back({ Id, Obj, DriverIndex }); });
+
+		std::map<std::string, std::vector<std::uint64_t>> Waiting;
+		std::size_t Depth = 0;
+		std::uint64_t LastId = 0;
+		PendingOrderStats Expected;
+		auto Serves = [](const Taxi& Obj, const char* Street)
+		{
+			for (int a = 0; a < Obj.GetAddressesCount(); a++)
+				if (std::strcmp(Obj.GetAddress(a), Street) == 0)
+					return true;
+			return false;
+		};
+		auto FreeServing = [&](const char* Street)
+		{
+			int Free = 0;
+			for (const Taxi& Obj : Fleet)
+				if (Serves(Obj, Street))
+					Free += Obj.Order();
+			return Free;
+		};
+		auto Submit = [&](const char* Street, bool Closed) -> std::string
+		{
+			std::string Name = std::string("order for ") + Street + " ";
+			int Free = FreeServing(Street);
+			bool Known = Free || std::any_of(Fleet.begin(), Fleet.end(), [&](const Taxi& Obj) { return Serves(Obj, Street); });
+			std::size_t DispatchedBefore = Dispatched.size();
+			std::uint64_t Id = 0;
+			SubmitResult Result = Queue.Submit(Street, &Id);
+			Expected.Submitted++;
+			if (Closed || !Known || (Policy == OverflowPolicy::Reject && !Free && Depth == Capacity))
+			{
+				Expected.Rejected++;
+				return Result == SubmitResult::Rejected ? "" : Name + "not rejected";
+			}
+			if (Free)
+			{
+				Expected.ServedAtOnce++;
+				if (Result != SubmitResult::Served)
+					return Name + "not served with a free driver";
+				return FreeServing(Street) == Free - 1 ? "" : Name + "served without taking a free driver";
+			}
+			if (Result != SubmitResult::Queued)
+				return Name + "not queued";
+			if (Id <= LastId)
+				return Name + "got id " + std::to_string(Id) + " after " + std::to_string(LastId);
+			LastId = Id;
+			Expected.Queued++;
+			if (Depth == Capacity)
+			{
+				// the order that waited longest over all addresses gives way
+				auto Oldest = Waiting.end();
+				for (auto It = Waiting.begin(); It != Waiting.end(); It++)
+					if (!It->second.empty() && (Oldest == Waiting.end() || It->second.front() < Oldest->second.front()))
+						Oldest = It;
+				if (Dispatched.size() != DispatchedBefore + 1 || Dispatched.back().Obj || Dispatched.back().Id != Oldest->second.front())
+					return Name + "did not drop the oldest order " + std::to_string(Oldest->second.front());
+				Oldest->second.erase(Oldest->second.begin());
+				Expected.Dropped++;
+				Depth--;
+			}
+			else if (Dispatched.size() != DispatchedBefore)
+				return Name + "dispatched something while queueing";
+			Waiting[Street].push_back(Id);
+			Depth++;
+			return "";
+		};
+		auto Release = [&](Taxi& Obj, int DriverIndex) -> std::string
+		{
+			std::string Name = "release of taxi " + std::to_string(&Obj - Fleet.data()) + " ";
+			// the oldest order over the addresses of the taxi
+			std::vector<std::uint64_t>* Oldest = nullptr;
+			for (int a = 0; a < Obj.GetAddressesCount(); a++)
+			{
+				auto It = Waiting.find(Obj.GetAddress(a));
+				if (It != Waiting.end() && !It->second.empty() && (!Oldest || It->second.front() < Oldest->front()))
+					Oldest = &It->second;
+			}
+			std::size_t DispatchedBefore = Dispatched.size();
+			Obj.SetDriverState(DriverIndex, DRIVER_FREE);
+			bool Served = Queue.DriverReleased(Obj, DriverIndex);
+			if (!Oldest)
+				return !Served && Dispatched.size() == DispatchedBefore ? "" : Name + "served an order nobody queued";
+			if (!Served || Dispatched.size() != DispatchedBefore + 1)
+				return Name + "left order " + std::to_string(Oldest->front()) + " waiting";
+			const Dispatch& Last = Dispatched.back();
+			if (Last.Id != Oldest->front() || Last.Obj != &Obj || Last.DriverIndex != DriverIndex)
+				return Name + "served order " + std::to_string(Last.Id) + " instead of " + std::to_string(Oldest->front());
+			if (Obj.GetDriverState(DriverIndex) == DRIVER_FREE)
+				return Name + "served an order without taking the driver";
+			Oldest->erase(Oldest->begin());
+			Expected.ServedFromQueue++;
+			Depth--;
+			return "";
+		};
+		// nothing waits for an address while one of its taxis has a free driver
+		auto Verify = [&]() -> std::string
+		{
+			if (Queue.GetDepth() != Depth)
+				return "depth " + std::to_string(Queue.GetDepth()) + " instead of " + std::to_string(Depth);
+			for (const auto& Entry : Waiting)
+				if (!Entry.second.empty() && FreeServing(Entry.first.c_str()))
+					return "order for " + Entry.first + " waits next to a free driver";
+			return "";
+		};
+		auto RandomStep = [&](bool Closed) -> std::string
+		{
+			if (Pick(Random, 2))
+				return Submit(Pick(Random, 20) ? Streets[Pick(Random, STREET_COUNT)] : "CheckStreetZ", Closed);
+			Taxi& Obj = Fleet[Pick(Random, static_cast<int>(Fleet.size()))];
+			int DriverIndex = Pick(Random, Obj.GetDriversCount());
+			return Obj.GetDriverState(DriverIndex) == DRIVER_BUSY ? Release(Obj, DriverIndex) : "";
+		};
+
+		for (int Step = 0; Step < 20000; Step++)
+		{
+			std::string Failure = RandomStep(false);
+			if (Failure.empty())
+				Failure = Verify();
+			if (!Failure.empty())
+				return "step " + std::to_string(Step) + ": " + Failure;
+		}
+
+		// a taxi added later serves its addresses once the queue is indexed again
+		Taxi Added;
+		Added.SetDriversCount(1);
+		Added.SetAddressesCount(1);
+		Added.SetAddress(0, "CheckStreetF");
+		Fleet.push_back(std::move(Added));
+		if (Queue.Submit("CheckStreetF") != SubmitResult::Rejected)
+			return "order for an address nobody had at the last Reindex not rejected";
+		Queue.Reindex();
+		if (Queue.Submit("CheckStreetF") != SubmitResult::Served)
+			return "order for a reindexed address not served";
+		Expected.Submitted += 2;
+		Expected.Rejected++;
+		Expected.ServedAtOnce++;
+
+		// after Close every order is rejected, the queued ones are still served
+		Queue.Close();
+		for (int Step = 0; Step < 2000; Step++)
+		{
+			std::string Failure = RandomStep(true);
+			if (Failure.empty())
+				Failure = Verify();
+			if (!Failure.empty())
+				return "closed queue, step " + std::to_string(Step) + ": " + Failure;
+		}
+
+		PendingOrderStats Stats = Queue.GetStats();
+		if (Stats.Submitted != Expected.Submitted || Stats.ServedAtOnce != Expected.ServedAtOnce || Stats.Queued != Expected.Queued
+			|| Stats.ServedFromQueue != Expected.ServedFromQueue || Stats.Rejected != Expected.Rejected
+			|| Stats.Dropped != Expected.Dropped || Stats.Depth != Depth)
+			return "statistics do not add up";
+		if (!Expected.Queued || !Expected.ServedFromQueue || (Policy == OverflowPolicy::DropOldest) != (Expected.Dropped > 0))
+			return "the run never queued, served from the queue or dropped as it should";
+		return "";
+	}
+
+	std::string PendingOrderCheck()
+	{
+		std::string Failure = PendingOrderRun(OverflowPolicy::Reject, 6);
+		if (!Failure.empty())
+			return "Reject: " + Failure;
+		Failure = PendingOrderRun(OverflowPolicy::DropOldest, 7);
+		return Failure.empty() ? "" : "DropOldest: " + Failure;
+	}
+
+	std::string TripSchedulerCheck()
+	{
+		std::mt19937 Random(8);
+		std::vector<Taxi> Fleet;
+		for (int i = 0; i < 50; i++)
+		{
+			Taxi Obj;
+			Obj.SetDriversCount(20);
+			Obj.SetAddressesCount(1);
+			Obj.SetAddress(0, "CheckTripStreet");
+			Fleet.push_back(std::move(Obj));
+		}
+
+		struct Trip
+		{
+			TripId Id;
+			std::uint64_t Expiry;
+			int TaxiIndex;
+			int DriverIndex;
+		};
+		// live trips by (taxi, driver)
+		std::map<std::pair<int, int>, Trip> Live;
+		TripScheduler Trips(1000);
+		std::string Failure;
+		Trips.SetReleaseCallback([&](Taxi& Obj, int DriverIndex)
+			{
+				auto It = Live.find({ static_cast<int>(&Obj - Fleet.data()), DriverIndex });
+				if (It == Live.end())
+				{
+					if (Failure.empty())
+						Failure = "released a driver that had no trip";
+					return;
+				}
+				if (Trips.GetNow() != It->second.Expiry && Failure.empty())
+					Failure = "trip ended at " + std::to_string(Trips.GetNow()) + " instead of " + std::to_string(It->second.Expiry);
+				if (Obj.GetDriverState(DriverIndex) != DRIVER_FREE && Failure.empty())
+					Failure = "released driver not free";
+				Live.erase(It);
+			});
+
+		// trips ending in every wheel level
+		auto RandomDuration = [&]() -> std::uint32_t
+		{
+			switch (Pick(Random, 5))
+			{
+			case 0: return Pick(Random, 3);
+			case 1: return 1 + Pick(Random, 255);
+			case 2: return 256 + Pick(Random, 65280);
+			case 3: return 65536 + Pick(Random, 1 << 20);
+			default: return (1u << 24) + Pick(Random, 1 << 20);
+			}
+		};
+		auto PickLive = [&]() -> Trip&
+		{
+			auto It = Live.begin();
+			std::advance(It, Pick(Random, static_cast<int>(Live.size())));
+			return It->second;
+		};
+
+		std::vector<TripId> Ended;
+		for (int Round = 0; Round < 300; Round++)
+		{
+			for (int i = 0; i < 40; i++)
+			{
+				int TaxiIndex = Pick(Random, static_cast<int>(Fleet.size()));
+				Taxi& Obj = Fleet[TaxiIndex];
+				int Free = Obj.Order();
+				std::uint32_t Duration = RandomDuration();
+				TripId Id = Trips.StartTrip(Obj, "CheckTripStreet", Duration);
+				if (!Free)
+				{
+					if (Id != INVALID_TRIP_ID)
+						return "trip started without a free driver";
+					continue;
+				}
+				if (Id == INVALID_TRIP_ID || Obj.Order() != Free - 1)
+					return "trip not started with a free driver";
+				int DriverIndex = -1;
+				for (int d = 0; d < Obj.GetDriversCount() && DriverIndex < 0; d++)
+					if (Obj.GetDriverState(d) != DRIVER_FREE && !Live.count({ TaxiIndex, d }))
+						DriverIndex = d;
+				Live[{ TaxiIndex, DriverIndex }] = { Id, Trips.GetNow() + std::max<std::uint32_t>(Duration, 1), TaxiIndex, DriverIndex };
+			}
+			// cancelled trips keep the driver as it is and never end
+			for (int i = 0; i < 3 && !Live.empty(); i++)
+			{
+				Trip Cancelled = PickLive();
+				Live.erase({ Cancelled.TaxiIndex, Cancelled.DriverIndex });
+				if (!Trips.Cancel(Cancelled.Id) || Trips.Cancel(Cancelled.Id))
+					return "cancel of trip " + std::to_string(Cancelled.Id) + " not accepted exactly once";
+				if (Fleet[Cancelled.TaxiIndex].GetDriverState(Cancelled.DriverIndex) == DRIVER_FREE)
+					return "cancelled trip released its driver";
+				Fleet[Cancelled.TaxiIndex].SetDriverState(Cancelled.DriverIndex, DRIVER_FREE);
+				Ended.push_back(Cancelled.Id);
+			}
+			// completed trips end now
+			for (int i = 0; i < 3 && !Live.empty(); i++)
+			{
+				Trip& Completed = PickLive();
+				Completed.Expiry = Trips.GetNow();
+				TripId Id = Completed.Id;
+				if (!Trips.Complete(Id) || Trips.Complete(Id))
+					return "complete of trip " + std::to_string(Id) + " not accepted exactly once";
+				Ended.push_back(Id);
+			}
+			for (TripId Id : Ended)
+				if (Trips.Cancel(Id))
+					return "ended trip " + std::to_string(Id) + " cancelled again";
+			Ended.clear();
+
+			Trips.Advance(Pick(Random, 4) ? Pick(Random, 5000) : Pick(Random, 1 << 22));
+			if (!Failure.empty())
+				return "round " + std::to_string(Round) + ": " + Failure;
+			if (Trips.GetActiveTrips() != static_cast<int>(Live.size()))
+				return "round " + std::to_string(Round) + ": " + std::to_string(Trips.GetActiveTrips()) + " active trips instead of "
+					+ std::to_string(Live.size());
+		}
+
+		// every trip ends eventually and every driver is free again
+		while (!Live.empty() && Failure.empty())
+			Trips.Advance(1 << 22);
+		if (!Failure.empty())
+			return Failure;
+		if (Trips.GetActiveTrips())
+			return std::to_string(Trips.GetActiveTrips()) + " trips left after all ended";
+		for (const Taxi& Obj : Fleet)
+			if (Obj.Order() != Obj.GetDriversCount())
+				return "a driver is still busy after every trip ended";
+		return "";
+	}
+
+	// A 63 character address, the longest AddressPool keeps
+	constexpr const char* CHECK_LONG_ADDRESS = "CheckLongAddress-0123456789-0123456789-0123456789-0123456789-ab";
+
+	constexpr AddressCatalog CheckCatalog({ "Main", "MainStreet", "MainStreet2", "mainstreet", "Broadway", "ParkAvenue",
+		"ParkAvenue ", " ParkAvenue", "Elm", "Oak", "Pine", "Maple", "Cedar", "Birch", "Walnut", "Chestnut", "Harbor, 1",
+		"Harbor|2", "Harbor\\3", "Harbor=4", "A", "B", "AB", "BA", "Ring Road", "Station Square", "Old Town", "New Town",
+		"Airport", "University", "Stadium", "Hospital", "Museum", "Library", "Market", "Riverside", "Hillside", "Lakeside",
+		"Bridge", "Tunnel", CHECK_LONG_ADDRESS });
+	static_assert(CheckCatalog.IsValid(), "the check catalog must get a perfect hash");
+	static_assert(std::char_traits<char>::length(CHECK_LONG_ADDRESS) == MAX_STR_LEN - 1, "the long address fills MAX_STR_LEN");
+
+	int ScanCatalog(const std::string& Address)
+	{
+		for (int i = 0; i < CheckCatalog.GetSize(); i++)
+			if (Address == CheckCatalog.Get(i))
+				return i;
+		return -1;
+	}
+
+	std::string AddressCatalogCheck()
+	{
+		std::mt19937 Random(9);
+		std::vector<std::string> Probes;
+		for (int i = 0; i < CheckCatalog.GetSize(); i++)
+		{
+			std::string Address = CheckCatalog.Get(i);
+			if (CheckCatalog.Find(Address) != i || CheckCatalog.Find(Address.c_str()) != i)
+				return "\"" + Address + "\" not found at " + std::to_string(i);
+			// every catalog address with a character dropped, added or changed
+			Probes.push_back(Address.substr(0, Address.size() - 1));
+			Probes.push_back(Address.substr(1));
+			Probes.push_back(Address + "x");
+			Probes.push_back(Address);
+			Probes.back()[0] ^= 0x20;
+		}
+		for (int i = 0; i < 10000; i++)
+			Probes.push_back(RandomText(Random, 1, 12));
+		Probes.push_back("");
+		for (const std::string& Probe : Probes)
+		{
+			int Expected = ScanCatalog(Probe);
+			int ExpectedCut = ScanCatalog(Probe.substr(0, MAX_STR_LEN - 1));
+			if (CheckCatalog.Find(Probe) != Expected || CheckCatalog.Find(Probe.c_str()) != ExpectedCut)
+				return "Find(\"" + Probe + "\") gives " + std::to_string(CheckCatalog.Find(Probe)) + ", the scan " + std::to_string(Expected);
+		}
+		// a zero terminated address is cut at MAX_STR_LEN - 1 like in the pool
+		std::string Longer = std::string(CHECK_LONG_ADDRESS) + "tail";
+		if (CheckCatalog.Find(Longer.c_str()) != CheckCatalog.GetSize() - 1 || CheckCatalog.Find(Longer) != -1)
+			return "long address not cut like AddressPool does";
+
+		// Order through the catalog against the same addresses through the pool
+		Taxi Cataloged;
+		Taxi Pooled;
+		Cataloged.SetDriversCount(64);
+		Pooled.SetDriversCount(64);
+		if (!Cataloged.UseCatalog(CheckCatalog) || Cataloged.GetCatalog() != &CheckCatalog)
+			return "catalog not taken";
+		Pooled.SetAddressesCount(CheckCatalog.GetSize());
+		for (int i = 0; i < CheckCatalog.GetSize(); i++)
+		{
+			Pooled.SetAddress(i, CheckCatalog.Get(i));
+			if (Cataloged.GetAddressesCount() != CheckCatalog.GetSize() || std::strcmp(Cataloged.GetAddress(i), CheckCatalog.Get(i)) != 0)
+				return "catalog taxi address " + std::to_string(i) + " is not the catalog's";
+		}
+		auto CompareOrders = [&](int Count) -> std::string
+		{
+			for (int i = 0; i < Count; i++)
+			{
+				if (i % 64 == 0)
+					for (int d = 0; d < 64; d++)
+					{
+						Cataloged.SetDriverState(d, DRIVER_FREE);
+						Pooled.SetDriverState(d, DRIVER_FREE);
+					}
+				const std::string& Address = Pick(Random, 10) < 7 ? std::string(CheckCatalog.Get(Pick(Random, CheckCatalog.GetSize())))
+					: Probes[Pick(Random, static_cast<int>(Probes.size()))];
+				int Expected = Pooled.OrderDriver(Address.c_str());
+				int Driver = Cataloged.OrderDriver(Address.c_str());
+				if (Driver != Expected)
+					return "order for \"" + Address + "\" took driver " + std::to_string(Driver) + ", through the pool " + std::to_string(Expected);
+			}
+			return "";
+		};
+		std::string Failure = CompareOrders(5000);
+		if (!Failure.empty())
+			return Failure;
+
+		// a copy keeps the catalog, changing an address drops it
+		Taxi Copy(Cataloged);
+		if (Copy.GetCatalog() != &CheckCatalog)
+			return "copy lost the catalog";
+		Cataloged.SetAddress(3, "CheckNewStreet");
+		Pooled.SetAddress(3, "CheckNewStreet");
+		if (Cataloged.GetCatalog())
+			return "catalog kept after an address changed";
+		Probes.push_back("CheckNewStreet");
+		return CompareOrders(5000);
+	}
+}
+
+bool CheckSnapshotRoundTrip()
+{
+	ScopedLogLevel Quiet(LogLevel::Error);
+	return Report("Snapshot round trip", SnapshotRoundTrip());
+}
+
+bool CheckDeltaRoundTrip()
+{
+	ScopedLogLevel Quiet(LogLevel::Error);
+	return Report("Delta round trip", DeltaRoundTrip());
+}
+
+bool CheckCodecRoundTrip()
+{
+	ScopedLogLevel Quiet(LogLevel::Off);
+	return Report("Codec round trip", CodecRoundTrip());
+}
+
+bool CheckJournalReplay()
+{
+	ScopedLogLevel Quiet(LogLevel::Error);
+	return Report("Journal replay", JournalReplay());
+}
+
+bool CheckFleetIndex()
+{
+	ScopedLogLevel Quiet(LogLevel::Error);
+	return Report("FleetIndex", FleetIndexCheck());
+}
+
+bool CheckPendingOrders()
+{
+	ScopedLogLevel Quiet(LogLevel::Error);
+	return Report("PendingOrderQueue", PendingOrderCheck());
+}
+
+bool CheckTripScheduler()
+{
+	ScopedLogLevel Quiet(LogLevel::Error);
+	return Report("TripScheduler", TripSchedulerCheck());
+}
+
+bool CheckAddressCatalog()
+{
+	ScopedLogLevel Quiet(LogLevel::Error);
+	return Report("AddressCatalog", AddressCatalogCheck());
+}
+
+bool RunChecks()
+{
+	bool Passed = CheckSnapshotRoundTrip();
+	Passed = CheckDeltaRoundTrip() && Passed;
+	Passed = CheckCodecRoundTrip() && Passed;
+	Passed = CheckJournalReplay() && Passed;
+	Passed = CheckFleetIndex() && Passed;
+	Passed = CheckPendingOrders() && Passed;
+	Passed = CheckTripScheduler() && Passed;
+	Passed = CheckAddressCatalog() && Passed;
+	std::cout << (Passed ? "All checks passed\n" : "Some checks failed\n");
+	return Passed;
+}
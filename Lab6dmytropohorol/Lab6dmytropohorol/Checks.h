@@ -0,0 +1,24 @@
+#pragma once
+
+// Round-trip and invariant checks of the file formats and the fleet structures. Every
+// check builds its own fleets from a fixed random seed, so a failure repeats, and prints
+// what went wrong. Returns false if any check failed.
+bool RunChecks();
+
+// SaveToFile, SaveToTextFile, snapshot records and fleet files: what is saved loads back equal
+bool CheckSnapshotRoundTrip();
+// Taxi delta records and FleetCheckpoint save/load, with compaction and removed taxis
+bool CheckDeltaRoundTrip();
+// TaxiCodec: encoding and parsing again gives the same taxi; legacy and malformed strings
+bool CheckCodecRoundTrip();
+// FleetJournal recovery gives the fleet as it was at the last Sync, also past a torn tail
+bool CheckJournalReplay();
+// FleetIndex queries against a scan of the fleet while drivers, passengers and the order change
+bool CheckFleetIndex();
+// PendingOrderQueue against a model: oldest order first per address and across the addresses
+// of a taxi, nothing queued while a driver is free, nothing lost or served twice
+bool CheckPendingOrders();
+// TripScheduler: every trip ends exactly at its expiry, cancelled and completed ones never later
+bool CheckTripScheduler();
+// AddressCatalog::Find against a scan, and Order through a catalog against the address pool
+bool CheckAddressCatalog();
@@ -0,0 +1,321 @@
+#include "DispatchClient.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#ifdef __linux__
+#define TAXI_SOCKETS 1
+#include <arpa/inet.h>
+#include <cerrno>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	// Room for the next read, responses of a whole batch usually arrive at once
+	const std::size_t READ_CHUNK = 64 * 1024;
+
+	// What the load generator knows about one taxi
+	struct LoadTarget
+	{
+		std::uint32_t TaxiIndex;
+		std::int32_t DriversCount;
+		std::string Address;
+	};
+
+	struct LoadResult
+	{
+		std::vector<float> LatenciesUs;
+		std::uint64_t Refused = 0;
+		std::uint64_t BadRequests = 0;
+		bool Ok = true;
+	};
+
+	bool Connect(DispatchClient& Client, const DispatchLoadOptions& Options)
+	{
+		return Options.UnixPath.empty() ? Client.ConnectTcp(Options.Port) : Client.ConnectUnix(Options.UnixPath.c_str());
+	}
+
+	void LoadConnection(const DispatchLoadOptions& Options, const std::vector<LoadTarget>& Targets,
+		int Requests, unsigned Seed, LoadResult& Result)
+	{
+		DispatchClient Client;
+		if (!Connect(Client, Options))
+		{
+			Result.Ok = false;
+			return;
+		}
+		Result.LatenciesUs.reserve(Requests);
+		unsigned Random = Seed;
+		for (int Done = 0; Done < Requests; )
+		{
+			int Batch = std::min(Options.Pipeline, Requests - Done);
+			for (int i = 0; i < Batch; i++)
+			{
+				Random = Random * 1103515245u + 12345u;
+				const LoadTarget& Target = Targets[(Random >> 8) % Targets.size()];
+				std::int32_t Driver = static_cast<std::int32_t>((Random >> 4) % static_cast<unsigned>(std::max(Target.DriversCount, 1)));
+				unsigned Kind = (Random >> 20) % 100;
+				// mostly queries, orders and releases in balance so the fleet never runs dry
+				if (Kind < 40)
+					Client.Add(DispatchOp::FreeCount, Target.TaxiIndex);
+				else if (Kind < 60)
+					Client.Add(DispatchOp::DriverState, Target.TaxiIndex, Driver);
+				else if (Kind < 80)
+					Client.Add(DispatchOp::Order, Target.TaxiIndex, 0, Target.Address.c_str());
+				else
+					Client.Add(DispatchOp::Release, Target.TaxiIndex, Driver);
+			}
+			Clock::time_point Sent = Clock::now();
+			if (!Client.Send())
+			{
+				Result.Ok = false;
+				return;
+			}
+			for (int i = 0; i < Batch; i++)
+			{
+				DispatchResponse Response;
+				if (!Client.Receive(Response))
+				{
+					Result.Ok = false;
+					return;
+				}
+				Result.LatenciesUs.push_back(std::chrono::duration<float, std::micro>(Clock::now() - Sent).count());
+				if (Response.Status == static_cast<std::uint8_t>(DispatchStatus::Refused))
+					Result.Refused++;
+				else if (Response.Status != static_cast<std::uint8_t>(DispatchStatus::Ok))
+					Result.BadRequests++;
+			}
+			Done += Batch;
+		}
+	}
+}
+
+#ifdef TAXI_SOCKETS
+
+bool DispatchClient::ConnectTcp(std::uint16_t Port, const char* Host)
+{
+	Close();
+	sockaddr_in Address = {};
+	Address.sin_family = AF_INET;
+	Address.sin_port = htons(Port);
+	Fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (Fd < 0 || inet_pton(AF_INET, Host, &Address.sin_addr) != 1
+		|| connect(Fd, reinterpret_cast<sockaddr*>(&Address), sizeof(Address)) != 0)
+	{
+		std::cerr << "Failed to connect to " << Host << ":" << Port << ": " << std::strerror(errno) << "\n";
+		Close();
+		return false;
+	}
+	int Yes = 1;
+	setsockopt(Fd, IPPROTO_TCP, TCP_NODELAY, &Yes, sizeof(Yes));
+	return true;
+}
+
+bool DispatchClient::ConnectUnix(const char* Path)
+{
+	Close();
+	sockaddr_un Address = {};
+	Address.sun_family = AF_UNIX;
+	std::strncpy(Address.sun_path, Path, sizeof(Address.sun_path) - 1);
+	Fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (Fd < 0 || connect(Fd, reinterpret_cast<sockaddr*>(&Address), sizeof(Address)) != 0)
+	{
+		std::cerr << "Failed to connect to " << Path << ": " << std::strerror(errno) << "\n";
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void DispatchClient::Close()
+{
+	if (Fd >= 0)
+		close(Fd);
+	Fd = -1;
+	Out.clear();
+	In.clear();
+	InStart = 0;
+	InEnd = 0;
+}
+
+bool DispatchClient::Send()
+{
+	std::size_t Offset = 0;
+	while (Offset < Out.size())
+	{
+		ssize_t Sent = send(Fd, Out.data() + Offset, Out.size() - Offset, MSG_NOSIGNAL);
+		if (Sent < 0 && errno == EINTR)
+			continue;
+		if (Sent <= 0)
+			return false;
+		Offset += static_cast<std::size_t>(Sent);
+	}
+	Out.clear();
+	return true;
+}
+
+bool DispatchClient::ReadExactly(char* Data, std::size_t Size)
+{
+	// responses come in batches, so read as much as there is and hand it out from In
+	while (InEnd - InStart < Size)
+	{
+		// keep the partial response and read behind it. In is sized once, so a read
+		// does not clear 64 KB of buffer first.
+		if (InStart)
+		{
+			std::memmove(In.data(), In.data() + InStart, InEnd - InStart);
+			InEnd -= InStart;
+			InStart = 0;
+		}
+		if (In.size() < InEnd + READ_CHUNK)
+			In.resize(InEnd + READ_CHUNK);
+		ssize_t Read = recv(Fd, In.data() + InEnd, In.size() - InEnd, 0);
+		if (Read < 0 && errno == EINTR)
+			continue;
+		if (Read <= 0)
+			return false;
+		InEnd += static_cast<std::size_t>(Read);
+	}
+	std::memcpy(Data, In.data() + InStart, Size);
+	InStart += Size;
+	return true;
+}
+
+#else
+
+bool DispatchClient::ConnectTcp(std::uint16_t, const char*)
+{
+	std::cerr << "Failed to connect: the dispatch client needs Linux sockets\n";
+	return false;
+}
+
+bool DispatchClient::ConnectUnix(const char*)
+{
+	std::cerr << "Failed to connect: the dispatch client needs Linux sockets\n";
+	return false;
+}
+
+void DispatchClient::Close()
+{
+}
+
+bool DispatchClient::Send()
+{
+	return false;
+}
+
+bool DispatchClient::ReadExactly(char*, std::size_t)
+{
+	return false;
+}
+
+#endif
+
+void DispatchClient::Add(DispatchOp Op, std::uint32_t TaxiIndex, std::int32_t Index, const char* Address, std::uint32_t Tag)
+{
+	std::size_t Length = Address ? std::min<std::size_t>(std::strlen(Address), DISPATCH_MAX_PAYLOAD) : 0;
+	DispatchRequest Request = { static_cast<std::uint32_t>(Length), Tag, static_cast<std::uint8_t>(Op), TaxiIndex, Index };
+	const char* Bytes = reinterpret_cast<const char*>(&Request);
+	Out.insert(Out.end(), Bytes, Bytes + sizeof(Request));
+	if (Length)
+		Out.insert(Out.end(), Address, Address + Length);
+}
+
+bool DispatchClient::Receive(DispatchResponse& Response, std::string* Payload)
+{
+	if (!ReadExactly(reinterpret_cast<char*>(&Response), sizeof(Response)))
+		return false;
+	if (Response.Size > DISPATCH_MAX_PAYLOAD)
+		return false;
+	char Buffer[DISPATCH_MAX_PAYLOAD];
+	if (Response.Size && !ReadExactly(Buffer, Response.Size))
+		return false;
+	if (Payload)
+		Payload->assign(Buffer, Response.Size);
+	return true;
+}
+
+bool DispatchClient::Call(DispatchOp Op, std::uint32_t TaxiIndex, std::int32_t Index, const char* Address,
+	DispatchResponse& Response, std::string* Payload)
+{
+	Add(Op, TaxiIndex, Index, Address);
+	return Send() && Receive(Response, Payload);
+}
+
+bool RunDispatchLoad(const DispatchLoadOptions& Options, DispatchLoadStats& Stats)
+{
+	Stats = DispatchLoadStats();
+	if (Options.Connections < 1 || Options.Pipeline < 1 || Options.Requests < 1)
+		return false;
+
+	// learn the fleet: taxis with drivers and an address to order to
+	std::vector<LoadTarget> Targets;
+	{
+		DispatchClient Client;
+		DispatchResponse Response;
+		if (!Connect(Client, Options) || !Client.Call(DispatchOp::FleetSize, 0, 0, nullptr, Response))
+			return false;
+		std::uint32_t TaxiCount = Response.Value > 0 ? static_cast<std::uint32_t>(Response.Value) : 0;
+		// a sample is enough, spread over the whole fleet
+		std::uint32_t Step = std::max(1u, TaxiCount / 4096);
+		for (std::uint32_t i = 0; i < TaxiCount; i += Step)
+		{
+			LoadTarget Target = { i, 0, std::string() };
+			if (!Client.Call(DispatchOp::DriversCount, i, 0, nullptr, Response))
+				return false;
+			Target.DriversCount = Response.Value;
+			if (!Client.Call(DispatchOp::GetAddress, i, 0, nullptr, Response, &Target.Address))
+				return false;
+			if (Target.DriversCount > 0 && Response.Status == static_cast<std::uint8_t>(DispatchStatus::Ok))
+				Targets.push_back(Target);
+		}
+	}
+	if (Targets.empty())
+	{
+		std::cerr << "Failed to generate load: the fleet has no taxi with drivers and addresses\n";
+		return false;
+	}
+
+	std::vector<LoadResult> Results(Options.Connections);
+	std::vector<std::thread> Threads;
+	Clock::time_point Start = Clock::now();
+	for (int i = 0; i < Options.Connections; i++)
+	{
+		int Requests = Options.Requests / Options.Connections + (i < Options.Requests % Options.Connections ? 1 : 0);
+		Threads.emplace_back(LoadConnection, std::cref(Options), std::cref(Targets), Requests, 17u + i, std::ref(Results[i]));
+	}
+	for (std::thread& Thread : Threads)
+		Thread.join();
+	Stats.Seconds = std::chrono::duration<double>(Clock::now() - Start).count();
+
+	std::vector<float> Latencies;
+	for (const LoadResult& Result : Results)
+	{
+		if (!Result.Ok)
+			return false;
+		Latencies.insert(Latencies.end(), Result.LatenciesUs.begin(), Result.LatenciesUs.end());
+		Stats.Refused += Result.Refused;
+		Stats.BadRequests += Result.BadRequests;
+	}
+	Stats.Requests = Latencies.size();
+	Stats.Qps = Stats.Seconds > 0 ? Stats.Requests / Stats.Seconds : 0;
+	auto Percentile = [&Latencies](double Fraction)
+	{
+		std::size_t At = std::min(Latencies.size() - 1, static_cast<std::size_t>(Fraction * Latencies.size()));
+		std::nth_element(Latencies.begin(), Latencies.begin() + static_cast<std::ptrdiff_t>(At), Latencies.end());
+		return static_cast<double>(Latencies[At]);
+	};
+	Stats.P50Us = Percentile(0.50);
+	Stats.P99Us = Percentile(0.99);
+	Stats.MaxUs = *std::max_element(Latencies.begin(), Latencies.end());
+	return true;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "DispatchProtocol.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Blocking client of DispatchServer. Call does one round trip; Send + Receive let the
+// caller pipeline any number of requests. Linux only, like the server.
+class DispatchClient
+{
+public:
+	DispatchClient() = default;
+	~DispatchClient() { Close(); }
+	DispatchClient(const DispatchClient&) = delete;
+	DispatchClient& operator=(const DispatchClient&) = delete;
+
+	bool ConnectTcp(std::uint16_t Port, const char* Host = "127.0.0.1");
+	bool ConnectUnix(const char* Path);
+	void Close();
+	bool IsConnected() const { return Fd >= 0; }
+
+	// Queues a request, Address may be nullptr
+	void Add(DispatchOp Op, std::uint32_t TaxiIndex, std::int32_t Index = 0, const char* Address = nullptr, std::uint32_t Tag = 0);
+	// Sends everything queued by Add with one write
+	bool Send();
+	// Reads the next response, its payload (if any) goes to Payload
+	bool Receive(DispatchResponse& Response, std::string* Payload = nullptr);
+	// Add + Send + Receive
+	bool Call(DispatchOp Op, std::uint32_t TaxiIndex, std::int32_t Index, const char* Address,
+		DispatchResponse& Response, std::string* Payload = nullptr);
+
+private:
+	bool ReadExactly(char* Data, std::size_t Size);
+
+	int Fd = -1;
+	std::vector<char> Out;
+	// Received bytes are In[InStart, InEnd), In itself only grows
+	std::vector<char> In;
+	std::size_t InStart = 0;
+	std::size_t InEnd = 0;
+};
+
+struct DispatchLoadOptions
+{
+	// TCP port on 127.0.0.1, used when UnixPath is empty
+	std::uint16_t Port = 0;
+	std::string UnixPath;
+	int Connections = 4;
+	// Requests sent before the answers are read
+	int Pipeline = 32;
+	// Total over all connections
+	int Requests = 100000;
+};
+
+struct DispatchLoadStats
+{
+	std::uint64_t Requests = 0;
+	std::uint64_t Refused = 0;
+	std::uint64_t BadRequests = 0;
+	double Seconds = 0;
+	double Qps = 0;
+	// Latency from sending a pipelined batch to each of its answers, in microseconds
+	double P50Us = 0;
+	double P99Us = 0;
+	double MaxUs = 0;
+};
+
+// Load generator: every connection runs on its own thread and keeps sending batches of
+// Pipeline requests (free counts, driver states, orders and releases across the fleet)
+// until Requests were answered in total
+bool RunDispatchLoad(const DispatchLoadOptions& Options, DispatchLoadStats& Stats);
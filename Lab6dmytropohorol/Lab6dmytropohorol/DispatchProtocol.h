@@ -0,0 +1,55 @@
+#pragma once
+
+#include "AbstractTaxi.h"
+#include <cstdint>
+
+// Binary protocol of DispatchServer. A connection carries DispatchRequest headers, each
+// followed by Size payload bytes, and gets one DispatchResponse (+ Size payload bytes)
+// per request, in request order. Clients may send any number of requests before reading
+// the responses (pipelining); Tag is echoed back so they can match them up.
+// Integers are in native byte order, both ends run on the same machine.
+
+enum class DispatchOp : std::uint8_t
+{
+	FleetSize = 1,       // Value = number of taxis
+	FreeCount = 2,       // Value = free drivers of the taxi (Taxi::Order())
+	DriverState = 3,     // Value = state of the driver
+	Order = 4,           // payload = address, Value = index of the driver that got the order
+	OrderDriver = 5,     // payload = address, orders that driver
+	Release = 6,         // makes the driver FREE again
+	DriversCount = 7,    // Value = drivers of the taxi
+	AddressesCount = 8,  // Value = addresses of the taxi
+	GetAddress = 9,      // Index = address index, payload of the response = the address
+	FleetFreeCount = 10  // Value = free drivers of the whole fleet served, TaxiIndex is ignored
+};
+
+enum class DispatchStatus : std::uint8_t
+{
+	Ok = 0,
+	BadRequest = 1,  // unknown op, bad taxi, driver or address index
+	Refused = 2      // a valid order nobody could take
+};
+
+#pragma pack(push, 1)
+struct DispatchRequest
+{
+	std::uint32_t Size;
+	std::uint32_t Tag;
+	std::uint8_t Op;
+	std::uint32_t TaxiIndex;
+	// Driver or address index, depending on Op
+	std::int32_t Index;
+};
+
+struct DispatchResponse
+{
+	std::uint32_t Size;
+	std::uint32_t Tag;
+	std::uint8_t Status;
+	std::int32_t Value;
+};
+#pragma pack(pop)
+
+// Longest request payload, an address with its terminating zero must fit MAX_STR_LEN.
+// A longer one is answered with BadRequest and the server closes the connection.
+const std::uint32_t DISPATCH_MAX_PAYLOAD = MAX_STR_LEN - 1;
@@ -0,0 +1,415 @@
+#include "DispatchServer.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#ifdef __linux__
+#define TAXI_EPOLL 1
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	// Stop reading a connection while this much is waiting to be sent to it
+	const std::size_t MAX_PENDING_OUTPUT = 1 << 20;
+	const std::size_t READ_CHUNK = 64 * 1024;
+
+	void AppendResponse(std::vector<char>& Out, std::uint32_t Tag, DispatchStatus Status, std::int32_t Value,
+		const char* Payload = nullptr, std::uint32_t Size = 0)
+	{
+		DispatchResponse Response = { Size, Tag, static_cast<std::uint8_t>(Status), Value };
+		const char* Bytes = reinterpret_cast<const char*>(&Response);
+		Out.insert(Out.end(), Bytes, Bytes + sizeof(Response));
+		if (Size)
+			Out.insert(Out.end(), Payload, Payload + Size);
+	}
+}
+
+#ifdef TAXI_EPOLL
+
+DispatchServer::DispatchServer(std::vector<Taxi>& Fleet)
+	: Fleet(Fleet), EpollFd(epoll_create1(EPOLL_CLOEXEC)), StopFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+{
+}
+
+DispatchServer::~DispatchServer()
+{
+	for (auto& Entry : Connections)
+		close(Entry.first);
+	for (int Fd : Listeners)
+		close(Fd);
+	if (!UnixPath.empty())
+		unlink(UnixPath.c_str());
+	if (EpollFd >= 0)
+		close(EpollFd);
+	if (StopFd >= 0)
+		close(StopFd);
+}
+
+bool DispatchServer::AddListener(int Fd)
+{
+	if (listen(Fd, SOMAXCONN) != 0 || fcntl(Fd, F_SETFL, fcntl(Fd, F_GETFL) | O_NONBLOCK) != 0)
+		return false;
+	Listeners.push_back(Fd);
+	return true;
+}
+
+bool DispatchServer::ListenTcp(std::uint16_t InPort, const char* Host)
+{
+	int Fd = socket(AF_INET, SOCK_STREAM, 0);
+	sockaddr_in Address = {};
+	Address.sin_family = AF_INET;
+	Address.sin_port = htons(InPort);
+	int Yes = 1;
+	if (Fd < 0 || inet_pton(AF_INET, Host, &Address.sin_addr) != 1
+		|| setsockopt(Fd, SOL_SOCKET, SO_REUSEADDR, &Yes, sizeof(Yes)) != 0
+		|| bind(Fd, reinterpret_cast<sockaddr*>(&Address), sizeof(Address)) != 0
+		|| !AddListener(Fd))
+	{
+		std::cerr << "Failed to listen on " << Host << ":" << InPort << ": " << std::strerror(errno) << "\n";
+		if (Fd >= 0)
+			close(Fd);
+		return false;
+	}
+	socklen_t Length = sizeof(Address);
+	getsockname(Fd, reinterpret_cast<sockaddr*>(&Address), &Length);
+	Port = ntohs(Address.sin_port);
+	return true;
+}
+
+bool DispatchServer::ListenUnix(const char* Path)
+{
+	sockaddr_un Address = {};
+	Address.sun_family = AF_UNIX;
+	if (std::strlen(Path) >= sizeof(Address.sun_path))
+	{
+		std::cerr << "Failed to listen on " << Path << ": path too long\n";
+		return false;
+	}
+	std::strcpy(Address.sun_path, Path);
+	unlink(Path);
+	int Fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (Fd < 0 || bind(Fd, reinterpret_cast<sockaddr*>(&Address), sizeof(Address)) != 0 || !AddListener(Fd))
+	{
+		std::cerr << "Failed to listen on " << Path << ": " << std::strerror(errno) << "\n";
+		if (Fd >= 0)
+			close(Fd);
+		return false;
+	}
+	UnixPath = Path;
+	return true;
+}
+
+void DispatchServer::Stop()
+{
+	if (StopFd < 0)
+		return;
+	std::uint64_t One = 1;
+	ssize_t Written = write(StopFd, &One, sizeof(One));
+	(void)Written;
+}
+
+bool DispatchServer::Run()
+{
+	if (Listeners.empty())
+	{
+		std::cerr << "Failed to start dispatch server: nothing to listen on\n";
+		return false;
+	}
+	if (EpollFd < 0 || StopFd < 0)
+	{
+		std::cerr << "Failed to start dispatch server: " << std::strerror(errno) << "\n";
+		return false;
+	}
+	FleetFree = 0;
+	for (const Taxi& Obj : Fleet)
+		FleetFree += Obj.GetFreeDriversCount();
+	epoll_event Event = {};
+	Event.events = EPOLLIN;
+	Event.data.fd = StopFd;
+	epoll_ctl(EpollFd, EPOLL_CTL_ADD, StopFd, &Event);
+	for (int Fd : Listeners)
+	{
+		Event.events = EPOLLIN | EPOLLET;
+		Event.data.fd = Fd;
+		epoll_ctl(EpollFd, EPOLL_CTL_ADD, Fd, &Event);
+	}
+
+	epoll_event Events[256];
+	for (;;)
+	{
+		int Count = epoll_wait(EpollFd, Events, 256, -1);
+		if (Count < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			std::cerr << "Failed to wait for connections: " << std::strerror(errno) << "\n";
+			return false;
+		}
+		for (int i = 0; i < Count; i++)
+		{
+			int Fd = Events[i].data.fd;
+			if (Fd == StopFd)
+			{
+				std::uint64_t Value;
+				ssize_t Read = read(StopFd, &Value, sizeof(Value));
+				(void)Read;
+				return true;
+			}
+			if (std::find(Listeners.begin(), Listeners.end(), Fd) != Listeners.end())
+			{
+				Accept(Fd);
+				continue;
+			}
+			auto It = Connections.find(Fd);
+			if (It == Connections.end())
+				continue;
+			Connection& Conn = It->second;
+			bool Keep = !(Events[i].events & (EPOLLERR | EPOLLHUP)) || (Events[i].events & EPOLLIN);
+			if (Keep && (Events[i].events & EPOLLOUT))
+				Keep = Flush(Conn);
+			// a throttled connection picks up reading once its answers went out
+			if (Keep && ((Events[i].events & EPOLLIN) || Conn.Throttled))
+				Keep = HandleInput(Conn);
+			if (Keep && Conn.Closing && Conn.OutStart == Conn.Out.size())
+				Keep = false;
+			if (!Keep)
+				CloseConnection(Fd);
+		}
+	}
+}
+
+void DispatchServer::Accept(int ListenFd)
+{
+	// edge-triggered: take every waiting connection
+	for (;;)
+	{
+		int Fd = accept4(ListenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (Fd < 0)
+			return;
+		int Yes = 1;
+		setsockopt(Fd, IPPROTO_TCP, TCP_NODELAY, &Yes, sizeof(Yes));
+		epoll_event Event = {};
+		Event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+		Event.data.fd = Fd;
+		if (epoll_ctl(EpollFd, EPOLL_CTL_ADD, Fd, &Event) != 0)
+		{
+			close(Fd);
+			continue;
+		}
+		Connections[Fd].Fd = Fd;
+		Stats.Connections++;
+	}
+}
+
+void DispatchServer::CloseConnection(int Fd)
+{
+	epoll_ctl(EpollFd, EPOLL_CTL_DEL, Fd, nullptr);
+	close(Fd);
+	Connections.erase(Fd);
+}
+
+bool DispatchServer::HandleInput(Connection& Conn)
+{
+	Conn.Throttled = false;
+	for (;;)
+	{
+		// answer what is already here before reading more
+		ProcessRequests(Conn);
+		if (!Flush(Conn))
+			return false;
+		if (Conn.Closing)
+			return true;
+		if (Conn.Out.size() - Conn.OutStart >= MAX_PENDING_OUTPUT)
+		{
+			Conn.Throttled = true;
+			return true;
+		}
+
+		// In is only resized when it has no room left, so a read does not clear it first
+		if (Conn.In.size() < Conn.InEnd + READ_CHUNK)
+			Conn.In.resize(Conn.InEnd + READ_CHUNK);
+		ssize_t Read = recv(Conn.Fd, Conn.In.data() + Conn.InEnd, READ_CHUNK, 0);
+		if (Read == 0)
+			return false;
+		if (Read < 0)
+			return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+		Conn.InEnd += static_cast<std::size_t>(Read);
+	}
+}
+
+bool DispatchServer::Flush(Connection& Conn)
+{
+	while (Conn.OutStart < Conn.Out.size())
+	{
+		ssize_t Sent = send(Conn.Fd, Conn.Out.data() + Conn.OutStart, Conn.Out.size() - Conn.OutStart, MSG_NOSIGNAL);
+		if (Sent < 0)
+			return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+		Conn.OutStart += static_cast<std::size_t>(Sent);
+		Stats.Writes++;
+	}
+	Conn.Out.clear();
+	Conn.OutStart = 0;
+	return true;
+}
+
+#else
+
+DispatchServer::DispatchServer(std::vector<Taxi>& Fleet)
+	: Fleet(Fleet)
+{
+}
+
+DispatchServer::~DispatchServer()
+{
+}
+
+bool DispatchServer::ListenTcp(std::uint16_t, const char*)
+{
+	std::cerr << "Failed to listen: the dispatch server needs epoll (Linux)\n";
+	return false;
+}
+
+bool DispatchServer::ListenUnix(const char*)
+{
+	std::cerr << "Failed to listen: the dispatch server needs epoll (Linux)\n";
+	return false;
+}
+
+bool DispatchServer::Run()
+{
+	std::cerr << "Failed to start dispatch server: it needs epoll (Linux)\n";
+	return false;
+}
+
+void DispatchServer::Stop()
+{
+}
+
+#endif
+
+void DispatchServer::ProcessRequests(Connection& Conn)
+{
+	while (Conn.InEnd - Conn.InStart >= sizeof(DispatchRequest)
+		&& Conn.Out.size() - Conn.OutStart < MAX_PENDING_OUTPUT)
+	{
+		DispatchRequest Request;
+		std::memcpy(&Request, Conn.In.data() + Conn.InStart, sizeof(Request));
+		if (Request.Size > DISPATCH_MAX_PAYLOAD)
+		{
+			// the rest of the payload is still on the socket and would be read as requests:
+			// answer, then close the connection (see Connection::Closing)
+			AppendResponse(Conn.Out, Request.Tag, DispatchStatus::BadRequest, -1);
+			Stats.BadRequests++;
+			Conn.InStart = 0;
+			Conn.InEnd = 0;
+			Conn.Closing = true;
+			return;
+		}
+		if (Conn.InEnd - Conn.InStart < sizeof(Request) + Request.Size)
+			break;
+		Execute(Request, Conn.In.data() + Conn.InStart + sizeof(Request), Conn);
+		Conn.InStart += sizeof(Request) + Request.Size;
+		Stats.Requests++;
+	}
+	// keep only the incomplete request
+	if (Conn.InStart == Conn.InEnd)
+	{
+		Conn.InStart = 0;
+		Conn.InEnd = 0;
+	}
+	else if (Conn.InStart > READ_CHUNK)
+	{
+		std::memmove(Conn.In.data(), Conn.In.data() + Conn.InStart, Conn.InEnd - Conn.InStart);
+		Conn.InEnd -= Conn.InStart;
+		Conn.InStart = 0;
+	}
+}
+
+void DispatchServer::Execute(const DispatchRequest& Request, const char* Payload, Connection& Conn)
+{
+	DispatchOp Op = static_cast<DispatchOp>(Request.Op);
+	if (Op == DispatchOp::FleetSize)
+	{
+		AppendResponse(Conn.Out, Request.Tag, DispatchStatus::Ok, static_cast<std::int32_t>(Fleet.size()));
+		return;
+	}
+	if (Op == DispatchOp::FleetFreeCount)
+	{
+		AppendResponse(Conn.Out, Request.Tag, DispatchStatus::Ok, static_cast<std::int32_t>(std::min(FleetFree, 0x7fffffffLL)));
+		return;
+	}
+	if (Request.TaxiIndex >= Fleet.size())
+	{
+		AppendResponse(Conn.Out, Request.Tag, DispatchStatus::BadRequest, -1);
+		Stats.BadRequests++;
+		return;
+	}
+	Taxi& Obj = Fleet[Request.TaxiIndex];
+	char Address[MAX_STR_LEN];
+	std::memcpy(Address, Payload, Request.Size);
+	Address[Request.Size] = '\0';
+
+	DispatchStatus Status = DispatchStatus::Ok;
+	std::int32_t Value = 0;
+	int FreeBefore = Obj.GetFreeDriversCount();
+	switch (Op)
+	{
+	case DispatchOp::FreeCount:
+		Value = Obj.Order();
+		break;
+	case DispatchOp::DriverState:
+		Value = Obj.GetDriverState(Request.Index);
+		if (Value < 0)
+			Status = DispatchStatus::BadRequest;
+		break;
+	case DispatchOp::Order:
+		Value = Obj.OrderDriver(Address);
+		if (Value < 0)
+			Status = DispatchStatus::Refused;
+		break;
+	case DispatchOp::OrderDriver:
+		if (Request.Index < 0 || Request.Index >= Obj.GetDriversCount())
+			Status = DispatchStatus::BadRequest;
+		else if (!Obj.Order(Request.Index, Address))
+			Status = DispatchStatus::Refused;
+		break;
+	case DispatchOp::Release:
+		if (!Obj.SetDriverState(Request.Index, DRIVER_FREE))
+			Status = DispatchStatus::BadRequest;
+		break;
+	case DispatchOp::DriversCount:
+		Value = Obj.GetDriversCount();
+		break;
+	case DispatchOp::AddressesCount:
+		Value = Obj.GetAddressesCount();
+		break;
+	case DispatchOp::GetAddress:
+	{
+		const char* Text = Obj.GetAddress(Request.Index);
+		if (!Text)
+		{
+			Status = DispatchStatus::BadRequest;
+			break;
+		}
+		AppendResponse(Conn.Out, Request.Tag, DispatchStatus::Ok, 0, Text, static_cast<std::uint32_t>(std::strlen(Text)));
+		return;
+	}
+	default:
+		Status = DispatchStatus::BadRequest;
+		break;
+	}
+	FleetFree += Obj.GetFreeDriversCount() - FreeBefore;
+	if (Status == DispatchStatus::BadRequest)
+		Stats.BadRequests++;
+	AppendResponse(Conn.Out, Request.Tag, Status, Value);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "DispatchProtocol.h"
+#include "Taxi.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct DispatchServerStats
+{
+	std::uint64_t Connections = 0;
+	std::uint64_t Requests = 0;
+	// Response writes, each one carrying every response ready at that moment
+	std::uint64_t Writes = 0;
+	std::uint64_t BadRequests = 0;
+};
+
+// Serves the Taxi API of a fleet over TCP and Unix sockets (protocol in DispatchProtocol.h).
+// One thread runs an edge-triggered epoll loop over all connections: every readiness
+// event reads all that arrived, answers every complete request in it and sends the
+// answers with one write. Since only that thread touches the fleet, the taxis need no
+// locking, but nothing else may change them while Run is going.
+// Linux only (epoll); elsewhere Listen* and Run report an error and return false.
+class DispatchServer
+{
+public:
+	explicit DispatchServer(std::vector<Taxi>& Fleet);
+	~DispatchServer();
+	DispatchServer(const DispatchServer&) = delete;
+	DispatchServer& operator=(const DispatchServer&) = delete;
+
+	// Port 0 picks a free port, see GetPort
+	bool ListenTcp(std::uint16_t Port, const char* Host = "127.0.0.1");
+	// Replaces a stale socket file at Path
+	bool ListenUnix(const char* Path);
+	std::uint16_t GetPort() const { return Port; }
+
+	// Serves until Stop is called
+	bool Run();
+	// Makes Run return, from any thread
+	void Stop();
+
+	// Only meaningful once Run returned
+	DispatchServerStats GetStats() const { return Stats; }
+
+private:
+	struct Connection
+	{
+		int Fd = -1;
+		// Received bytes are In[InStart, InEnd), In itself only grows
+		std::vector<char> In;
+		std::size_t InStart = 0;
+		std::size_t InEnd = 0;
+		std::vector<char> Out;
+		std::size_t OutStart = 0;
+		// Reading stopped because too many answers are waiting to be sent
+		bool Throttled = false;
+		// A request could not be framed: nothing more is read, the connection closes once
+		// the BadRequest answer is sent
+		bool Closing = false;
+	};
+
+	bool AddListener(int Fd);
+	void Accept(int ListenFd);
+	// Reads and answers until the socket is drained, false when the connection must go
+	bool HandleInput(Connection& Conn);
+	bool Flush(Connection& Conn);
+	void CloseConnection(int Fd);
+	// Answers every complete request in the input buffer
+	void ProcessRequests(Connection& Conn);
+	void Execute(const DispatchRequest& Request, const char* Payload, Connection& Conn);
+
+	std::vector<Taxi>& Fleet;
+	// Free drivers of the whole fleet, counted when Run starts and kept up to date by
+	// the requests that change drivers, so FleetFreeCount does not walk the fleet
+	long long FleetFree = 0;
+	std::vector<int> Listeners;
+	std::unordered_map<int, Connection> Connections;
+	std::string UnixPath;
+	std::uint16_t Port = 0;
+	int EpollFd = -1;
+	int StopFd = -1;
+	DispatchServerStats Stats;
+};
@@ -0,0 +1,214 @@
+#include "DriverGrid.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+DriverGrid::DriverGrid(GeoPoint Min, GeoPoint Max, float CellSize)
+	: Min(Min), CellSize(CellSize > 0 ? CellSize : 1), InvCellSize(1 / this->CellSize)
+{
+	Columns = std::max(1, static_cast<int>(std::ceil((Max.X - Min.X) * InvCellSize)));
+	Rows = std::max(1, static_cast<int>(std::ceil((Max.Y - Min.Y) * InvCellSize)));
+	Cells.resize(static_cast<std::size_t>(Columns) * Rows);
+}
+
+std::uint32_t DriverGrid::CellOf(GeoPoint At) const
+{
+	int Column = std::clamp(static_cast<int>(std::floor((At.X - Min.X) * InvCellSize)), 0, Columns - 1);
+	int Row = std::clamp(static_cast<int>(std::floor((At.Y - Min.Y) * InvCellSize)), 0, Rows - 1);
+	return static_cast<std::uint32_t>(Row * Columns + Column);
+}
+
+void DriverGrid::Place(std::uint32_t Driver)
+{
+	DriverSlot& Slot = Drivers[Driver];
+	Slot.Cell = CellOf(Slot.Position);
+	std::vector<CellEntry>& Cell = Cells[Slot.Cell];
+	Slot.SlotInCell = static_cast<std::uint32_t>(Cell.size());
+	Cell.push_back(CellEntry{ Slot.Position.X, Slot.Position.Y, Driver });
+	FreeCount++;
+}
+
+void DriverGrid::Remove(std::uint32_t Driver)
+{
+	DriverSlot& Slot = Drivers[Driver];
+	std::vector<CellEntry>& Cell = Cells[Slot.Cell];
+	// move the last entry into the hole
+	Cell[Slot.SlotInCell] = Cell.back();
+	Drivers[Cell[Slot.SlotInCell].Driver].SlotInCell = Slot.SlotInCell;
+	Cell.pop_back();
+	Slot.Cell = NO_CELL;
+	FreeCount--;
+}
+
+int DriverGrid::AddTaxi(Taxi& Obj, const GeoPoint* DriverPositions)
+{
+	int TaxiIndex = static_cast<int>(Taxis.size());
+	Taxis.push_back(&Obj);
+	TaxiIndices[&Obj] = TaxiIndex;
+	TaxiFirstDriver.push_back(static_cast<std::uint32_t>(Drivers.size()));
+	for (int i = 0; i < Obj.GetDriversCount(); i++)
+	{
+		std::uint32_t Driver = static_cast<std::uint32_t>(Drivers.size());
+		Drivers.push_back(DriverSlot{ DriverPositions[i], static_cast<std::uint32_t>(TaxiIndex), i, NO_CELL, 0 });
+		if (Obj.GetDriverState(i) == DRIVER_FREE)
+			Place(Driver);
+	}
+	return TaxiIndex;
+}
+
+void DriverGrid::MoveDriver(int TaxiIndex, int DriverIndex, GeoPoint To)
+{
+	std::uint32_t Driver = TaxiFirstDriver[TaxiIndex] + DriverIndex;
+	DriverSlot& Slot = Drivers[Driver];
+	Slot.Position = To;
+	if (Slot.Cell == NO_CELL)
+		return;
+	if (CellOf(To) != Slot.Cell)
+	{
+		Remove(Driver);
+		Place(Driver);
+		return;
+	}
+	CellEntry& Entry = Cells[Slot.Cell][Slot.SlotInCell];
+	Entry.X = To.X;
+	Entry.Y = To.Y;
+}
+
+GeoPoint DriverGrid::GetDriverPosition(int TaxiIndex, int DriverIndex) const
+{
+	return Drivers[TaxiFirstDriver[TaxiIndex] + DriverIndex].Position;
+}
+
+void DriverGrid::SyncDriver(int TaxiIndex, int DriverIndex)
+{
+	std::uint32_t Driver = TaxiFirstDriver[TaxiIndex] + DriverIndex;
+	bool Free = Taxis[TaxiIndex]->GetDriverState(DriverIndex) == DRIVER_FREE;
+	bool Placed = Drivers[Driver].Cell != NO_CELL;
+	if (Free && !Placed)
+		Place(Driver);
+	else if (!Free && Placed)
+		Remove(Driver);
+}
+
+void DriverGrid::SyncDriver(Taxi& Obj, int DriverIndex)
+{
+	auto It = TaxiIndices.find(&Obj);
+	if (It != TaxiIndices.end())
+		SyncDriver(It->second, DriverIndex);
+}
+
+bool DriverGrid::Accepts(const DriverSlot& Slot, AddressId Address) const
+{
+	const Taxi* Obj = Taxis[Slot.TaxiIndex];
+	return Obj->GetDriverState(Slot.DriverIndex) == DRIVER_FREE
+		&& (Address == INVALID_ADDRESS_ID || Obj->HasAddress(Address));
+}
+
+DriverRef DriverGrid::FindNearestFree(GeoPoint At, AddressId Address) const
+{
+	DriverRef Result;
+	if (FreeCount == 0)
+		return Result;
+	std::uint32_t Center = CellOf(At);
+	int CenterColumn = static_cast<int>(Center % Columns);
+	int CenterRow = static_cast<int>(Center / Columns);
+
+	const float Infinity = std::numeric_limits<float>::infinity();
+	float BestDistance2 = Infinity;
+	std::uint32_t Best = NO_CELL;
+	auto ScanCell = [&](int Column, int Row)
+	{
+		for (const CellEntry& Entry : Cells[static_cast<std::size_t>(Row) * Columns + Column])
+		{
+			float Dx = Entry.X - At.X, Dy = Entry.Y - At.Y;
+			float Distance2 = Dx * Dx + Dy * Dy;
+			if (Distance2 < BestDistance2 && Accepts(Drivers[Entry.Driver], Address))
+			{
+				BestDistance2 = Distance2;
+				Best = Entry.Driver;
+			}
+		}
+	};
+
+	ScanCell(CenterColumn, CenterRow);
+	for (int Ring = 1; ; Ring++)
+	{
+		// closest any cell of this ring can be, looking only at the sides that still exist
+		float Bound = Infinity;
+		if (CenterColumn - Ring >= 0)
+			Bound = std::min(Bound, At.X - (Min.X + (CenterColumn - Ring + 1) * CellSize));
+		if (CenterColumn + Ring < Columns)
+			Bound = std::min(Bound, Min.X + (CenterColumn + Ring) * CellSize - At.X);
+		if (CenterRow - Ring >= 0)
+			Bound = std::min(Bound, At.Y - (Min.Y + (CenterRow - Ring + 1) * CellSize));
+		if (CenterRow + Ring < Rows)
+			Bound = std::min(Bound, Min.Y + (CenterRow + Ring) * CellSize - At.Y);
+		if (Bound == Infinity)
+			break; // the whole grid was scanned
+		if (Bound > 0 && Bound * Bound >= BestDistance2)
+			break;
+
+		int FromColumn = std::max(CenterColumn - Ring, 0);
+		int ToColumn = std::min(CenterColumn + Ring, Columns - 1);
+		if (CenterRow - Ring >= 0)
+			for (int Column = FromColumn; Column <= ToColumn; Column++)
+				ScanCell(Column, CenterRow - Ring);
+		if (CenterRow + Ring < Rows)
+			for (int Column = FromColumn; Column <= ToColumn; Column++)
+				ScanCell(Column, CenterRow + Ring);
+		int FromRow = std::max(CenterRow - Ring + 1, 0);
+		int ToRow = std::min(CenterRow + Ring - 1, Rows - 1);
+		if (CenterColumn - Ring >= 0)
+			for (int Row = FromRow; Row <= ToRow; Row++)
+				ScanCell(CenterColumn - Ring, Row);
+		if (CenterColumn + Ring < Columns)
+			for (int Row = FromRow; Row <= ToRow; Row++)
+				ScanCell(CenterColumn + Ring, Row);
+	}
+
+	if (Best != NO_CELL)
+	{
+		const DriverSlot& Slot = Drivers[Best];
+		Result.TaxiIndex = static_cast<int>(Slot.TaxiIndex);
+		Result.DriverIndex = Slot.DriverIndex;
+		Result.Obj = Taxis[Slot.TaxiIndex];
+		Result.Distance = std::sqrt(BestDistance2);
+	}
+	return Result;
+}
+
+DriverRef DriverGrid::FindNearestFreeLinear(GeoPoint At, AddressId Address) const
+{
+	DriverRef Result;
+	float BestDistance2 = std::numeric_limits<float>::infinity();
+	for (const DriverSlot& Slot : Drivers)
+	{
+		float Dx = Slot.Position.X - At.X, Dy = Slot.Position.Y - At.Y;
+		float Distance2 = Dx * Dx + Dy * Dy;
+		if (Distance2 < BestDistance2 && Accepts(Slot, Address))
+		{
+			BestDistance2 = Distance2;
+			Result.TaxiIndex = static_cast<int>(Slot.TaxiIndex);
+			Result.DriverIndex = Slot.DriverIndex;
+		}
+	}
+	if (Result.TaxiIndex >= 0)
+	{
+		Result.Obj = Taxis[Result.TaxiIndex];
+		Result.Distance = std::sqrt(BestDistance2);
+	}
+	return Result;
+}
+
+DriverRef DriverGrid::OrderNearest(const char* InAddress, const GeocodeTable& Geocode)
+{
+	AddressId Address = InAddress ? AddressPool::Find(InAddress) : INVALID_ADDRESS_ID;
+	GeoPoint At;
+	if (Address == INVALID_ADDRESS_ID || !Geocode.Find(Address, At))
+		return DriverRef();
+	DriverRef Found = FindNearestFree(At, Address);
+	if (Found.TaxiIndex < 0 || !Found.Obj->Order(Found.DriverIndex, InAddress))
+		return DriverRef();
+	SyncDriver(Found.TaxiIndex, Found.DriverIndex);
+	return Found;
+}
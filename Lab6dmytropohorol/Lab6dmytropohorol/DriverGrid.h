@@ -0,0 +1,93 @@
+#pragma once
+
+#include "GeocodeTable.h"
+#include "Taxi.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// A driver of one of the taxis in a DriverGrid, TaxiIndex is -1 when nothing was found
+struct DriverRef
+{
+	int TaxiIndex = -1;
+	int DriverIndex = -1;
+	Taxi* Obj = nullptr;
+	float Distance = 0;
+};
+
+// Positions of the drivers of a fleet, with the FREE ones kept in a uniform grid so
+// the nearest free driver to a point is found by looking at a few cells around it.
+// Moving a driver or changing its state only touches the cell it leaves and the one
+// it enters.
+// Driver states changed outside the grid are picked up by SyncDriver; until then a
+// driver that stopped being FREE is skipped by the queries, one that became FREE is
+// not found. The taxis must outlive the grid and keep their drivers count.
+class DriverGrid
+{
+public:
+	// Covers the rectangle Min..Max with square cells of CellSize, points outside it
+	// go to the border cells. About one or two free drivers per cell works well.
+	DriverGrid(GeoPoint Min, GeoPoint Max, float CellSize);
+
+	// Adds the drivers of Obj at the given positions, one per driver, returns the taxi index
+	int AddTaxi(Taxi& Obj, const GeoPoint* DriverPositions);
+	int GetTaxiCount() const { return static_cast<int>(Taxis.size()); }
+
+	void MoveDriver(int TaxiIndex, int DriverIndex, GeoPoint To);
+	GeoPoint GetDriverPosition(int TaxiIndex, int DriverIndex) const;
+	// Re-reads the state of the driver from its taxi
+	void SyncDriver(int TaxiIndex, int DriverIndex);
+	// Same, e.g. as the TripScheduler release callback
+	void SyncDriver(Taxi& Obj, int DriverIndex);
+
+	// Nearest FREE driver to At. With a valid Address only taxis serving it are considered.
+	DriverRef FindNearestFree(GeoPoint At, AddressId Address = INVALID_ADDRESS_ID) const;
+	// Same result by looking at every driver, kept as the reference for FindNearestFree
+	DriverRef FindNearestFreeLinear(GeoPoint At, AddressId Address = INVALID_ADDRESS_ID) const;
+
+	// Orders the nearest free driver of a taxi serving InAddress to it.
+	// Returns an empty DriverRef if the address has no coordinates or nobody is free.
+	DriverRef OrderNearest(const char* InAddress, const GeocodeTable& Geocode);
+
+	int GetFreeCount() const { return FreeCount; }
+
+private:
+	static constexpr std::uint32_t NO_CELL = 0xFFFFFFFFu;
+
+	// Grid entry, the position is copied in so a cell scan stays in one array
+	struct CellEntry
+	{
+		float X;
+		float Y;
+		std::uint32_t Driver;
+	};
+
+	struct DriverSlot
+	{
+		GeoPoint Position;
+		std::uint32_t TaxiIndex;
+		int DriverIndex;
+		// Cell holding the driver and its place there, NO_CELL when not FREE
+		std::uint32_t Cell;
+		std::uint32_t SlotInCell;
+	};
+
+	std::uint32_t CellOf(GeoPoint At) const;
+	void Place(std::uint32_t Driver);
+	void Remove(std::uint32_t Driver);
+	// Skips drivers that are no longer FREE and taxis without the address
+	bool Accepts(const DriverSlot& Slot, AddressId Address) const;
+
+	GeoPoint Min;
+	float CellSize;
+	float InvCellSize;
+	int Columns;
+	int Rows;
+	std::vector<std::vector<CellEntry>> Cells;
+	std::vector<DriverSlot> Drivers;
+	std::vector<Taxi*> Taxis;
+	// First slot of every taxi in Drivers
+	std::vector<std::uint32_t> TaxiFirstDriver;
+	std::unordered_map<const Taxi*, int> TaxiIndices;
+	int FreeCount = 0;
+};
@@ -0,0 +1,42 @@
+#include "DriverState.h"
+
+namespace
+{
+	const char* const STATE_NAMES[DRIVER_STATE_COUNT] = { "FREE", "BUSY", "OFFLINE", "EN_ROUTE", "ON_TRIP", "BREAK" };
+
+	constexpr std::uint8_t Bit(DriverState State)
+	{
+		return static_cast<std::uint8_t>(1 << static_cast<int>(State));
+	}
+
+	// Allowed target states of every state, one bit per target
+	const std::uint8_t ALLOWED_TRANSITIONS[DRIVER_STATE_COUNT] =
+	{
+		// Free
+		Bit(DriverState::Busy) | Bit(DriverState::Offline) | Bit(DriverState::EnRoute) | Bit(DriverState::Break),
+		// Busy
+		Bit(DriverState::Free) | Bit(DriverState::Offline) | Bit(DriverState::EnRoute) | Bit(DriverState::OnTrip)
+			| Bit(DriverState::Break),
+		// Offline
+		Bit(DriverState::Free),
+		// EnRoute
+		Bit(DriverState::Free) | Bit(DriverState::Busy) | Bit(DriverState::OnTrip),
+		// OnTrip
+		Bit(DriverState::Free) | Bit(DriverState::Busy),
+		// Break
+		Bit(DriverState::Free) | Bit(DriverState::Offline)
+	};
+}
+
+const char* GetDriverStateName(int State)
+{
+	return IsValidDriverState(State) ? STATE_NAMES[State] : "INVALID";
+}
+
+bool IsValidTransition(DriverState From, DriverState To)
+{
+	int FromIndex = static_cast<int>(From);
+	if (!IsValidDriverState(FromIndex) || !IsValidDriverState(static_cast<int>(To)))
+		return false;
+	return From == To || (ALLOWED_TRANSITIONS[FromIndex] & Bit(To)) != 0;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+
+// What a driver is doing. The numbers are stored in files, never renumber them.
+enum class DriverState : std::uint8_t
+{
+	Free = 0,
+	// Taken, without saying what for. Order() and files from before the other states use it
+	Busy = 1,
+	Offline = 2,
+	// Driving to the pickup address
+	EnRoute = 3,
+	OnTrip = 4,
+	Break = 5
+};
+
+const int DRIVER_STATE_COUNT = 6;
+
+// The int form of the states, used by the int based Taxi API and the file formats
+const int DRIVER_FREE = static_cast<int>(DriverState::Free);
+const int DRIVER_BUSY = static_cast<int>(DriverState::Busy);
+const int DRIVER_OFFLINE = static_cast<int>(DriverState::Offline);
+const int DRIVER_EN_ROUTE = static_cast<int>(DriverState::EnRoute);
+const int DRIVER_ON_TRIP = static_cast<int>(DriverState::OnTrip);
+const int DRIVER_BREAK = static_cast<int>(DriverState::Break);
+
+// Packed storage uses this many bits per driver. Six states need three bits,
+// four keep a driver from straddling two words.
+const int DRIVER_STATE_BITS = 4;
+const int DRIVERS_PER_WORD = 64 / DRIVER_STATE_BITS;
+
+// For console prompts
+const char* const DRIVER_STATE_PROMPT = "0=FREE,1=BUSY,2=OFFLINE,3=EN_ROUTE,4=ON_TRIP,5=BREAK";
+
+inline bool IsValidDriverState(int State)
+{
+	return State >= 0 && State < DRIVER_STATE_COUNT;
+}
+
+// "FREE", "BUSY", ..., "INVALID" for anything else
+const char* GetDriverStateName(int State);
+
+// Whether a driver may go From -> To. Staying in the same state is always allowed.
+//   FREE     -> BUSY, OFFLINE, EN_ROUTE, BREAK
+//   BUSY     -> FREE, OFFLINE, EN_ROUTE, ON_TRIP, BREAK
+//   OFFLINE  -> FREE
+//   EN_ROUTE -> FREE (cancelled), BUSY, ON_TRIP
+//   ON_TRIP  -> FREE, BUSY
+//   BREAK    -> FREE, OFFLINE
+bool IsValidTransition(DriverState From, DriverState To);
@@ -0,0 +1,84 @@
+#include "FleetAvailability.h"
+#include <cmath>
+
+void FleetAvailability::Attach(const std::vector<Taxi>& InFleet)
+{
+	Fleet = &InFleet;
+	Pointers = nullptr;
+	PointerCount = 0;
+}
+
+void FleetAvailability::Attach(const Taxi* const* InFleet, int Count)
+{
+	Fleet = nullptr;
+	Pointers = InFleet;
+	PointerCount = Count;
+}
+
+int FleetAvailability::GetTaxiCount() const
+{
+	return Fleet ? static_cast<int>(Fleet->size()) : PointerCount;
+}
+
+long long FleetAvailability::GetDriverCount() const
+{
+	long long Drivers = 0;
+	for (int i = 0, Count = GetTaxiCount(); i < Count; i++)
+		Drivers += Get(i).GetDriversCount();
+	return Drivers;
+}
+
+long long FleetAvailability::CountBusy() const
+{
+	long long Busy = 0;
+	for (int i = 0, Count = GetTaxiCount(); i < Count; i++)
+		Busy += Get(i).GetDriversCount() - Get(i).GetFreeDriversCount();
+	return Busy;
+}
+
+AvailabilityReport FleetAvailability::Aggregate() const
+{
+	AvailabilityReport Report;
+	int TaxiCount = GetTaxiCount();
+	Report.FreePerTaxi.resize(TaxiCount);
+	for (int i = 0; i < TaxiCount; i++)
+	{
+		const Taxi& Obj = Get(i);
+		int Drivers = Obj.GetDriversCount();
+		int Free = Obj.GetFreeDriversCount();
+		int TaxiBusy = Drivers - Free;
+		for (int State = 0; State < DRIVER_STATE_COUNT; State++)
+			Report.StateDrivers[State] += Obj.GetDriversInState(static_cast<DriverState>(State));
+		Report.TotalDrivers += Drivers;
+		Report.FreePerTaxi[i] = Free;
+		if (static_cast<std::size_t>(Free) >= Report.TaxisWithFree.size())
+			Report.TaxisWithFree.resize(Free + 1);
+		Report.TaxisWithFree[Free]++;
+		if (Drivers > 0)
+			Report.UtilisationHistogram[static_cast<long long>(TaxiBusy) * 10 / Drivers]++;
+	}
+	Report.FreeDrivers = Report.StateDrivers[DRIVER_FREE];
+	Report.BusyDrivers = Report.TotalDrivers - Report.FreeDrivers;
+	return Report;
+}
+
+int AvailabilityReport::FreePercentile(double Percent) const
+{
+	long long Taxis = static_cast<long long>(FreePerTaxi.size());
+	if (Taxis == 0)
+		return 0;
+	if (Percent < 0)
+		Percent = 0;
+	// nearest rank
+	long long Needed = static_cast<long long>(std::ceil(Percent / 100.0 * Taxis));
+	if (Needed < 1)
+		Needed = 1;
+	long long Seen = 0;
+	for (std::size_t k = 0; k < TaxisWithFree.size(); k++)
+	{
+		Seen += TaxisWithFree[k];
+		if (Seen >= Needed)
+			return static_cast<int>(k);
+	}
+	return static_cast<int>(TaxisWithFree.size()) - 1;
+}
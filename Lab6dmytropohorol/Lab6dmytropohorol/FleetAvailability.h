@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Taxi.h"
+#include <vector>
+
+// Utilisation (busy / drivers) of a taxi falls in one of these buckets:
+// [0%, 10%), [10%, 20%) ... [90%, 100%), and exactly 100%
+const int UTILISATION_BUCKETS = 11;
+
+struct AvailabilityReport
+{
+	long long TotalDrivers = 0;
+	long long FreeDrivers = 0;
+	// Drivers in any state but FREE
+	long long BusyDrivers = 0;
+	// Drivers in every DriverState, StateDrivers[DRIVER_FREE] == FreeDrivers
+	long long StateDrivers[DRIVER_STATE_COUNT] = {};
+	// Number of taxis per utilisation bucket, taxis without drivers are not counted
+	long long UtilisationHistogram[UTILISATION_BUCKETS] = {};
+	// Free drivers of every taxi, in fleet order
+	std::vector<int> FreePerTaxi;
+	// TaxisWithFree[k] is the number of taxis with exactly k free drivers
+	std::vector<long long> TaxisWithFree;
+
+	// Smallest free-driver count such that at least Percent % of the taxis have no
+	// more free drivers than that, e.g. FreePercentile(50) is the median
+	int FreePercentile(double Percent) const;
+};
+
+// Availability of a whole fleet, read straight from the taxis: every Taxi keeps its
+// drivers per state (StateCounts, updated by each state change), so a taxi costs O(1)
+// whatever its number of drivers, and there is no copy of the states to keep current.
+class FleetAvailability
+{
+public:
+	// Reads Fleet on every call, so it must stay alive while this object is used.
+	// Taxis added to the vector later are counted too.
+	void Attach(const std::vector<Taxi>& InFleet);
+	// Same, for Count taxis behind pointers; the array must stay alive too
+	void Attach(const Taxi* const* InFleet, int Count);
+
+	int GetTaxiCount() const;
+	long long GetDriverCount() const;
+
+	// Totals, the utilisation histogram and the per-taxi counts in one pass
+	AvailabilityReport Aggregate() const;
+
+	// Drivers that are not FREE over the whole fleet
+	long long CountBusy() const;
+
+private:
+	const Taxi& Get(int TaxiIndex) const { return Fleet ? (*Fleet)[TaxiIndex] : *Pointers[TaxiIndex]; }
+
+	const std::vector<Taxi>* Fleet = nullptr;
+	const Taxi* const* Pointers = nullptr;
+	int PointerCount = 0;
+};
@@ -0,0 +1,407 @@
+#include "FleetCheckpoint.h"
+#include "FleetFile.h"
+#include "TaxiSnapshot.h"
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#pragma warning( disable : 4996)
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	bool SyncFile(std::FILE* File)
+	{
+		if (std::fflush(File) != 0)
+			return false;
+#ifdef _WIN32
+		return _commit(_fileno(File)) == 0;
+#else
+		return fsync(fileno(File)) == 0;
+#endif
+	}
+
+	bool SyncPath(const std::string& Path)
+	{
+		std::FILE* File = std::fopen(Path.c_str(), "rb+");
+		if (!File)
+			return false;
+		bool Synced = SyncFile(File);
+		std::fclose(File);
+		return Synced;
+	}
+
+	// Makes a rename or a new file in the directory of Path durable. Windows has no
+	// directory handle to flush, NTFS journals the rename itself.
+	bool SyncDirectory(const std::string& Path)
+	{
+#ifdef _WIN32
+		return true;
+#else
+		std::filesystem::path Directory = std::filesystem::path(Path).parent_path();
+		int Fd = open(Directory.empty() ? "." : Directory.c_str(), O_RDONLY | O_DIRECTORY);
+		if (Fd < 0)
+			return false;
+		bool Synced = fsync(Fd) == 0;
+		close(Fd);
+		return Synced;
+#endif
+	}
+
+	// Reads [From, To) of a file, the file may be shorter
+	bool ReadRange(const std::string& Path, std::uint64_t From, std::uint64_t To, std::vector<char>& Out)
+	{
+		Out.clear();
+		std::FILE* File = std::fopen(Path.c_str(), "rb");
+		if (!File)
+			return false;
+		Out.resize(static_cast<std::size_t>(To - From));
+		bool Read = std::fseek(File, static_cast<long>(From), SEEK_SET) == 0;
+		if (Read)
+			Out.resize(std::fread(Out.data(), 1, Out.size(), File));
+		std::fclose(File);
+		return Read;
+	}
+
+	void AppendRecord(std::vector<char>& Out, std::size_t TaxiIndex, bool Delta, const Taxi& Obj)
+	{
+		std::size_t Start = Out.size();
+		Out.resize(Start + sizeof(DeltaFileRecord));
+		if (!Delta)
+			Obj.AppendSnapshot(Out);
+		else
+			Obj.AppendDelta(Out);
+		DeltaFileRecord Record;
+		Record.Size = static_cast<std::uint32_t>(Out.size() - Start - sizeof(Record));
+		Record.TaxiIndex = static_cast<std::uint32_t>(TaxiIndex);
+		std::memcpy(Out.data() + Start, &Record, sizeof(Record));
+	}
+
+	double MsSince(Clock::time_point Start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - Start).count();
+	}
+}
+
+FleetCheckpoint::FleetCheckpoint(const char* BasePath)
+	: BasePath(BasePath), DeltaPath(std::string(BasePath) + ".delta")
+{
+}
+
+FleetCheckpoint::~FleetCheckpoint()
+{
+	WaitForCompaction();
+	if (File)
+		std::fclose(File);
+}
+
+std::string FleetCheckpoint::BaseFilePath(std::uint64_t Sequence) const
+{
+	return BasePath + "." + std::to_string(Sequence) + ".base";
+}
+
+bool FleetCheckpoint::LoadUpTo(std::uint64_t Sequence, std::uint64_t End, std::vector<Taxi>& Fleet, std::uint64_t* ValidEnd) const
+{
+	Fleet.clear();
+	std::string Base = BaseFilePath(Sequence);
+	FleetFile Snapshot;
+	if (!Snapshot.Open(Base.c_str()) || !Snapshot.LoadAllParallel(Fleet))
+	{
+		std::cerr << "Failed to load fleet base: " << Base << "\n";
+		return false;
+	}
+	std::vector<char> Data;
+	if (!ReadRange(DeltaPath, 0, End, Data) || Data.size() < sizeof(DeltaFileHeader))
+	{
+		std::cerr << "Failed to read delta file: " << DeltaPath << "\n";
+		return false;
+	}
+	DeltaFileHeader Header;
+	std::memcpy(&Header, Data.data(), sizeof(Header));
+
+	// a record cut short by a crash ends the file, anything else must apply
+	std::size_t Offset = Header.HeaderSize;
+	while (Data.size() - Offset >= sizeof(DeltaFileRecord))
+	{
+		DeltaFileRecord Record;
+		std::memcpy(&Record, Data.data() + Offset, sizeof(Record));
+		const char* Payload = Data.data() + Offset + sizeof(Record);
+		if (Record.Size > Data.size() - Offset - sizeof(Record))
+			break;
+		bool Applied = Record.TaxiIndex <= Fleet.size();
+		if (Applied)
+		{
+			if (Record.TaxiIndex == Fleet.size())
+				Fleet.emplace_back();
+			Taxi& Obj = Fleet[Record.TaxiIndex];
+			Applied = (IsDelta(Payload, Record.Size) ? Obj.ReadDelta(Payload, Record.Size)
+				: Obj.ReadSnapshot(Payload, Record.Size)) == Record.Size;
+		}
+		if (!Applied)
+		{
+			std::cerr << "Failed to apply delta file " << DeltaPath << ": bad record for taxi " << Record.TaxiIndex << "\n";
+			return false;
+		}
+		Offset += sizeof(Record) + Record.Size;
+	}
+	if (ValidEnd)
+		*ValidEnd = Offset;
+	return true;
+}
+
+bool FleetCheckpoint::Load(std::vector<Taxi>& Fleet)
+{
+	WaitForCompaction();
+	std::lock_guard<std::mutex> Guard(Lock);
+	if (File)
+		std::fclose(File);
+	File = nullptr;
+	BaseSequence = LastSequence = DeltaBytes = 0;
+	SavedCount = 0;
+	Fleet.clear();
+
+	std::vector<char> Data;
+	std::error_code Error;
+	if (!std::filesystem::exists(DeltaPath, Error))
+		return true;
+	DeltaFileHeader Header = {};
+	if (ReadRange(DeltaPath, 0, sizeof(Header), Data) && Data.size() == sizeof(Header))
+		std::memcpy(&Header, Data.data(), sizeof(Header));
+	if (std::memcmp(Header.Magic, DELTA_FILE_MAGIC, sizeof(Header.Magic)) != 0
+		|| Header.Version > DELTA_FILE_VERSION || Header.HeaderSize < sizeof(DeltaFileHeader))
+	{
+		std::cerr << "Not a valid delta file: " << DeltaPath << "\n";
+		return false;
+	}
+
+	std::uint64_t Size = std::filesystem::file_size(DeltaPath, Error);
+	std::uint64_t ValidEnd = 0;
+	if (Error || !LoadUpTo(Header.BaseSequence, Size, Fleet, &ValidEnd))
+	{
+		Fleet.clear();
+		return false;
+	}
+	if (ValidEnd < Size)
+		std::filesystem::resize_file(DeltaPath, ValidEnd, Error);
+	File = Error ? nullptr : std::fopen(DeltaPath.c_str(), "ab");
+	if (!File)
+	{
+		std::cerr << "Failed to open delta file: " << DeltaPath << "\n";
+		Fleet.clear();
+		return false;
+	}
+	BaseSequence = LastSequence = Header.BaseSequence;
+	DeltaBytes = ValidEnd;
+	SavedCount = Fleet.size();
+	for (Taxi& Obj : Fleet)
+		Obj.StartDeltaTracking();
+	return true;
+}
+
+bool FleetCheckpoint::ReplaceDeltaFile(std::uint64_t Sequence, const std::vector<char>& Tail)
+{
+	DeltaFileHeader Header = {};
+	std::memcpy(Header.Magic, DELTA_FILE_MAGIC, sizeof(Header.Magic));
+	Header.Version = DELTA_FILE_VERSION;
+	Header.HeaderSize = sizeof(DeltaFileHeader);
+	Header.BaseSequence = Sequence;
+
+	std::string Temporary = DeltaPath + ".tmp";
+	std::FILE* Out = std::fopen(Temporary.c_str(), "wb");
+	if (!Out)
+		return false;
+	bool Written = std::fwrite(&Header, sizeof(Header), 1, Out) == 1
+		&& (Tail.empty() || std::fwrite(Tail.data(), 1, Tail.size(), Out) == Tail.size())
+		&& SyncFile(Out);
+	std::fclose(Out);
+	if (!Written)
+		return false;
+
+	// Windows cannot rename over an open file
+	if (File)
+		std::fclose(File);
+	std::error_code Error;
+	std::filesystem::rename(Temporary, DeltaPath, Error);
+	// the old base may only be removed once the directory names the new delta file
+	// (and the new base) for good
+	bool Durable = !Error && SyncDirectory(DeltaPath);
+	File = std::fopen(DeltaPath.c_str(), "ab");
+	if (!Durable || !File)
+	{
+		std::cerr << "Failed to replace delta file: " << DeltaPath << "\n";
+		return false;
+	}
+	DeltaBytes = sizeof(Header) + Tail.size();
+	return true;
+}
+
+bool FleetCheckpoint::SaveFull(std::vector<Taxi>& Fleet, CheckpointStats* Stats)
+{
+	Clock::time_point Start = Clock::now();
+	std::uint64_t Sequence;
+	{
+		std::lock_guard<std::mutex> Guard(Lock);
+		Sequence = ++LastSequence;
+	}
+	std::string Base = BaseFilePath(Sequence);
+	if (!SaveFleet(Base.c_str(), Fleet) || !SyncPath(Base))
+	{
+		std::cerr << "Failed to write fleet base: " << Base << "\n";
+		return false;
+	}
+
+	std::uint64_t OldSequence;
+	{
+		std::lock_guard<std::mutex> Guard(Lock);
+		if (!ReplaceDeltaFile(Sequence, std::vector<char>()))
+			return false;
+		OldSequence = BaseSequence;
+		BaseSequence = Sequence;
+		SavedCount = Fleet.size();
+	}
+	std::error_code Error;
+	if (OldSequence)
+		std::filesystem::remove(BaseFilePath(OldSequence), Error);
+	for (Taxi& Obj : Fleet)
+		Obj.StartDeltaTracking();
+
+	if (Stats)
+	{
+		*Stats = CheckpointStats();
+		Stats->Full = true;
+		Stats->SnapshotTaxis = static_cast<int>(Fleet.size());
+		Stats->Bytes = std::filesystem::file_size(Base, Error);
+		Stats->Milliseconds = MsSince(Start);
+	}
+	return true;
+}
+
+bool FleetCheckpoint::Save(std::vector<Taxi>& Fleet, CheckpointStats* Stats)
+{
+	Clock::time_point Start = Clock::now();
+	bool HasDeltaFile;
+	{
+		std::lock_guard<std::mutex> Guard(Lock);
+		HasDeltaFile = File != nullptr;
+	}
+	if (!HasDeltaFile || Fleet.size() < SavedCount)
+		return SaveFull(Fleet, Stats);
+
+	CheckpointStats Result;
+	std::vector<char> Buffer;
+	std::vector<std::size_t> Written;
+	for (std::size_t i = 0; i < Fleet.size(); i++)
+	{
+		const Taxi& Obj = Fleet[i];
+		bool Delta = i < SavedCount && Obj.IsDeltaTracking();
+		if (Delta && !Obj.HasDirtyBlocks())
+			continue;
+		AppendRecord(Buffer, i, Delta, Obj);
+		Written.push_back(i);
+		(Delta ? Result.DeltaTaxis : Result.SnapshotTaxis)++;
+	}
+
+	bool StartCompacting = false;
+	{
+		std::lock_guard<std::mutex> Guard(Lock);
+		if (!Buffer.empty())
+		{
+			if (std::fwrite(Buffer.data(), 1, Buffer.size(), File) != Buffer.size() || !SyncFile(File))
+			{
+				std::cerr << "Failed to write delta file: " << DeltaPath << "\n";
+				return false;
+			}
+			DeltaBytes += Buffer.size();
+		}
+		SavedCount = Fleet.size();
+		StartCompacting = CompactionBytes && DeltaBytes >= CompactionBytes && !Compacting;
+	}
+	// only now are the changes safe to forget
+	for (std::size_t i : Written)
+		Fleet[i].StartDeltaTracking();
+	if (StartCompacting)
+		StartCompaction();
+
+	if (Stats)
+	{
+		Result.Bytes = Buffer.size();
+		Result.Milliseconds = MsSince(Start);
+		*Stats = Result;
+	}
+	return true;
+}
+
+bool FleetCheckpoint::StartCompaction()
+{
+	std::lock_guard<std::mutex> Guard(Lock);
+	if (Compacting || !File)
+		return false;
+	if (Compactor.joinable())
+		Compactor.join();
+	Compacting = true;
+	Compactor = std::thread(&FleetCheckpoint::Compact, this, BaseSequence, DeltaBytes, ++LastSequence);
+	return true;
+}
+
+void FleetCheckpoint::Compact(std::uint64_t Sequence, std::uint64_t End, std::uint64_t NewSequence)
+{
+	// a private copy of the fleet as saved up to End, the caller keeps using its own
+	std::vector<Taxi> Fleet;
+	std::string NewBase = BaseFilePath(NewSequence);
+	std::error_code Error;
+	bool Done = LoadUpTo(Sequence, End, Fleet, nullptr)
+		&& SaveFleet(NewBase.c_str(), Fleet) && SyncPath(NewBase);
+	Fleet = std::vector<Taxi>();
+
+	std::lock_guard<std::mutex> Guard(Lock);
+	if (Done && BaseSequence == Sequence)
+	{
+		// records saved while the base was written stay in the new delta file
+		std::vector<char> Tail;
+		Done = ReadRange(DeltaPath, End, DeltaBytes, Tail) && Tail.size() == DeltaBytes - End
+			&& ReplaceDeltaFile(NewSequence, Tail);
+		if (Done)
+		{
+			std::filesystem::remove(BaseFilePath(Sequence), Error);
+			BaseSequence = NewSequence;
+		}
+	}
+	// otherwise a SaveFull replaced the base meanwhile and there is nothing to fold
+	if (BaseSequence != NewSequence)
+		std::filesystem::remove(NewBase, Error);
+	if (!Done)
+		std::cerr << "Failed to compact delta file: " << DeltaPath << "\n";
+	CompactionFailed = !Done;
+	Compacting = false;
+}
+
+bool FleetCheckpoint::WaitForCompaction()
+{
+	if (Compactor.joinable())
+		Compactor.join();
+	std::lock_guard<std::mutex> Guard(Lock);
+	bool Succeeded = !CompactionFailed;
+	CompactionFailed = false;
+	return Succeeded;
+}
+
+std::uint64_t FleetCheckpoint::GetDeltaBytes() const
+{
+	std::lock_guard<std::mutex> Guard(Lock);
+	return DeltaBytes;
+}
+
+std::uint64_t FleetCheckpoint::GetBaseSequence() const
+{
+	std::lock_guard<std::mutex> Guard(Lock);
+	return BaseSequence;
+}
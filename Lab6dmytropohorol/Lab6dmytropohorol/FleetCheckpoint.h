@@ -0,0 +1,108 @@
+#pragma once
+
+#include "Taxi.h"
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Incremental checkpoints of a fleet. The fleet lives in two files:
+//   <Base>.<N>.base  fleet file (see FleetFile.h) with everything up to some point
+//   <Base>.delta     DeltaFileHeader naming the base N, then DeltaFileRecord + payload
+//                    records appended by every Save since
+// Save only writes the driver and address blocks changed since the last Save (see
+// Taxi::AppendDelta), plus whole snapshot records for new taxis and for taxis whose
+// counts changed. Load applies the records in order on top of the base.
+// Compaction folds the delta file into a new base on a background thread while Save
+// keeps appending; once the new base is on disk the delta file is atomically replaced
+// by one that names it and holds only the records saved meanwhile. A crash at any point
+// leaves either the old base and delta file or the new ones.
+// Removing taxis makes the next Save write a full base.
+
+const char DELTA_FILE_MAGIC[4] = { 'T', 'X', 'D', 'F' };
+const std::uint16_t DELTA_FILE_VERSION = 1;
+
+#pragma pack(push, 1)
+struct DeltaFileHeader
+{
+	char Magic[4];
+	std::uint16_t Version;
+	std::uint16_t HeaderSize;
+	// The records apply to <Base>.<BaseSequence>.base
+	std::uint64_t BaseSequence;
+};
+
+struct DeltaFileRecord
+{
+	// Payload bytes after this header: a delta or a snapshot record (TaxiSnapshot.h)
+	std::uint32_t Size;
+	// Index of the taxi in the fleet, one past the end appends a taxi
+	std::uint32_t TaxiIndex;
+};
+#pragma pack(pop)
+
+struct CheckpointStats
+{
+	bool Full = false;
+	int DeltaTaxis = 0;
+	int SnapshotTaxis = 0;
+	std::uint64_t Bytes = 0;
+	double Milliseconds = 0;
+};
+
+class FleetCheckpoint
+{
+public:
+	explicit FleetCheckpoint(const char* BasePath);
+	~FleetCheckpoint();
+	FleetCheckpoint(const FleetCheckpoint&) = delete;
+	FleetCheckpoint& operator=(const FleetCheckpoint&) = delete;
+
+	// Replaces Fleet with the base plus the deltas (an empty fleet if nothing was saved
+	// yet) and starts delta tracking on every taxi
+	bool Load(std::vector<Taxi>& Fleet);
+	// Appends the changes since the last Save or Load, or writes a full base when
+	// there is none yet or taxis were removed
+	bool Save(std::vector<Taxi>& Fleet, CheckpointStats* Stats = nullptr);
+	// Writes a new base and an empty delta file
+	bool SaveFull(std::vector<Taxi>& Fleet, CheckpointStats* Stats = nullptr);
+
+	// Starts folding the delta file into a new base, false if one is already running
+	bool StartCompaction();
+	// Waits for the running compaction, returns false if it failed
+	bool WaitForCompaction();
+	// Save starts a compaction once the delta file grows past this size (0 turns it off)
+	void SetCompactionBytes(std::uint64_t Bytes) { CompactionBytes = Bytes; }
+
+	std::uint64_t GetDeltaBytes() const;
+	std::uint64_t GetBaseSequence() const;
+
+private:
+	std::string BaseFilePath(std::uint64_t Sequence) const;
+	// Atomically replaces the delta file by a new one naming Sequence and holding Tail,
+	// under the lock
+	bool ReplaceDeltaFile(std::uint64_t Sequence, const std::vector<char>& Tail);
+	// Loads base Sequence plus the delta records before End into Fleet. ValidEnd gets
+	// the end of the last complete record.
+	bool LoadUpTo(std::uint64_t Sequence, std::uint64_t End, std::vector<Taxi>& Fleet, std::uint64_t* ValidEnd) const;
+	// Compaction thread: writes base NewSequence from base Sequence and the deltas before End
+	void Compact(std::uint64_t Sequence, std::uint64_t End, std::uint64_t NewSequence);
+
+	std::string BasePath;
+	std::string DeltaPath;
+
+	mutable std::mutex Lock;
+	std::FILE* File = nullptr;
+	std::uint64_t BaseSequence = 0;
+	// Last base number handed out, every base file gets a new one
+	std::uint64_t LastSequence = 0;
+	std::uint64_t DeltaBytes = 0;
+	// Taxis the base plus the delta file describe
+	std::size_t SavedCount = 0;
+	std::uint64_t CompactionBytes = 64ull << 20;
+	std::thread Compactor;
+	bool Compacting = false;
+	bool CompactionFailed = false;
+};
@@ -0,0 +1,352 @@
+#include "FleetFile.h"
+#include <charconv>
+#include <cstring>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+#pragma warning( disable : 4996)
+
+namespace
+{
+	// Records are collected in a buffer and written out in blocks of this size
+	const std::size_t WRITE_BLOCK_SIZE = 4 << 20;
+	// Workers of the parallel loader take this many records at a time
+	const int LOAD_CHUNK_RECORDS = 2048;
+
+	void AppendString(std::vector<char>& Out, const char* Str)
+	{
+		Out.insert(Out.end(), Str, Str + std::strlen(Str));
+	}
+
+	void AppendInt(std::vector<char>& Out, int Value)
+	{
+		char Buffer[16];
+		std::to_chars_result Result = std::to_chars(Buffer, Buffer + sizeof(Buffer), Value);
+		Out.insert(Out.end(), Buffer, Result.ptr);
+	}
+
+	// Cuts the next line off [Cursor, End), without the line break
+	bool NextLine(const char*& Cursor, const char* End, const char*& LineBegin, const char*& LineEnd)
+	{
+		if (Cursor >= End)
+			return false;
+		LineBegin = Cursor;
+		const char* Newline = static_cast<const char*>(std::memchr(Cursor, '\n', End - Cursor));
+		LineEnd = Newline ? Newline : End;
+		Cursor = Newline ? Newline + 1 : End;
+		if (LineEnd > LineBegin && LineEnd[-1] == '\r')
+			LineEnd--;
+		return true;
+	}
+
+	bool NextInt(const char*& Cursor, const char* End, int& Value)
+	{
+		const char* LineBegin;
+		const char* LineEnd;
+		if (!NextLine(Cursor, End, LineBegin, LineEnd))
+			return false;
+		return std::from_chars(LineBegin, LineEnd, Value).ec == std::errc();
+	}
+
+	template <typename TaxiAt>
+	bool SaveRecords(const char* FileName, int Count, FleetEncoding Encoding, TaxiAt GetTaxi)
+	{
+		std::ofstream fout(FileName, std::ios::binary);
+		if (!fout)
+		{
+			std::cerr << "Failed to open file for saving: " << FileName << "\n";
+			return false;
+		}
+		std::vector<FleetIndexEntry> Entries(Count > 0 ? Count : 0);
+		std::vector<char> Buffer;
+		Buffer.reserve(WRITE_BLOCK_SIZE + (WRITE_BLOCK_SIZE >> 2));
+		std::uint64_t Written = 0;
+		bool Sorted = true;
+		for (int i = 0; i < Count; i++)
+		{
+			const Taxi& Obj = GetTaxi(i);
+			std::size_t Start = Buffer.size();
+			if (Encoding == FleetEncoding::Binary)
+				Obj.AppendSnapshot(Buffer);
+			else
+				AppendTextRecord(Obj, Buffer);
+			Entries[i].Offset = Written + Start;
+			Entries[i].Size = static_cast<std::uint32_t>(Buffer.size() - Start);
+			Entries[i].ObjectNumber = Obj.GetObjectNumber();
+			if (i > 0 && Entries[i - 1].ObjectNumber > Entries[i].ObjectNumber)
+				Sorted = false;
+			if (Buffer.size() >= WRITE_BLOCK_SIZE)
+			{
+				fout.write(Buffer.data(), static_cast<std::streamsize>(Buffer.size()));
+				Written += Buffer.size();
+				Buffer.clear();
+			}
+		}
+		fout.write(Buffer.data(), static_cast<std::streamsize>(Buffer.size()));
+		Written += Buffer.size();
+
+		FleetFooter Footer = {};
+		std::memcpy(Footer.Magic, FLEET_MAGIC, sizeof(Footer.Magic));
+		Footer.Version = FLEET_VERSION;
+		Footer.Encoding = static_cast<std::uint16_t>(Encoding);
+		Footer.Flags = Sorted ? FLEET_SORTED_BY_NUMBER : 0;
+		Footer.RecordCount = Entries.size();
+		Footer.IndexOffset = Written;
+		fout.write(reinterpret_cast<const char*>(Entries.data()), static_cast<std::streamsize>(Entries.size() * sizeof(FleetIndexEntry)));
+		fout.write(reinterpret_cast<const char*>(&Footer), sizeof(Footer));
+		if (!fout)
+		{
+			std::cerr << "Failed to write fleet file: " << FileName << "\n";
+			return false;
+		}
+		return true;
+	}
+}
+
+void AppendTextRecord(const Taxi& Obj, std::vector<char>& Out)
+{
+	AppendString(Out, Obj.Passenger);
+	Out.push_back('\n');
+	int dc = Obj.GetDriversCount();
+	AppendInt(Out, dc);
+	Out.push_back('\n');
+	for (int i = 0; i < dc; i++)
+	{
+		AppendInt(Out, Obj.GetDriverState(i));
+		Out.push_back('\n');
+	}
+	int ac = Obj.GetAddressesCount();
+	AppendInt(Out, ac);
+	Out.push_back('\n');
+	for (int i = 0; i < ac; i++)
+	{
+		const char* A = Obj.GetAddress(i);
+		AppendString(Out, A ? A : UNKNOWN_ADDRESS);
+		Out.push_back('\n');
+	}
+}
+
+std::size_t ParseTextRecord(const char* Data, std::size_t Size, Taxi& Obj)
+{
+	const char* Cursor = Data;
+	const char* End = Data + Size;
+	const char* LineBegin;
+	const char* LineEnd;
+	if (!NextLine(Cursor, End, LineBegin, LineEnd))
+		return 0;
+	std::size_t PassengerLen = LineEnd - LineBegin;
+	if (PassengerLen > MAX_STR_LEN - 1)
+		PassengerLen = MAX_STR_LEN - 1;
+	if (PassengerLen)
+	{
+		std::memcpy(Obj.Passenger, LineBegin, PassengerLen);
+		Obj.Passenger[PassengerLen] = '\0';
+	}
+	else
+		std::strcpy(Obj.Passenger, "Unknown");
+
+	int dc;
+	if (!NextInt(Cursor, End, dc) || dc < 0)
+		return 0;
+	Obj.SetDriversCount(dc);
+	for (int i = 0; i < dc; i++)
+	{
+		int st;
+		if (!NextInt(Cursor, End, st))
+			return 0;
+		if (!Obj.SetDriverState(i, st))
+			return 0; // not a DriverState value
+	}
+
+	int ac;
+	if (!NextInt(Cursor, End, ac) || ac < 0)
+		return 0;
+	Obj.SetAddressesCount(ac);
+	char AddrBuf[MAX_STR_LEN];
+	for (int i = 0; i < ac; i++)
+	{
+		if (!NextLine(Cursor, End, LineBegin, LineEnd))
+			return 0;
+		std::size_t Len = LineEnd - LineBegin;
+		if (!Len)
+			continue; // keeps "UnknownAddr" from SetAddressesCount
+		if (Len > MAX_STR_LEN - 1)
+			Len = MAX_STR_LEN - 1;
+		std::memcpy(AddrBuf, LineBegin, Len);
+		AddrBuf[Len] = '\0';
+		Obj.SetAddress(i, AddrBuf);
+	}
+	return Cursor - Data;
+}
+
+bool SaveFleet(const char* FileName, const std::vector<Taxi>& Fleet, FleetEncoding Encoding)
+{
+	return SaveRecords(FileName, static_cast<int>(Fleet.size()), Encoding,
+		[&Fleet](int i) -> const Taxi& { return Fleet[i]; });
+}
+
+bool SaveFleet(const char* FileName, const Taxi* const* Fleet, int Count, FleetEncoding Encoding)
+{
+	return SaveRecords(FileName, Count, Encoding,
+		[Fleet](int i) -> const Taxi& { return *Fleet[i]; });
+}
+
+bool FleetFile::Open(const char* FileName)
+{
+	Close();
+	if (!File.Open(FileName) || File.GetSize() < sizeof(FleetFooter))
+	{
+		std::cerr << "Failed to open fleet file: " << FileName << "\n";
+		Close();
+		return false;
+	}
+	std::memcpy(&Footer, File.GetData() + File.GetSize() - sizeof(FleetFooter), sizeof(FleetFooter));
+	std::uint64_t IndexBytes = File.GetSize() - sizeof(FleetFooter);
+	if (std::memcmp(Footer.Magic, FLEET_MAGIC, sizeof(Footer.Magic)) != 0
+		|| Footer.Version > FLEET_VERSION
+		|| Footer.Encoding > static_cast<std::uint16_t>(FleetEncoding::Text)
+		|| Footer.IndexOffset > IndexBytes
+		|| Footer.RecordCount != (IndexBytes - Footer.IndexOffset) / sizeof(FleetIndexEntry)
+		|| (IndexBytes - Footer.IndexOffset) % sizeof(FleetIndexEntry) != 0
+		|| Footer.RecordCount > static_cast<std::uint64_t>(std::numeric_limits<int>::max()))
+	{
+		std::cerr << "Not a valid fleet file: " << FileName << "\n";
+		Close();
+		return false;
+	}
+	Index = File.GetData() + Footer.IndexOffset;
+	return true;
+}
+
+void FleetFile::Close()
+{
+	File.Close();
+	Footer = {};
+	Index = nullptr;
+}
+
+const FleetIndexEntry* FleetFile::GetEntry(int RecordIndex) const
+{
+	if (!Index || RecordIndex < 0 || RecordIndex >= GetCount())
+		return nullptr;
+	const FleetIndexEntry* Entry = reinterpret_cast<const FleetIndexEntry*>(Index) + RecordIndex;
+	if (Entry->Offset > Footer.IndexOffset || Entry->Size > Footer.IndexOffset - Entry->Offset)
+		return nullptr;
+	return Entry;
+}
+
+int FleetFile::FindBySavedNumber(int SavedNumber) const
+{
+	if (!Index)
+		return -1;
+	const FleetIndexEntry* Entries = reinterpret_cast<const FleetIndexEntry*>(Index);
+	int Count = GetCount();
+	if (Footer.Flags & FLEET_SORTED_BY_NUMBER)
+	{
+		int Low = 0, High = Count;
+		while (Low < High)
+		{
+			int Mid = Low + (High - Low) / 2;
+			if (Entries[Mid].ObjectNumber < SavedNumber)
+				Low = Mid + 1;
+			else
+				High = Mid;
+		}
+		return Low < Count && Entries[Low].ObjectNumber == SavedNumber ? Low : -1;
+	}
+	for (int i = 0; i < Count; i++)
+		if (Entries[i].ObjectNumber == SavedNumber)
+			return i;
+	return -1;
+}
+
+bool FleetFile::LoadByIndex(int RecordIndex, Taxi& Obj) const
+{
+	const FleetIndexEntry* Entry = GetEntry(RecordIndex);
+	if (!Entry)
+		return false;
+	const char* Record = File.GetData() + Entry->Offset;
+	if (GetEncoding() == FleetEncoding::Binary)
+		return Obj.ReadSnapshot(Record, Entry->Size) != 0;
+	return ParseTextRecord(Record, Entry->Size, Obj) != 0;
+}
+
+bool FleetFile::LoadBySavedNumber(int SavedNumber, Taxi& Obj) const
+{
+	int RecordIndex = FindBySavedNumber(SavedNumber);
+	return RecordIndex >= 0 && LoadByIndex(RecordIndex, Obj);
+}
+
+bool FleetFile::LoadAll(std::vector<Taxi>& Fleet) const
+{
+	if (!Index)
+		return false;
+	int Count = GetCount();
+	std::size_t First = Fleet.size();
+	Fleet.reserve(First + Count);
+	for (int i = 0; i < Count; i++)
+	{
+		Fleet.emplace_back();
+		if (!LoadByIndex(i, Fleet.back()))
+		{
+			Fleet.resize(First);
+			return false;
+		}
+	}
+	return true;
+}
+
+bool FleetFile::LoadAllParallel(std::vector<Taxi>& Fleet, int ThreadCount) const
+{
+	if (!Index)
+		return false;
+	int Count = GetCount();
+	int ChunkCount = (Count + LOAD_CHUNK_RECORDS - 1) / LOAD_CHUNK_RECORDS;
+	if (ThreadCount <= 0)
+		ThreadCount = static_cast<int>(std::thread::hardware_concurrency());
+	if (ThreadCount > ChunkCount)
+		ThreadCount = ChunkCount;
+	if (ThreadCount <= 1)
+		return LoadAll(Fleet);
+
+	std::size_t First = Fleet.size();
+	Fleet.resize(First + Count);
+	Taxi* Storage = Fleet.data() + First;
+
+	std::atomic<int> NextChunk{ 0 };
+	std::atomic<bool> Failed{ false };
+	auto Worker = [&]()
+	{
+		int Chunk;
+		while (!Failed.load(std::memory_order_relaxed)
+			&& (Chunk = NextChunk.fetch_add(1, std::memory_order_relaxed)) < ChunkCount)
+		{
+			int End = (Chunk + 1) * LOAD_CHUNK_RECORDS;
+			if (End > Count)
+				End = Count;
+			for (int i = Chunk * LOAD_CHUNK_RECORDS; i < End; i++)
+				if (!LoadByIndex(i, Storage[i]))
+				{
+					Failed.store(true, std::memory_order_relaxed);
+					return;
+				}
+		}
+	};
+
+	std::vector<std::thread> Workers;
+	Workers.reserve(ThreadCount - 1);
+	for (int i = 1; i < ThreadCount; i++)
+		Workers.emplace_back(Worker);
+	Worker();
+	for (std::thread& Thread : Workers)
+		Thread.join();
+
+	if (Failed.load())
+	{
+		Fleet.resize(First);
+		return false;
+	}
+	return true;
+}
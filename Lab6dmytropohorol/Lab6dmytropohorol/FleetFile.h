@@ -0,0 +1,97 @@
+#pragma once
+
+#include "MappedFile.h"
+#include "Taxi.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A fleet file holds many Taxi records followed by an offset table and a footer:
+//   [record 0][record 1]...[record N-1][FleetIndexEntry x N][FleetFooter]
+// Records are either binary snapshots (see TaxiSnapshot.h) or the text format of
+// SaveToTextFile. The offset table is always binary, so any record can be found
+// without reading the ones before it.
+
+enum class FleetEncoding : std::uint16_t
+{
+	Binary = 0,
+	Text = 1
+};
+
+const char FLEET_MAGIC[4] = { 'T', 'X', 'F', 'L' };
+const std::uint16_t FLEET_VERSION = 1;
+// Set when the index entries are in ascending ObjectNumber order
+const std::uint16_t FLEET_SORTED_BY_NUMBER = 1;
+
+#pragma pack(push, 1)
+struct FleetIndexEntry
+{
+	std::uint64_t Offset;
+	std::uint32_t Size;
+	// GetObjectNumber() of the taxi when it was saved
+	std::int32_t ObjectNumber;
+};
+
+struct FleetFooter
+{
+	char Magic[4];
+	std::uint16_t Version;
+	std::uint16_t Encoding;
+	std::uint16_t Flags;
+	std::uint16_t Reserved;
+	std::uint32_t Reserved2;
+	std::uint64_t RecordCount;
+	std::uint64_t IndexOffset;
+};
+#pragma pack(pop)
+
+// Writes the whole fleet with large sequential writes, returns false on I/O errors
+bool SaveFleet(const char* FileName, const std::vector<Taxi>& Fleet, FleetEncoding Encoding = FleetEncoding::Binary);
+
+// Same, for a fleet kept as pointers (e.g. mixed Taxi, LuxTaxi and MiniTaxi objects)
+bool SaveFleet(const char* FileName, const Taxi* const* Fleet, int Count, FleetEncoding Encoding = FleetEncoding::Binary);
+
+// Appends one text record in the SaveToTextFile format
+void AppendTextRecord(const Taxi& Obj, std::vector<char>& Out);
+// Parses one text record, returns the bytes consumed or 0 if the data is invalid
+std::size_t ParseTextRecord(const char* Data, std::size_t Size, Taxi& Obj);
+
+// Random access reader over a memory mapped fleet file
+class FleetFile
+{
+public:
+	FleetFile() = default;
+
+	// Maps the file and validates the footer and the offset table
+	bool Open(const char* FileName);
+	void Close();
+
+	bool IsOpen() const { return Index != nullptr; }
+	int GetCount() const { return static_cast<int>(Footer.RecordCount); }
+	FleetEncoding GetEncoding() const { return static_cast<FleetEncoding>(Footer.Encoding); }
+
+	// Offset table entry of a record, nullptr for a bad index
+	const FleetIndexEntry* GetEntry(int RecordIndex) const;
+
+	// Returns the index of the record whose taxi had this ObjectNumber when it was saved, or -1
+	int FindBySavedNumber(int SavedNumber) const;
+
+	// Loading never changes the ObjectNumber of a taxi: numbers are unique per process and
+	// never reused (ObjectAccounting), so a loaded taxi keeps its own. The saved number only
+	// finds the record again and stays in the offset table (GetEntry).
+	bool LoadByIndex(int RecordIndex, Taxi& Obj) const;
+	bool LoadBySavedNumber(int SavedNumber, Taxi& Obj) const;
+
+	// Loads every record in file order, appending them to Fleet as new taxis
+	bool LoadAll(std::vector<Taxi>& Fleet) const;
+
+	// Same result as LoadAll, but the records are parsed on ThreadCount worker threads
+	// (0 = one per hardware thread). The taxis are constructed up front on the calling
+	// thread, so they keep the file order and get ascending object numbers of their own.
+	bool LoadAllParallel(std::vector<Taxi>& Fleet, int ThreadCount = 0) const;
+
+private:
+	MappedFile File;
+	FleetFooter Footer = {};
+	const char* Index = nullptr;
+};
@@ -0,0 +1,160 @@
+#include "FleetIndex.h"
+#include <climits>
+#include <cstring>
+
+FleetIndex::Position FleetIndex::Link(Taxi* Obj)
+{
+	int Free = Obj->GetFreeDriversCount();
+	int Number = Obj->GetObjectNumber();
+	Position Pos;
+	Pos.ByPassenger = ByPassenger.insert(PassengerEntry{ Obj->Passenger, Free, Number, Obj });
+	Pos.ByAvailability = ByAvailability.insert(AvailabilityEntry{ Free, Number, Obj });
+	return Pos;
+}
+
+bool FleetIndex::Insert(Taxi* Obj)
+{
+	if (!Obj || Positions.count(Obj) || !Obj->AttachListener(this, 0))
+		return false;
+	Positions.emplace(Obj, Link(Obj));
+	return true;
+}
+
+void FleetIndex::InsertAll(std::vector<Taxi>& Fleet)
+{
+	Positions.reserve(Positions.size() + Fleet.size());
+	for (Taxi& Obj : Fleet)
+		Insert(&Obj);
+}
+
+bool FleetIndex::Remove(const Taxi* Obj)
+{
+	auto It = Positions.find(Obj);
+	if (It == Positions.end())
+		return false;
+	It->second.ByPassenger->Obj->DetachListener(this);
+	ByPassenger.erase(It->second.ByPassenger);
+	ByAvailability.erase(It->second.ByAvailability);
+	Positions.erase(It);
+	return true;
+}
+
+void FleetIndex::Clear()
+{
+	for (const PassengerEntry& Entry : ByPassenger)
+		Entry.Obj->DetachListener(this);
+	ByPassenger.clear();
+	ByAvailability.clear();
+	Positions.clear();
+}
+
+bool FleetIndex::Update(Taxi* Obj)
+{
+	auto It = Positions.find(Obj);
+	if (It == Positions.end())
+		return false;
+	Reposition(It);
+	return true;
+}
+
+void FleetIndex::Reposition(PositionMap::iterator It)
+{
+	Position& Pos = It->second;
+	const PassengerEntry& Old = *Pos.ByPassenger;
+	Taxi* Obj = Old.Obj;
+	// the object number can change too, Swap and move assignment exchange it
+	if (Old.FreeDrivers == Obj->GetFreeDriversCount() && Old.ObjectNumber == Obj->GetObjectNumber()
+		&& Old.Passenger == Obj->Passenger)
+		return;
+	if (Old.Passenger != Obj->Passenger)
+	{
+		ByPassenger.erase(Pos.ByPassenger);
+		ByAvailability.erase(Pos.ByAvailability);
+		Pos = Link(Obj);
+		return;
+	}
+	// same passenger: move the nodes themselves, nothing is allocated or copied
+	int Free = Obj->GetFreeDriversCount();
+	int Number = Obj->GetObjectNumber();
+	auto PassengerNode = ByPassenger.extract(Pos.ByPassenger);
+	PassengerNode.value().FreeDrivers = Free;
+	PassengerNode.value().ObjectNumber = Number;
+	Pos.ByPassenger = ByPassenger.insert(std::move(PassengerNode));
+	auto AvailabilityNode = ByAvailability.extract(Pos.ByAvailability);
+	AvailabilityNode.value().FreeDrivers = Free;
+	AvailabilityNode.value().ObjectNumber = Number;
+	Pos.ByAvailability = ByAvailability.insert(std::move(AvailabilityNode));
+}
+
+void FleetIndex::DriverChanged(std::uint32_t, const Taxi& Obj, int, int OldState, int State)
+{
+	// only the free count is part of the keys
+	if ((OldState == DRIVER_FREE) == (State == DRIVER_FREE))
+		return;
+	auto It = Positions.find(&Obj);
+	if (It != Positions.end())
+		Reposition(It);
+}
+
+void FleetIndex::TaxiChanged(std::uint32_t, const Taxi& Obj)
+{
+	auto It = Positions.find(&Obj);
+	if (It != Positions.end())
+		Reposition(It);
+}
+
+void FleetIndex::SetPassenger(Taxi* Obj, const char* InPassenger)
+{
+	if (!InPassenger)
+		return;
+	std::strncpy(Obj->Passenger, InPassenger, MAX_STR_LEN - 1);
+	Obj->Passenger[MAX_STR_LEN - 1] = '\0';
+	Update(Obj);
+}
+
+std::vector<Taxi*> FleetIndex::FindByPassenger(const char* InPassenger, int MinFree, int MaxFree) const
+{
+	std::vector<Taxi*> Result;
+	if (!InPassenger || MinFree > MaxFree)
+		return Result;
+	auto First = ByPassenger.lower_bound(PassengerProbe{ InPassenger, MinFree, INT_MIN });
+	auto Last = ByPassenger.upper_bound(PassengerProbe{ InPassenger, MaxFree, INT_MAX });
+	for (auto It = First; It != Last; ++It)
+		Result.push_back(It->Obj);
+	return Result;
+}
+
+std::vector<Taxi*> FleetIndex::FindPassengerRange(const char* From, const char* To) const
+{
+	std::vector<Taxi*> Result;
+	if (!From)
+		From = "";
+	bool Bounded = To && *To;
+	if (Bounded && std::strcmp(To, From) <= 0)
+		return Result;
+	auto It = ByPassenger.lower_bound(PassengerProbe{ From, INT_MIN, INT_MIN });
+	auto Last = Bounded ? ByPassenger.lower_bound(PassengerProbe{ To, INT_MIN, INT_MIN }) : ByPassenger.end();
+	for (; It != Last; ++It)
+		Result.push_back(It->Obj);
+	return Result;
+}
+
+std::vector<Taxi*> FleetIndex::FindWithFreeDrivers(int MinFree) const
+{
+	std::vector<Taxi*> Result;
+	auto Stop = ByAvailability.lower_bound(AvailabilityEntry{ MinFree, INT_MIN, nullptr });
+	for (auto It = ByAvailability.end(); It != Stop; )
+		Result.push_back((--It)->Obj);
+	return Result;
+}
+
+std::vector<Taxi*> FleetIndex::TopAvailable(int K) const
+{
+	std::vector<Taxi*> Result;
+	if (K <= 0)
+		return Result;
+	Result.reserve(K < GetSize() ? K : GetSize());
+	for (auto It = ByAvailability.rbegin(); It != ByAvailability.rend() && static_cast<int>(Result.size()) < K; ++It)
+		Result.push_back(It->Obj);
+	return Result;
+}
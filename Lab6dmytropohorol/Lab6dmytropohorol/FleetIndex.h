@@ -0,0 +1,129 @@
+#pragma once
+
+#include "Taxi.h"
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Keeps a set of taxis ordered by (passenger, number of free drivers) and by number
+// of free drivers alone, so passenger ranges and availability queries do not scan
+// the whole fleet. The index does not own the taxis: a taxi must be removed before it
+// is destroyed or moved to another address (e.g. by a growing std::vector).
+// The index attaches to its taxis as a TaxiListener, so driver changes made anywhere
+// (Order, TripScheduler, the dispatch server...) and PublishWhole reposition them.
+// Not seen are the Passenger field, a plain array (use SetPassenger or Update), and
+// move assignment, which does not publish (call Update or Taxi::PublishWhole).
+class FleetIndex : public TaxiListener
+{
+public:
+	FleetIndex() = default;
+	~FleetIndex() { Clear(); }
+	FleetIndex(const FleetIndex&) = delete;
+	FleetIndex& operator=(const FleetIndex&) = delete;
+
+	// Adds a taxi, returns false if it is already indexed or has no free listener slot
+	bool Insert(Taxi* Obj);
+	// Adds every taxi of the fleet
+	void InsertAll(std::vector<Taxi>& Fleet);
+	// Returns false if the taxi was not indexed
+	bool Remove(const Taxi* Obj);
+	void Clear();
+
+	// Moves the taxi to its new position after its passenger or drivers changed.
+	// Does nothing when its key is unchanged; returns false if it is not indexed.
+	bool Update(Taxi* Obj);
+
+	// Changes the passenger of an indexed taxi and repositions it in one step
+	void SetPassenger(Taxi* Obj, const char* InPassenger);
+
+	bool Contains(const Taxi* Obj) const { return Positions.count(Obj) != 0; }
+	int GetSize() const { return static_cast<int>(Positions.size()); }
+
+	// Taxis of this passenger with MinFree..MaxFree free drivers, fewest free first
+	std::vector<Taxi*> FindByPassenger(const char* InPassenger,
+		int MinFree = 0, int MaxFree = MAX_FREE) const;
+	// Taxis whose passenger is in [From, To), in index order; an empty To means no upper bound
+	std::vector<Taxi*> FindPassengerRange(const char* From, const char* To) const;
+	// Taxis with at least MinFree free drivers, most free first
+	std::vector<Taxi*> FindWithFreeDrivers(int MinFree) const;
+	// The K taxis with the most free drivers, most free first
+	std::vector<Taxi*> TopAvailable(int K) const;
+
+	static const int MAX_FREE = 0x7fffffff;
+
+	// TaxiListener, called by the indexed taxis
+	void DriverChanged(std::uint32_t Key, const Taxi& Obj, int Index, int OldState, int State) override;
+	void AddressChanged(std::uint32_t, const Taxi&, int) override {}
+	void TaxiChanged(std::uint32_t Key, const Taxi& Obj) override;
+
+private:
+	struct PassengerEntry
+	{
+		std::string Passenger;
+		int FreeDrivers;
+		// Ties are broken by object number. Two entries can briefly share a key while
+		// taxis that swapped state are updated one after the other, hence the multisets.
+		int ObjectNumber;
+		Taxi* Obj;
+	};
+
+	struct AvailabilityEntry
+	{
+		int FreeDrivers;
+		int ObjectNumber;
+		Taxi* Obj;
+
+		bool operator<(const AvailabilityEntry& Other) const
+		{
+			if (FreeDrivers != Other.FreeDrivers)
+				return FreeDrivers < Other.FreeDrivers;
+			return ObjectNumber < Other.ObjectNumber;
+		}
+	};
+
+	// Search bound for the passenger set, compares like a PassengerEntry
+	struct PassengerProbe
+	{
+		std::string_view Passenger;
+		int FreeDrivers;
+		int ObjectNumber;
+	};
+
+	struct PassengerLess
+	{
+		using is_transparent = void;
+
+		template <typename A, typename B>
+		bool operator()(const A& Left, const B& Right) const
+		{
+			int Cmp = std::string_view(Left.Passenger).compare(std::string_view(Right.Passenger));
+			if (Cmp != 0)
+				return Cmp < 0;
+			if (Left.FreeDrivers != Right.FreeDrivers)
+				return Left.FreeDrivers < Right.FreeDrivers;
+			return Left.ObjectNumber < Right.ObjectNumber;
+		}
+	};
+
+	using PassengerSet = std::multiset<PassengerEntry, PassengerLess>;
+	using AvailabilitySet = std::multiset<AvailabilityEntry>;
+
+	struct Position
+	{
+		PassengerSet::iterator ByPassenger;
+		AvailabilitySet::iterator ByAvailability;
+	};
+
+	using PositionMap = std::unordered_map<const Taxi*, Position>;
+
+	// Inserts the entries of Obj with its current key
+	Position Link(Taxi* Obj);
+	// Moves an indexed taxi to its current key
+	void Reposition(PositionMap::iterator It);
+
+	PassengerSet ByPassenger;
+	AvailabilitySet ByAvailability;
+	PositionMap Positions;
+};
@@ -0,0 +1,585 @@
+#include "FleetJournal.h"
+#include "FleetFile.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#pragma warning( disable : 4996)
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define TAXI_X86 1
+#include <nmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang only emit SSE4.2 code in functions marked for it, MSVC always can
+#if defined(TAXI_X86) && !defined(_MSC_VER)
+#define TAXI_TARGET_SSE42 __attribute__((target("sse4.2")))
+#else
+#define TAXI_TARGET_SSE42
+#endif
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	// CRC-32C (Castagnoli), the polynomial SSE4.2 computes in hardware
+	std::uint32_t Crc32cTable(std::uint32_t Crc, const unsigned char* Bytes, std::size_t Size)
+	{
+		static const struct CrcTable
+		{
+			std::uint32_t Values[256];
+			CrcTable()
+			{
+				for (std::uint32_t i = 0; i < 256; i++)
+				{
+					std::uint32_t Value = i;
+					for (int Bit = 0; Bit < 8; Bit++)
+						Value = (Value >> 1) ^ (Value & 1 ? 0x82F63B78u : 0);
+					Values[i] = Value;
+				}
+			}
+		} Table;
+		for (std::size_t i = 0; i < Size; i++)
+			Crc = Table.Values[(Crc ^ Bytes[i]) & 0xFF] ^ (Crc >> 8);
+		return Crc;
+	}
+
+#ifdef TAXI_X86
+	TAXI_TARGET_SSE42 std::uint32_t Crc32cHardware(std::uint32_t Crc, const unsigned char* Bytes, std::size_t Size)
+	{
+		std::size_t i = 0;
+#if defined(_M_X64) || defined(__x86_64__)
+		std::uint64_t Wide = Crc;
+		for (; i + 8 <= Size; i += 8)
+		{
+			std::uint64_t Word;
+			std::memcpy(&Word, Bytes + i, sizeof(Word));
+			Wide = _mm_crc32_u64(Wide, Word);
+		}
+		Crc = static_cast<std::uint32_t>(Wide);
+#endif
+		for (; i < Size; i++)
+			Crc = _mm_crc32_u8(Crc, Bytes[i]);
+		return Crc;
+	}
+
+	bool HasSse42()
+	{
+#ifdef _MSC_VER
+		static const bool Available = []
+		{
+			int Info[4];
+			__cpuid(Info, 1);
+			return (Info[2] & (1 << 20)) != 0;
+		}();
+		return Available;
+#else
+		return __builtin_cpu_supports("sse4.2");
+#endif
+	}
+#endif
+
+	std::uint32_t Crc32c(std::uint32_t Crc, const void* Data, std::size_t Size)
+	{
+		const unsigned char* Bytes = static_cast<const unsigned char*>(Data);
+#ifdef TAXI_X86
+		static const bool Hardware = HasSse42();
+		if (Hardware)
+			return ~Crc32cHardware(~Crc, Bytes, Size);
+#endif
+		return ~Crc32cTable(~Crc, Bytes, Size);
+	}
+
+	// Covers everything after the Checksum field
+	std::uint32_t RecordChecksum(const JournalRecordHeader& Header, const char* Payload)
+	{
+		const char* Fields = reinterpret_cast<const char*>(&Header) + offsetof(JournalRecordHeader, Type);
+		std::uint32_t Crc = Crc32c(0, Fields, sizeof(JournalRecordHeader) - offsetof(JournalRecordHeader, Type));
+		return Crc32c(Crc, Payload, Header.Size);
+	}
+
+	// Same for a record in a file, where the fields and the payload follow each other
+	std::uint32_t StoredRecordChecksum(const char* Record, std::uint32_t PayloadSize)
+	{
+		const std::size_t Fields = offsetof(JournalRecordHeader, Type);
+		return Crc32c(0, Record + Fields, sizeof(JournalRecordHeader) - Fields + PayloadSize);
+	}
+
+	const std::uint32_t DRIVER_STATE_PAYLOAD = sizeof(std::uint32_t) + 1;
+	// Taxi ranges the replay is grouped by, few enough to write each one sequentially
+	const int REPLAY_RANGES = 1024;
+	// A record waiting to be applied is its file offset, or for a driver state record
+	// this flag | taxi key << 32 | driver index << 8 | state
+	const std::uint64_t INLINE_DRIVER_STATE = std::uint64_t(1) << 63;
+	const std::uint32_t MAX_INLINE_KEY = (1u << 31) - 1;
+	const std::uint32_t MAX_INLINE_DRIVER = (1u << 24) - 1;
+
+	bool SyncFile(std::FILE* File)
+	{
+		if (std::fflush(File) != 0)
+			return false;
+#ifdef _WIN32
+		return _commit(_fileno(File)) == 0;
+#else
+		return fsync(fileno(File)) == 0;
+#endif
+	}
+
+	bool SyncPath(const std::string& Path)
+	{
+		std::FILE* File = std::fopen(Path.c_str(), "rb+");
+		if (!File)
+			return false;
+		bool Synced = SyncFile(File);
+		std::fclose(File);
+		return Synced;
+	}
+
+	// Makes a rename or a new file in the directory of Path durable. Windows has no
+	// directory handle to flush, NTFS journals the rename itself.
+	bool SyncDirectory(const std::string& Path)
+	{
+#ifdef _WIN32
+		return true;
+#else
+		std::filesystem::path Directory = std::filesystem::path(Path).parent_path();
+		int Fd = open(Directory.empty() ? "." : Directory.c_str(), O_RDONLY | O_DIRECTORY);
+		if (Fd < 0)
+			return false;
+		bool Synced = fsync(Fd) == 0;
+		close(Fd);
+		return Synced;
+#endif
+	}
+
+	bool ApplyRecord(std::vector<Taxi>& Fleet, const JournalRecordHeader& Header, const char* Payload)
+	{
+		std::uint32_t Index;
+		switch (static_cast<JournalRecordType>(Header.Type))
+		{
+		case JournalRecordType::DriverState:
+		{
+			if (Header.Key >= Fleet.size() || Header.Size != DRIVER_STATE_PAYLOAD)
+				return false;
+			std::memcpy(&Index, Payload, sizeof(Index));
+			return Index < static_cast<std::uint32_t>(Fleet[Header.Key].GetDriversCount())
+				&& Fleet[Header.Key].SetDriverState(static_cast<int>(Index), static_cast<unsigned char>(Payload[sizeof(Index)]));
+		}
+		case JournalRecordType::Address:
+		{
+			std::uint16_t Len;
+			if (Header.Key >= Fleet.size() || Header.Size < sizeof(Index) + sizeof(Len))
+				return false;
+			std::memcpy(&Index, Payload, sizeof(Index));
+			std::memcpy(&Len, Payload + sizeof(Index), sizeof(Len));
+			if (Header.Size != sizeof(Index) + sizeof(Len) + Len
+				|| Index >= static_cast<std::uint32_t>(Fleet[Header.Key].GetAddressesCount()))
+				return false;
+			Fleet[Header.Key].SetAddress(static_cast<int>(Index), Payload + sizeof(Index) + sizeof(Len), Len);
+			return true;
+		}
+		case JournalRecordType::Taxi:
+			if (Header.Key > Fleet.size())
+				return false;
+			if (Header.Key == Fleet.size())
+				Fleet.emplace_back();
+			return Fleet[Header.Key].ReadSnapshot(Payload, Header.Size) == Header.Size;
+		}
+		return false;
+	}
+}
+
+bool FleetJournal::Open(const char* BasePath, std::vector<Taxi>& InFleet, JournalRecoveryStats* Stats)
+{
+	Close();
+	Clock::time_point Start = Clock::now();
+	SnapshotPath = std::string(BasePath) + ".snap";
+	JournalPath = std::string(BasePath) + ".wal";
+	JournalRecoveryStats Recovery;
+
+	InFleet.clear();
+	std::error_code Error;
+	if (std::filesystem::exists(SnapshotPath, Error))
+	{
+		FleetFile Snapshot;
+		if (!Snapshot.Open(SnapshotPath.c_str()) || !Snapshot.LoadAllParallel(InFleet))
+		{
+			std::cerr << "Failed to load fleet snapshot: " << SnapshotPath << "\n";
+			InFleet.clear();
+			return false;
+		}
+		Recovery.SnapshotTaxis = static_cast<int>(InFleet.size());
+	}
+
+	// replay the journal up to the first record that is incomplete or damaged
+	std::uint64_t ValidBytes = 0;
+	{
+		MappedFile Journal;
+		if (Journal.Open(JournalPath.c_str()) && Journal.GetSize() >= sizeof(JournalHeader))
+		{
+			const char* Data = Journal.GetData();
+			std::size_t Size = Journal.GetSize();
+			JournalHeader Header;
+			std::memcpy(&Header, Data, sizeof(Header));
+			if (std::memcmp(Header.Magic, JOURNAL_MAGIC, sizeof(Header.Magic)) != 0
+				|| Header.Version > JOURNAL_VERSION
+				|| Header.HeaderSize < sizeof(JournalHeader) || Header.HeaderSize > Size)
+			{
+				std::cerr << "Not a valid journal file: " << JournalPath << "\n";
+				InFleet.clear();
+				return false;
+			}
+			// records of different taxis do not depend on each other, so they are applied
+			// a range of taxis at a time, keeping the order per taxi: jumping between taxis
+			// on every record would make the replay wait on memory for nearly each one.
+			// The ranges go by ascending key, so taxis appended after the snapshot are still
+			// appended in order; keys past the last range all go to it.
+			int Shift = 0;
+			while ((InFleet.size() >> Shift) >= static_cast<std::size_t>(REPLAY_RANGES))
+				Shift++;
+			auto RangeOf = [Shift](std::uint32_t Key)
+			{
+				std::uint32_t Range = Key >> Shift;
+				return Range < static_cast<std::uint32_t>(REPLAY_RANGES) ? Range : REPLAY_RANGES - 1;
+			};
+
+			// First pass: check the records, count them per range and find the last
+			// whole-taxi record of every taxi, which makes what was logged before it moot
+			std::vector<std::size_t> LastWhole;
+			std::vector<std::size_t> RangeStarts(REPLAY_RANGES + 1, 0);
+			std::uint64_t RecordCount = 0;
+			std::size_t Offset = Header.HeaderSize;
+			while (Size - Offset >= sizeof(JournalRecordHeader))
+			{
+				JournalRecordHeader Record;
+				std::memcpy(&Record, Data + Offset, sizeof(Record));
+				if (Record.Size > Size - Offset - sizeof(Record) || StoredRecordChecksum(Data + Offset, Record.Size) != Record.Checksum)
+					break;
+				if (Record.Type == static_cast<std::uint8_t>(JournalRecordType::Taxi) && Record.Key < InFleet.size())
+				{
+					if (LastWhole.empty())
+						LastWhole.assign(InFleet.size(), 0);
+					LastWhole[Record.Key] = Offset;
+				}
+				RangeStarts[RangeOf(Record.Key) + 1]++;
+				RecordCount++;
+				Offset += sizeof(Record) + Record.Size;
+			}
+			ValidBytes = Offset;
+			for (int r = 1; r <= REPLAY_RANGES; r++)
+				RangeStarts[r] += RangeStarts[r - 1];
+
+			// Second pass: group the records that still matter by range. Driver state
+			// records, nearly all of them, are packed into the entry so applying them does
+			// not read the file again. Only taxis of the snapshot can be superseded: a
+			// record for a later taxi may be the one that appends it.
+			std::unique_ptr<std::uint64_t[]> Ordered(new std::uint64_t[RecordCount]);
+			std::vector<std::size_t> RangeEnds(RangeStarts.begin(), RangeStarts.end() - 1);
+			for (Offset = Header.HeaderSize; Offset < ValidBytes; )
+			{
+				JournalRecordHeader Record;
+				std::memcpy(&Record, Data + Offset, sizeof(Record));
+				std::uint64_t Entry = Offset;
+				Offset += sizeof(Record) + Record.Size;
+				if (!LastWhole.empty() && Record.Key < LastWhole.size() && LastWhole[Record.Key] > Entry)
+				{
+					Recovery.Superseded++;
+					continue;
+				}
+				if (Record.Type == static_cast<std::uint8_t>(JournalRecordType::DriverState) && Record.Size == DRIVER_STATE_PAYLOAD)
+				{
+					const char* Payload = Data + Entry + sizeof(Record);
+					std::uint32_t Index;
+					std::memcpy(&Index, Payload, sizeof(Index));
+					if (Index <= MAX_INLINE_DRIVER && Record.Key <= MAX_INLINE_KEY)
+						Entry = INLINE_DRIVER_STATE | std::uint64_t(Record.Key) << 32 | Index << 8
+							| static_cast<unsigned char>(Payload[sizeof(Index)]);
+				}
+				Ordered[RangeEnds[RangeOf(Record.Key)]++] = Entry;
+			}
+
+			for (int r = 0; r < REPLAY_RANGES; r++)
+				for (std::size_t i = RangeStarts[r]; i < RangeEnds[r]; i++)
+				{
+					std::uint64_t Entry = Ordered[i];
+					std::uint32_t Key;
+					bool Applied;
+					if (Entry & INLINE_DRIVER_STATE)
+					{
+						Key = static_cast<std::uint32_t>(Entry >> 32) & MAX_INLINE_KEY;
+						int Index = static_cast<int>((Entry >> 8) & MAX_INLINE_DRIVER);
+						Applied = Key < InFleet.size() && Index < InFleet[Key].GetDriversCount()
+							&& InFleet[Key].SetDriverState(Index, static_cast<int>(Entry & 0xFF));
+					}
+					else
+					{
+						JournalRecordHeader Record;
+						std::memcpy(&Record, Data + Entry, sizeof(Record));
+						Key = Record.Key;
+						Applied = ApplyRecord(InFleet, Record, Data + Entry + sizeof(Record));
+					}
+					if (!Applied)
+					{
+						std::cerr << "Failed to replay journal " << JournalPath << ": bad record for taxi " << Key << "\n";
+						InFleet.clear();
+						return false;
+					}
+				}
+			Recovery.Records = RecordCount;
+			Recovery.DiscardedBytes = Size - ValidBytes;
+		}
+	}
+
+	Fleet = &InFleet;
+	{
+		std::lock_guard<std::mutex> Guard(Lock);
+		Stopping = false;
+		WriteFailed = false;
+		if (ValidBytes)
+		{
+			if (Recovery.DiscardedBytes)
+				std::filesystem::resize_file(JournalPath, ValidBytes, Error);
+			File = Error ? nullptr : std::fopen(JournalPath.c_str(), "ab");
+			LoggedBytes = DurableBytes = ValidBytes;
+		}
+		else
+			ResetFile();
+		if (!File)
+		{
+			std::cerr << "Failed to open journal: " << JournalPath << "\n";
+			Fleet = nullptr;
+			return false;
+		}
+	}
+	AttachAll();
+	Flusher = std::thread(&FleetJournal::FlushLoop, this);
+
+	Recovery.Milliseconds = std::chrono::duration<double, std::milli>(Clock::now() - Start).count();
+	if (Stats)
+		*Stats = Recovery;
+	return true;
+}
+
+void FleetJournal::Close()
+{
+	if (!File)
+		return;
+	Sync();
+	{
+		std::lock_guard<std::mutex> Guard(Lock);
+		Stopping = true;
+	}
+	Wake.notify_all();
+	Flusher.join();
+	std::fclose(File);
+	File = nullptr;
+	for (Taxi& Obj : *Fleet)
+		Obj.DetachListener(this);
+	Fleet = nullptr;
+	Pending.clear();
+	Records = Syncs = 0;
+}
+
+void FleetJournal::AttachAll()
+{
+	for (std::size_t i = 0; i < Fleet->size(); i++)
+		(*Fleet)[i].AttachListener(this, static_cast<std::uint32_t>(i));
+}
+
+void FleetJournal::Track(int FleetIndex)
+{
+	if (!Fleet || FleetIndex < 0 || FleetIndex >= static_cast<int>(Fleet->size()))
+		return;
+	Taxi& Obj = (*Fleet)[FleetIndex];
+	Obj.AttachListener(this, static_cast<std::uint32_t>(FleetIndex));
+	TaxiChanged(static_cast<std::uint32_t>(FleetIndex), Obj);
+}
+
+bool FleetJournal::ResetFile()
+{
+	if (File)
+		std::fclose(File);
+	File = std::fopen(JournalPath.c_str(), "wb");
+	if (!File)
+		return false;
+	JournalHeader Header = {};
+	std::memcpy(Header.Magic, JOURNAL_MAGIC, sizeof(Header.Magic));
+	Header.Version = JOURNAL_VERSION;
+	Header.HeaderSize = sizeof(JournalHeader);
+	if (std::fwrite(&Header, sizeof(Header), 1, File) != 1 || !SyncFile(File))
+		WriteFailed = true;
+	Pending.clear();
+	LoggedBytes = DurableBytes = sizeof(Header);
+	return !WriteFailed;
+}
+
+void FleetJournal::Append(JournalRecordType Type, std::uint32_t Key, const char* Payload, std::size_t Size)
+{
+	JournalRecordHeader Header;
+	Header.Size = static_cast<std::uint32_t>(Size);
+	Header.Type = static_cast<std::uint8_t>(Type);
+	Header.Key = Key;
+	Header.Checksum = RecordChecksum(Header, Payload);
+
+	std::lock_guard<std::mutex> Guard(Lock);
+	if (!File)
+		return;
+	const char* HeaderBytes = reinterpret_cast<const char*>(&Header);
+	Pending.insert(Pending.end(), HeaderBytes, HeaderBytes + sizeof(Header));
+	Pending.insert(Pending.end(), Payload, Payload + Size);
+	LoggedBytes += sizeof(Header) + Size;
+	Records++;
+}
+
+void FleetJournal::DriverChanged(std::uint32_t Key, const Taxi&, int Index, int, int State)
+{
+	char Payload[DRIVER_STATE_PAYLOAD];
+	std::uint32_t DriverIndex = static_cast<std::uint32_t>(Index);
+	std::memcpy(Payload, &DriverIndex, sizeof(DriverIndex));
+	Payload[sizeof(DriverIndex)] = static_cast<char>(State);
+	Append(JournalRecordType::DriverState, Key, Payload, sizeof(Payload));
+}
+
+void FleetJournal::AddressChanged(std::uint32_t Key, const Taxi& Obj, int Index)
+{
+	const char* Address = Obj.GetAddress(Index);
+	char Payload[sizeof(std::uint32_t) + sizeof(std::uint16_t) + MAX_STR_LEN];
+	std::uint32_t AddressIndex = static_cast<std::uint32_t>(Index);
+	std::size_t Length = Address ? std::strlen(Address) : 0;
+	if (Length > MAX_STR_LEN - 1)
+		Length = MAX_STR_LEN - 1;
+	std::uint16_t Len = static_cast<std::uint16_t>(Length);
+	std::memcpy(Payload, &AddressIndex, sizeof(AddressIndex));
+	std::memcpy(Payload + sizeof(AddressIndex), &Len, sizeof(Len));
+	if (Len)
+		std::memcpy(Payload + sizeof(AddressIndex) + sizeof(Len), Address, Len);
+	Append(JournalRecordType::Address, Key, Payload, sizeof(AddressIndex) + sizeof(Len) + Len);
+}
+
+void FleetJournal::TaxiChanged(std::uint32_t Key, const Taxi& Obj)
+{
+	std::vector<char> Snapshot;
+	Obj.AppendSnapshot(Snapshot);
+	Append(JournalRecordType::Taxi, Key, Snapshot.data(), Snapshot.size());
+}
+
+void FleetJournal::FlushLoop()
+{
+	std::vector<char> Writing;
+	std::unique_lock<std::mutex> Guard(Lock);
+	while (true)
+	{
+		// wait out the commit interval so one sync covers everything logged meanwhile
+		Wake.wait_for(Guard, CommitInterval, [this] { return Stopping || SyncRequested; });
+		SyncRequested = false;
+		if (Pending.empty())
+		{
+			if (Stopping)
+				break;
+			continue;
+		}
+		Writing.swap(Pending);
+		std::uint64_t Target = LoggedBytes;
+		std::FILE* Out = File;
+		Guard.unlock();
+		bool Written = std::fwrite(Writing.data(), 1, Writing.size(), Out) == Writing.size() && SyncFile(Out);
+		Writing.clear();
+		Guard.lock();
+		if (!Written && !WriteFailed)
+		{
+			std::cerr << "Failed to write journal: " << JournalPath << "\n";
+			WriteFailed = true;
+		}
+		DurableBytes = Target;
+		Syncs++;
+		Durable.notify_all();
+	}
+}
+
+bool FleetJournal::Sync()
+{
+	std::unique_lock<std::mutex> Guard(Lock);
+	if (!File)
+		return false;
+	std::uint64_t Target = LoggedBytes;
+	if (DurableBytes < Target)
+	{
+		SyncRequested = true;
+		Wake.notify_one();
+		Durable.wait(Guard, [this, Target] { return DurableBytes >= Target; });
+	}
+	return !WriteFailed;
+}
+
+bool FleetJournal::Checkpoint()
+{
+	if (!Sync())
+		return false;
+	// the new snapshot replaces the old one only once it is complete and on disk
+	std::string Temporary = SnapshotPath + ".tmp";
+	std::error_code Error;
+	if (!SaveFleet(Temporary.c_str(), *Fleet) || !SyncPath(Temporary))
+		return false;
+	std::filesystem::rename(Temporary, SnapshotPath, Error);
+	// the journal may only be emptied once the directory names the new snapshot for good
+	if (Error || !SyncDirectory(SnapshotPath))
+	{
+		std::cerr << "Failed to replace fleet snapshot: " << SnapshotPath << "\n";
+		return false;
+	}
+	{
+		std::unique_lock<std::mutex> Guard(Lock);
+		// anything the flush thread still writes is already in the snapshot
+		Durable.wait(Guard, [this] { return DurableBytes >= LoggedBytes; });
+		if (!ResetFile())
+		{
+			std::cerr << "Failed to start a new journal: " << JournalPath << "\n";
+			return false;
+		}
+	}
+	AttachAll();
+	return true;
+}
+
+bool FleetJournal::CheckpointIfNeeded()
+{
+	return CheckpointBytes && GetJournalBytes() >= CheckpointBytes ? Checkpoint() : true;
+}
+
+void FleetJournal::SetCommitInterval(std::chrono::milliseconds Interval)
+{
+	std::lock_guard<std::mutex> Guard(Lock);
+	CommitInterval = Interval;
+}
+
+std::uint64_t FleetJournal::GetJournalBytes() const
+{
+	std::lock_guard<std::mutex> Guard(Lock);
+	return LoggedBytes;
+}
+
+std::uint64_t FleetJournal::GetRecordCount() const
+{
+	std::lock_guard<std::mutex> Guard(Lock);
+	return Records;
+}
+
+std::uint64_t FleetJournal::GetSyncCount() const
+{
+	std::lock_guard<std::mutex> Guard(Lock);
+	return Syncs;
+}
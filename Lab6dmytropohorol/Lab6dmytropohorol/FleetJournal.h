@@ -0,0 +1,133 @@
+#pragma once
+
+#include "Taxi.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Write-ahead journal of a fleet. The fleet lives in two files:
+//   <Base>.snap  fleet file (see FleetFile.h) written by the last Checkpoint
+//   <Base>.wal   every change made since, as JournalRecordHeader + payload records
+// Taxis attached to the journal log each driver state and address change; changes of
+// the driver or address count, snapshot loads and assignments log the whole taxi.
+// Records are buffered and written by a background thread, which syncs the file at
+// most once per commit interval for all the records that came in meanwhile (group
+// commit). Sync() waits until everything logged so far is on disk.
+// Every record only sets state, so replaying one twice gives the same result; a crash
+// during Checkpoint can therefore not lose or corrupt anything.
+// Not supported: the Passenger field (a plain array) and removing taxis, both are
+// saved by the next Checkpoint only.
+
+const char JOURNAL_MAGIC[4] = { 'T', 'X', 'W', 'L' };
+const std::uint16_t JOURNAL_VERSION = 1;
+
+enum class JournalRecordType : std::uint8_t
+{
+	DriverState = 1, // uint32 driver index, uint8 state
+	Address = 2,     // uint32 address index, uint16 length, characters
+	Taxi = 3         // binary snapshot record; a key one past the end appends a taxi
+};
+
+#pragma pack(push, 1)
+struct JournalHeader
+{
+	char Magic[4];
+	std::uint16_t Version;
+	std::uint16_t HeaderSize;
+};
+
+struct JournalRecordHeader
+{
+	// Payload bytes after this header
+	std::uint32_t Size;
+	// CRC-32C of Type, Key and the payload, a torn or damaged tail fails it
+	std::uint32_t Checksum;
+	std::uint8_t Type;
+	// Index of the taxi in the fleet
+	std::uint32_t Key;
+};
+#pragma pack(pop)
+
+struct JournalRecoveryStats
+{
+	int SnapshotTaxis = 0;
+	std::uint64_t Records = 0;
+	// Records not applied because a later whole-taxi record replaced them
+	std::uint64_t Superseded = 0;
+	// Bytes of an incomplete last record, cut off the journal
+	std::uint64_t DiscardedBytes = 0;
+	double Milliseconds = 0;
+};
+
+class FleetJournal : public TaxiListener
+{
+public:
+	FleetJournal() = default;
+	~FleetJournal() { Close(); }
+	FleetJournal(const FleetJournal&) = delete;
+	FleetJournal& operator=(const FleetJournal&) = delete;
+
+	// Replaces Fleet with the last snapshot plus the journal tail (an empty fleet if
+	// neither file exists yet), attaches every taxi and opens the journal for appending.
+	// Fleet must stay alive until Close.
+	bool Open(const char* BasePath, std::vector<Taxi>& Fleet, JournalRecoveryStats* Stats = nullptr);
+	// Writes what is still buffered and detaches the fleet
+	void Close();
+	bool IsOpen() const { return File != nullptr; }
+
+	// Attaches a taxi added to the fleet after Open and logs it whole
+	void Track(int FleetIndex);
+
+	// Blocks until every record logged so far is on disk
+	bool Sync();
+	// Saves the fleet as a new snapshot and starts an empty journal
+	bool Checkpoint();
+	// Checkpoint once the journal has grown past the threshold (0 turns it off)
+	bool CheckpointIfNeeded();
+	void SetCheckpointBytes(std::uint64_t Bytes) { CheckpointBytes = Bytes; }
+	void SetCommitInterval(std::chrono::milliseconds Interval);
+
+	std::uint64_t GetJournalBytes() const;
+	std::uint64_t GetRecordCount() const;
+	// Number of file syncs, each one committing a whole group of records
+	std::uint64_t GetSyncCount() const;
+
+	// TaxiListener, called by the attached taxis
+	void DriverChanged(std::uint32_t Key, const Taxi& Obj, int Index, int OldState, int State) override;
+	void AddressChanged(std::uint32_t Key, const Taxi& Obj, int Index) override;
+	void TaxiChanged(std::uint32_t Key, const Taxi& Obj) override;
+
+private:
+	void Append(JournalRecordType Type, std::uint32_t Key, const char* Payload, std::size_t Size);
+	// Starts an empty journal file, under the lock
+	bool ResetFile();
+	void FlushLoop();
+	void AttachAll();
+
+	std::string SnapshotPath;
+	std::string JournalPath;
+	std::vector<Taxi>* Fleet = nullptr;
+	std::FILE* File = nullptr;
+
+	mutable std::mutex Lock;
+	std::condition_variable Wake;
+	std::condition_variable Durable;
+	// Records waiting for the flush thread
+	std::vector<char> Pending;
+	// Journal bytes handed to Append, and the ones known to be on disk
+	std::uint64_t LoggedBytes = 0;
+	std::uint64_t DurableBytes = 0;
+	std::uint64_t Records = 0;
+	std::uint64_t Syncs = 0;
+	bool SyncRequested = false;
+	bool WriteFailed = false;
+	bool Stopping = false;
+	std::chrono::milliseconds CommitInterval{ 5 };
+	std::uint64_t CheckpointBytes = 64ull << 20;
+	std::thread Flusher;
+};
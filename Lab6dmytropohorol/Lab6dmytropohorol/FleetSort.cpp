@@ -0,0 +1,311 @@
+#include "FleetSort.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define TAXI_X86 1
+#include <xmmintrin.h>
+#endif
+
+namespace
+{
+	struct KeyedIndex
+	{
+		std::uint32_t Key;
+		std::uint32_t Index;
+	};
+
+	const int RADIX_BITS = 8;
+	const int RADIX_SIZE = 1 << RADIX_BITS;
+	// Below this size std::sort beats setting up the radix passes
+	const int RADIX_MIN_SIZE = 256;
+	// How many taxis ahead SortTaxis prefetches while putting them in place
+	const std::size_t PREFETCH_DISTANCE = 16;
+
+	// Asks for the cache lines of Size bytes at Address ahead of their use, a no-op off x86
+	void Prefetch(const void* Address, std::size_t Size)
+	{
+#ifdef TAXI_X86
+		const char* Bytes = static_cast<const char*>(Address);
+		for (std::size_t Offset = 0; Offset < Size; Offset += 64)
+			_mm_prefetch(Bytes + Offset, _MM_HINT_T0);
+		_mm_prefetch(Bytes + Size - 1, _MM_HINT_T0);
+#else
+		(void)Address;
+		(void)Size;
+#endif
+	}
+
+	int SortThreads(std::size_t Size)
+	{
+		if (Size < static_cast<std::size_t>(PARALLEL_SORT_THRESHOLD))
+			return 1;
+		int Threads = static_cast<int>(std::thread::hardware_concurrency());
+		return Threads < 1 ? 1 : (Threads > 16 ? 16 : Threads);
+	}
+
+	// Threads started once per sort and handed every parallel step of it, so the radix
+	// passes do not start and join threads of their own
+	class SortWorkers
+	{
+	public:
+		explicit SortWorkers(int InThreads)
+			: Threads(InThreads)
+		{
+			Workers.reserve(Threads - 1);
+			for (int t = 1; t < Threads; t++)
+				Workers.emplace_back(&SortWorkers::WorkerLoop, this, t);
+		}
+
+		~SortWorkers()
+		{
+			{
+				std::lock_guard<std::mutex> Guard(Lock);
+				Stopping = true;
+			}
+			Start.notify_all();
+			for (std::thread& Worker : Workers)
+				Worker.join();
+		}
+
+		SortWorkers(const SortWorkers&) = delete;
+		SortWorkers& operator=(const SortWorkers&) = delete;
+
+		int GetThreads() const { return Threads; }
+
+		// Runs Body(ThreadIndex) on every thread, the calling thread being number 0,
+		// and returns once all of them are done
+		template <typename F>
+		void Run(F&& Body)
+		{
+			if (Threads == 1)
+			{
+				Body(0);
+				return;
+			}
+			{
+				std::lock_guard<std::mutex> Guard(Lock);
+				Job = [](void* Context, int ThreadIndex) { (*static_cast<std::remove_reference_t<F>*>(Context))(ThreadIndex); };
+				JobContext = &Body;
+				Pending = Threads - 1;
+				Generation++;
+			}
+			Start.notify_all();
+			Body(0);
+			std::unique_lock<std::mutex> Guard(Lock);
+			Done.wait(Guard, [this] { return Pending == 0; });
+		}
+
+	private:
+		void WorkerLoop(int ThreadIndex)
+		{
+			std::uint64_t Seen = 0;
+			while (true)
+			{
+				void (*Call)(void*, int);
+				void* Context;
+				{
+					std::unique_lock<std::mutex> Guard(Lock);
+					Start.wait(Guard, [&] { return Stopping || Generation != Seen; });
+					if (Stopping)
+						return;
+					Seen = Generation;
+					Call = Job;
+					Context = JobContext;
+				}
+				Call(Context, ThreadIndex);
+				bool Last;
+				{
+					std::lock_guard<std::mutex> Guard(Lock);
+					Last = --Pending == 0;
+				}
+				if (Last)
+					Done.notify_one();
+			}
+		}
+
+		int Threads;
+		std::vector<std::thread> Workers;
+		std::mutex Lock;
+		std::condition_variable Start;
+		std::condition_variable Done;
+		void (*Job)(void*, int) = nullptr;
+		void* JobContext = nullptr;
+		int Pending = 0;
+		std::uint64_t Generation = 0;
+		bool Stopping = false;
+	};
+
+	// Stable LSD radix sort by Key, every pass splits the array between the threads
+	void RadixSort(std::vector<KeyedIndex>& Items, SortWorkers& Workers)
+	{
+		std::size_t Size = Items.size();
+		if (Size < static_cast<std::size_t>(RADIX_MIN_SIZE))
+		{
+			std::sort(Items.begin(), Items.end(),
+				[](const KeyedIndex& A, const KeyedIndex& B) { return A.Key < B.Key; });
+			return;
+		}
+		int Threads = Workers.GetThreads();
+		std::vector<KeyedIndex> Buffer(Size);
+		KeyedIndex* Src = Items.data();
+		KeyedIndex* Dst = Buffer.data();
+		std::vector<std::size_t> Counts(static_cast<std::size_t>(Threads) * RADIX_SIZE);
+
+		for (int Shift = 0; Shift < 32; Shift += RADIX_BITS)
+		{
+			std::fill(Counts.begin(), Counts.end(), 0);
+			Workers.Run([&](int t)
+			{
+				std::size_t* Local = Counts.data() + static_cast<std::size_t>(t) * RADIX_SIZE;
+				for (std::size_t i = Size * t / Threads; i < Size * (t + 1) / Threads; i++)
+					Local[(Src[i].Key >> Shift) & (RADIX_SIZE - 1)]++;
+			});
+
+			// skip the pass when every key has the same digit
+			bool Trivial = false;
+			for (int d = 0; d < RADIX_SIZE && !Trivial; d++)
+			{
+				std::size_t Total = 0;
+				for (int t = 0; t < Threads; t++)
+					Total += Counts[static_cast<std::size_t>(t) * RADIX_SIZE + d];
+				Trivial = Total == Size;
+			}
+			if (Trivial)
+				continue;
+
+			// turn the counts into write positions, thread by thread inside every digit
+			std::size_t Offset = 0;
+			for (int d = 0; d < RADIX_SIZE; d++)
+				for (int t = 0; t < Threads; t++)
+				{
+					std::size_t& Slot = Counts[static_cast<std::size_t>(t) * RADIX_SIZE + d];
+					std::size_t Count = Slot;
+					Slot = Offset;
+					Offset += Count;
+				}
+
+			Workers.Run([&](int t)
+			{
+				std::size_t* Local = Counts.data() + static_cast<std::size_t>(t) * RADIX_SIZE;
+				for (std::size_t i = Size * t / Threads; i < Size * (t + 1) / Threads; i++)
+					Dst[Local[(Src[i].Key >> Shift) & (RADIX_SIZE - 1)]++] = Src[i];
+			});
+			std::swap(Src, Dst);
+		}
+		if (Src != Items.data())
+			std::memcpy(Items.data(), Src, Size * sizeof(KeyedIndex));
+	}
+
+	// Sorts Items with Less, splitting the work between threads and merging the sorted runs
+	template <typename T, typename Compare>
+	void ParallelSort(std::vector<T>& Items, Compare Less, SortWorkers& Workers)
+	{
+		std::size_t Size = Items.size();
+		int Threads = Workers.GetThreads();
+		Workers.Run([&](int t)
+		{
+			std::sort(Items.begin() + Size * t / Threads, Items.begin() + Size * (t + 1) / Threads, Less);
+		});
+		// merge neighbouring runs until one is left, the pairs of a level at the same time
+		for (int Width = 1; Width < Threads; Width *= 2)
+			Workers.Run([&](int t)
+			{
+				if (t % (2 * Width) != 0 || t + Width >= Threads)
+					return;
+				int Last = t + 2 * Width < Threads ? t + 2 * Width : Threads;
+				std::inplace_merge(Items.begin() + Size * t / Threads,
+					Items.begin() + Size * (t + Width) / Threads,
+					Items.begin() + Size * Last / Threads, Less);
+			});
+	}
+}
+
+void SortByObjectNumber(IAutoNumber* Arr[], int Size)
+{
+	if (!Arr || Size < 2)
+		return;
+	std::size_t Count = static_cast<std::size_t>(Size);
+	SortWorkers Workers(SortThreads(Count));
+	int Threads = Workers.GetThreads();
+	std::vector<KeyedIndex> Items(Size);
+	Workers.Run([&](int t)
+	{
+		for (std::size_t i = Count * t / Threads; i < Count * (t + 1) / Threads; i++)
+		{
+			// flip the sign bit so negative numbers sort before positive ones
+			Items[i].Key = static_cast<std::uint32_t>(Arr[i]->GetObjectNumber()) ^ 0x80000000u;
+			Items[i].Index = static_cast<std::uint32_t>(i);
+		}
+	});
+	RadixSort(Items, Workers);
+	std::vector<IAutoNumber*> Sorted(Size);
+	Workers.Run([&](int t)
+	{
+		for (std::size_t i = Count * t / Threads; i < Count * (t + 1) / Threads; i++)
+			Sorted[i] = Arr[Items[i].Index];
+	});
+	std::copy(Sorted.begin(), Sorted.end(), Arr);
+}
+
+void SortTaxis(std::vector<Taxi>& Fleet)
+{
+	struct CachedKey
+	{
+		TaxiSortKey Key;
+		std::uint32_t Index;
+	};
+	std::size_t Size = Fleet.size();
+	if (Size < 2)
+		return;
+	SortWorkers Workers(SortThreads(Size));
+	int Threads = Workers.GetThreads();
+	std::vector<CachedKey> Keys(Size);
+	Workers.Run([&](int t)
+	{
+		for (std::size_t i = Size * t / Threads; i < Size * (t + 1) / Threads; i++)
+			Keys[i] = { Fleet[i].GetSortKey(), static_cast<std::uint32_t>(i) };
+	});
+	ParallelSort(Keys, [](const CachedKey& A, const CachedKey& B) { return A.Key < B.Key; }, Workers);
+
+	// Put the taxis in place front to back: position i swaps with wherever the taxi it
+	// needs is now. Where[j] is the position of the taxi that started at j, Who[p] where
+	// the taxi at p started. Unlike following the cycles of the permutation, the next
+	// steps are known ahead, so their taxis are prefetched instead of missing one by one.
+	std::vector<std::uint32_t> Where(Size), Who(Size);
+	Workers.Run([&](int t)
+	{
+		for (std::size_t i = Size * t / Threads; i < Size * (t + 1) / Threads; i++)
+			Where[i] = Who[i] = static_cast<std::uint32_t>(i);
+	});
+	for (std::size_t i = 0; i < Size; i++)
+	{
+		if (i + 2 * PREFETCH_DISTANCE < Size)
+			Prefetch(&Where[Keys[i + 2 * PREFETCH_DISTANCE].Index], sizeof(std::uint32_t));
+		if (i + PREFETCH_DISTANCE < Size)
+		{
+			std::uint32_t Ahead = Where[Keys[i + PREFETCH_DISTANCE].Index];
+			Prefetch(&Fleet[Ahead], sizeof(Taxi));
+			Prefetch(&Who[Ahead], sizeof(std::uint32_t));
+			Prefetch(&Where[Who[i + PREFETCH_DISTANCE]], sizeof(std::uint32_t));
+		}
+		std::uint32_t Taken = Keys[i].Index;
+		std::uint32_t From = Where[Taken];
+		if (From != i)
+		{
+			// the taxi at i moves to From. Positions up to i are final and never looked up again
+			Fleet[i].Swap(Fleet[From]);
+			std::uint32_t Displaced = Who[i];
+			Where[Displaced] = From;
+			Who[From] = Displaced;
+		}
+		// Swap does not publish, tell the listeners once per taxi that changed place
+		if (Taken != i)
+			Fleet[i].PublishWhole();
+	}
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "AbstractTaxi.h"
+#include "Taxi.h"
+#include <vector>
+
+// Fleets at least this large are sorted on several threads
+const int PARALLEL_SORT_THRESHOLD = 1 << 16;
+
+// Sorts by ascending GetObjectNumber(). The numbers are read once into a (key, index)
+// array, which is radix sorted, in parallel for large arrays.
+void SortByObjectNumber(IAutoNumber* Arr[], int Size);
+
+// Sorts the fleet by Taxi::operator<. The sort keys (Taxi::GetSortKey) are taken once per taxi and
+// the taxis are put in place front to back with Swap, prefetching the next ones, so no Taxi
+// is copied or constructed. Every taxi that changed place is published once (Taxi::PublishWhole).
+void SortTaxis(std::vector<Taxi>& Fleet);
@@ -0,0 +1,61 @@
+#include "GeocodeTable.h"
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+bool GeocodeTable::LoadFromFile(const char* FileName)
+{
+	std::ifstream In(FileName);
+	if (!In)
+	{
+		std::cerr << "Failed to open geocode file: " << FileName << "\n";
+		return false;
+	}
+	std::string Line;
+	int LineNumber = 0;
+	while (std::getline(In, Line))
+	{
+		LineNumber++;
+		if (!Line.empty() && Line.back() == '\r')
+			Line.pop_back();
+		if (Line.empty() || Line[0] == '#')
+			continue;
+		const char* Begin = Line.c_str();
+		char* End;
+		float X = std::strtof(Begin, &End);
+		const char* Next = End;
+		float Y = std::strtof(Next, &End);
+		bool Parsed = End != Begin && End != Next && *End == ' ';
+		while (*End == ' ' || *End == '\t')
+			End++;
+		if (!Parsed || !*End)
+		{
+			std::cerr << "Failed to read geocode file " << FileName << ": bad line " << LineNumber << "\n";
+			return false;
+		}
+		Set(End, GeoPoint{ X, Y });
+	}
+	return !In.bad();
+}
+
+void GeocodeTable::Set(const char* Address, GeoPoint Position)
+{
+	AddressId Id = AddressPool::Intern(Address);
+	if (Id != INVALID_ADDRESS_ID)
+		Points[Id] = Position;
+}
+
+bool GeocodeTable::Find(AddressId Id, GeoPoint& Position) const
+{
+	auto It = Points.find(Id);
+	if (It == Points.end())
+		return false;
+	Position = It->second;
+	return true;
+}
+
+bool GeocodeTable::Find(const char* Address, GeoPoint& Position) const
+{
+	return Find(AddressPool::Find(Address), Position);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "AddressPool.h"
+#include <unordered_map>
+
+struct GeoPoint
+{
+	float X = 0;
+	float Y = 0;
+};
+
+// Coordinates of addresses, keyed by their AddressPool id.
+// The text file has one address per line: "<x> <y> <address>", the address
+// running to the end of the line. Empty lines and lines starting with '#' are skipped.
+class GeocodeTable
+{
+public:
+	// Adds the entries of the file to the table, returns false if it could not be read
+	bool LoadFromFile(const char* FileName);
+
+	void Set(const char* Address, GeoPoint Position);
+	bool Find(AddressId Id, GeoPoint& Position) const;
+	bool Find(const char* Address, GeoPoint& Position) const;
+
+	int GetSize() const { return static_cast<int>(Points.size()); }
+
+private:
+	std::unordered_map<AddressId, GeoPoint> Points;
+};
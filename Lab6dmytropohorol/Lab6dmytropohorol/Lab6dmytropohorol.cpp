@@ -1,18 +1,98 @@
 ﻿#include "Taxi.h"
 #include "LuxTaxi.h"
 #include "MiniTaxi.h"
+#include "Benchmarks.h"
+#include "Checks.h"
+#include "DispatchClient.h"
+#include "DispatchServer.h"
+#include "FleetFile.h"
+#include "FleetSort.h"
+#include "StreamPipeline.h"
 #include <iostream>
+#include <cstdlib>
 #include <fstream>
 #include <string>
 
 int ReadStrictInt();
 void ReadNonEmptyString(char* Buffer);
 void PressEnterToContinue();
-void SortByObjectNumber(IAutoNumber*[], int);
 void StreamConversion(std::istream&, std::ostream&, IStringConvertible*);
 
-int main()
+int main(int argc, char* argv[])
 {
+	// "--bench" skips the interactive demo and only runs the benchmarks
+	if (argc > 1 && std::string(argv[1]) == "--bench")
+	{
+		RunBenchmarks();
+		return 0;
+	}
+	// "--check" runs the round-trip and invariant checks, the exit code says whether they passed
+	if (argc > 1 && std::string(argv[1]) == "--check")
+		return RunChecks() ? 0 : 1;
+	// "--convert <in> <out>" runs every line of a dump through FromString/ToString in bulk
+	if (argc > 3 && std::string(argv[1]) == "--convert")
+	{
+		std::ifstream In(argv[2], std::ios::binary);
+		std::ofstream Out(argv[3], std::ios::binary);
+		if (!In || !Out)
+		{
+			std::cerr << "Failed to open " << (!In ? argv[2] : argv[3]) << "\n";
+			return 1;
+		}
+		StreamPipelineStats Stats;
+		bool Ok = StreamConversionBulk<LuxTaxi>(In, Out, &Stats);
+		std::cout << "Converted " << Stats.Lines << " lines, " << Stats.BytesIn << " -> " << Stats.BytesOut << " bytes\n";
+		return Ok ? 0 : 1;
+	}
+
+	// "--serve <fleet file> <port | unix socket path>" runs the dispatch server on the fleet
+	if (argc > 3 && std::string(argv[1]) == "--serve")
+	{
+		std::vector<Taxi> Fleet;
+		FleetFile File;
+		if (!File.Open(argv[2]) || !File.LoadAll(Fleet))
+		{
+			std::cerr << "Failed to load fleet " << argv[2] << "\n";
+			return 1;
+		}
+		File.Close();
+		DispatchServer Server(Fleet);
+		std::string Endpoint = argv[3];
+		bool Listening = Endpoint.find_first_not_of("0123456789") == std::string::npos
+			? Server.ListenTcp(static_cast<std::uint16_t>(std::stoi(Endpoint)))
+			: Server.ListenUnix(Endpoint.c_str());
+		if (!Listening)
+			return 1;
+		std::cout << "Serving " << Fleet.size() << " taxis on " << Endpoint << "\n";
+		return Server.Run() ? 0 : 1;
+	}
+	// "--load <port | unix socket path> [requests] [connections] [pipeline]" drives a running server
+	if (argc > 2 && std::string(argv[1]) == "--load")
+	{
+		DispatchLoadOptions Options;
+		std::string Endpoint = argv[2];
+		if (Endpoint.find_first_not_of("0123456789") == std::string::npos)
+			Options.Port = static_cast<std::uint16_t>(std::stoi(Endpoint));
+		else
+			Options.UnixPath = Endpoint;
+		if (argc > 3)
+			Options.Requests = std::atoi(argv[3]);
+		if (argc > 4)
+			Options.Connections = std::atoi(argv[4]);
+		if (argc > 5)
+			Options.Pipeline = std::atoi(argv[5]);
+		DispatchLoadStats Stats;
+		if (!RunDispatchLoad(Options, Stats))
+		{
+			std::cerr << "Failed to run the load\n";
+			return 1;
+		}
+		std::cout << Stats.Requests << " requests in " << Stats.Seconds << " s: " << static_cast<long long>(Stats.Qps)
+			<< " req/s, p50 " << Stats.P50Us << " us, p99 " << Stats.P99Us << " us, max " << Stats.MaxUs
+			<< " us (" << Stats.Refused << " orders refused)\n";
+		return 0;
+	}
+
 	// A) Basic usage of Taxi
 	int sampleDrivers[3] = { DRIVER_FREE, DRIVER_BUSY, DRIVER_FREE };
 	char sampleAddresses[2][MAX_STR_LEN] = { "MainStreet","Broadway" };
@@ -100,20 +180,6 @@ void PressEnterToContinue()
 	std::cout << std::endl;
 }
 
-void SortByObjectNumber(IAutoNumber* arr[], int size)
-{
-	// basic bubble sort or std::sort with lambda
-	for (int i = 0; i < size - 1; i++) {
-		for (int j = 0; j < size - 1 - i; j++) {
-			if (arr[j]->GetObjectNumber() > arr[j + 1]->GetObjectNumber()) {
-				IAutoNumber* Temp = arr[j];
-				arr[j] = arr[j + 1];
-				arr[j + 1] = Temp;
-			}
-		}
-	}
-}
-
 void StreamConversion(std::istream& in, std::ostream& out, IStringConvertible* obj)
 {
 	out << "Enter a line to parse => ";
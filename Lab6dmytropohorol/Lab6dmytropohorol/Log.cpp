@@ -0,0 +1,153 @@
+#include "Log.h"
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+std::atomic<int> Logger::MinLevel{ static_cast<int>(LogLevel::Debug) };
+
+namespace
+{
+	// The writer thread is woken early once this much output is queued
+	const std::size_t ASYNC_WAKE_BYTES = 64 << 10;
+	const std::chrono::milliseconds ASYNC_FLUSH_PERIOD(50);
+
+	struct LoggerState
+	{
+		std::mutex Lock;
+		std::condition_variable Wake;
+		std::condition_variable Drained;
+		std::ostream* Out = &std::cout;
+		std::string Pending;
+		std::thread Writer;
+		bool Async = false;
+		bool Stop = false;
+		// Lines taken by the writer but not yet written
+		bool Writing = false;
+		bool FlushRequested = false;
+
+		~LoggerState() { StopWriter(); }
+
+		void WriterLoop()
+		{
+			std::string Batch;
+			std::unique_lock<std::mutex> Guard(Lock);
+			while (true)
+			{
+				Wake.wait_for(Guard, ASYNC_FLUSH_PERIOD, [this] { return Stop || FlushRequested || Pending.size() >= ASYNC_WAKE_BYTES; });
+				FlushRequested = false;
+				if (!Pending.empty())
+				{
+					Batch.swap(Pending);
+					Writing = true;
+					std::ostream* Target = Out;
+					Guard.unlock();
+					Target->write(Batch.data(), static_cast<std::streamsize>(Batch.size()));
+					Target->flush();
+					Batch.clear();
+					Guard.lock();
+					Writing = false;
+				}
+				Drained.notify_all();
+				if (Stop && Pending.empty())
+					return;
+			}
+		}
+
+		void StopWriter()
+		{
+			{
+				std::lock_guard<std::mutex> Guard(Lock);
+				if (!Async)
+					return;
+				Stop = true;
+			}
+			Wake.notify_one();
+			Writer.join();
+			std::lock_guard<std::mutex> Guard(Lock);
+			Async = false;
+			Stop = false;
+		}
+	};
+
+	LoggerState& State()
+	{
+		static LoggerState Logs;
+		return Logs;
+	}
+}
+
+const char* Logger::LevelTag(LogLevel Level)
+{
+	switch (Level)
+	{
+	case LogLevel::Trace: return "[TRACE] ";
+	case LogLevel::Debug: return "[LOG] ";
+	case LogLevel::Info: return "[INFO] ";
+	case LogLevel::Warning: return "[WARN] ";
+	case LogLevel::Error: return "[ERROR] ";
+	default: return "";
+	}
+}
+
+void Logger::Submit(std::string&& Line)
+{
+	LoggerState& Logs = State();
+	std::unique_lock<std::mutex> Guard(Logs.Lock);
+	if (!Logs.Async)
+	{
+		Logs.Out->write(Line.data(), static_cast<std::streamsize>(Line.size()));
+		return;
+	}
+	Logs.Pending += Line;
+	if (Logs.Pending.size() >= ASYNC_WAKE_BYTES)
+	{
+		Guard.unlock();
+		Logs.Wake.notify_one();
+	}
+}
+
+void Logger::SetStream(std::ostream& Out)
+{
+	Flush();
+	LoggerState& Logs = State();
+	std::lock_guard<std::mutex> Guard(Logs.Lock);
+	Logs.Out = &Out;
+}
+
+void Logger::SetAsync(bool Enabled)
+{
+	LoggerState& Logs = State();
+	if (!Enabled)
+	{
+		Logs.StopWriter();
+		return;
+	}
+	std::lock_guard<std::mutex> Guard(Logs.Lock);
+	if (Logs.Async)
+		return;
+	Logs.Async = true;
+	Logs.Writer = std::thread(&LoggerState::WriterLoop, &Logs);
+}
+
+bool Logger::IsAsync()
+{
+	LoggerState& Logs = State();
+	std::lock_guard<std::mutex> Guard(Logs.Lock);
+	return Logs.Async;
+}
+
+void Logger::Flush()
+{
+	LoggerState& Logs = State();
+	std::unique_lock<std::mutex> Guard(Logs.Lock);
+	if (!Logs.Async)
+	{
+		Logs.Out->flush();
+		return;
+	}
+	Logs.FlushRequested = true;
+	Logs.Wake.notify_one();
+	Logs.Drained.wait(Guard, [&Logs] { return Logs.Pending.empty() && !Logs.Writing; });
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <charconv>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+enum class LogLevel : int
+{
+	Trace = 0,
+	Debug = 1,
+	Info = 2,
+	Warning = 3,
+	Error = 4,
+	Off = 5
+};
+
+// Messages below this level are removed at compile time, define it as 5 to strip all logging.
+// Arguments of removed messages are not evaluated, so they must not have side effects.
+#ifndef TAXI_LOG_MIN_LEVEL
+#define TAXI_LOG_MIN_LEVEL 0
+#endif
+
+// TAXI_LOG(LogLevel::Debug, "Taxi copied, id=", Id) writes one line, the parts are concatenated
+#define TAXI_LOG(Level, ...) \
+	do { \
+		if constexpr (static_cast<int>(Level) >= TAXI_LOG_MIN_LEVEL) \
+			if (Logger::IsEnabled(Level)) \
+				Logger::Write(Level, __VA_ARGS__); \
+	} while (0)
+
+// Process-wide, level filtered logger. Writes to std::cout by default, either
+// synchronously or through a background thread that batches the lines.
+class Logger
+{
+public:
+	static bool IsEnabled(LogLevel Level)
+	{
+		return static_cast<int>(Level) >= MinLevel.load(std::memory_order_relaxed);
+	}
+
+	// Runtime filter, Debug by default so the constructor logs stay visible
+	static void SetLevel(LogLevel Level) { MinLevel.store(static_cast<int>(Level), std::memory_order_relaxed); }
+	static LogLevel GetLevel() { return static_cast<LogLevel>(MinLevel.load(std::memory_order_relaxed)); }
+
+	// Redirects the output, the stream has to outlive the logging
+	static void SetStream(std::ostream& Out);
+
+	// With async enabled lines are queued and written in batches by a background thread.
+	// Disabling it flushes the queue and stops the thread.
+	static void SetAsync(bool Enabled);
+	static bool IsAsync();
+
+	// Waits until every queued line is written
+	static void Flush();
+
+	template <typename... Parts>
+	static void Write(LogLevel Level, const Parts&... InParts)
+	{
+		std::string Line;
+		Line.reserve(128);
+		Line += LevelTag(Level);
+		(Append(Line, InParts), ...);
+		Line += '\n';
+		Submit(std::move(Line));
+	}
+
+private:
+	static const char* LevelTag(LogLevel Level);
+	static void Submit(std::string&& Line);
+
+	template <typename T>
+	static void Append(std::string& Line, const T& Value)
+	{
+		if constexpr (std::is_same_v<T, bool>)
+			Line += Value ? "true" : "false";
+		else if constexpr (std::is_same_v<T, char>)
+			Line += Value;
+		else if constexpr (std::is_integral_v<T> || std::is_enum_v<T>)
+		{
+			char Buffer[24];
+			std::to_chars_result Result;
+			if constexpr (std::is_enum_v<T>)
+				Result = std::to_chars(Buffer, Buffer + sizeof(Buffer), static_cast<long long>(Value));
+			else
+				Result = std::to_chars(Buffer, Buffer + sizeof(Buffer), Value);
+			Line.append(Buffer, Result.ptr);
+		}
+		else if constexpr (std::is_floating_point_v<T>)
+			Line += std::to_string(Value);
+		else
+			Line += std::string_view(Value);
+	}
+
+	static std::atomic<int> MinLevel;
+};
+
+// Changes the runtime log level while alive, e.g. to keep constructor logs out of a benchmark
+class ScopedLogLevel
+{
+public:
+	explicit ScopedLogLevel(LogLevel Level) : OldLevel(Logger::GetLevel()) { Logger::SetLevel(Level); }
+	~ScopedLogLevel() { Logger::SetLevel(OldLevel); }
+	ScopedLogLevel(const ScopedLogLevel&) = delete;
+	ScopedLogLevel& operator=(const ScopedLogLevel&) = delete;
+
+private:
+	LogLevel OldLevel;
+};
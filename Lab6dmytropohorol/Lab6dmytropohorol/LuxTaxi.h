@@ -1,4 +1,5 @@
 #pragma once
+#include "Log.h"
 #include "Taxi.h"
 
 class LuxTaxi : public Taxi
@@ -6,7 +7,7 @@ class LuxTaxi : public Taxi
 public:
 	LuxTaxi() : Taxi()
 	{
-		std::cout << "[LOG] LuxTaxi default constructor called.\n";
+		TAXI_LOG(LogLevel::Debug, "LuxTaxi default constructor called.");
 	}
 
 	LuxTaxi(const char* InPassenger,
@@ -14,16 +15,24 @@ public:
 		const char (*InAddresses)[MAX_STR_LEN], int InAddressesCount)
 		: Taxi(InPassenger, InDrivers, InDriversCount, InAddresses, InAddressesCount)
 	{
-		std::cout << "[LOG] LuxTaxi param constructor called.\n";
+		TAXI_LOG(LogLevel::Debug, "LuxTaxi param constructor called.");
 	}
 
 	// Polymorphic function override
 	void PrintInfo() const override
 	{
-		std::cout << "Lux taxi:\n"
-			<< "Passenger: " << Passenger
-			<< ", Total Taxi objects: " << Count
-			<< std::endl;
+		std::string Info;
+		AppendInfo(Info, GetCount());
+		std::cout << Info << std::flush;
+	}
+
+	void AppendInfo(std::string& Out, int TotalCount) const override
+	{
+		Out += "Lux taxi:\nPassenger: ";
+		Out += Passenger;
+		Out += ", Total Taxi objects: ";
+		Out += std::to_string(TotalCount);
+		Out += '\n';
 	}
 
 	// Lets show how to access 'Addresses' (protected in Taxi)
@@ -33,7 +42,7 @@ public:
 		std::cout << "[LuxTaxi::ShowProtectedAccess] We can read addresses...\n";
 		for (int i = 0; i < GetAddressesCount(); i++)
 			if (Addresses) // 'Addresses' is protected, so its avaiable here
-				std::cout << "  LuxTaxi address[" << i << "] = " << Addresses[i] << "\n";
+				std::cout << "  LuxTaxi address[" << i << "] = " << AddressPool::Get(Addresses[i]) << "\n";
 
 		// Uncommenting the following lines will fail to compile,
 		// because 'Drivers' is private in 'Taxi':
@@ -0,0 +1,96 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const char* FileName)
+{
+	Close();
+	HANDLE File = CreateFileA(FileName, GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (File == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER FileSize;
+	if (!GetFileSizeEx(File, &FileSize) || FileSize.QuadPart == 0)
+	{
+		CloseHandle(File);
+		return false;
+	}
+	HANDLE Mapping = CreateFileMappingA(File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!Mapping)
+	{
+		CloseHandle(File);
+		return false;
+	}
+	void* View = MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!View)
+	{
+		CloseHandle(Mapping);
+		CloseHandle(File);
+		return false;
+	}
+	FileHandle = File;
+	MappingHandle = Mapping;
+	Data = static_cast<const char*>(View);
+	Size = static_cast<std::size_t>(FileSize.QuadPart);
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (Data)
+		UnmapViewOfFile(Data);
+	if (MappingHandle)
+		CloseHandle(MappingHandle);
+	if (FileHandle)
+		CloseHandle(FileHandle);
+	Data = nullptr;
+	Size = 0;
+	FileHandle = nullptr;
+	MappingHandle = nullptr;
+}
+
+#else
+
+bool MappedFile::Open(const char* FileName)
+{
+	Close();
+	int Fd = open(FileName, O_RDONLY);
+	if (Fd < 0)
+		return false;
+	struct stat Info;
+	if (fstat(Fd, &Info) != 0 || Info.st_size == 0)
+	{
+		close(Fd);
+		return false;
+	}
+	void* View = mmap(nullptr, static_cast<std::size_t>(Info.st_size), PROT_READ, MAP_PRIVATE, Fd, 0);
+	// the mapping stays valid after the descriptor is closed
+	close(Fd);
+	if (View == MAP_FAILED)
+		return false;
+	madvise(View, static_cast<std::size_t>(Info.st_size), MADV_SEQUENTIAL);
+	Data = static_cast<const char*>(View);
+	Size = static_cast<std::size_t>(Info.st_size);
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (Data)
+		munmap(const_cast<char*>(Data), Size);
+	Data = nullptr;
+	Size = 0;
+}
+
+#endif
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+
+// Read-only memory mapping of a whole file.
+// Uses CreateFileMapping on Windows and mmap everywhere else.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	explicit MappedFile(const char* FileName) { Open(FileName); }
+	~MappedFile() { Close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// Maps the file, returns false if it does not exist or is empty
+	bool Open(const char* FileName);
+	void Close();
+
+	bool IsOpen() const { return Data != nullptr; }
+	const char* GetData() const { return Data; }
+	std::size_t GetSize() const { return Size; }
+
+private:
+	const char* Data = nullptr;
+	std::size_t Size = 0;
+#ifdef _WIN32
+	void* FileHandle = nullptr;
+	void* MappingHandle = nullptr;
+#endif
+};
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "Log.h"
 #include "Taxi.h"
 
 class MiniTaxi : public Taxi
@@ -7,7 +8,7 @@ class MiniTaxi : public Taxi
 public:
 	MiniTaxi() : Taxi()
 	{
-		std::cout << "[LOG] MiniTaxi default constructor.\n";
+		TAXI_LOG(LogLevel::Debug, "MiniTaxi default constructor.");
 	}
 
 	MiniTaxi(const char* InPassenger,
@@ -15,16 +16,24 @@ public:
 		const char (*InAddresses)[MAX_STR_LEN], int InAddressesCount)
 		: Taxi(InPassenger, InDrivers, InDriversCount, InAddresses, InAddressesCount)
 	{
-		std::cout << "[LOG] MiniTaxi param constructor.\n";
+		TAXI_LOG(LogLevel::Debug, "MiniTaxi param constructor.");
 	}
 
 	// override the abstract method from AbstractTaxi
 	void PrintInfo() const override
 	{
-		std::cout << "Mini taxi:\n"
-			<< "Passenger: " << Passenger
-			<< ", Total Taxi objects: " << Count
-			<< std::endl;
+		std::string Info;
+		AppendInfo(Info, GetCount());
+		std::cout << Info << std::flush;
+	}
+
+	void AppendInfo(std::string& Out, int TotalCount) const override
+	{
+		Out += "Mini taxi:\nPassenger: ";
+		Out += Passenger;
+		Out += ", Total Taxi objects: ";
+		Out += std::to_string(TotalCount);
+		Out += '\n';
 	}
 };
 
@@ -0,0 +1,55 @@
+#include "PartitionedFleet.h"
+
+namespace
+{
+	// The report buffer is handed to the stream whenever it grows past this
+	const std::size_t REPORT_BLOCK_SIZE = 1 << 20;
+
+	template <typename T>
+	void AppendInfos(const std::vector<T>& Bucket, int TotalCount, std::string& Buffer, std::ostream& Out)
+	{
+		for (const T& Obj : Bucket)
+		{
+			// qualified, so Taxi::AppendInfo is not looked up in the vtable either
+			Obj.T::AppendInfo(Buffer, TotalCount);
+			if (Buffer.size() >= REPORT_BLOCK_SIZE)
+			{
+				Out.write(Buffer.data(), static_cast<std::streamsize>(Buffer.size()));
+				Buffer.clear();
+			}
+		}
+	}
+}
+
+void PartitionedFleet::Reserve(int TaxiNum, int LuxNum, int MiniNum)
+{
+	Taxis.reserve(TaxiNum);
+	LuxTaxis.reserve(LuxNum);
+	MiniTaxis.reserve(MiniNum);
+}
+
+void PartitionedFleet::Clear()
+{
+	Taxis.clear();
+	LuxTaxis.clear();
+	MiniTaxis.clear();
+}
+
+void PartitionedFleet::PrintInfo(std::ostream& Out) const
+{
+	int TotalCount = AbstractTaxi::GetCount();
+	std::string Buffer;
+	Buffer.reserve(REPORT_BLOCK_SIZE + 256);
+	AppendInfos(Taxis, TotalCount, Buffer, Out);
+	AppendInfos(LuxTaxis, TotalCount, Buffer, Out);
+	AppendInfos(MiniTaxis, TotalCount, Buffer, Out);
+	Out.write(Buffer.data(), static_cast<std::streamsize>(Buffer.size()));
+	Out.flush();
+}
+
+long long PartitionedFleet::CountFreeDrivers() const
+{
+	long long Free = 0;
+	ForEach([&Free](const Taxi& Obj) { Free += Obj.GetFreeDriversCount(); });
+	return Free;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "LuxTaxi.h"
+#include "MiniTaxi.h"
+#include "Taxi.h"
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Mixed Taxi / LuxTaxi / MiniTaxi objects kept by value in one vector per type.
+// Batch operations walk each vector with the concrete type known, so the calls
+// bind statically and can be inlined, instead of one virtual call per object as
+// with an AbstractTaxi* array.
+class PartitionedFleet
+{
+public:
+	void Reserve(int TaxiNum, int LuxNum, int MiniNum);
+
+	Taxi& Add(Taxi&& Obj) { Taxis.push_back(std::move(Obj)); return Taxis.back(); }
+	LuxTaxi& Add(LuxTaxi&& Obj) { LuxTaxis.push_back(std::move(Obj)); return LuxTaxis.back(); }
+	MiniTaxi& Add(MiniTaxi&& Obj) { MiniTaxis.push_back(std::move(Obj)); return MiniTaxis.back(); }
+
+	std::vector<Taxi>& GetTaxis() { return Taxis; }
+	std::vector<LuxTaxi>& GetLuxTaxis() { return LuxTaxis; }
+	std::vector<MiniTaxi>& GetMiniTaxis() { return MiniTaxis; }
+
+	int GetSize() const { return static_cast<int>(Taxis.size() + LuxTaxis.size() + MiniTaxis.size()); }
+	void Clear();
+
+	// Calls Fn(Obj) for every object, one type after the other. Fn is usually a
+	// generic lambda, it is instantiated once per type.
+	template <typename F>
+	void ForEach(F&& Fn) const
+	{
+		for (const Taxi& Obj : Taxis)
+			Fn(Obj);
+		for (const LuxTaxi& Obj : LuxTaxis)
+			Fn(Obj);
+		for (const MiniTaxi& Obj : MiniTaxis)
+			Fn(Obj);
+	}
+
+	// PrintInfo of every object, grouped by type, written to Out in large blocks
+	void PrintInfo(std::ostream& Out) const;
+
+	// Free drivers over the whole fleet
+	long long CountFreeDrivers() const;
+
+private:
+	std::vector<Taxi> Taxis;
+	std::vector<LuxTaxi> LuxTaxis;
+	std::vector<MiniTaxi> MiniTaxis;
+};
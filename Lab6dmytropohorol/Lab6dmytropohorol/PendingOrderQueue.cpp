@@ -0,0 +1,213 @@
+#include "PendingOrderQueue.h"
+
+PendingOrderQueue::PendingOrderQueue(std::vector<Taxi>& Fleet, std::size_t Capacity, OverflowPolicy Policy)
+	: Fleet(Fleet), Slots(Capacity ? Capacity : 1), Policy(Policy)
+{
+	for (std::size_t i = 0; i < Slots.size(); i++)
+		Slots[i].Next = i + 1 < Slots.size() ? static_cast<int>(i + 1) : -1;
+	FreeSlot = 0;
+	IndexTaxis();
+}
+
+void PendingOrderQueue::IndexTaxis()
+{
+	for (auto& Entry : ByAddress)
+		Entry.second.Taxis.clear();
+	for (Taxi& Obj : Fleet)
+		for (int i = 0; i < Obj.GetAddressesCount(); i++)
+		{
+			AddressId Id = Obj.GetAddressId(i);
+			if (Id == INVALID_ADDRESS_ID)
+				continue;
+			std::vector<Taxi*>& Taxis = ByAddress[Id].Taxis;
+			// a taxi listing an address twice is indexed once
+			if (Taxis.empty() || Taxis.back() != &Obj)
+				Taxis.push_back(&Obj);
+		}
+}
+
+void PendingOrderQueue::Reindex()
+{
+	std::lock_guard<std::mutex> Guard(Lock);
+	IndexTaxis();
+}
+
+bool PendingOrderQueue::TryServe(AddressQueue& Queue, AddressId Address)
+{
+	for (Taxi* Obj : Queue.Taxis)
+		if (Obj->GetFreeDriversCount() > 0 && Obj->OrderDriver(AddressPool::Get(Address)) >= 0)
+			return true;
+	return false;
+}
+
+void PendingOrderQueue::Push(AddressQueue& Queue, AddressId Address)
+{
+	int Slot = FreeSlot;
+	FreeSlot = Slots[Slot].Next;
+	Slots[Slot] = PendingOrder{ NextId++, Address, Clock::now(), -1, Newest, -1 };
+	if (Newest >= 0)
+		Slots[Newest].Next = Slot;
+	else
+		Oldest = Slot;
+	Newest = Slot;
+	if (Queue.Tail >= 0)
+		Slots[Queue.Tail].NextSame = Slot;
+	else
+		Queue.Head = Slot;
+	Queue.Tail = Slot;
+	Depth++;
+}
+
+PendingOrderQueue::PendingOrder PendingOrderQueue::PopFront(AddressQueue& Queue)
+{
+	int Slot = Queue.Head;
+	PendingOrder Order = Slots[Slot];
+	Queue.Head = Order.NextSame;
+	if (Queue.Head < 0)
+		Queue.Tail = -1;
+	if (Order.Prev >= 0)
+		Slots[Order.Prev].Next = Order.Next;
+	else
+		Oldest = Order.Next;
+	if (Order.Next >= 0)
+		Slots[Order.Next].Prev = Order.Prev;
+	else
+		Newest = Order.Prev;
+	Slots[Slot].Next = FreeSlot;
+	FreeSlot = Slot;
+	Depth--;
+	return Order;
+}
+
+SubmitResult PendingOrderQueue::Submit(const char* InAddress, std::uint64_t* OrderId)
+{
+	std::unique_lock<std::mutex> Guard(Lock);
+	Stats.Submitted++;
+	AddressId Address = InAddress ? AddressPool::Find(InAddress) : INVALID_ADDRESS_ID;
+	auto Found = ByAddress.find(Address);
+	// an address no taxi has would wait forever
+	if (Found == ByAddress.end() || Found->second.Taxis.empty() || Closed)
+	{
+		Stats.Rejected++;
+		return SubmitResult::Rejected;
+	}
+	// elements of an unordered_map stay where they are, also across a Reindex
+	AddressQueue& Queue = Found->second;
+
+	while (true)
+	{
+		if (TryServe(Queue, Address))
+		{
+			Stats.ServedAtOnce++;
+			return SubmitResult::Served;
+		}
+		if (Depth < Slots.size())
+			break;
+		if (Policy == OverflowPolicy::Reject)
+		{
+			Stats.Rejected++;
+			return SubmitResult::Rejected;
+		}
+		if (Policy == OverflowPolicy::DropOldest)
+		{
+			// the oldest order of all is the first one of its address
+			PendingOrder Dropped = PopFront(ByAddress[Slots[Oldest].Address]);
+			Stats.Dropped++;
+			if (OnDispatch)
+				OnDispatch(Dropped.Id, nullptr, -1);
+			break;
+		}
+		// Block, a release may also have left a driver free for us, so try again
+		Space.wait(Guard, [this] { return Closed || Depth < Slots.size() || Policy != OverflowPolicy::Block; });
+		if (Closed)
+		{
+			Stats.Rejected++;
+			return SubmitResult::Rejected;
+		}
+	}
+
+	if (OrderId)
+		*OrderId = NextId;
+	Push(Queue, Address);
+	Stats.Queued++;
+	if (Depth > Stats.MaxDepth)
+		Stats.MaxDepth = Depth;
+	return SubmitResult::Queued;
+}
+
+bool PendingOrderQueue::DriverReleased(Taxi& Obj, int DriverIndex)
+{
+	std::lock_guard<std::mutex> Guard(Lock);
+	return DriverReleasedLocked(Obj, DriverIndex);
+}
+
+bool PendingOrderQueue::DriverReleasedLocked(Taxi& Obj, int DriverIndex)
+{
+	if (Depth == 0 || Obj.GetDriverState(DriverIndex) != DRIVER_FREE)
+		return false;
+	// the oldest of the first orders of the taxi's addresses
+	AddressQueue* Best = nullptr;
+	for (int i = 0; i < Obj.GetAddressesCount(); i++)
+	{
+		auto Found = ByAddress.find(Obj.GetAddressId(i));
+		if (Found == ByAddress.end() || Found->second.Head < 0)
+			continue;
+		if (!Best || Slots[Found->second.Head].Id < Slots[Best->Head].Id)
+			Best = &Found->second;
+	}
+	if (!Best || !Obj.Order(DriverIndex, AddressPool::Get(Slots[Best->Head].Address)))
+		return false;
+	Dispatch(PopFront(*Best), &Obj, DriverIndex);
+	return true;
+}
+
+void PendingOrderQueue::Dispatch(const PendingOrder& Order, Taxi* Obj, int DriverIndex)
+{
+	double WaitMs = std::chrono::duration<double, std::milli>(Clock::now() - Order.QueuedAt).count();
+	Stats.ServedFromQueue++;
+	Stats.TotalWaitMs += WaitMs;
+	if (WaitMs > Stats.MaxWaitMs)
+		Stats.MaxWaitMs = WaitMs;
+	if (OnDispatch)
+		OnDispatch(Order.Id, Obj, DriverIndex);
+	Space.notify_one();
+}
+
+void PendingOrderQueue::Close()
+{
+	{
+		std::lock_guard<std::mutex> Guard(Lock);
+		Closed = true;
+	}
+	Space.notify_all();
+}
+
+void PendingOrderQueue::SetPolicy(OverflowPolicy NewPolicy)
+{
+	{
+		std::lock_guard<std::mutex> Guard(Lock);
+		Policy = NewPolicy;
+	}
+	// blocked producers apply the new policy
+	Space.notify_all();
+}
+
+void PendingOrderQueue::SetDispatchCallback(std::function<void(std::uint64_t OrderId, Taxi* Obj, int DriverIndex)> Callback)
+{
+	std::lock_guard<std::mutex> Guard(Lock);
+	OnDispatch = std::move(Callback);
+}
+
+PendingOrderStats PendingOrderQueue::GetStats() const
+{
+	std::lock_guard<std::mutex> Guard(Lock);
+	PendingOrderStats Result = Stats;
+	Result.Depth = Depth;
+	return Result;
+}
+
+std::size_t PendingOrderQueue::GetDepth() const
+{
+	std::lock_guard<std::mutex> Guard(Lock);
+	return Depth;
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "AddressPool.h"
+#include "Taxi.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// What Submit does when the queue is full
+enum class OverflowPolicy
+{
+	Reject,     // refuse the new order
+	Block,      // wait until a driver release makes room
+	DropOldest  // drop the order that waited longest and queue the new one
+};
+
+enum class SubmitResult
+{
+	Served,   // a free driver took the order right away
+	Queued,   // waiting for a driver release
+	Rejected  // queue full (Reject), queue closed, or no taxi serves the address
+};
+
+struct PendingOrderStats
+{
+	std::uint64_t Submitted = 0;
+	std::uint64_t ServedAtOnce = 0;
+	std::uint64_t Queued = 0;
+	std::uint64_t ServedFromQueue = 0;
+	std::uint64_t Rejected = 0;
+	std::uint64_t Dropped = 0;
+	std::size_t Depth = 0;
+	std::size_t MaxDepth = 0;
+	// Time spent in the queue by the orders served from it
+	double TotalWaitMs = 0;
+	double MaxWaitMs = 0;
+
+	double AverageWaitMs() const { return ServedFromQueue ? TotalWaitMs / ServedFromQueue : 0; }
+};
+
+// Bounded queue of orders a fleet could not serve yet. Any number of threads may
+// submit orders and report driver releases; a released driver gets the oldest queued
+// order for one of its addresses straight away, so nobody has to retry Order in a loop.
+// The taxis are only read and changed under the queue lock. Whatever else changes them
+// while producers run (e.g. TripScheduler::Advance) must hold GetFleetMutex() and
+// report releases with DriverReleasedLocked.
+// The fleet must not be destroyed or reallocated while the queue is used.
+//
+// The queue keeps Capacity order slots allocated up front and never grows. The taxis
+// are indexed by address when the queue is made, so Submit only looks at the taxis
+// serving the address, and the queued orders are chained per address, so a release
+// only looks at the first order of each address of the taxi. A taxi that gets other
+// addresses later is only found for them after Reindex.
+class PendingOrderQueue
+{
+public:
+	PendingOrderQueue(std::vector<Taxi>& Fleet, std::size_t Capacity, OverflowPolicy Policy = OverflowPolicy::Reject);
+	PendingOrderQueue(const PendingOrderQueue&) = delete;
+	PendingOrderQueue& operator=(const PendingOrderQueue&) = delete;
+
+	// Orders a free driver of any taxi serving InAddress, or queues the order.
+	// OrderId, if given, receives the id passed to the dispatch callback later.
+	SubmitResult Submit(const char* InAddress, std::uint64_t* OrderId = nullptr);
+
+	// A driver of Obj became FREE: hands it the oldest queued order it can serve.
+	// Returns true if it got one.
+	bool DriverReleased(Taxi& Obj, int DriverIndex);
+	// Same, for a caller that already holds GetFleetMutex()
+	bool DriverReleasedLocked(Taxi& Obj, int DriverIndex);
+
+	// Indexes the addresses of the fleet again, after taxis changed them
+	void Reindex();
+
+	// Rejects the orders blocked in Submit and every later one, queued orders stay
+	void Close();
+
+	void SetPolicy(OverflowPolicy NewPolicy);
+	// Called for every queued order that got a driver, Obj is nullptr when the order
+	// was dropped instead. Runs under the queue lock, so it must not call back into it.
+	void SetDispatchCallback(std::function<void(std::uint64_t OrderId, Taxi* Obj, int DriverIndex)> Callback);
+
+	PendingOrderStats GetStats() const;
+	std::size_t GetDepth() const;
+	std::mutex& GetFleetMutex() { return Lock; }
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	// Slot of a queued order, or of the free list
+	struct PendingOrder
+	{
+		std::uint64_t Id;
+		AddressId Address;
+		Clock::time_point QueuedAt;
+		// Next order for the same address
+		int NextSame;
+		// Neighbours in arrival order over all addresses, Next also links the free list
+		int Prev;
+		int Next;
+	};
+
+	struct AddressQueue
+	{
+		// Taxis that had the address at the last Reindex
+		std::vector<Taxi*> Taxis;
+		// Oldest and newest queued order for the address, -1 when there is none
+		int Head = -1;
+		int Tail = -1;
+	};
+
+	// Free driver of a taxi serving Address, under the lock
+	bool TryServe(AddressQueue& Queue, AddressId Address);
+	void Push(AddressQueue& Queue, AddressId Address);
+	// Takes the first order of an address off its chain and the arrival list
+	PendingOrder PopFront(AddressQueue& Queue);
+	void Dispatch(const PendingOrder& Order, Taxi* Obj, int DriverIndex);
+	void IndexTaxis();
+
+	std::vector<Taxi>& Fleet;
+	std::unordered_map<AddressId, AddressQueue> ByAddress;
+	std::vector<PendingOrder> Slots;
+	// Arrival order of the queued orders, and the unused slots
+	int Oldest = -1;
+	int Newest = -1;
+	int FreeSlot = -1;
+	std::size_t Depth = 0;
+	OverflowPolicy Policy;
+	bool Closed = false;
+	std::uint64_t NextId = 1;
+	PendingOrderStats Stats;
+	std::function<void(std::uint64_t, Taxi*, int)> OnDispatch;
+
+	mutable std::mutex Lock;
+	std::condition_variable Space;
+};
@@ -0,0 +1,315 @@
+#include "ShardRouter.h"
+#include "DispatchServer.h"
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+#ifdef __linux__
+#define TAXI_SHARD_WORKERS 1
+#include <csignal>
+#include <cerrno>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	std::uint32_t MixBits(std::uint32_t Value)
+	{
+		Value ^= Value >> 16;
+		Value *= 0x85ebca6bu;
+		Value ^= Value >> 13;
+		Value *= 0xc2b2ae35u;
+		Value ^= Value >> 16;
+		return Value;
+	}
+
+	// FNV-1a
+	std::uint32_t HashString(const char* Str)
+	{
+		std::uint32_t Hash = 2166136261u;
+		for (; *Str; Str++)
+			Hash = (Hash ^ static_cast<unsigned char>(*Str)) * 16777619u;
+		return Hash;
+	}
+
+	DispatchResponse MakeResponse(DispatchStatus Status, std::int32_t Value)
+	{
+		DispatchResponse Response = { 0, 0, static_cast<std::uint8_t>(Status), Value };
+		return Response;
+	}
+}
+
+int ShardOf(const Taxi& Obj, ShardKey Key, int ShardCount)
+{
+	if (ShardCount <= 1)
+		return 0;
+	std::uint32_t Hash = Key == ShardKey::AddressRegion && Obj.GetAddressesCount() > 0
+		? MixBits(HashString(Obj.GetAddress(0)))
+		: MixBits(static_cast<std::uint32_t>(Obj.GetObjectNumber()));
+	return static_cast<int>(Hash % static_cast<std::uint32_t>(ShardCount));
+}
+
+std::vector<std::vector<Taxi>> SplitFleet(std::vector<Taxi>& Fleet, int ShardCount, ShardKey Key,
+	std::vector<ShardLocation>& Directory)
+{
+	if (ShardCount < 1)
+		ShardCount = 1;
+	std::vector<std::vector<Taxi>> Shards(ShardCount);
+	Directory.clear();
+	Directory.reserve(Fleet.size());
+	for (const Taxi& Obj : Fleet)
+	{
+		int Shard = ShardOf(Obj, Key, ShardCount);
+		Directory.push_back({ static_cast<std::uint32_t>(Shard), 0 });
+	}
+	std::vector<std::size_t> Sizes(ShardCount, 0);
+	for (ShardLocation& Location : Directory)
+		Location.TaxiIndex = static_cast<std::uint32_t>(Sizes[Location.Shard]++);
+	for (int i = 0; i < ShardCount; i++)
+		Shards[i].reserve(Sizes[i]);
+	for (std::size_t i = 0; i < Fleet.size(); i++)
+		Shards[Directory[i].Shard].push_back(std::move(Fleet[i]));
+	Fleet.clear();
+	return Shards;
+}
+
+#ifdef TAXI_SHARD_WORKERS
+
+bool ShardWorkers::Start(std::vector<std::vector<Taxi>>& Shards, const std::string& SocketPrefix)
+{
+	Stop();
+	pid_t Parent = getpid();
+	for (std::size_t i = 0; i < Shards.size(); i++)
+	{
+		std::string Path = SocketPrefix + "." + std::to_string(i);
+		// the child says through the pipe whether it listens
+		int Ready[2];
+		if (pipe(Ready) != 0)
+		{
+			std::cerr << "Failed to start shard " << i << ": " << std::strerror(errno) << "\n";
+			Stop();
+			return false;
+		}
+		pid_t Pid = fork();
+		if (Pid < 0)
+		{
+			std::cerr << "Failed to start shard " << i << ": " << std::strerror(errno) << "\n";
+			close(Ready[0]);
+			close(Ready[1]);
+			Stop();
+			return false;
+		}
+		if (Pid == 0)
+		{
+			close(Ready[0]);
+			// do not outlive the parent
+			prctl(PR_SET_PDEATHSIG, SIGTERM);
+			if (getppid() != Parent)
+				_exit(1);
+			DispatchServer Server(Shards[i]);
+			char Listening = Server.ListenUnix(Path.c_str()) ? 1 : 0;
+			ssize_t Written = write(Ready[1], &Listening, 1);
+			close(Ready[1]);
+			// runs until Stop sends SIGTERM; _exit skips the parent's atexit handlers and destructors
+			_exit(Listening && Written == 1 && Server.Run() ? 0 : 1);
+		}
+		close(Ready[1]);
+		Pids.push_back(Pid);
+		Paths.push_back(Path);
+		char Listening = 0;
+		ssize_t Read;
+		do
+			Read = read(Ready[0], &Listening, 1);
+		while (Read < 0 && errno == EINTR);
+		close(Ready[0]);
+		if (Read != 1 || !Listening)
+		{
+			std::cerr << "Failed to start shard " << i << " on " << Path << "\n";
+			Stop();
+			return false;
+		}
+	}
+	return true;
+}
+
+void ShardWorkers::Stop()
+{
+	for (int Pid : Pids)
+		kill(Pid, SIGTERM);
+	for (int Pid : Pids)
+		while (waitpid(Pid, nullptr, 0) < 0 && errno == EINTR)
+			;
+	for (const std::string& Path : Paths)
+		unlink(Path.c_str());
+	Pids.clear();
+	Paths.clear();
+}
+
+#else
+
+bool ShardWorkers::Start(std::vector<std::vector<Taxi>>&, const std::string&)
+{
+	std::cerr << "Failed to start shards: shard workers need Linux\n";
+	return false;
+}
+
+void ShardWorkers::Stop()
+{
+}
+
+#endif
+
+ShardRouter::ShardRouter(std::shared_ptr<const std::vector<ShardLocation>> Directory)
+	: Directory(std::move(Directory))
+{
+}
+
+bool ShardRouter::Connect(const std::vector<std::string>& ShardPaths)
+{
+	Close();
+	for (const std::string& Path : ShardPaths)
+	{
+		Shards.push_back(std::make_unique<DispatchClient>());
+		if (!Shards.back()->ConnectUnix(Path.c_str()))
+		{
+			Close();
+			return false;
+		}
+	}
+	Queued.assign(Shards.size(), 0);
+	return true;
+}
+
+void ShardRouter::Close()
+{
+	Shards.clear();
+	Queued.clear();
+	Requests.clear();
+}
+
+void ShardRouter::Add(DispatchOp Op, std::uint32_t TaxiIndex, std::int32_t Index, const char* Address)
+{
+	std::uint32_t Tag = static_cast<std::uint32_t>(Requests.size());
+	Pending Request = { Route::Local, MakeResponse(DispatchStatus::Ok, 0), 0 };
+	if (Op == DispatchOp::FleetSize)
+	{
+		Request.Local.Value = static_cast<std::int32_t>(Directory->size());
+	}
+	else if (Op == DispatchOp::FleetFreeCount)
+	{
+		Request.Via = Route::AllShards;
+		for (std::size_t i = 0; i < Shards.size(); i++)
+		{
+			Shards[i]->Add(Op, 0, 0, nullptr, Tag);
+			Queued[i]++;
+		}
+	}
+	else if (TaxiIndex < Directory->size() && (*Directory)[TaxiIndex].Shard < Shards.size())
+	{
+		const ShardLocation& Location = (*Directory)[TaxiIndex];
+		Request.Via = Route::Shard;
+		Shards[Location.Shard]->Add(Op, Location.TaxiIndex, Index, Address, Tag);
+		Queued[Location.Shard]++;
+	}
+	else
+	{
+		Request.Local.Status = static_cast<std::uint8_t>(DispatchStatus::BadRequest);
+	}
+	Request.Local.Tag = Tag;
+	Requests.push_back(Request);
+}
+
+bool ShardRouter::Execute(std::vector<DispatchResponse>& Responses, std::vector<std::string>* Payloads)
+{
+	Responses.resize(Requests.size());
+	if (Payloads)
+		Payloads->assign(Requests.size(), std::string());
+	for (std::size_t i = 0; i < Requests.size(); i++)
+		Responses[i] = Requests[i].Local;
+
+	// scatter: every shard gets its whole batch before any answer is read
+	bool Ok = true;
+	for (std::size_t i = 0; i < Shards.size() && Ok; i++)
+		if (Queued[i])
+			Ok = Shards[i]->Send();
+	// gather: each shard answers in order, the tags put the answers back in place
+	for (std::size_t i = 0; i < Shards.size() && Ok; i++)
+	{
+		for (; Queued[i] && Ok; Queued[i]--)
+		{
+			DispatchResponse Response;
+			std::string Payload;
+			Ok = Shards[i]->Receive(Response, Payloads ? &Payload : nullptr) && Response.Tag < Requests.size();
+			if (!Ok)
+				break;
+			Pending& Request = Requests[Response.Tag];
+			DispatchResponse& Out = Responses[Response.Tag];
+			if (Request.Via == Route::AllShards)
+			{
+				Request.Sum += Response.Value;
+				if (Response.Status != static_cast<std::uint8_t>(DispatchStatus::Ok))
+					Out.Status = Response.Status;
+				Out.Value = static_cast<std::int32_t>(Request.Sum < 0x7fffffffLL ? Request.Sum : 0x7fffffffLL);
+			}
+			else
+			{
+				Out = Response;
+				if (Payloads)
+					(*Payloads)[Response.Tag] = std::move(Payload);
+			}
+		}
+	}
+	Requests.clear();
+	if (!Ok)
+	{
+		// the shard connections are out of step now
+		std::cerr << "Failed to route a batch to the shards\n";
+		Close();
+	}
+	return Ok;
+}
+
+bool ShardRouter::Call(DispatchOp Op, std::uint32_t TaxiIndex, std::int32_t Index, const char* Address,
+	DispatchResponse& Response, std::string* Payload)
+{
+	// a Call never mixes with queued requests
+	if (!Requests.empty())
+		return false;
+	Add(Op, TaxiIndex, Index, Address);
+	std::vector<DispatchResponse> Responses;
+	std::vector<std::string> Payloads;
+	if (!Execute(Responses, Payload ? &Payloads : nullptr))
+		return false;
+	Response = Responses[0];
+	if (Payload)
+		*Payload = std::move(Payloads[0]);
+	return true;
+}
+
+bool ShardRouter::GetFleetFreeCount(long long& Free)
+{
+	if (!Requests.empty() || Shards.empty())
+		return false;
+	// same scatter-gather as Execute, but summed without the 32 bit cap of a response
+	bool Ok = true;
+	for (std::size_t i = 0; i < Shards.size() && Ok; i++)
+	{
+		Shards[i]->Add(DispatchOp::FleetFreeCount, 0);
+		Ok = Shards[i]->Send();
+	}
+	Free = 0;
+	for (std::size_t i = 0; i < Shards.size() && Ok; i++)
+	{
+		DispatchResponse Response = {};
+		Ok = Shards[i]->Receive(Response) && Response.Status == static_cast<std::uint8_t>(DispatchStatus::Ok);
+		Free += Response.Value;
+	}
+	if (!Ok)
+	{
+		std::cerr << "Failed to gather the free count of the shards\n";
+		Close();
+	}
+	return Ok;
+}
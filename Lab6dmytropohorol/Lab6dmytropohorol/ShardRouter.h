@@ -0,0 +1,105 @@
+#pragma once
+
+#include "DispatchClient.h"
+#include "Taxi.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Horizontal sharding of a fleet: SplitFleet hash-partitions the taxis into shard fleets,
+// ShardWorkers serves every shard from its own DispatchServer process over a Unix socket
+// and ShardRouter sends each request to the shard that owns its taxi. Callers keep using
+// the fleet-wide taxi indexes; the router translates them with the directory SplitFleet
+// built. Fleet-wide queries are scattered to every shard and the answers summed up.
+
+enum class ShardKey
+{
+	// Spreads the taxis evenly
+	ObjectNumber,
+	// Keeps taxis with the same first address (their home region) on one shard
+	AddressRegion
+};
+
+// Where a taxi of the whole fleet ended up
+struct ShardLocation
+{
+	std::uint32_t Shard;
+	std::uint32_t TaxiIndex;
+};
+
+int ShardOf(const Taxi& Obj, ShardKey Key, int ShardCount);
+
+// Moves the taxis of Fleet into ShardCount fleets, Fleet is left empty.
+// Directory[i] tells where the i-th taxi of Fleet went.
+std::vector<std::vector<Taxi>> SplitFleet(std::vector<Taxi>& Fleet, int ShardCount, ShardKey Key,
+	std::vector<ShardLocation>& Directory);
+
+// One DispatchServer child process per shard, listening on "<SocketPrefix>.<shard>".
+// Linux only (fork); elsewhere Start reports an error and returns false.
+class ShardWorkers
+{
+public:
+	ShardWorkers() = default;
+	~ShardWorkers() { Stop(); }
+	ShardWorkers(const ShardWorkers&) = delete;
+	ShardWorkers& operator=(const ShardWorkers&) = delete;
+
+	// Returns once every worker listens; the shard fleets are handed over to the children
+	// and may be dropped afterwards
+	bool Start(std::vector<std::vector<Taxi>>& Shards, const std::string& SocketPrefix);
+	// Ends the workers and removes their sockets
+	void Stop();
+
+	int GetShardCount() const { return static_cast<int>(Paths.size()); }
+	const std::vector<std::string>& GetPaths() const { return Paths; }
+
+private:
+	std::vector<int> Pids;
+	std::vector<std::string> Paths;
+};
+
+// Client side router. Holds one pipelined connection per shard and is not thread safe,
+// give every thread its own router over the same directory.
+class ShardRouter
+{
+public:
+	explicit ShardRouter(std::shared_ptr<const std::vector<ShardLocation>> Directory);
+
+	bool Connect(const std::vector<std::string>& ShardPaths);
+	void Close();
+	int GetShardCount() const { return static_cast<int>(Shards.size()); }
+
+	// Queues a request with a fleet-wide taxi index. FleetSize is answered by the router,
+	// FleetFreeCount goes to every shard, everything else to the shard of the taxi.
+	void Add(DispatchOp Op, std::uint32_t TaxiIndex, std::int32_t Index = 0, const char* Address = nullptr);
+	// Sends the queued requests with one write per shard, then gathers the answers in the
+	// order the requests were added. Payloads (GetAddress) go to Payloads when given.
+	// Answers wait in the shards' buffers meanwhile, so keep batches well under a megabyte.
+	// Every shard with requests costs a message and a wake-up, so a batch should hold a few
+	// dozen requests per shard rather than a few dozen in all.
+	bool Execute(std::vector<DispatchResponse>& Responses, std::vector<std::string>* Payloads = nullptr);
+	// Add + Execute for a single request
+	bool Call(DispatchOp Op, std::uint32_t TaxiIndex, std::int32_t Index, const char* Address,
+		DispatchResponse& Response, std::string* Payload = nullptr);
+
+	// Free drivers of the whole fleet, one scatter-gather round
+	bool GetFleetFreeCount(long long& Free);
+
+private:
+	// Where the answer of a queued request comes from
+	enum class Route : std::uint8_t { Local, Shard, AllShards };
+
+	struct Pending
+	{
+		Route Via;
+		DispatchResponse Local;
+		long long Sum;
+	};
+
+	std::shared_ptr<const std::vector<ShardLocation>> Directory;
+	std::vector<std::unique_ptr<DispatchClient>> Shards;
+	// Requests queued on each shard since the last Execute
+	std::vector<std::uint32_t> Queued;
+	std::vector<Pending> Requests;
+};
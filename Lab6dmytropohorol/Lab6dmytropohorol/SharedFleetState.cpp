@@ -0,0 +1,422 @@
+#include "SharedFleetState.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free && std::atomic<std::uint32_t>::is_always_lock_free,
+	"shared memory slots must not need a lock");
+
+namespace
+{
+	std::size_t AlignUp(std::size_t Value)
+	{
+		return (Value + 63) & ~std::size_t(63);
+	}
+
+	std::atomic<std::uint64_t>* Words(char* Base, std::uint64_t Offset)
+	{
+		return reinterpret_cast<std::atomic<std::uint64_t>*>(Base + Offset);
+	}
+
+	// Writer half of the seqlock: odd while the taxi changes
+	void BeginWrite(SharedTaxiEntry& Entry)
+	{
+		Entry.Sequence.store(Entry.Sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+	}
+
+	void EndWrite(SharedTaxiEntry& Entry)
+	{
+		Entry.Sequence.store(Entry.Sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	// Reader half: runs Read until no write overlapped it
+	template <typename Function>
+	auto ReadConsistent(const SharedTaxiEntry& Entry, std::atomic<std::uint64_t>& Retries, Function Read)
+	{
+		for (int Attempt = 0; ; Attempt++)
+		{
+			std::uint32_t Before = Entry.Sequence.load(std::memory_order_acquire);
+			if (!(Before & 1))
+			{
+				auto Result = Read();
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (Entry.Sequence.load(std::memory_order_relaxed) == Before)
+					return Result;
+			}
+			Retries.fetch_add(1, std::memory_order_relaxed);
+			// the writer may have been preempted in the middle of a change
+			if (Attempt > 64)
+				std::this_thread::yield();
+		}
+	}
+}
+
+#ifdef _WIN32
+
+bool SharedFleetState::Create(const char*, std::vector<Taxi>&, double)
+{
+	std::cerr << "Failed to create shared fleet state: POSIX shared memory is not available\n";
+	return false;
+}
+
+bool SharedFleetState::Build()
+{
+	return false;
+}
+
+void SharedFleetState::Unmap()
+{
+}
+
+bool SharedFleetReader::Open(const char*)
+{
+	std::cerr << "Failed to open shared fleet state: POSIX shared memory is not available\n";
+	return false;
+}
+
+void SharedFleetReader::Close()
+{
+}
+
+#else
+
+bool SharedFleetState::Create(const char* InName, std::vector<Taxi>& InFleet, double InSpare)
+{
+	Close();
+	Name = InName;
+	Fleet = &InFleet;
+	Spare = InSpare > 0 ? InSpare : 0;
+	if (!Build())
+	{
+		Fleet = nullptr;
+		return false;
+	}
+	return true;
+}
+
+void SharedFleetState::Unmap()
+{
+	if (!Base)
+		return;
+	reinterpret_cast<SharedFleetHeader*>(Base)->Stale.store(1, std::memory_order_release);
+	munmap(Base, Size);
+	Base = nullptr;
+	Size = 0;
+}
+
+bool SharedFleetState::Build()
+{
+	const std::vector<Taxi>& Taxis = *Fleet;
+	std::size_t TableBytes = AlignUp(sizeof(SharedFleetHeader)) + Taxis.size() * sizeof(SharedTaxiEntry);
+	std::vector<std::uint32_t> DriverCapacity(Taxis.size()), AddressCapacity(Taxis.size());
+	std::size_t Total = TableBytes;
+	for (std::size_t i = 0; i < Taxis.size(); i++)
+	{
+		int Drivers = Taxis[i].GetDriversCount();
+		int Addresses = Taxis[i].GetAddressesCount();
+		// whole words, at least one more word than needed
+		int Room = std::max(static_cast<int>(Drivers * (1 + Spare)), Drivers + DRIVERS_PER_WORD);
+		DriverCapacity[i] = static_cast<std::uint32_t>((Room + DRIVERS_PER_WORD - 1) / DRIVERS_PER_WORD * DRIVERS_PER_WORD);
+		AddressCapacity[i] = static_cast<std::uint32_t>(std::max(static_cast<int>(Addresses * (1 + Spare)), Addresses + 2));
+		Total += DriverCapacity[i] / DRIVERS_PER_WORD * sizeof(std::uint64_t)
+			+ AddressCapacity[i] * SHARED_ADDRESS_WORDS * sizeof(std::uint64_t);
+	}
+
+	// readers that still map the old segment see it stale and open the new one
+	Unmap();
+	shm_unlink(Name.c_str());
+	int Fd = shm_open(Name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+	if (Fd < 0 || ftruncate(Fd, static_cast<off_t>(Total)) != 0)
+	{
+		std::cerr << "Failed to create shared memory " << Name << "\n";
+		if (Fd >= 0)
+		{
+			close(Fd);
+			shm_unlink(Name.c_str());
+		}
+		return false;
+	}
+	void* View = mmap(nullptr, Total, PROT_READ | PROT_WRITE, MAP_SHARED, Fd, 0);
+	close(Fd);
+	if (View == MAP_FAILED)
+	{
+		std::cerr << "Failed to map shared memory " << Name << "\n";
+		shm_unlink(Name.c_str());
+		return false;
+	}
+	Base = static_cast<char*>(View);
+	Size = Total;
+
+	// the new segment is zero filled, construct the atomics in it
+	SharedFleetHeader* Header = new (Base) SharedFleetHeader{};
+	std::memcpy(Header->Magic, SHARED_FLEET_MAGIC, sizeof(Header->Magic));
+	Header->Version = SHARED_FLEET_VERSION;
+	Header->HeaderSize = static_cast<std::uint16_t>(AlignUp(sizeof(SharedFleetHeader)));
+	Header->TaxiCount = static_cast<std::uint32_t>(Taxis.size());
+	Header->EntrySize = sizeof(SharedTaxiEntry);
+	Header->TotalBytes = Total;
+	std::uint64_t Offset = TableBytes;
+	for (std::size_t i = 0; i < Taxis.size(); i++)
+	{
+		SharedTaxiEntry* Entry = new (Base + Header->HeaderSize + i * sizeof(SharedTaxiEntry)) SharedTaxiEntry{};
+		Entry->DriverCapacity = DriverCapacity[i];
+		Entry->AddressCapacity = AddressCapacity[i];
+		Entry->DriversOffset = Offset;
+		for (std::uint32_t w = 0; w < DriverCapacity[i] / DRIVERS_PER_WORD; w++)
+			new (Base + Offset + w * sizeof(std::uint64_t)) std::atomic<std::uint64_t>(0);
+		Offset += DriverCapacity[i] / DRIVERS_PER_WORD * sizeof(std::uint64_t);
+		Entry->AddressesOffset = Offset;
+		for (std::uint32_t w = 0; w < AddressCapacity[i] * SHARED_ADDRESS_WORDS; w++)
+			new (Base + Offset + w * sizeof(std::uint64_t)) std::atomic<std::uint64_t>(0);
+		Offset += AddressCapacity[i] * SHARED_ADDRESS_WORDS * sizeof(std::uint64_t);
+	}
+	Rebuilds++;
+
+	for (std::size_t i = 0; i < Fleet->size(); i++)
+	{
+		Taxi& Obj = (*Fleet)[i];
+		Obj.AttachListener(this, static_cast<std::uint32_t>(i));
+		TaxiChanged(static_cast<std::uint32_t>(i), Obj);
+	}
+	return true;
+}
+
+bool SharedFleetReader::Open(const char* Name)
+{
+	Close();
+	int Fd = shm_open(Name, O_RDONLY, 0);
+	if (Fd < 0)
+	{
+		std::cerr << "Failed to open shared memory " << Name << "\n";
+		return false;
+	}
+	struct stat Info;
+	void* View = MAP_FAILED;
+	if (fstat(Fd, &Info) == 0 && static_cast<std::size_t>(Info.st_size) >= sizeof(SharedFleetHeader))
+		View = mmap(nullptr, static_cast<std::size_t>(Info.st_size), PROT_READ, MAP_SHARED, Fd, 0);
+	close(Fd);
+	if (View == MAP_FAILED)
+	{
+		std::cerr << "Failed to map shared memory " << Name << "\n";
+		return false;
+	}
+	Base = static_cast<char*>(View);
+	Size = static_cast<std::size_t>(Info.st_size);
+	const SharedFleetHeader* Candidate = reinterpret_cast<const SharedFleetHeader*>(Base);
+	if (std::memcmp(Candidate->Magic, SHARED_FLEET_MAGIC, sizeof(Candidate->Magic)) != 0
+		|| Candidate->Version > SHARED_FLEET_VERSION || Candidate->EntrySize != sizeof(SharedTaxiEntry)
+		|| Candidate->TotalBytes > Size
+		|| Candidate->HeaderSize + static_cast<std::uint64_t>(Candidate->TaxiCount) * sizeof(SharedTaxiEntry) > Size)
+	{
+		std::cerr << "Not a shared fleet segment: " << Name << "\n";
+		Close();
+		return false;
+	}
+	Header = Candidate;
+	return true;
+}
+
+void SharedFleetReader::Close()
+{
+	if (Base)
+		munmap(Base, Size);
+	Base = nullptr;
+	Size = 0;
+	Header = nullptr;
+}
+
+#endif
+
+void SharedFleetState::Close()
+{
+	// a failed Rebuild leaves no segment, but the taxis are still attached
+	if (!Fleet)
+		return;
+	Unmap();
+#ifndef _WIN32
+	shm_unlink(Name.c_str());
+#endif
+	for (Taxi& Obj : *Fleet)
+		Obj.DetachListener(this);
+	Fleet = nullptr;
+}
+
+bool SharedFleetState::Rebuild()
+{
+	return Fleet && Build();
+}
+
+void SharedFleetState::Track(int FleetIndex)
+{
+	if (Fleet && FleetIndex >= 0 && FleetIndex < static_cast<int>(Fleet->size()))
+		Rebuild();
+}
+
+void SharedFleetState::WriteAddress(const SharedTaxiEntry& Entry, int Index, const char* Address)
+{
+	std::uint64_t Slot[SHARED_ADDRESS_WORDS] = {};
+	if (Address)
+		std::memcpy(Slot, Address, std::min(std::strlen(Address), static_cast<std::size_t>(MAX_STR_LEN - 1)));
+	std::atomic<std::uint64_t>* Target = Words(Base, Entry.AddressesOffset) + static_cast<std::size_t>(Index) * SHARED_ADDRESS_WORDS;
+	for (int w = 0; w < SHARED_ADDRESS_WORDS; w++)
+		Target[w].store(Slot[w], std::memory_order_relaxed);
+}
+
+void SharedFleetState::DriverChanged(std::uint32_t Key, const Taxi& Obj, int Index, int, int State)
+{
+	SharedFleetHeader* Header = reinterpret_cast<SharedFleetHeader*>(Base);
+	if (!Base || Key >= Header->TaxiCount)
+		return;
+	SharedTaxiEntry& Entry = reinterpret_cast<SharedTaxiEntry*>(Base + Header->HeaderSize)[Key];
+	std::atomic<std::uint64_t>& Word = Words(Base, Entry.DriversOffset)[Index / DRIVERS_PER_WORD];
+	int Shift = Index % DRIVERS_PER_WORD * DRIVER_STATE_BITS;
+	BeginWrite(Entry);
+	// only this process writes, so a plain load and store is enough
+	std::uint64_t Value = Word.load(std::memory_order_relaxed);
+	Word.store((Value & ~(std::uint64_t(0xF) << Shift)) | (static_cast<std::uint64_t>(State) << Shift), std::memory_order_relaxed);
+	Entry.FreeCount.store(Obj.GetFreeDriversCount(), std::memory_order_relaxed);
+	EndWrite(Entry);
+}
+
+void SharedFleetState::AddressChanged(std::uint32_t Key, const Taxi& Obj, int Index)
+{
+	SharedFleetHeader* Header = reinterpret_cast<SharedFleetHeader*>(Base);
+	if (!Base || Key >= Header->TaxiCount)
+		return;
+	SharedTaxiEntry& Entry = reinterpret_cast<SharedTaxiEntry*>(Base + Header->HeaderSize)[Key];
+	BeginWrite(Entry);
+	WriteAddress(Entry, Index, Obj.GetAddress(Index));
+	EndWrite(Entry);
+}
+
+void SharedFleetState::TaxiChanged(std::uint32_t Key, const Taxi& Obj)
+{
+	SharedFleetHeader* Header = reinterpret_cast<SharedFleetHeader*>(Base);
+	if (!Base)
+		return;
+	if (Key >= Header->TaxiCount)
+	{
+		Rebuild();
+		return;
+	}
+	SharedTaxiEntry& Entry = reinterpret_cast<SharedTaxiEntry*>(Base + Header->HeaderSize)[Key];
+	int Drivers = Obj.GetDriversCount();
+	int Addresses = Obj.GetAddressesCount();
+	if (static_cast<std::uint32_t>(Drivers) > Entry.DriverCapacity || static_cast<std::uint32_t>(Addresses) > Entry.AddressCapacity)
+	{
+		Rebuild();
+		return;
+	}
+
+	BeginWrite(Entry);
+	std::atomic<std::uint64_t>* DriverWords = Words(Base, Entry.DriversOffset);
+	for (std::uint32_t w = 0; w < Entry.DriverCapacity / DRIVERS_PER_WORD; w++)
+	{
+		std::uint64_t Value = 0;
+		for (int i = 0; i < DRIVERS_PER_WORD && static_cast<int>(w) * DRIVERS_PER_WORD + i < Drivers; i++)
+			Value |= static_cast<std::uint64_t>(Obj.GetDriverState(static_cast<int>(w) * DRIVERS_PER_WORD + i)) << (i * DRIVER_STATE_BITS);
+		DriverWords[w].store(Value, std::memory_order_relaxed);
+	}
+	for (int i = 0; i < Addresses; i++)
+		WriteAddress(Entry, i, Obj.GetAddress(i));
+	Entry.DriversCount.store(Drivers, std::memory_order_relaxed);
+	Entry.AddressesCount.store(Addresses, std::memory_order_relaxed);
+	Entry.FreeCount.store(Obj.GetFreeDriversCount(), std::memory_order_relaxed);
+	EndWrite(Entry);
+}
+
+bool SharedFleetReader::IsStale() const
+{
+	return !Header || Header->Stale.load(std::memory_order_acquire) != 0;
+}
+
+const SharedTaxiEntry* SharedFleetReader::Entry(int TaxiIndex) const
+{
+	if (!Header || TaxiIndex < 0 || static_cast<std::uint32_t>(TaxiIndex) >= Header->TaxiCount)
+		return nullptr;
+	return reinterpret_cast<const SharedTaxiEntry*>(Base + Header->HeaderSize) + TaxiIndex;
+}
+
+int SharedFleetReader::GetFreeCount(int TaxiIndex) const
+{
+	const SharedTaxiEntry* Taxi = Entry(TaxiIndex);
+	return Taxi ? Taxi->FreeCount.load(std::memory_order_acquire) : -1;
+}
+
+int SharedFleetReader::GetDriversCount(int TaxiIndex) const
+{
+	const SharedTaxiEntry* Taxi = Entry(TaxiIndex);
+	return Taxi ? Taxi->DriversCount.load(std::memory_order_acquire) : -1;
+}
+
+long long SharedFleetReader::GetFleetFreeCount() const
+{
+	long long Total = 0;
+	for (int i = 0; i < GetTaxiCount(); i++)
+		Total += GetFreeCount(i);
+	return Total;
+}
+
+int SharedFleetReader::GetDriverState(int TaxiIndex, int DriverIndex) const
+{
+	const SharedTaxiEntry* Taxi = Entry(TaxiIndex);
+	if (!Taxi || DriverIndex < 0 || static_cast<std::uint32_t>(DriverIndex) >= Taxi->DriverCapacity)
+		return -1;
+	const std::atomic<std::uint64_t>& Word = Words(Base, Taxi->DriversOffset)[DriverIndex / DRIVERS_PER_WORD];
+	return ReadConsistent(*Taxi, Retries, [&]
+	{
+		if (DriverIndex >= Taxi->DriversCount.load(std::memory_order_relaxed))
+			return -1;
+		return static_cast<int>((Word.load(std::memory_order_relaxed) >> (DriverIndex % DRIVERS_PER_WORD * DRIVER_STATE_BITS)) & 0xF);
+	});
+}
+
+bool SharedFleetReader::ReadDriverStates(int TaxiIndex, std::vector<std::uint8_t>& States) const
+{
+	const SharedTaxiEntry* Taxi = Entry(TaxiIndex);
+	if (!Taxi)
+		return false;
+	const std::atomic<std::uint64_t>* DriverWords = Words(Base, Taxi->DriversOffset);
+	States.reserve(Taxi->DriverCapacity);
+	return ReadConsistent(*Taxi, Retries, [&]
+	{
+		std::uint32_t Count = std::min(static_cast<std::uint32_t>(Taxi->DriversCount.load(std::memory_order_relaxed)), Taxi->DriverCapacity);
+		States.resize(Count);
+		for (std::uint32_t w = 0; w * DRIVERS_PER_WORD < Count; w++)
+		{
+			std::uint64_t Value = DriverWords[w].load(std::memory_order_relaxed);
+			for (std::uint32_t i = w * DRIVERS_PER_WORD; i < Count && i < (w + 1) * DRIVERS_PER_WORD; i++, Value >>= DRIVER_STATE_BITS)
+				States[i] = static_cast<std::uint8_t>(Value & 0xF);
+		}
+		return true;
+	});
+}
+
+bool SharedFleetReader::ReadAddress(int TaxiIndex, int AddressIndex, char* Out) const
+{
+	const SharedTaxiEntry* Taxi = Entry(TaxiIndex);
+	if (!Taxi || AddressIndex < 0 || static_cast<std::uint32_t>(AddressIndex) >= Taxi->AddressCapacity)
+		return false;
+	const std::atomic<std::uint64_t>* Slot = Words(Base, Taxi->AddressesOffset) + static_cast<std::size_t>(AddressIndex) * SHARED_ADDRESS_WORDS;
+	return ReadConsistent(*Taxi, Retries, [&]
+	{
+		if (AddressIndex >= Taxi->AddressesCount.load(std::memory_order_relaxed))
+			return false;
+		std::uint64_t Copy[SHARED_ADDRESS_WORDS];
+		for (int w = 0; w < SHARED_ADDRESS_WORDS; w++)
+			Copy[w] = Slot[w].load(std::memory_order_relaxed);
+		std::memcpy(Out, Copy, MAX_STR_LEN);
+		Out[MAX_STR_LEN - 1] = '\0';
+		return true;
+	});
+}
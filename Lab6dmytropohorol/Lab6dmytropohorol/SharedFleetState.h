@@ -0,0 +1,135 @@
+#pragma once
+
+#include "Taxi.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Live driver states and addresses of a fleet in a POSIX shared memory segment, written
+// by one process (SharedFleetState) and read by any number of others (SharedFleetReader).
+// Every taxi has its own entry with a sequence counter (a seqlock): the writer makes it
+// odd, changes the taxi's words and makes it even again; readers read the counter, the
+// words and the counter again and retry if it changed. Reading takes no lock and no
+// system call, and the writer never waits for readers.
+// Every slot is a lock-free std::atomic, so both sides may touch the same words at once.
+// Each taxi gets room for some more drivers and addresses than it has. A taxi that
+// outgrows it, or a fleet that gets more taxis, makes the writer build a new segment
+// under the same name and mark the old one stale; readers then Open again.
+// Linux and other POSIX systems only; on Windows Create and Open return false.
+//
+// Segment layout: SharedFleetHeader, TaxiCount SharedTaxiEntry, then the driver words
+// (DRIVERS_PER_WORD states each, as in Taxi) and the address slots of every taxi.
+
+const char SHARED_FLEET_MAGIC[4] = { 'T', 'X', 'S', 'M' };
+const std::uint16_t SHARED_FLEET_VERSION = 1;
+// An address slot holds MAX_STR_LEN characters, zero padded
+const int SHARED_ADDRESS_WORDS = MAX_STR_LEN / 8;
+
+struct SharedFleetHeader
+{
+	char Magic[4];
+	std::uint16_t Version;
+	std::uint16_t HeaderSize;
+	std::uint32_t TaxiCount;
+	std::uint32_t EntrySize;
+	std::uint64_t TotalBytes;
+	// Set once the writer replaced or removed the segment
+	std::atomic<std::uint32_t> Stale;
+};
+
+struct alignas(64) SharedTaxiEntry
+{
+	// Odd while the writer changes the taxi
+	std::atomic<std::uint32_t> Sequence;
+	std::atomic<std::int32_t> DriversCount;
+	std::atomic<std::int32_t> AddressesCount;
+	std::atomic<std::int32_t> FreeCount;
+	// Fixed when the segment is built
+	std::uint32_t DriverCapacity;
+	std::uint32_t AddressCapacity;
+	std::uint64_t DriversOffset;
+	std::uint64_t AddressesOffset;
+};
+
+// Writer side. Attaches to every taxi of the fleet like FleetJournal does, so each
+// driver state or address change is published as it happens.
+class SharedFleetState : public TaxiListener
+{
+public:
+	SharedFleetState() = default;
+	~SharedFleetState() { Close(); }
+	SharedFleetState(const SharedFleetState&) = delete;
+	SharedFleetState& operator=(const SharedFleetState&) = delete;
+
+	// Name is a shared memory object name like "/taxi_fleet". Fleet must stay alive
+	// until Close. Spare is the extra room per taxi, e.g. 0.25 for a quarter more.
+	bool Create(const char* Name, std::vector<Taxi>& Fleet, double Spare = 0.25);
+	// Marks the segment stale, removes it and detaches the fleet
+	void Close();
+	bool IsOpen() const { return Base != nullptr; }
+
+	// Publishes a taxi added to the fleet after Create (builds a new segment)
+	void Track(int FleetIndex);
+	// Builds a new segment for the current fleet
+	bool Rebuild();
+	// Segments built so far, readers of an older one must Open again
+	std::uint64_t GetRebuildCount() const { return Rebuilds; }
+
+	// TaxiListener, called by the attached taxis
+	void DriverChanged(std::uint32_t Key, const Taxi& Obj, int Index, int OldState, int State) override;
+	void AddressChanged(std::uint32_t Key, const Taxi& Obj, int Index) override;
+	void TaxiChanged(std::uint32_t Key, const Taxi& Obj) override;
+
+private:
+	bool Build();
+	void Unmap();
+	void WriteAddress(const SharedTaxiEntry& Entry, int Index, const char* Address);
+
+	std::string Name;
+	std::vector<Taxi>* Fleet = nullptr;
+	double Spare = 0.25;
+	char* Base = nullptr;
+	std::size_t Size = 0;
+	std::uint64_t Rebuilds = 0;
+};
+
+// Reader side, for any process
+class SharedFleetReader
+{
+public:
+	SharedFleetReader() = default;
+	~SharedFleetReader() { Close(); }
+	SharedFleetReader(const SharedFleetReader&) = delete;
+	SharedFleetReader& operator=(const SharedFleetReader&) = delete;
+
+	bool Open(const char* Name);
+	void Close();
+	bool IsOpen() const { return Base != nullptr; }
+	// True once the writer replaced the segment, Open again to follow it
+	bool IsStale() const;
+
+	int GetTaxiCount() const { return Header ? static_cast<int>(Header->TaxiCount) : 0; }
+	// -1 for a bad index
+	int GetFreeCount(int TaxiIndex) const;
+	int GetDriversCount(int TaxiIndex) const;
+	int GetDriverState(int TaxiIndex, int DriverIndex) const;
+	// Free drivers of the whole fleet, each taxi read consistently
+	long long GetFleetFreeCount() const;
+	// Consistent copy of all driver states of a taxi, false for a bad index
+	bool ReadDriverStates(int TaxiIndex, std::vector<std::uint8_t>& States) const;
+	// Copies one address into Out (MAX_STR_LEN chars), false for a bad index
+	bool ReadAddress(int TaxiIndex, int AddressIndex, char* Out) const;
+
+	// Times a read had to start over because the writer was busy with the taxi
+	std::uint64_t GetRetryCount() const { return Retries.load(std::memory_order_relaxed); }
+
+private:
+	const SharedTaxiEntry* Entry(int TaxiIndex) const;
+
+	char* Base = nullptr;
+	std::size_t Size = 0;
+	const SharedFleetHeader* Header = nullptr;
+	mutable std::atomic<std::uint64_t> Retries{ 0 };
+};
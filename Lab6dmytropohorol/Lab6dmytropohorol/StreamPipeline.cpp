@@ -0,0 +1,183 @@
+#include "StreamPipeline.h"
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	// Batches in flight, two per stage is enough to keep all three busy
+	const int PIPELINE_BATCHES = 6;
+
+	struct Batch
+	{
+		std::vector<char> In;
+		std::size_t InSize = 0;
+		std::string Out;
+		std::uint64_t Lines = 0;
+	};
+
+	// Blocking hand-off between two stages. Pop returns nullptr once the queue is
+	// closed and empty.
+	class BatchQueue
+	{
+	public:
+		void Push(Batch* Item)
+		{
+			{
+				std::lock_guard<std::mutex> Guard(Lock);
+				Items.push_back(Item);
+			}
+			Ready.notify_one();
+		}
+
+		Batch* Pop()
+		{
+			std::unique_lock<std::mutex> Guard(Lock);
+			Ready.wait(Guard, [this] { return Closed || !Items.empty(); });
+			if (Items.empty())
+				return nullptr;
+			Batch* Item = Items.front();
+			Items.pop_front();
+			return Item;
+		}
+
+		// Drops the queued items as well, so the consumer stops right away
+		void Abort()
+		{
+			{
+				std::lock_guard<std::mutex> Guard(Lock);
+				Items.clear();
+			}
+			Close();
+		}
+
+		void Close()
+		{
+			{
+				std::lock_guard<std::mutex> Guard(Lock);
+				Closed = true;
+			}
+			Ready.notify_all();
+		}
+
+	private:
+		std::mutex Lock;
+		std::condition_variable Ready;
+		std::deque<Batch*> Items;
+		bool Closed = false;
+	};
+
+	// Fills batches with whole lines, a partial last line is carried to the next batch
+	void ReadLoop(std::istream& In, std::size_t BatchBytes, BatchQueue& Free, BatchQueue& Parse, bool& ReadFailed)
+	{
+		std::vector<char> Carry;
+		bool Eof = false;
+		while (!Eof)
+		{
+			Batch* Item = Free.Pop();
+			if (!Item)
+				break; // the writer gave up
+			std::size_t Capacity = BatchBytes > Carry.size() ? BatchBytes : Carry.size() * 2;
+			if (Item->In.size() < Capacity)
+				Item->In.resize(Capacity);
+			if (!Carry.empty())
+				std::memcpy(Item->In.data(), Carry.data(), Carry.size());
+			std::size_t Size = Carry.size();
+			Carry.clear();
+
+			std::size_t LastLine = 0;
+			while (true)
+			{
+				In.read(Item->In.data() + Size, static_cast<std::streamsize>(Item->In.size() - Size));
+				std::size_t Got = static_cast<std::size_t>(In.gcount());
+				Size += Got;
+				if (!In)
+				{
+					Eof = true;
+					ReadFailed = In.bad();
+					LastLine = Size;
+					break;
+				}
+				const char* Data = Item->In.data();
+				const char* Found = nullptr;
+				for (std::size_t i = Size; i > 0 && !Found; i--)
+					if (Data[i - 1] == '\n')
+						Found = Data + i - 1;
+				if (Found)
+				{
+					LastLine = Found - Data + 1;
+					break;
+				}
+				// one line longer than the whole batch, keep reading into a larger one
+				Item->In.resize(Item->In.size() * 2);
+			}
+			Carry.assign(Item->In.data() + LastLine, Item->In.data() + Size);
+			Item->InSize = LastLine;
+			Parse.Push(Item);
+		}
+		Parse.Close();
+	}
+
+	void ConvertLoop(const BatchConverter& Convert, BatchQueue& Parse, BatchQueue& Write)
+	{
+		while (Batch* Item = Parse.Pop())
+		{
+			Item->Out.clear();
+			Item->Lines = 0;
+			if (Item->InSize)
+				Convert(Item->In.data(), Item->InSize, Item->Out, Item->Lines);
+			Write.Push(Item);
+		}
+		Write.Close();
+	}
+}
+
+bool RunStreamPipeline(std::istream& In, std::ostream& Out, const BatchConverter& Convert,
+	StreamPipelineStats* Stats, std::size_t BatchBytes)
+{
+	if (BatchBytes == 0)
+		BatchBytes = STREAM_BATCH_BYTES;
+	std::vector<Batch> Batches(PIPELINE_BATCHES);
+	BatchQueue Free, Parse, Write;
+	for (Batch& Item : Batches)
+		Free.Push(&Item);
+
+	bool ReadFailed = false;
+	std::thread Reader(ReadLoop, std::ref(In), BatchBytes, std::ref(Free), std::ref(Parse), std::ref(ReadFailed));
+	std::thread Converter(ConvertLoop, std::cref(Convert), std::ref(Parse), std::ref(Write));
+
+	StreamPipelineStats Totals;
+	bool WriteFailed = false;
+	while (Batch* Item = Write.Pop())
+	{
+		if (!WriteFailed)
+		{
+			Out.write(Item->Out.data(), static_cast<std::streamsize>(Item->Out.size()));
+			if (!Out)
+			{
+				// stop the reader, the batches still in flight are drained and dropped
+				WriteFailed = true;
+				Free.Abort();
+			}
+			Totals.Lines += Item->Lines;
+			Totals.BytesIn += Item->InSize;
+			Totals.BytesOut += Item->Out.size();
+		}
+		if (!WriteFailed)
+			Free.Push(Item);
+	}
+	Reader.join();
+	Converter.join();
+	Out.flush();
+
+	if (Stats)
+		*Stats = Totals;
+	if (ReadFailed)
+		std::cerr << "Failed to read the input stream\n";
+	if (WriteFailed)
+		std::cerr << "Failed to write the output stream\n";
+	return !ReadFailed && !WriteFailed;
+}
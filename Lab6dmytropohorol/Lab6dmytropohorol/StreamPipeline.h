@@ -0,0 +1,83 @@
+#pragma once
+
+#include "AbstractTaxi.h"
+#include "Taxi.h"
+#include "TaxiCodec.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Lines are read and converted in batches of about this many bytes
+const std::size_t STREAM_BATCH_BYTES = 4 << 20;
+
+struct StreamPipelineStats
+{
+	std::uint64_t Lines = 0;
+	std::uint64_t BytesIn = 0;
+	std::uint64_t BytesOut = 0;
+};
+
+// Converts a batch of whole lines, each ending in '\n' (the last one may not), and
+// appends the output to Out. Called once per batch, always from the same thread.
+using BatchConverter = std::function<void(const char* Data, std::size_t Size, std::string& Out, std::uint64_t& Lines)>;
+
+// Reads In in large blocks on one thread, converts them on a second one and writes
+// the results to Out from the calling thread, so the three stages overlap.
+// Returns false if reading or writing failed.
+bool RunStreamPipeline(std::istream& In, std::ostream& Out, const BatchConverter& Convert,
+	StreamPipelineStats* Stats = nullptr, std::size_t BatchBytes = STREAM_BATCH_BYTES);
+
+// FromString followed by ToString on one reused object. Taxi and its subclasses go
+// straight through TaxiCodec, anything else through its IStringConvertible methods,
+// called on the concrete type so the compiler can bind them statically. A line TaxiCodec
+// rejects is copied through as it is, not replaced by the previous line's taxi.
+template <typename T>
+void ConvertLine(std::string_view Line, T& Obj, std::string& Scratch, std::string& Out)
+{
+	if constexpr (std::is_base_of_v<Taxi, T>)
+	{
+		if (ParseTaxiString(Line, Obj))
+			AppendTaxiString(Obj, Out);
+		else
+			Out.append(Line);
+	}
+	else
+	{
+		Scratch.assign(Line);
+		Obj.FromString(Scratch);
+		Obj.AppendString(Out);
+	}
+}
+
+// Bulk version of StreamConversion: every input line is parsed into one T and written
+// back out with ToString, one output line per input line
+template <typename T>
+bool StreamConversionBulk(std::istream& In, std::ostream& Out, StreamPipelineStats* Stats = nullptr)
+{
+	static_assert(std::is_base_of_v<IStringConvertible, T>, "T must implement IStringConvertible");
+	T Obj;
+	std::string Scratch;
+	return RunStreamPipeline(In, Out,
+		[&Obj, &Scratch](const char* Data, std::size_t Size, std::string& Result, std::uint64_t& Lines)
+		{
+			const char* End = Data + Size;
+			while (Data < End)
+			{
+				const char* LineEnd = static_cast<const char*>(std::memchr(Data, '\n', End - Data));
+				if (!LineEnd)
+					LineEnd = End;
+				std::size_t Len = LineEnd - Data;
+				if (Len && Data[Len - 1] == '\r')
+					Len--;
+				ConvertLine(std::string_view(Data, Len), Obj, Scratch, Result);
+				Result.push_back('\n');
+				Lines++;
+				Data = LineEnd + 1;
+			}
+		}, Stats);
+}
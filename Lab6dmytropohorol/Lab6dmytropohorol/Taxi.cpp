@@ -1,14 +1,61 @@
 #include "Taxi.h"
+#include "AddressCatalog.h"
+#include "Log.h"
+#include "MappedFile.h"
+#include "TaxiCodec.h"
+#include "TaxiSnapshot.h"
+#include <algorithm>
+#include <iterator>
 #include <string>
 
 #pragma warning( disable : 4996)
 
+// Words of packed driver states needed for count drivers
+int DriverWords(int count)
+{
+	return (count + DRIVERS_PER_WORD - 1) / DRIVERS_PER_WORD;
+}
+
 // Helper functions for copying arrays
-int* CopyDrivers(const int* source, int count)
+std::uint64_t* CopyDrivers(const std::uint64_t* source, int count)
+{
+	if (source && count > 0)
+	{
+		int words = DriverWords(count);
+		std::uint64_t* dest = new std::uint64_t[words];
+		for (int i = 0; i < words; i++)
+		{
+			dest[i] = source[i];
+		}
+		return dest;
+	}
+	return nullptr;
+}
+
+// Packs one int state per driver, invalid states are stored as FREE
+std::uint64_t* PackDrivers(const int* source, int count)
+{
+	if (!source || count <= 0)
+		return nullptr;
+	std::uint64_t* dest = new std::uint64_t[DriverWords(count)]();
+	for (int i = 0; i < count; i++)
+	{
+		int state = source[i];
+		if (!IsValidDriverState(state))
+		{
+			TAXI_LOG(LogLevel::Warning, "Invalid driver state ", state, " of driver #", i, " stored as FREE");
+			state = DRIVER_FREE;
+		}
+		dest[i / DRIVERS_PER_WORD] |= static_cast<std::uint64_t>(state) << (i % DRIVERS_PER_WORD * DRIVER_STATE_BITS);
+	}
+	return dest;
+}
+
+AddressId* CopyAddresses(const AddressId* source, int count)
 {
 	if (source && count > 0)
 	{
-		int* dest = new int[count];
+		AddressId* dest = new AddressId[count];
 		for (int i = 0; i < count; i++)
 		{
 			dest[i] = source[i];
@@ -18,188 +65,437 @@ int* CopyDrivers(const int* source, int count)
 	return nullptr;
 }
 
-char (*CopyAddresses(const char source[][MAX_STR_LEN], int count))[MAX_STR_LEN]
+AddressId* InternAddresses(const char source[][MAX_STR_LEN], int count)
 {
 	if (source && count > 0)
 	{
-		char (*dest)[MAX_STR_LEN] = new char[count][MAX_STR_LEN];
+		AddressId* dest = new AddressId[count];
 		for (int i = 0; i < count; i++)
 		{
-			std::strncpy(dest[i], source[i], MAX_STR_LEN - 1);
-			dest[i][MAX_STR_LEN - 1] = '\0';
+			dest[i] = AddressPool::InternOrUnknown(source[i]);
 		}
 		return dest;
 	}
 	return nullptr;
 }
 
-void AllocateDrivers(int*& Drivers, int& Count, int NewCount)
+// Fills a new address table with the "UnknownAddr" placeholder
+AddressId* AllocateUnknownAddresses(int count)
+{
+	AddressId* dest = new AddressId[count];
+	for (int i = 0; i < count; i++)
+		dest[i] = UNKNOWN_ADDRESS_ID;
+	return dest;
+}
+
+// New drivers are all FREE, which is the zero state
+void AllocateDrivers(std::uint64_t*& Drivers, int& Count, int NewCount)
 {
+	if (NewCount < 0)
+		NewCount = 0;
+	// the same number of words: clear the array we have instead of allocating again
+	if (Drivers && NewCount > 0 && DriverWords(NewCount) == DriverWords(Count))
+	{
+		std::fill(Drivers, Drivers + DriverWords(NewCount), std::uint64_t(0));
+		Count = NewCount;
+		return;
+	}
 	delete[] Drivers;
 	Drivers = nullptr;
-	Count = (NewCount > 0 ? NewCount : 0);
+	Count = NewCount;
 	if (Count > 0)
-	{
-		Drivers = new int[Count];
-		for (int i = 0; i < Count; i++)
-			Drivers[i] = DRIVER_FREE;
-	}
+		Drivers = new std::uint64_t[DriverWords(Count)]();
 }
 
 int ReadStrictInt();
 void ReadNonEmptyString(char* Buffer);
 
+std::atomic<AddressCopy> Taxi::DefaultAddressCopy{ AddressCopy::Deep };
+
 Taxi::Taxi()
 {
-	std::cout << "[LOG] Taxi default constructor called. Current number of taxi's classes - " << ++Count << std::endl;
+	TAXI_LOG(LogLevel::Debug, "Taxi default constructor called. Current number of taxi's classes - ", GetCount());
 	std::strcpy(Passenger, "Unknown");
 	Drivers = nullptr;
 	Addresses = nullptr;
+	AddressesRefCount = nullptr;
 	DriversCount = 0;
+	std::fill(std::begin(StateCounts), std::end(StateCounts), 0);
 	AddressesCount = 0;
-	ObjectNumber = Count;
 }
 
 Taxi::Taxi(const char* InPassenger,
 	const int* InDrivers, int InDriversCount,
 	const char (*InAddresses)[MAX_STR_LEN], int InAddressesCount)
 {
-	std::cout << "[LOG] Taxi parameterized constructor called. Current number of taxi's classes - " << ++Count << std::endl;
+	TAXI_LOG(LogLevel::Debug, "Taxi parameterized constructor called. Current number of taxi's classes - ", GetCount());
 
 	InPassenger ? std::strncpy(Passenger, InPassenger, MAX_STR_LEN - 1) : std::strcpy(Passenger, "Unknown");
 	Passenger[MAX_STR_LEN - 1] = '\0';
 
 	DriversCount = (InDrivers && InDriversCount > 0) ? InDriversCount : 0;
-	Drivers = CopyDrivers(InDrivers, DriversCount);
+	Drivers = PackDrivers(InDrivers, DriversCount);
+	RecountDriverStates();
 	AddressesCount = (InAddresses && InAddressesCount > 0) ? InAddressesCount : 0;
-	Addresses = CopyAddresses(InAddresses, AddressesCount);
+	Addresses = InternAddresses(InAddresses, AddressesCount);
+	AddressesRefCount = nullptr;
 
-	ObjectNumber = Count;
 }
 
 Taxi::Taxi(const Taxi& Other)
+	: Taxi(Other, GetDefaultAddressCopy())
+{
+}
+
+Taxi::Taxi(const Taxi& Other, AddressCopy Mode)
+	: AbstractTaxi()
 {
-	std::cout << "[LOG] Taxi copy constructor called. Current number of taxi's classes - " << ++Count << std::endl;
+	TAXI_LOG(LogLevel::Debug, "Taxi copy constructor called. Current number of taxi's classes - ", GetCount());
 
 	std::strcpy(Passenger, Other.Passenger);
 
 	DriversCount = Other.DriversCount;
+	std::copy(std::begin(Other.StateCounts), std::end(Other.StateCounts), StateCounts);
 	AddressesCount = Other.AddressesCount;
 	
 	Drivers = CopyDrivers(Other.Drivers, DriversCount);
-	Addresses = CopyAddresses(Other.Addresses, AddressesCount);
+	AcquireAddresses(Other, Mode);
 
-	ObjectNumber = Count;
+}
+
+Taxi::Taxi(Taxi&& Other) noexcept
+{
+	TAXI_LOG(LogLevel::Debug, "Taxi move constructor called. Current number of taxi's classes - ", GetCount());
+
+	std::strcpy(Passenger, Other.Passenger);
+
+	// steal the arrays, the moved-from taxi is left empty
+	Drivers = Other.Drivers;
+	DriversCount = Other.DriversCount;
+	std::copy(std::begin(Other.StateCounts), std::end(Other.StateCounts), StateCounts);
+	Addresses = Other.Addresses;
+	AddressesRefCount.store(Other.AddressesRefCount.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	AddressesCount = Other.AddressesCount;
+	Other.Drivers = nullptr;
+	Other.DriversCount = 0;
+	std::fill(std::begin(Other.StateCounts), std::end(Other.StateCounts), 0);
+	Other.Addresses = nullptr;
+	Other.AddressesRefCount = nullptr;
+	Other.AddressesCount = 0;
+	Catalog = Other.Catalog;
+	Other.Catalog = nullptr;
+	std::copy(std::begin(Other.Listeners), std::end(Other.Listeners), Listeners);
+	ListenerCount = Other.ListenerCount;
+	Other.ListenerCount = 0;
+	DirtyDriverBlocks = std::move(Other.DirtyDriverBlocks);
+	DirtyAddressBlocks = std::move(Other.DirtyAddressBlocks);
+	DeltaTracking = Other.DeltaTracking;
+	AnyDirtyBlock = Other.AnyDirtyBlock;
+	Other.DeltaTracking = false;
+	Other.AnyDirtyBlock = false;
+
+	// the moved taxi keeps its identity, the moved-from one takes our fresh number
+	std::swap(ObjectNumber, Other.ObjectNumber);
 }
 
 Taxi::~Taxi()
 {
-	std::cout << "[LOG] Taxi destructor called. Current number of taxi's classes - " << --Count << ". Freeing memory.\n";
+	// the object is unregistered by ~AbstractTaxi right after this
+	TAXI_LOG(LogLevel::Debug, "Taxi destructor called. Current number of taxi's classes - ", GetCount() - 1, ". Freeing memory.");
+	delete[] Drivers;
+	ReleaseAddresses();
+}
+
+Taxi& Taxi::operator=(const Taxi& Other)
+{
+	if (this == &Other)
+		return *this;
+	std::strcpy(Passenger, Other.Passenger);
+
+	std::uint64_t* NewDrivers = CopyDrivers(Other.Drivers, Other.DriversCount);
 	delete[] Drivers;
-	delete[] Addresses;
+	Drivers = NewDrivers;
+	DriversCount = Other.DriversCount;
+	std::copy(std::begin(Other.StateCounts), std::end(Other.StateCounts), StateCounts);
+
+	ReleaseAddresses();
+	AcquireAddresses(Other, GetDefaultAddressCopy());
+	WholeTaxiChanged();
+	return *this;
+}
+
+Taxi& Taxi::operator=(Taxi&& Other) noexcept
+{
+	// Other frees our old arrays when it is destroyed
+	if (this != &Other)
+		Swap(Other);
+	return *this;
+}
+
+void Taxi::Swap(Taxi& Other) noexcept
+{
+	std::swap(Passenger, Other.Passenger);
+	std::swap(Drivers, Other.Drivers);
+	std::swap(DriversCount, Other.DriversCount);
+	std::swap(StateCounts, Other.StateCounts);
+	std::swap(Addresses, Other.Addresses);
+	AddressesRefCount.store(Other.AddressesRefCount.exchange(AddressesRefCount.load(std::memory_order_relaxed),
+		std::memory_order_relaxed), std::memory_order_relaxed);
+	std::swap(AddressesCount, Other.AddressesCount);
+	std::swap(Catalog, Other.Catalog);
+	std::swap(ObjectNumber, Other.ObjectNumber);
+	// the dirty blocks describe the old contents and layout: both taxis are saved whole
+	// next time. The listeners stay with the objects, the caller publishes (see Taxi.h)
+	DeltaTracking = Other.DeltaTracking = false;
+	AnyDirtyBlock = Other.AnyDirtyBlock = false;
+}
+
+void Taxi::RecountDriverStates()
+{
+	std::fill(std::begin(StateCounts), std::end(StateCounts), 0);
+	for (int i = 0; i < DriversCount; i++)
+		StateCounts[ReadDriver(i)]++;
+}
+
+void Taxi::WriteDriver(int Index, int State)
+{
+	int Shift = Index % DRIVERS_PER_WORD * DRIVER_STATE_BITS;
+	std::uint64_t& Word = Drivers[Index / DRIVERS_PER_WORD];
+	Word = (Word & ~(std::uint64_t(0xF) << Shift)) | (static_cast<std::uint64_t>(State) << Shift);
+}
+
+void Taxi::WholeTaxiChanged()
+{
+	DeltaTracking = false;
+	AnyDirtyBlock = false;
+	NotifyTaxiChanged();
+}
+
+void Taxi::NotifyTaxiChanged() const
+{
+	for (int i = 0; i < ListenerCount; i++)
+		Listeners[i].Listener->TaxiChanged(Listeners[i].Key, *this);
+}
+
+bool Taxi::AttachListener(TaxiListener* Listener, std::uint32_t Key)
+{
+	if (!Listener)
+		return false;
+	for (int i = 0; i < ListenerCount; i++)
+		if (Listeners[i].Listener == Listener)
+		{
+			Listeners[i].Key = Key;
+			return true;
+		}
+	if (ListenerCount == MAX_TAXI_LISTENERS)
+	{
+		std::cerr << "Failed to attach a listener: the taxi already has " << MAX_TAXI_LISTENERS << "\n";
+		return false;
+	}
+	Listeners[ListenerCount++] = { Listener, Key };
+	return true;
+}
+
+void Taxi::DetachListener(const TaxiListener* Listener)
+{
+	for (int i = 0; i < ListenerCount; i++)
+		if (Listeners[i].Listener == Listener)
+		{
+			// keep the others in attach order
+			std::copy(Listeners + i + 1, Listeners + ListenerCount, Listeners + i);
+			Listeners[--ListenerCount] = {};
+			return;
+		}
+}
+
+bool Taxi::IsAttached(const TaxiListener* Listener) const
+{
+	for (int i = 0; i < ListenerCount; i++)
+		if (Listeners[i].Listener == Listener)
+			return true;
+	return false;
+}
+
+void Taxi::MarkDriverDirty(int Index)
+{
+	if (!DeltaTracking)
+		return;
+	int Block = Index / DELTA_DRIVER_BLOCK;
+	DirtyDriverBlocks[Block / 64] |= std::uint64_t(1) << (Block % 64);
+	AnyDirtyBlock = true;
+}
+
+void Taxi::MarkAddressDirty(int Index)
+{
+	if (!DeltaTracking)
+		return;
+	int Block = Index / DELTA_ADDRESS_BLOCK;
+	DirtyAddressBlocks[Block / 64] |= std::uint64_t(1) << (Block % 64);
+	AnyDirtyBlock = true;
+}
+
+void Taxi::AcquireAddresses(const Taxi& Other, AddressCopy Mode)
+{
+	AddressesCount = Other.AddressesCount;
+	Catalog = Other.Catalog;
+	if (Mode == AddressCopy::Shared && Other.Addresses)
+	{
+		// threads copying the same taxi at once agree on one count: the first one installs it
+		AddressRefCount* Count = Other.AddressesRefCount.load(std::memory_order_acquire);
+		if (!Count)
+		{
+			AddressRefCount* Created = new AddressRefCount(1);
+			if (Other.AddressesRefCount.compare_exchange_strong(Count, Created, std::memory_order_acq_rel))
+				Count = Created;
+			else
+				delete Created;
+		}
+		Count->fetch_add(1, std::memory_order_relaxed);
+		Addresses = Other.Addresses;
+		AddressesRefCount.store(Count, std::memory_order_relaxed);
+		return;
+	}
+	Addresses = CopyAddresses(Other.Addresses, AddressesCount);
+	AddressesRefCount.store(nullptr, std::memory_order_relaxed);
+}
+
+void Taxi::DetachAddresses()
+{
+	// only called before a write, after which the addresses may differ from the catalog
+	Catalog = nullptr;
+	AddressRefCount* Count = AddressesRefCount.load(std::memory_order_relaxed);
+	if (!Count)
+		return;
+	// nobody else holds the table, and only a holder could share it again
+	if (Count->load(std::memory_order_acquire) == 1)
+	{
+		delete Count;
+		AddressesRefCount.store(nullptr, std::memory_order_relaxed);
+		return;
+	}
+	AddressId* Own = CopyAddresses(Addresses, AddressesCount);
+	ReleaseAddresses();
+	Addresses = Own;
+}
+
+void Taxi::ReleaseAddresses()
+{
+	Catalog = nullptr;
+	AddressRefCount* Count = AddressesRefCount.exchange(nullptr, std::memory_order_relaxed);
+	// the last of the sharers frees the table, whichever thread it runs on
+	if (!Count || Count->fetch_sub(1, std::memory_order_acq_rel) == 1)
+	{
+		delete Count;
+		delete[] Addresses;
+	}
+	Addresses = nullptr;
 }
 
 std::string Taxi::ToString() const
 {
-	std::string result = "Passenger=";
-	result += Passenger;
-	result += ", DriversCount=" + std::to_string(DriversCount);
-	result += ", AddressesCount=" + std::to_string(AddressesCount);
-	return result;
+	// AppendTaxiString makes room for the longest line, encode into a reused buffer
+	// and return a copy of just the text
+	thread_local std::string Scratch;
+	Scratch.clear();
+	AppendTaxiString(*this, Scratch);
+	return Scratch;
+}
+
+void Taxi::AppendString(std::string& Out) const
+{
+	AppendTaxiString(*this, Out);
 }
 
 void Taxi::FromString(const std::string& InStr)
 {
-	// A minimal parse. Just a naive approach:
-	// If we find "Passenger=" up to a comma, store that in Passenger
-	// Real parse is way more robust
-	// Similarly for DriversCount, AddressesCount. 
-	// e.g. InStr: "Passenger=Bob, DriversCount=3, AddressesCount=2"
-	std::size_t pPos = InStr.find("Passenger=");
-	if (pPos != std::string::npos) {
-		// read until next comma
-		std::size_t comma = InStr.find(",", pPos);
-		if (comma == std::string::npos) comma = InStr.size();
-		std::string passVal = InStr.substr(pPos + 10, comma - (pPos + 10));
-		if (!passVal.empty() && passVal.size() < MAX_STR_LEN)
-			std::strcpy(Passenger, passVal.c_str());
-	}
-	std::size_t dPos = InStr.find("DriversCount=");
-	if (dPos != std::string::npos) {
-		std::size_t comma = InStr.find(",", dPos);
-		if (comma == std::string::npos) comma = InStr.size();
-		std::string dVal = InStr.substr(dPos + 13, comma - (dPos + 13));
-		int val = std::atoi(dVal.c_str());
-		if (val < 0) val = 0;
-		SetDriversCount(val);
-	}
-	std::size_t aPos = InStr.find("AddressesCount=");
-	if (aPos != std::string::npos) {
-		std::size_t comma = InStr.find(",", aPos);
-		if (comma == std::string::npos) comma = InStr.size();
-		std::string aVal = InStr.substr(aPos + 15, comma - (aPos + 15));
-		int val = std::atoi(aVal.c_str());
-		if (val < 0) val = 0;
-		SetAddressesCount(val);
-	}
+	// e.g. InStr: "Passenger=Bob, DriversCount=3, AddressesCount=2, Drivers=010, Addresses=Main St|Park Ave"
+	ParseTaxiString(InStr, *this);
 }
 
 int Taxi::GetDriverState(int Index) const
 {
 	if (Index < 0 || Index >= DriversCount || !Drivers) return -1;
-	return Drivers[Index];
+	return ReadDriver(Index);
+}
+
+bool Taxi::SetDriverState(int Index, int State)
+{
+	if (Index < 0 || Index >= DriversCount || !Drivers || !IsValidDriverState(State))
+		return false;
+	int OldState = ReadDriver(Index);
+	StateCounts[OldState]--;
+	StateCounts[State]++;
+	WriteDriver(Index, State);
+	MarkDriverDirty(Index);
+	for (int i = 0; i < ListenerCount; i++)
+		Listeners[i].Listener->DriverChanged(Listeners[i].Key, *this, Index, OldState, State);
+	return true;
 }
 
-void Taxi::SetDriverState(int Index, int State)
+bool Taxi::TransitionDriver(int Index, DriverState To)
 {
-	if (Index < 0 || Index >= DriversCount || !Drivers) return;
-	Drivers[Index] = State;
+	if (Index < 0 || Index >= DriversCount || !Drivers)
+		return false;
+	if (!IsValidTransition(static_cast<DriverState>(ReadDriver(Index)), To))
+		return false;
+	return SetDriverState(Index, static_cast<int>(To));
 }
 
 const char* Taxi::GetAddress(int Index) const
 {
 	if (Index < 0 || Index >= AddressesCount || !Addresses)
 		return nullptr;
+	return AddressPool::Get(Addresses[Index]);
+}
+
+AddressId Taxi::GetAddressId(int Index) const
+{
+	if (Index < 0 || Index >= AddressesCount || !Addresses)
+		return INVALID_ADDRESS_ID;
 	return Addresses[Index];
 }
 
 void Taxi::SetAddress(int Index, const char* NewAddress)
 {
-	if (Index < 0 || Index >= AddressesCount || !Addresses || !NewAddress) return;
-	std::strncpy(Addresses[Index], NewAddress, MAX_STR_LEN - 1);
-	Addresses[Index][MAX_STR_LEN - 1] = '\0';
+	if (NewAddress)
+		SetAddress(Index, NewAddress, std::strlen(NewAddress));
 }
 
-int Taxi::Order()
+void Taxi::SetAddress(int Index, const char* NewAddress, std::size_t Length)
 {
-	if (!Drivers) return 0;
-	int FreeDriversNum = 0;
-	for (int i = 0; i < DriversCount; i++)
-		if (Drivers[i] == DRIVER_FREE)
-			FreeDriversNum++;
-	return FreeDriversNum;
+	if (Index < 0 || Index >= AddressesCount || !Addresses || !NewAddress) return;
+	AddressId Id = AddressPool::Intern(NewAddress, Length);
+	if (Id == INVALID_ADDRESS_ID)
+	{
+		TAXI_LOG(LogLevel::Warning, "Address pool is full, address #", Index, " not changed");
+		return;
+	}
+	DetachAddresses();
+	Addresses[Index] = Id;
+	MarkAddressDirty(Index);
+	for (int i = 0; i < ListenerCount; i++)
+		Listeners[i].Listener->AddressChanged(Listeners[i].Key, *this, Index);
 }
 
 bool Taxi::Order(const char* InAddress)
+{
+	return OrderDriver(InAddress) >= 0;
+}
+
+int Taxi::OrderDriver(const char* InAddress)
 {
 	if (!Drivers || !Addresses || !InAddress || std::strlen(InAddress) == 0)
-		return false;
-	// confirm the address is known
-	bool KnownAddress = false;
-	for (int i = 0; i < AddressesCount; i++)
-	{
-		if (!std::strcmp(Addresses[i], InAddress))
-		{
-			KnownAddress = true; break;
-		}
-	}
-	if (!KnownAddress)
-		return false;
+		return -1;
+	if (StateCounts[DRIVER_FREE] == 0 || !KnowsAddress(InAddress))
+		return -1;
 	// find a free driver
 	for (int i = 0; i < DriversCount; i++)
-		if (Drivers[i] == DRIVER_FREE)
-			return Order(i, InAddress);
-	return false; // no free drivers
+		if (ReadDriver(i) == DRIVER_FREE)
+		{
+			SetDriverState(i, DRIVER_BUSY);
+			return i;
+		}
+	return -1; // no free drivers
 }
 
 bool Taxi::Order(int DriverIndex, const char* InAddress)
@@ -208,26 +504,69 @@ bool Taxi::Order(int DriverIndex, const char* InAddress)
 		|| DriverIndex < 0 || DriverIndex >= DriversCount
 		|| !std::strlen(InAddress))
 		return false;
-	if (Drivers[DriverIndex] != DRIVER_FREE)
+	if (ReadDriver(DriverIndex) != DRIVER_FREE)
 		return false;
-	// check address
-	for (int i = 0; i < AddressesCount; i++)
+	if (!KnowsAddress(InAddress))
+		return false; // address not known
+	return SetDriverState(DriverIndex, DRIVER_BUSY);
+}
+
+bool Taxi::KnowsAddress(const char* InAddress) const
+{
+	// the catalog's addresses are exactly ours: one hash and one compare
+	if (Catalog)
+		return Catalog->Find(InAddress) >= 0;
+	// an address that was never interned cannot be ours
+	return HasAddress(AddressPool::Find(InAddress));
+}
+
+bool Taxi::UseCatalog(const AddressCatalogView& InCatalog)
+{
+	if (!InCatalog.IsValid())
 	{
-		if (!std::strcmp(Addresses[i], InAddress))
+		std::cerr << "Failed to use the address catalog: its addresses repeat or do not fit MAX_STR_LEN\n";
+		return false;
+	}
+	std::vector<AddressId> Ids(InCatalog.GetSize());
+	for (int i = 0; i < InCatalog.GetSize(); i++)
+		if ((Ids[i] = AddressPool::Intern(InCatalog.Get(i))) == INVALID_ADDRESS_ID)
 		{
-			Drivers[DriverIndex] = DRIVER_BUSY;
-			return true;
+			std::cerr << "Failed to use the address catalog: the address pool is full\n";
+			return false;
 		}
-	}
-	return false; // address not known
+	ReleaseAddresses();
+	AddressesCount = InCatalog.GetSize();
+	Addresses = CopyAddresses(Ids.data(), AddressesCount);
+	WholeTaxiChanged();
+	// set last, ReleaseAddresses clears it
+	Catalog = &InCatalog;
+	return true;
+}
+
+bool Taxi::HasAddress(AddressId Id) const
+{
+	if (!Addresses || Id == INVALID_ADDRESS_ID)
+		return false;
+	for (int i = 0; i < AddressesCount; i++)
+		if (Addresses[i] == Id)
+			return true;
+	return false;
 }
 
 void Taxi::PrintInfo() const
 {
-	std::cout << "Standart taxi:\n" 
-		<< "Passenger: " << Passenger
-		<< ", Total Taxi objects: " << Count
-		<< std::endl;
+	std::string Info;
+	AppendInfo(Info, GetCount());
+	std::cout << Info << std::flush;
+}
+
+void Taxi::AppendInfo(std::string& Out, int TotalCount) const
+{
+	Out += "Standart taxi:\nPassenger: ";
+	Out += Passenger;
+	Out += ", Total Taxi objects: ";
+	Out += std::to_string(TotalCount);
+	Out += '\n';
 }
 
 void Taxi::InputFromConsole()
@@ -242,27 +581,33 @@ void Taxi::InputFromConsole()
 	AllocateDrivers(Drivers, DriversCount, DriversCount);
 	for (int i = 0; i < DriversCount; i++)
 	{
-		std::cout << "Enter state for driver No." << i << " (0=FREE,1=BUSY): ";
+		std::cout << "Enter state for driver No." << i << " (" << DRIVER_STATE_PROMPT << "): ";
 		int State = ReadStrictInt();
-		if (State != DRIVER_FREE && State != DRIVER_BUSY)
-			State = DRIVER_FREE;
-		Drivers[i] = State;
+		while (!IsValidDriverState(State))
+		{
+			std::cout << "Invalid driver state. Please try again: ";
+			State = ReadStrictInt();
+		}
+		WriteDriver(i, State);
 	}
+	RecountDriverStates();
 	std::cout << "How many addresses: ";
 	AddressesCount = ReadStrictInt();
 	if (AddressesCount < 0) 
 		AddressesCount = 0;
-	delete[] Addresses;
-	Addresses = nullptr;
+	ReleaseAddresses();
 	if (AddressesCount > 0)
 	{
-		Addresses = new char[AddressesCount][MAX_STR_LEN];
+		Addresses = new AddressId[AddressesCount];
+		char Buffer[MAX_STR_LEN];
 		for (int i = 0; i < AddressesCount; i++)
 		{
 			std::cout << "Enter address #" << i << ": ";
-			ReadNonEmptyString(Addresses[i]);
+			ReadNonEmptyString(Buffer);
+			Addresses[i] = AddressPool::InternOrUnknown(Buffer);
 		}
 	}
+	WholeTaxiChanged();
 }
 
 void Taxi::PrintToConsole() const
@@ -273,35 +618,369 @@ void Taxi::PrintToConsole() const
 	if (Drivers)
 		for (int i = 0; i < DriversCount; i++)
 			std::cout << "Driver #" << i << " => "
-			<< (Drivers[i] == DRIVER_FREE ? "FREE" : "BUSY")
+			<< GetDriverStateName(ReadDriver(i))
 			<< "\n";
 	else
 		std::cout << "No driver data.\n";
 	std::cout << "AddressesCount: " << AddressesCount << "\n";
 	if (Addresses)
 		for (int i = 0; i < AddressesCount; i++)
-			std::cout << "Address #" << i << ": " << Addresses[i] << "\n";
+			std::cout << "Address #" << i << ": " << AddressPool::Get(Addresses[i]) << "\n";
 	else
 		std::cout << "No address data.\n";
 	std::cout << std::endl;
 }
 
+void Taxi::AppendSnapshot(std::vector<char>& Out) const
+{
+	SnapshotHeader Header = {};
+	std::memcpy(Header.Magic, SNAPSHOT_MAGIC, sizeof(Header.Magic));
+	Header.Version = SNAPSHOT_VERSION;
+	Header.HeaderSize = sizeof(SnapshotHeader);
+	Header.ObjectNumber = ObjectNumber;
+	Header.DriversCount = static_cast<std::uint32_t>(DriversCount);
+	Header.AddressesCount = static_cast<std::uint32_t>(AddressesCount);
+	for (int i = 0; i < AddressesCount; i++)
+		Header.AddressesBytes += static_cast<std::uint32_t>(sizeof(std::uint16_t) + std::strlen(AddressPool::Get(Addresses[i])));
+	// Passenger is always terminated and the header is zeroed, the rest stays zero padding
+	std::memcpy(Header.Passenger, Passenger, std::strlen(Passenger));
+
+	std::size_t Start = Out.size();
+	Out.resize(Start + SnapshotRecordSize(Header));
+	char* Cursor = Out.data() + Start;
+	std::memcpy(Cursor, &Header, sizeof(Header));
+	Cursor += sizeof(Header);
+
+	// the packed words are little-endian, so their first bytes are the nibbles in order
+	std::size_t DriverBytes = SnapshotDriverBytes(Header.Version, Header.DriversCount);
+	if (DriverBytes)
+		std::memcpy(Cursor, Drivers, DriverBytes);
+	Cursor += DriverBytes;
+
+	for (int i = 0; i < AddressesCount; i++)
+	{
+		const char* Address = AddressPool::Get(Addresses[i]);
+		std::uint16_t Len = static_cast<std::uint16_t>(std::strlen(Address));
+		std::memcpy(Cursor, &Len, sizeof(Len));
+		std::memcpy(Cursor + sizeof(Len), Address, Len);
+		Cursor += sizeof(Len) + Len;
+	}
+}
+
+std::size_t Taxi::ReadSnapshot(const char* Data, std::size_t Size)
+{
+	if (!IsSnapshot(Data, Size))
+		return 0;
+	SnapshotHeader Header;
+	std::memcpy(&Header, Data, sizeof(Header));
+	if (Header.Version > SNAPSHOT_VERSION || Header.HeaderSize < sizeof(SnapshotHeader)
+		|| Header.DriversCount > static_cast<std::uint32_t>(std::numeric_limits<int>::max())
+		|| Header.AddressesCount > Header.AddressesBytes / sizeof(std::uint16_t)
+		|| SnapshotRecordSize(Header) > Size)
+		return 0;
+
+	// validate the whole string table before touching the object
+	const char* Bits = Data + Header.HeaderSize;
+	const char* Table = Bits + SnapshotDriverBytes(Header.Version, Header.DriversCount);
+	const char* TableEnd = Table + Header.AddressesBytes;
+	const char* Cursor = Table;
+	for (std::uint32_t i = 0; i < Header.AddressesCount; i++)
+	{
+		std::uint16_t Len;
+		if (TableEnd - Cursor < static_cast<std::ptrdiff_t>(sizeof(Len)))
+			return 0;
+		std::memcpy(&Len, Cursor, sizeof(Len));
+		Cursor += sizeof(Len);
+		if (TableEnd - Cursor < Len)
+			return 0;
+		Cursor += Len;
+	}
+
+	// validate the driver states too, version 1 only had one bit (BUSY) per driver
+	if (Header.Version >= 2)
+		for (std::uint32_t i = 0; i < Header.DriversCount; i++)
+			if (!IsValidDriverState((Bits[i >> 1] >> ((i & 1) * 4)) & 0xF))
+				return 0;
+
+	std::memcpy(Passenger, Header.Passenger, MAX_STR_LEN);
+	Passenger[MAX_STR_LEN - 1] = '\0';
+
+	AllocateDrivers(Drivers, DriversCount, static_cast<int>(Header.DriversCount));
+	if (Header.Version >= 2)
+	{
+		if (DriversCount)
+			std::memcpy(Drivers, Bits, SnapshotDriverBytes(Header.Version, Header.DriversCount));
+		// an odd count leaves a spare nibble in the last byte
+		if (DriversCount & 1)
+			WriteDriver(DriversCount, 0);
+	}
+	else
+	{
+		for (int i = 0; i < DriversCount; i++)
+			if ((Bits[i >> 3] >> (i & 7)) & 1)
+				WriteDriver(i, DRIVER_BUSY);
+	}
+	RecountDriverStates();
+
+	ReleaseAddresses();
+	AddressesCount = static_cast<int>(Header.AddressesCount);
+	if (AddressesCount > 0)
+	{
+		Addresses = new AddressId[AddressesCount];
+		Cursor = Table;
+		for (int i = 0; i < AddressesCount; i++)
+		{
+			std::uint16_t Len;
+			std::memcpy(&Len, Cursor, sizeof(Len));
+			Cursor += sizeof(Len);
+			Addresses[i] = Len ? AddressPool::InternOrUnknown(Cursor, Len) : UNKNOWN_ADDRESS_ID;
+			Cursor += Len;
+		}
+	}
+	WholeTaxiChanged();
+	return SnapshotRecordSize(Header);
+}
+
+namespace
+{
+	int DeltaBlocks(int Count, int BlockSize)
+	{
+		return (Count + BlockSize - 1) / BlockSize;
+	}
+
+	// Drivers of a block, the last one may be shorter
+	int DriverBlockSize(int Block, int DriversCount)
+	{
+		return std::min(DELTA_DRIVER_BLOCK, DriversCount - Block * DELTA_DRIVER_BLOCK);
+	}
+
+	bool IsBitSet(const std::vector<std::uint64_t>& Bits, int Index)
+	{
+		return (Bits[Index / 64] >> (Index % 64)) & 1;
+	}
+}
+
+void Taxi::StartDeltaTracking()
+{
+	DirtyDriverBlocks.assign((DeltaBlocks(DriversCount, DELTA_DRIVER_BLOCK) + 63) / 64, 0);
+	DirtyAddressBlocks.assign((DeltaBlocks(AddressesCount, DELTA_ADDRESS_BLOCK) + 63) / 64, 0);
+	DeltaTracking = true;
+	AnyDirtyBlock = false;
+}
+
+bool Taxi::AppendDelta(std::vector<char>& Out) const
+{
+	if (!DeltaTracking)
+		return false;
+	DeltaHeader Header = {};
+	std::memcpy(Header.Magic, DELTA_MAGIC, sizeof(Header.Magic));
+	Header.Version = DELTA_VERSION;
+	Header.HeaderSize = sizeof(DeltaHeader);
+	Header.DriversCount = static_cast<std::uint32_t>(DriversCount);
+	Header.AddressesCount = static_cast<std::uint32_t>(AddressesCount);
+	std::memcpy(Header.Passenger, Passenger, std::strlen(Passenger));
+
+	std::size_t Start = Out.size();
+	Out.resize(Start + sizeof(Header));
+	auto Put = [&Out](const void* Data, std::size_t Size)
+	{
+		const char* Bytes = static_cast<const char*>(Data);
+		Out.insert(Out.end(), Bytes, Bytes + Size);
+	};
+
+	int DriverBlocks = DeltaBlocks(DriversCount, DELTA_DRIVER_BLOCK);
+	for (int Block = 0; Block < DriverBlocks; Block++)
+	{
+		if (!IsBitSet(DirtyDriverBlocks, Block))
+			continue;
+		std::uint32_t Index = static_cast<std::uint32_t>(Block);
+		Put(&Index, sizeof(Index));
+		// same nibble order as a snapshot, straight from the little-endian words
+		Put(reinterpret_cast<const char*>(Drivers) + Block * (DELTA_DRIVER_BLOCK / 2),
+			(DriverBlockSize(Block, DriversCount) + 1) / 2);
+		Header.DriverBlocks++;
+	}
+
+	int AddressBlocks = DeltaBlocks(AddressesCount, DELTA_ADDRESS_BLOCK);
+	for (int Block = 0; Block < AddressBlocks; Block++)
+	{
+		if (!IsBitSet(DirtyAddressBlocks, Block))
+			continue;
+		std::uint32_t Index = static_cast<std::uint32_t>(Block);
+		Put(&Index, sizeof(Index));
+		int End = std::min(AddressesCount, (Block + 1) * DELTA_ADDRESS_BLOCK);
+		for (int i = Block * DELTA_ADDRESS_BLOCK; i < End; i++)
+		{
+			const char* Address = AddressPool::Get(Addresses[i]);
+			std::uint16_t Len = static_cast<std::uint16_t>(std::strlen(Address));
+			Put(&Len, sizeof(Len));
+			Put(Address, Len);
+		}
+		Header.AddressBlocks++;
+	}
+
+	Header.RecordSize = static_cast<std::uint32_t>(Out.size() - Start);
+	std::memcpy(Out.data() + Start, &Header, sizeof(Header));
+	return true;
+}
+
+std::size_t Taxi::ReadDelta(const char* Data, std::size_t Size)
+{
+	if (!IsDelta(Data, Size))
+		return 0;
+	DeltaHeader Header;
+	std::memcpy(&Header, Data, sizeof(Header));
+	if (Header.Version > DELTA_VERSION || Header.HeaderSize < sizeof(DeltaHeader)
+		|| Header.RecordSize < Header.HeaderSize || Header.RecordSize > Size
+		|| Header.DriversCount != static_cast<std::uint32_t>(DriversCount)
+		|| Header.AddressesCount != static_cast<std::uint32_t>(AddressesCount))
+		return 0;
+
+	// validate every block before touching the object
+	const char* End = Data + Header.RecordSize;
+	const char* Cursor = Data + Header.HeaderSize;
+	int DriverBlocks = DeltaBlocks(DriversCount, DELTA_DRIVER_BLOCK);
+	for (std::uint32_t b = 0; b < Header.DriverBlocks; b++)
+	{
+		std::uint32_t Block;
+		if (End - Cursor < static_cast<std::ptrdiff_t>(sizeof(Block)))
+			return 0;
+		std::memcpy(&Block, Cursor, sizeof(Block));
+		Cursor += sizeof(Block);
+		if (Block >= static_cast<std::uint32_t>(DriverBlocks))
+			return 0;
+		int Count = DriverBlockSize(static_cast<int>(Block), DriversCount);
+		if (End - Cursor < (Count + 1) / 2)
+			return 0;
+		for (int i = 0; i < Count; i++)
+			if (!IsValidDriverState((Cursor[i >> 1] >> ((i & 1) * 4)) & 0xF))
+				return 0;
+		Cursor += (Count + 1) / 2;
+	}
+	const char* AddressData = Cursor;
+	int AddressBlocks = DeltaBlocks(AddressesCount, DELTA_ADDRESS_BLOCK);
+	for (std::uint32_t b = 0; b < Header.AddressBlocks; b++)
+	{
+		std::uint32_t Block;
+		if (End - Cursor < static_cast<std::ptrdiff_t>(sizeof(Block)))
+			return 0;
+		std::memcpy(&Block, Cursor, sizeof(Block));
+		Cursor += sizeof(Block);
+		if (Block >= static_cast<std::uint32_t>(AddressBlocks))
+			return 0;
+		int Count = std::min(AddressesCount - static_cast<int>(Block) * DELTA_ADDRESS_BLOCK, DELTA_ADDRESS_BLOCK);
+		for (int i = 0; i < Count; i++)
+		{
+			std::uint16_t Len;
+			if (End - Cursor < static_cast<std::ptrdiff_t>(sizeof(Len)))
+				return 0;
+			std::memcpy(&Len, Cursor, sizeof(Len));
+			Cursor += sizeof(Len);
+			if (End - Cursor < Len)
+				return 0;
+			Cursor += Len;
+		}
+	}
+	if (Cursor != End)
+		return 0;
+
+	std::memcpy(Passenger, Header.Passenger, MAX_STR_LEN);
+	Passenger[MAX_STR_LEN - 1] = '\0';
+
+	Cursor = Data + Header.HeaderSize;
+	for (std::uint32_t b = 0; b < Header.DriverBlocks; b++)
+	{
+		std::uint32_t Block;
+		std::memcpy(&Block, Cursor, sizeof(Block));
+		Cursor += sizeof(Block);
+		int First = static_cast<int>(Block) * DELTA_DRIVER_BLOCK;
+		int Count = DriverBlockSize(static_cast<int>(Block), DriversCount);
+		for (int i = First; i < First + Count; i++)
+			StateCounts[ReadDriver(i)]--;
+		std::memcpy(reinterpret_cast<char*>(Drivers) + First / 2, Cursor, (Count + 1) / 2);
+		if (First + Count == DriversCount && (DriversCount & 1))
+			WriteDriver(DriversCount, 0);
+		for (int i = First; i < First + Count; i++)
+		{
+			StateCounts[ReadDriver(i)]++;
+			MarkDriverDirty(i);
+		}
+		Cursor += (Count + 1) / 2;
+	}
+
+	if (Header.AddressBlocks)
+		DetachAddresses();
+	Cursor = AddressData;
+	for (std::uint32_t b = 0; b < Header.AddressBlocks; b++)
+	{
+		std::uint32_t Block;
+		std::memcpy(&Block, Cursor, sizeof(Block));
+		Cursor += sizeof(Block);
+		int First = static_cast<int>(Block) * DELTA_ADDRESS_BLOCK;
+		int Last = std::min(AddressesCount, First + DELTA_ADDRESS_BLOCK);
+		for (int i = First; i < Last; i++)
+		{
+			std::uint16_t Len;
+			std::memcpy(&Len, Cursor, sizeof(Len));
+			Cursor += sizeof(Len);
+			Addresses[i] = Len ? AddressPool::InternOrUnknown(Cursor, Len) : UNKNOWN_ADDRESS_ID;
+			MarkAddressDirty(i);
+			Cursor += Len;
+		}
+	}
+	if (Header.DriverBlocks || Header.AddressBlocks)
+	{
+		NotifyTaxiChanged();
+	}
+	return Header.RecordSize;
+}
+
 void Taxi::SaveToFile(const char* FileName) const
+{
+	std::vector<char> Buffer;
+	AppendSnapshot(Buffer);
+	std::ofstream fout(FileName, std::ios::binary);
+	if (!fout)
+	{
+		std::cerr << "Failed to open file for saving: " << FileName << "\n";
+		return;
+	}
+	fout.write(Buffer.data(), static_cast<std::streamsize>(Buffer.size()));
+}
+
+void Taxi::LoadFromFile(const char* FileName)
+{
+	MappedFile File;
+	if (File.Open(FileName) && IsSnapshot(File.GetData(), File.GetSize()))
+	{
+		if (!ReadSnapshot(File.GetData(), File.GetSize()))
+			std::cerr << "Corrupted snapshot file: " << FileName << "\n";
+		return;
+	}
+	File.Close();
+	// not a snapshot, fall back to the text format
+	LoadFromTextFile(FileName);
+}
+
+void Taxi::SaveToTextFile(const char* FileName) const
 {
 	std::ofstream fout(FileName);
 	if (!fout)
-		std::cerr << "Failed to open file for saving: " << FileName << "\n"; return;
+	{
+		std::cerr << "Failed to open file for saving: " << FileName << "\n";
+		return;
+	}
 	fout << Passenger << "\n";
 	fout << DriversCount << "\n";
 	for (int i = 0; i < DriversCount; i++)
-		fout << Drivers[i] << "\n";
+		fout << ReadDriver(i) << "\n";
 	fout << AddressesCount << "\n";
 	for (int i = 0; i < AddressesCount; i++)
-		fout << Addresses[i] << "\n";
+		fout << AddressPool::Get(Addresses[i]) << "\n";
 	fout.close();
 }
 
-void Taxi::LoadFromFile(const char* FileName)
+void Taxi::LoadFromTextFile(const char* FileName)
 {
 	std::ifstream fin(FileName);
 	if (!fin)
@@ -309,35 +988,54 @@ void Taxi::LoadFromFile(const char* FileName)
 		std::cerr << "Failed to open file for loading: " << FileName << "\n";
 		return;
 	}
-	fin.getline(Passenger, MAX_STR_LEN);
-	fin >> DriversCount;
-	if (DriversCount < 0)
-		DriversCount = 0;
-	AllocateDrivers(Drivers, DriversCount, DriversCount);
-	for (int i = 0; i < DriversCount; i++)
+	// read everything first, the taxi is only changed once the whole file is good
+	char NewPassenger[MAX_STR_LEN] = {};
+	fin.getline(NewPassenger, MAX_STR_LEN);
+	int NewDriversCount = 0;
+	fin >> NewDriversCount;
+	if (!fin)
+	{
+		std::cerr << "Failed to load " << FileName << ": no drivers count\n";
+		return;
+	}
+	if (NewDriversCount < 0)
+		NewDriversCount = 0;
+	std::vector<int> States;
+	for (int i = 0; i < NewDriversCount; i++)
 	{
 		int st;
 		fin >> st;
-		if (st != DRIVER_FREE && st != DRIVER_BUSY)
-			st = DRIVER_FREE;
-		Drivers[i] = st;
+		if (!fin || !IsValidDriverState(st))
+		{
+			std::cerr << "Failed to load " << FileName << ": invalid state of driver #" << i << "\n";
+			return;
+		}
+		States.push_back(st);
 	}
-	fin >> AddressesCount;
+	int NewAddressesCount = 0;
+	fin >> NewAddressesCount;
 	fin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-	delete[] Addresses;
-	Addresses = nullptr;
-	if (AddressesCount < 0) AddressesCount = 0;
-	if (AddressesCount > 0)
+	if (NewAddressesCount < 0)
+		NewAddressesCount = 0;
+	std::vector<AddressId> NewAddresses;
+	char Buffer[MAX_STR_LEN];
+	for (int i = 0; i < NewAddressesCount; i++)
 	{
-		Addresses = new char[AddressesCount][MAX_STR_LEN];
-		for (int i = 0; i < AddressesCount; i++)
-		{
-			fin.getline(Addresses[i], MAX_STR_LEN);
-			if (!std::strlen(Addresses[i]))
-				std::strcpy(Addresses[i], "UnknownAddr");
-		}
+		Buffer[0] = '\0';
+		fin.getline(Buffer, MAX_STR_LEN);
+		NewAddresses.push_back(std::strlen(Buffer) ? AddressPool::InternOrUnknown(Buffer) : UNKNOWN_ADDRESS_ID);
 	}
 	fin.close();
+
+	std::memcpy(Passenger, NewPassenger, MAX_STR_LEN);
+	delete[] Drivers;
+	DriversCount = NewDriversCount;
+	Drivers = PackDrivers(States.data(), DriversCount);
+	RecountDriverStates();
+	ReleaseAddresses();
+	AddressesCount = NewAddressesCount;
+	Addresses = CopyAddresses(NewAddresses.data(), AddressesCount);
+	WholeTaxiChanged();
 }
 
 std::istream& operator>>(std::istream& InStream, Taxi& Obj)
@@ -359,13 +1057,15 @@ std::istream& operator>>(std::istream& InStream, Taxi& Obj)
 	Obj.SetDriversCount(dc);
 	for (int i = 0; i < Obj.GetDriversCount(); i++)
 	{
-		std::cout << "  Driver #" << i << " state (0=FREE,1=BUSY): ";
+		std::cout << "  Driver #" << i << " state (" << DRIVER_STATE_PROMPT << "): ";
 		int st;
-		InStream >> st;
-		if (!InStream || (st != DRIVER_FREE && st != DRIVER_BUSY))
+		while (!(InStream >> st) || !IsValidDriverState(st))
 		{
-			st = DRIVER_FREE;
+			if (InStream.eof())
+				return InStream;
 			InStream.clear();
+			InStream.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+			std::cout << "  Invalid driver state. Please try again: ";
 		}
 		Obj.SetDriverState(i, st);
 	}
@@ -386,7 +1086,7 @@ std::istream& operator>>(std::istream& InStream, Taxi& Obj)
 		lineBuf[0] = '\0';
 		InStream.getline(lineBuf, MAX_STR_LEN);
 		if (std::strlen(lineBuf) == 0)
-			std::strcpy(lineBuf, "UnknownAddr");
+			std::strcpy(lineBuf, UNKNOWN_ADDRESS);
 		Obj.SetAddress(i, lineBuf);
 	}
 	return InStream;
@@ -399,9 +1099,8 @@ std::ostream& operator<<(std::ostream& OutStream, const Taxi& Obj)
 		<< "DriversCount: " << Obj.GetDriversCount() << "\n";
 	for (int i = 0; i < Obj.GetDriversCount(); i++)
 	{
-		int st = Obj.GetDriverState(i);
 		OutStream << "  Driver #" << i
-			<< (st == DRIVER_FREE ? " => FREE" : " => BUSY")
+			<< " => " << GetDriverStateName(Obj.GetDriverState(i))
 			<< "\n";
 	}
 	OutStream << "AddressesCount: " << Obj.GetAddressesCount() << "\n";
@@ -436,8 +1135,12 @@ std::ifstream& operator>>(std::ifstream& InFile, Taxi& Obj)
 	{
 		int st;
 		InFile >> st;
-		if (st != DRIVER_FREE && st != DRIVER_BUSY)
-			st = DRIVER_FREE;
+		if (!InFile || !IsValidDriverState(st))
+		{
+			std::cerr << "Failed to read taxi: invalid state of driver #" << i << "\n";
+			InFile.setstate(std::ios::failbit);
+			return InFile;
+		}
 		Obj.SetDriverState(i, st);
 	}
 	InFile.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
@@ -456,7 +1159,7 @@ std::ifstream& operator>>(std::ifstream& InFile, Taxi& Obj)
 		addrBuf[0] = '\0';
 		InFile.getline(addrBuf, MAX_STR_LEN);
 		if (std::strlen(addrBuf) == 0)
-			std::strcpy(addrBuf, "UnknownAddr");
+			std::strcpy(addrBuf, UNKNOWN_ADDRESS);
 		Obj.SetAddress(i, addrBuf);
 	}
 	return InFile;
@@ -475,59 +1178,62 @@ std::ofstream& operator<<(std::ofstream& OutFile, const Taxi& Obj)
 	for (int i = 0; i < ac; i++)
 	{
 		const char* A = Obj.GetAddress(i);
-		OutFile << (A ? A : "UnknownAddr") << "\n";
+		OutFile << (A ? A : UNKNOWN_ADDRESS) << "\n";
 	}
 	return OutFile;
 }
 
+std::strong_ordering TaxiSortKey::operator<=>(const TaxiSortKey& Other) const
+{
+	if (PassengerPrefix != Other.PassengerPrefix)
+		return PassengerPrefix <=> Other.PassengerPrefix;
+	// equal prefixes without a terminator inside mean the names may differ further on
+	if ((PassengerPrefix & 0xFF) != 0)
+	{
+		int cmp = std::strcmp(Passenger + 8, Other.Passenger + 8);
+		if (cmp != 0)
+			return cmp <=> 0;
+	}
+	return FreeDrivers <=> Other.FreeDrivers;
+}
+
+TaxiSortKey Taxi::GetSortKey() const
+{
+	std::uint64_t Prefix = 0;
+	int i = 0;
+	for (; i < 8 && Passenger[i]; i++)
+		Prefix = (Prefix << 8) | static_cast<unsigned char>(Passenger[i]);
+	if (i > 0)
+		Prefix <<= 8 * (8 - i);
+	return { Prefix, StateCounts[DRIVER_FREE], Passenger };
+}
+
 bool Taxi::operator==(const Taxi& Other) const
 {
-	// match passenger name & # of free drivers
-	if (std::strcmp(Passenger, Other.Passenger) != 0)
-		return false;
-	int freeThis = 0; // compare free drivers
-	for (int i = 0; i < GetDriversCount(); i++)
-		if (GetDriverState(i) == DRIVER_FREE)
-			freeThis++;
-	int freeOther = 0;
-	for (int i = 0; i < Other.GetDriversCount(); i++)
-		if (Other.GetDriverState(i) == DRIVER_FREE)
-			freeOther++;
-	return freeThis == freeOther;
-}
-
-bool Taxi::operator<(const Taxi& Other) const
-{
-	// compare passenger name lexicly
-	int cmp = std::strcmp(Passenger, Other.Passenger);
-	if (cmp < 0) return true;
-	if (cmp > 0) return false;
-	int freeThis = 0; // if equal names, compare free drivers ascending
-	for (int i = 0; i < GetDriversCount(); i++)
-		if (GetDriverState(i) == DRIVER_FREE)
-			freeThis++;
-	int freeOther = 0;
-	for (int j = 0; j < Other.GetDriversCount(); j++)
-		if (Other.GetDriverState(j) == DRIVER_FREE)
-			freeOther++;
-	return freeThis < freeOther;
+	// match # of free drivers first, it is cached, then the passenger name
+	return StateCounts[DRIVER_FREE] == Other.StateCounts[DRIVER_FREE]
+		&& std::strcmp(Passenger, Other.Passenger) == 0;
 }
 
 void Taxi::SetDriversCount(int NewCount)
 {
 	AllocateDrivers(Drivers, DriversCount, NewCount);
+	std::fill(std::begin(StateCounts), std::end(StateCounts), 0);
+	StateCounts[DRIVER_FREE] = DriversCount;
+	WholeTaxiChanged();
 }
 
 void Taxi::SetAddressesCount(int NewCount)
 {
 	if (NewCount < 0) NewCount = 0;
-	delete[] Addresses;
-	Addresses = nullptr;
+	ReleaseAddresses();
 	if (NewCount == 0)
 	{
-		AddressesCount = 0; return;
+		AddressesCount = 0;
+		WholeTaxiChanged();
+		return;
 	}
 	AddressesCount = NewCount;
-	Addresses = new char[AddressesCount][MAX_STR_LEN];
-	for (int i = 0; i < AddressesCount; i++) std::strcpy(Addresses[i], "UnknownAddr");
+	Addresses = AllocateUnknownAddresses(AddressesCount);
+	WholeTaxiChanged();
 }
\ No newline at end of file
@@ -1,12 +1,44 @@
 #pragma once
 
 #include "AbstractTaxi.h"
+#include "AddressPool.h"
+#include "DriverState.h"
+#include "TaxiListener.h"
+#include <atomic>
 #include <iostream>
+#include <compare>
+#include <cstddef>
+#include <cstdint>
 #include <fstream>
+#include <utility>
+#include <vector>
 
-// Possible driver states
-const int DRIVER_FREE = 0;
-const int DRIVER_BUSY = 1;
+class AddressCatalogView;
+
+// Listeners a taxi can have at once: a journal, a shared memory copy and an index
+const int MAX_TAXI_LISTENERS = 3;
+
+// Precomputed ordering key of a Taxi. The first 8 passenger characters are packed
+// big-endian, so comparing prefixes as integers gives the same order as strcmp.
+struct TaxiSortKey
+{
+	std::uint64_t PassengerPrefix;
+	int FreeDrivers;
+	// The whole name, only looked at when the prefixes are equal
+	const char* Passenger;
+
+	std::strong_ordering operator<=>(const TaxiSortKey& Other) const;
+	bool operator==(const TaxiSortKey& Other) const { return (*this <=> Other) == 0; }
+};
+
+// How a copy gets the address table of the original
+enum class AddressCopy
+{
+	// A table of its own, copied right away
+	Deep,
+	// One table for both until either taxi writes to it (copy-on-write)
+	Shared
+};
 
 class Taxi : public AbstractTaxi
 {
@@ -15,44 +47,124 @@ public:
 	Taxi(const char* InPassenger,
 		const int* InDrivers, int InDriversCount,
 		const char (*InAddresses)[MAX_STR_LEN], int InAddressesCount);
+	// Copies the addresses as SetDefaultAddressCopy says
 	Taxi(const Taxi& Other);
+	// Copies the addresses as Mode says, whatever the default is
+	Taxi(const Taxi& Other, AddressCopy Mode);
+	Taxi(Taxi&& Other) noexcept;
 	~Taxi();
 
-	// Return number of free drivers
-	int Order();
+	Taxi& operator=(const Taxi& Other);
+	// Exchanges the state with Other like Swap
+	Taxi& operator=(Taxi&& Other) noexcept;
+
+	// Exchange all state with another taxi, including the object number.
+	// Delta tracking stops on both, so the next checkpoint saves them whole. The listeners
+	// are not told: whoever moves taxis around (a sort, a compaction) calls PublishWhole on
+	// the taxis that ended up with other contents once it is done.
+	void Swap(Taxi& Other) noexcept;
+	// Hands the whole taxi to the listeners and stops delta tracking
+	void PublishWhole() { WholeTaxiChanged(); }
+
+	// Sends every later change of this taxi to Listener under Key (TaxiListener.h).
+	// Attaching again only changes the key; false once MAX_TAXI_LISTENERS are attached.
+	// The attachments stay with this object: copies are not attached, a move hands them
+	// over and Swap leaves them where they are. A listener must detach before it goes away.
+	bool AttachListener(TaxiListener* Listener, std::uint32_t Key);
+	void DetachListener(const TaxiListener* Listener);
+	bool IsAttached(const TaxiListener* Listener) const;
+
+	// Takes the addresses of a catalog (AddressCatalog.h). Only the pointer is kept, and it
+	// is copied to copies of the taxi, so the catalog must have static storage duration
+	// (a constexpr catalog at namespace scope or a static one), never a local or heap object.
+	// While the addresses stay as they are, Order finds an address with the catalog's perfect
+	// hash instead of the address pool and a scan; changing any address drops the catalog
+	// and the taxi goes on with its own table. False for an invalid catalog.
+	bool UseCatalog(const AddressCatalogView& InCatalog);
+	const AddressCatalogView* GetCatalog() const { return Catalog; }
+
+	// Address policy of the copy constructor and copy assignment. It may be changed while
+	// other threads copy taxis; code that depends on one policy passes it to the
+	// constructor instead. Taxis sharing a table may be copied and destroyed on any thread.
+	static void SetDefaultAddressCopy(AddressCopy Mode) { DefaultAddressCopy.store(Mode, std::memory_order_relaxed); }
+	static AddressCopy GetDefaultAddressCopy() { return DefaultAddressCopy.load(std::memory_order_relaxed); }
+
+	// Return number of free drivers, kept up to date by every driver state change
+	int Order() const { return StateCounts[DRIVER_FREE]; }
 
 	// Check if given address is in the array of addresses
 	bool Order(const char* InAddress);
+	// Same, returns the index of the driver that took the order or -1
+	int OrderDriver(const char* InAddress);
 
 	// Orders the driver by address
 	bool Order(int DriverIndex, const char* InAddress);
+	// Check if an interned address is one of ours
+	bool HasAddress(AddressId Id) const;
 
 	// Polymorphic function required by base class
 	// This overrides the pure virtual method from AbstractTaxi
 	void PrintInfo() const override;
+	void AppendInfo(std::string& Out, int TotalCount) const override;
 
 	void InputFromConsole();
 	void PrintToConsole() const;
 
+	// Binary snapshot, see TaxiSnapshot.h. LoadFromFile also accepts the text format.
 	void SaveToFile(const char* FileName) const;
 	void LoadFromFile(const char* FileName);
 
+	// One value per line text format, kept for exports and manual editing
+	void SaveToTextFile(const char* FileName) const;
+	void LoadFromTextFile(const char* FileName);
+
+	// Appends a binary snapshot record of this taxi to Out
+	void AppendSnapshot(std::vector<char>& Out) const;
+	// Restores the taxi from a snapshot record, returns the record size or 0 if the data is invalid
+	std::size_t ReadSnapshot(const char* Data, std::size_t Size);
+
+	// Delta checkpoints (see FleetCheckpoint.h): from StartDeltaTracking on, the blocks of
+	// drivers and addresses that change are remembered. Anything that changes the layout
+	// (counts, loads, assignments) stops the tracking until it is started again.
+	// The Passenger field is not tracked, it is written with every delta.
+	void StartDeltaTracking();
+	bool IsDeltaTracking() const { return DeltaTracking; }
+	bool HasDirtyBlocks() const { return AnyDirtyBlock; }
+	// Appends a delta record of the changed blocks (TaxiSnapshot.h), false when not tracking
+	bool AppendDelta(std::vector<char>& Out) const;
+	// Applies a delta record, returns its size or 0 if it is invalid or made for another layout
+	std::size_t ReadDelta(const char* Data, std::size_t Size);
+
+	// State of a driver as an int (see DriverState.h), -1 for a bad index
 	int  GetDriverState(int Index) const;
-	void SetDriverState(int Index, int State);
+	// Sets any valid state without checking the transition, returns false for a bad index or state
+	bool SetDriverState(int Index, int State);
+	// Moves a driver to another state if IsValidTransition allows it
+	bool TransitionDriver(int Index, DriverState To);
 	int GetDriversCount() const { return DriversCount; }
+	int GetFreeDriversCount() const { return StateCounts[DRIVER_FREE]; }
+	// Number of drivers in a state, kept up to date like the free count
+	int GetDriversInState(DriverState State) const { return StateCounts[static_cast<int>(State)]; }
+	// Resizes to NewCount FREE drivers
 	void SetDriversCount(int NewCount);
 
 	const char* GetAddress(int Index) const;
+	// Interned id of an address, INVALID_ADDRESS_ID for a bad index
+	AddressId GetAddressId(int Index) const;
 	void SetAddress(int Index, const char* NewAddress);
+	// Same, for an address that is not zero terminated
+	void SetAddress(int Index, const char* NewAddress, std::size_t Length);
 	int GetAddressesCount() const { return AddressesCount; }
 	void SetAddressesCount(int NewCount);
 
 	// Implement IAutoNumber:
 	int GetObjectNumber() const override { return ObjectNumber; }
-	int GetTotalCount() const override { return Count; }
+	int GetTotalCount() const override { return GetCount(); }
 
 	// Implement IStringConvertible:
+	// Both use the single line format of TaxiCodec.h
 	std::string ToString() const override;
+	void AppendString(std::string& Out) const override;
 	void FromString(const std::string& InStr) override;
 
 	friend std::istream& operator>>(std::istream& InStream, Taxi& Obj);
@@ -61,22 +173,68 @@ public:
 	friend std::ifstream& operator>>(std::ifstream& InFile, Taxi& Obj);
 	friend std::ofstream& operator<<(std::ofstream& OutFile, const Taxi& Obj);
 
+	// Taxis are ordered by passenger name, then by number of free drivers.
+	// Both compare the cached free count, so they do not scan the drivers.
 	bool operator==(const Taxi& Other) const;
-	bool operator!=(const Taxi& Other) const { return !(*this == Other); }
+	std::strong_ordering operator<=>(const Taxi& Other) const { return GetSortKey() <=> Other.GetSortKey(); }
 
-	bool operator<(const Taxi& Other) const;
-	bool operator>(const Taxi& Other) const { return Other < *this; }
-	bool operator<=(const Taxi& Other) const { return !(Other < *this); }
-	bool operator>=(const Taxi& Other) const { return !(*this < Other); }
+	TaxiSortKey GetSortKey() const;
 
 	char Passenger[MAX_STR_LEN];
 
 protected:
-	char (*Addresses)[MAX_STR_LEN];
+	// Ids of interned address strings, see AddressPool
+	AddressId* Addresses;
 
 private:
-	int* Drivers;
+	// Make our own copy of a shared address table before writing to it
+	void DetachAddresses();
+	// Drop our reference to the address table, freeing it if we were the last user
+	void ReleaseAddresses();
+	// Take the addresses of Other, sharing or deep copying them
+	void AcquireAddresses(const Taxi& Other, AddressCopy Mode);
+	// Whether the address is one of ours, through the catalog when there is one
+	bool KnowsAddress(const char* InAddress) const;
+	// Recount StateCounts after the drivers were written directly
+	void RecountDriverStates();
+	// Raw access to the packed states, Index must be valid
+	int ReadDriver(int Index) const
+	{
+		return static_cast<int>((Drivers[Index / DRIVERS_PER_WORD] >> (Index % DRIVERS_PER_WORD * DRIVER_STATE_BITS)) & 0xF);
+	}
+	void WriteDriver(int Index, int State);
+	// After changes too big for one record: stops delta tracking and hands the whole
+	// taxi to the listeners
+	void WholeTaxiChanged();
+	void NotifyTaxiChanged() const;
+	void MarkDriverDirty(int Index);
+	void MarkAddressDirty(int Index);
+
+	// Driver states, DRIVER_STATE_BITS each, DRIVERS_PER_WORD to a word
+	std::uint64_t* Drivers;
+	// Number of taxis sharing 'Addresses', nullptr while the table was never shared.
+	// Copying a const taxi installs it, so concurrent copies race to set it: atomic.
+	using AddressRefCount = std::atomic<int>;
+	mutable std::atomic<AddressRefCount*> AddressesRefCount;
+	struct ListenerSlot
+	{
+		TaxiListener* Listener;
+		std::uint32_t Key;
+	};
+	ListenerSlot Listeners[MAX_TAXI_LISTENERS] = {};
+	int ListenerCount = 0;
+	// Static catalog the addresses came from, nullptr once they changed
+	const AddressCatalogView* Catalog = nullptr;
+	// One bit per block of DELTA_DRIVER_BLOCK drivers / DELTA_ADDRESS_BLOCK addresses
+	std::vector<std::uint64_t> DirtyDriverBlocks;
+	std::vector<std::uint64_t> DirtyAddressBlocks;
+	bool DeltaTracking = false;
+	bool AnyDirtyBlock = false;
 
 	int DriversCount;
+	// Drivers in every state, StateCounts[DRIVER_FREE] is the free count
+	int StateCounts[DRIVER_STATE_COUNT];
 	int AddressesCount;
+
+	static std::atomic<AddressCopy> DefaultAddressCopy;
 };
\ No newline at end of file
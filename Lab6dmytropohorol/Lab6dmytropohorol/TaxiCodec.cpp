@@ -0,0 +1,290 @@
+#include "TaxiCodec.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+namespace
+{
+	const char FIELD_PASSENGER[] = "Passenger=";
+	const char FIELD_DRIVERS_COUNT[] = ", DriversCount=";
+	const char FIELD_ADDRESSES_COUNT[] = ", AddressesCount=";
+	const char FIELD_DRIVERS[] = ", Drivers=";
+	const char FIELD_ADDRESSES[] = ", Addresses=";
+	// Characters of an int and of a string of at most MAX_STR_LEN - 1 characters, every one escaped
+	const std::size_t MAX_INT_CHARS = 11;
+	const std::size_t MAX_ESCAPED_CHARS = 2 * (MAX_STR_LEN - 1);
+
+	bool IsEscaped(char C)
+	{
+		return C == ',' || C == '|' || C == '\\';
+	}
+
+	template <std::size_t N>
+	char* Put(char* Cursor, const char (&Text)[N])
+	{
+		std::memcpy(Cursor, Text, N - 1);
+		return Cursor + N - 1;
+	}
+
+	char* PutEscaped(char* Cursor, const char* Str)
+	{
+		for (; *Str; Str++)
+		{
+			if (IsEscaped(*Str))
+				*Cursor++ = '\\';
+			*Cursor++ = *Str;
+		}
+		return Cursor;
+	}
+
+	char* PutInt(char* Cursor, int Value)
+	{
+		return std::to_chars(Cursor, Cursor + MAX_INT_CHARS, Value).ptr;
+	}
+
+	// Copies an escaped value to Out (MAX_STR_LEN bytes), dropping the escapes.
+	// Returns the unescaped length or -1 if it does not fit.
+	int Unescape(std::string_view Value, char* Out)
+	{
+		int Len = 0;
+		for (std::size_t i = 0; i < Value.size(); i++)
+		{
+			char C = Value[i];
+			if (C == '\\' && i + 1 < Value.size())
+				C = Value[++i];
+			if (Len == MAX_STR_LEN - 1)
+				return -1;
+			Out[Len++] = C;
+		}
+		Out[Len] = '\0';
+		return Len;
+	}
+
+	// Returns the position of the next unescaped Separator at or after From
+	std::size_t FindUnescaped(std::string_view Str, std::size_t From, char Separator)
+	{
+		const char* Data = Str.data();
+		const char* End = Data + Str.size();
+		const char* Cursor = Data + From;
+		while (Cursor < End)
+		{
+			const char* Found = static_cast<const char*>(std::memchr(Cursor, Separator, End - Cursor));
+			if (!Found)
+				break;
+			// escapes are rare, only step over them when there is one before the separator
+			const char* Escape = static_cast<const char*>(std::memchr(Cursor, '\\', Found - Cursor));
+			if (!Escape)
+				return Found - Data;
+			Cursor = Escape + 2;
+		}
+		return Str.size();
+	}
+
+	// End of the address starting at From in an Addresses value
+	std::size_t NextAddress(std::string_view Addresses, std::size_t From, bool Escaped)
+	{
+		if (Escaped)
+			return FindUnescaped(Addresses, From, '|');
+		const void* Found = std::memchr(Addresses.data() + From, '|', Addresses.size() - From);
+		return Found ? static_cast<const char*>(Found) - Addresses.data() : Addresses.size();
+	}
+
+	bool ParseCount(std::string_view Value, int& Count)
+	{
+		while (!Value.empty() && Value.front() == ' ')
+			Value.remove_prefix(1);
+		std::from_chars_result Res = std::from_chars(Value.data(), Value.data() + Value.size(), Count);
+		if (Res.ec != std::errc())
+			return false;
+		if (Count < 0)
+			Count = 0;
+		return true;
+	}
+
+	// Escaped tells whether Value may hold escapes
+	void SetAddressValue(Taxi& Obj, int Index, std::string_view Value, bool Escaped)
+	{
+		if (Value.empty())
+		{
+			Obj.SetAddress(Index, UNKNOWN_ADDRESS, std::strlen(UNKNOWN_ADDRESS));
+			return;
+		}
+		Escaped = Escaped && std::memchr(Value.data(), '\\', Value.size());
+		if (!Escaped)
+		{
+			// parsing into a reused taxi mostly finds the address already there
+			const char* Current = Obj.GetAddress(Index);
+			if (Current && std::strncmp(Current, Value.data(), Value.size()) == 0 && Current[Value.size()] == '\0')
+				return;
+			Obj.SetAddress(Index, Value.data(), Value.size());
+			return;
+		}
+		char Buf[MAX_STR_LEN];
+		int Len = Unescape(Value, Buf);
+		Obj.SetAddress(Index, Buf, Len < 0 ? MAX_STR_LEN - 1 : static_cast<std::size_t>(Len));
+	}
+
+	// Splits the next "Key=Value" field off Cursor. Value ends at the first unescaped ','
+	// and Escaped tells whether it held a '\'. Returns false for a field without '='.
+	bool NextField(const char*& Cursor, const char* End, std::string_view& Key, std::string_view& Value, bool& Escaped)
+	{
+		while (Cursor < End && *Cursor == ' ')
+			Cursor++;
+		const char* KeyStart = Cursor;
+		while (Cursor < End && *Cursor != '=' && *Cursor != ',')
+			Cursor++;
+		if (Cursor == End || *Cursor == ',')
+		{
+			Cursor += Cursor < End;
+			return false;
+		}
+		Key = std::string_view(KeyStart, Cursor - KeyStart);
+		const char* ValueStart = ++Cursor;
+		Escaped = false;
+		for (; Cursor < End && *Cursor != ','; Cursor++)
+			if (*Cursor == '\\' && Cursor + 1 < End)
+			{
+				Escaped = true;
+				Cursor++;
+			}
+		Value = std::string_view(ValueStart, Cursor - ValueStart);
+		Cursor += Cursor < End;
+		return true;
+	}
+}
+
+void AppendTaxiString(const Taxi& Obj, std::string& Out)
+{
+	int DriversCount = Obj.GetDriversCount();
+	int AddressesCount = Obj.GetAddressesCount();
+
+	// room for the longest possible line, written through a pointer and cut to size after
+	std::size_t Start = Out.size();
+	Out.resize(Start + sizeof(FIELD_PASSENGER) + sizeof(FIELD_DRIVERS_COUNT) + sizeof(FIELD_ADDRESSES_COUNT)
+		+ sizeof(FIELD_DRIVERS) + sizeof(FIELD_ADDRESSES) + MAX_ESCAPED_CHARS + 2 * MAX_INT_CHARS
+		+ DriversCount + static_cast<std::size_t>(AddressesCount) * (MAX_ESCAPED_CHARS + 1));
+	char* Cursor = Out.data() + Start;
+
+	Cursor = Put(Cursor, FIELD_PASSENGER);
+	Cursor = PutEscaped(Cursor, Obj.Passenger);
+	Cursor = Put(Cursor, FIELD_DRIVERS_COUNT);
+	Cursor = PutInt(Cursor, DriversCount);
+	Cursor = Put(Cursor, FIELD_ADDRESSES_COUNT);
+	Cursor = PutInt(Cursor, AddressesCount);
+	Cursor = Put(Cursor, FIELD_DRIVERS);
+	for (int i = 0; i < DriversCount; i++)
+		*Cursor++ = static_cast<char>('0' + Obj.GetDriverState(i));
+	Cursor = Put(Cursor, FIELD_ADDRESSES);
+	for (int i = 0; i < AddressesCount; i++)
+	{
+		if (i > 0)
+			*Cursor++ = '|';
+		const char* Address = Obj.GetAddress(i);
+		Cursor = PutEscaped(Cursor, Address ? Address : "");
+	}
+	Out.resize(Cursor - Out.data());
+}
+
+bool ParseTaxiString(std::string_view In, Taxi& Obj)
+{
+	std::string_view Passenger, Drivers, Addresses;
+	bool HasPassenger = false, HasDrivers = false, HasAddresses = false;
+	int DriversCount = -1, AddressesCount = -1;
+	bool Ok = true;
+
+	// split "Key=Value, Key=Value" once, remembering the values
+	const char* Cursor = In.data();
+	const char* End = Cursor + In.size();
+	bool AddressesEscaped = false;
+	while (Cursor < End)
+	{
+		std::string_view Key, Value;
+		bool Escaped;
+		if (!NextField(Cursor, End, Key, Value, Escaped))
+			continue;
+		if (Key == "Passenger")
+		{
+			Passenger = Value;
+			HasPassenger = true;
+		}
+		else if (Key == "DriversCount")
+			Ok = ParseCount(Value, DriversCount) && Ok;
+		else if (Key == "AddressesCount")
+			Ok = ParseCount(Value, AddressesCount) && Ok;
+		else if (Key == "Drivers")
+		{
+			Drivers = Value;
+			HasDrivers = true;
+		}
+		else if (Key == "Addresses")
+		{
+			Addresses = Value;
+			AddressesEscaped = Escaped;
+			HasAddresses = true;
+		}
+	}
+
+	// check every field before the taxi is touched, so a rejected line changes nothing
+	char PassengerBuf[MAX_STR_LEN];
+	int PassengerLen = 0;
+	if (HasPassenger && !Passenger.empty())
+	{
+		PassengerLen = Unescape(Passenger, PassengerBuf);
+		if (PassengerLen <= 0)
+			Ok = false;
+	}
+	if (DriversCount < 0 && HasDrivers)
+		DriversCount = static_cast<int>(Drivers.size());
+	if (HasDrivers && DriversCount > 0)
+	{
+		std::size_t Given = std::min(Drivers.size(), static_cast<std::size_t>(DriversCount));
+		for (std::size_t i = 0; i < Given; i++)
+			if (!IsValidDriverState(Drivers[i] - '0'))
+				Ok = false;
+	}
+	if (!Ok)
+		return false;
+
+	if (PassengerLen > 0)
+		std::memcpy(Obj.Passenger, PassengerBuf, PassengerLen + 1);
+
+	if (DriversCount >= 0)
+	{
+		// keep the drivers array when the size is unchanged, a new one is all FREE
+		bool Fresh = DriversCount != Obj.GetDriversCount();
+		if (Fresh)
+			Obj.SetDriversCount(DriversCount);
+		for (int i = 0; i < DriversCount; i++)
+		{
+			int State = HasDrivers && i < static_cast<int>(Drivers.size()) ? Drivers[i] - '0' : DRIVER_FREE;
+			if (State != DRIVER_FREE || !Fresh)
+				Obj.SetDriverState(i, State);
+		}
+	}
+
+	if (AddressesCount < 0 && HasAddresses)
+	{
+		AddressesCount = 0;
+		for (std::size_t i = 0; i < Addresses.size(); i = NextAddress(Addresses, i, AddressesEscaped) + 1)
+			AddressesCount++;
+	}
+	if (AddressesCount >= 0)
+	{
+		// a fresh table is all "UnknownAddr", otherwise every entry is overwritten in place
+		if (!HasAddresses || AddressesCount != Obj.GetAddressesCount())
+			Obj.SetAddressesCount(AddressesCount);
+		std::size_t From = 0;
+		for (int i = 0; HasAddresses && i < AddressesCount; i++)
+		{
+			std::string_view Item;
+			if (From < Addresses.size())
+			{
+				std::size_t ItemEnd = NextAddress(Addresses, From, AddressesEscaped);
+				Item = Addresses.substr(From, ItemEnd - From);
+				From = ItemEnd + 1;
+			}
+			SetAddressValue(Obj, i, Item, AddressesEscaped);
+		}
+	}
+	return true;
+}
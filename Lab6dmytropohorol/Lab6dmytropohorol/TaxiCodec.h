@@ -0,0 +1,21 @@
+#pragma once
+
+#include "Taxi.h"
+#include <string>
+#include <string_view>
+
+// Single line form of a Taxi, used by ToString/FromString:
+//   Passenger=Bob, DriversCount=3, AddressesCount=2, Drivers=010, Addresses=Main St|Park Ave
+// Drivers has one digit per driver (the DriverState value), addresses are separated by '|'.
+// Inside values ',', '|' and '\' are escaped with a '\'.
+// The older "Passenger=.., DriversCount=.., AddressesCount=.." strings still parse:
+// missing driver states are FREE and missing addresses are "UnknownAddr".
+
+// Appends the encoded taxi to Out. Out grows at most once, so a reused string does
+// not allocate after the first call.
+void AppendTaxiString(const Taxi& Obj, std::string& Out);
+
+// Parses the fields in one pass without temporary strings. Missing fields leave their
+// part of the taxi unchanged. If any field is malformed nothing is changed and it
+// returns false.
+bool ParseTaxiString(std::string_view In, Taxi& Obj);
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+class Taxi;
+
+// Receives the changes of the taxis it is attached to (Taxi::AttachListener), right after
+// they are made. FleetJournal logs them, SharedFleetState publishes them and FleetIndex
+// repositions the taxi. Key is the value given when attaching, usually the fleet index.
+// The calls come from the thread that changed the taxi, under whatever lock it holds.
+class TaxiListener
+{
+public:
+	virtual ~TaxiListener() = default;
+
+	// One driver went from OldState to State
+	virtual void DriverChanged(std::uint32_t Key, const Taxi& Obj, int Index, int OldState, int State) = 0;
+	// One address was replaced, Obj.GetAddress(Index) is the new one
+	virtual void AddressChanged(std::uint32_t Key, const Taxi& Obj, int Index) = 0;
+	// Anything bigger: counts, loads, assignments, UseCatalog, Taxi::PublishWhole
+	virtual void TaxiChanged(std::uint32_t Key, const Taxi& Obj) = 0;
+};
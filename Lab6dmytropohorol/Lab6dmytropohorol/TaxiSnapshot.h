@@ -0,0 +1,89 @@
+#pragma once
+
+#include "AbstractTaxi.h"
+#include <cstddef>
+#include <cstdint>
+
+// Binary snapshot of one Taxi, as written by Taxi::SaveToFile.
+// Layout: SnapshotHeader, then the driver states, then AddressesCount strings,
+// each one a uint16 length followed by the characters without a terminating zero.
+// Driver states are 4-bit DriverState values, two per byte, low nibble first
+// (version 2), or a bitset with bit set = BUSY, least significant bit first (version 1).
+// Integers are stored in native byte order (little-endian on every platform we build for).
+
+const char SNAPSHOT_MAGIC[4] = { 'T', 'X', 'S', 'N' };
+const std::uint16_t SNAPSHOT_VERSION = 2;
+
+#pragma pack(push, 1)
+struct SnapshotHeader
+{
+	char Magic[4];
+	std::uint16_t Version;
+	// Size of this header, lets newer versions append fields
+	std::uint16_t HeaderSize;
+	std::int32_t ObjectNumber;
+	std::uint32_t DriversCount;
+	std::uint32_t AddressesCount;
+	// Size of the address string table in bytes
+	std::uint32_t AddressesBytes;
+	char Passenger[MAX_STR_LEN];
+};
+#pragma pack(pop)
+
+// Bytes used by the driver states
+inline std::size_t SnapshotDriverBytes(std::uint16_t Version, std::uint32_t DriversCount)
+{
+	if (Version < 2)
+		return (static_cast<std::size_t>(DriversCount) + 7) / 8;
+	return (static_cast<std::size_t>(DriversCount) + 1) / 2;
+}
+
+// Whole record size described by a header
+inline std::size_t SnapshotRecordSize(const SnapshotHeader& Header)
+{
+	return Header.HeaderSize + SnapshotDriverBytes(Header.Version, Header.DriversCount) + Header.AddressesBytes;
+}
+
+// True if the data starts with a snapshot header of a version we can read
+inline bool IsSnapshot(const char* Data, std::size_t Size)
+{
+	return Size >= sizeof(SnapshotHeader)
+		&& Data[0] == SNAPSHOT_MAGIC[0] && Data[1] == SNAPSHOT_MAGIC[1]
+		&& Data[2] == SNAPSHOT_MAGIC[2] && Data[3] == SNAPSHOT_MAGIC[3];
+}
+
+// Delta record of one Taxi, as written by Taxi::AppendDelta: only the driver and address
+// blocks changed since StartDeltaTracking. Layout: DeltaHeader, then DriverBlocks times
+// a uint32 block index followed by the driver states of the block (encoded as in a
+// version 2 snapshot), then AddressBlocks times a uint32 block index followed by the
+// addresses of the block (uint16 length + characters each).
+// A delta only applies to a taxi with the same drivers and addresses counts.
+
+const char DELTA_MAGIC[4] = { 'T', 'X', 'D', 'L' };
+const std::uint16_t DELTA_VERSION = 1;
+// Drivers per block, a whole number of packed words
+const int DELTA_DRIVER_BLOCK = 256;
+const int DELTA_ADDRESS_BLOCK = 64;
+
+#pragma pack(push, 1)
+struct DeltaHeader
+{
+	char Magic[4];
+	std::uint16_t Version;
+	std::uint16_t HeaderSize;
+	// Whole record, this header included
+	std::uint32_t RecordSize;
+	std::uint32_t DriversCount;
+	std::uint32_t AddressesCount;
+	std::uint32_t DriverBlocks;
+	std::uint32_t AddressBlocks;
+	char Passenger[MAX_STR_LEN];
+};
+#pragma pack(pop)
+
+inline bool IsDelta(const char* Data, std::size_t Size)
+{
+	return Size >= sizeof(DeltaHeader)
+		&& Data[0] == DELTA_MAGIC[0] && Data[1] == DELTA_MAGIC[1]
+		&& Data[2] == DELTA_MAGIC[2] && Data[3] == DELTA_MAGIC[3];
+}
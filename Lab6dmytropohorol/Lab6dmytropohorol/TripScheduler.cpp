@@ -0,0 +1,190 @@
+#include "TripScheduler.h"
+#include <algorithm>
+#include <iterator>
+
+TripScheduler::TripScheduler(std::uint64_t StartTick) : Now(StartTick)
+{
+	std::fill(std::begin(Heads), std::end(Heads), NIL);
+}
+
+std::uint32_t TripScheduler::AllocateNode()
+{
+	if (FreeList != NIL)
+	{
+		std::uint32_t Node = FreeList;
+		FreeList = Nodes[Node].Next;
+		return Node;
+	}
+	Nodes.push_back(TripNode{});
+	return static_cast<std::uint32_t>(Nodes.size() - 1);
+}
+
+void TripScheduler::FreeNode(std::uint32_t Node)
+{
+	TripNode& Trip = Nodes[Node];
+	Trip.Generation++;
+	Trip.Bucket = NIL;
+	Trip.Obj = nullptr;
+	Trip.Next = FreeList;
+	FreeList = Node;
+}
+
+void TripScheduler::Link(std::uint32_t Node)
+{
+	TripNode& Trip = Nodes[Node];
+	std::uint64_t Delta = Trip.Expiry - Now;
+	int Level = 0;
+	while (Level < LEVELS - 1 && Delta >= (std::uint64_t(1) << (SLOT_BITS * (Level + 1))))
+		Level++;
+	std::uint32_t Slot = static_cast<std::uint32_t>((Trip.Expiry >> (SLOT_BITS * Level)) & (SLOTS - 1));
+	std::uint32_t Bucket = static_cast<std::uint32_t>(Level) * SLOTS + Slot;
+
+	LevelCounts[Level]++;
+	Trip.Bucket = Bucket;
+	Trip.Prev = NIL;
+	Trip.Next = Heads[Bucket];
+	if (Trip.Next != NIL)
+		Nodes[Trip.Next].Prev = Node;
+	Heads[Bucket] = Node;
+}
+
+void TripScheduler::Unlink(std::uint32_t Node)
+{
+	TripNode& Trip = Nodes[Node];
+	LevelCounts[Trip.Bucket / SLOTS]--;
+	if (Trip.Prev != NIL)
+		Nodes[Trip.Prev].Next = Trip.Next;
+	else
+		Heads[Trip.Bucket] = Trip.Next;
+	if (Trip.Next != NIL)
+		Nodes[Trip.Next].Prev = Trip.Prev;
+}
+
+std::uint32_t TripScheduler::Find(TripId Trip) const
+{
+	std::uint32_t Node = static_cast<std::uint32_t>(Trip & 0xFFFFFFFFu);
+	std::uint32_t Generation = static_cast<std::uint32_t>(Trip >> 32);
+	// ids store the node + 1, so that 0 stays invalid
+	if (Node == 0 || Node > Nodes.size())
+		return NIL;
+	Node--;
+	const TripNode& Found = Nodes[Node];
+	return Found.Bucket != NIL && Found.Generation == Generation ? Node : NIL;
+}
+
+TripId TripScheduler::StartTrip(Taxi& Obj, const char* InAddress, std::uint32_t Duration)
+{
+	int DriverIndex = Obj.OrderDriver(InAddress);
+	if (DriverIndex < 0)
+		return INVALID_TRIP_ID;
+	return Schedule(Obj, DriverIndex, Duration);
+}
+
+TripId TripScheduler::Schedule(Taxi& Obj, int DriverIndex, std::uint32_t Duration)
+{
+	if (DriverIndex < 0 || DriverIndex >= Obj.GetDriversCount())
+		return INVALID_TRIP_ID;
+	std::uint32_t Node = AllocateNode();
+	TripNode& Trip = Nodes[Node];
+	// the current tick is already processed, the earliest end is the next one
+	Trip.Expiry = Now + (Duration ? Duration : 1);
+	Trip.Obj = &Obj;
+	Trip.DriverIndex = DriverIndex;
+	Link(Node);
+	ActiveTrips++;
+	return (static_cast<TripId>(Trip.Generation) << 32) | (Node + 1);
+}
+
+bool TripScheduler::Cancel(TripId Trip)
+{
+	std::uint32_t Node = Find(Trip);
+	if (Node == NIL)
+		return false;
+	Unlink(Node);
+	FreeNode(Node);
+	ActiveTrips--;
+	return true;
+}
+
+bool TripScheduler::Complete(TripId Trip)
+{
+	std::uint32_t Node = Find(Trip);
+	if (Node == NIL)
+		return false;
+	Unlink(Node);
+	TripNode Ended = Nodes[Node];
+	FreeNode(Node);
+	ActiveTrips--;
+	Release(Ended);
+	return true;
+}
+
+bool TripScheduler::Release(TripNode& Trip)
+{
+	// a driver someone already moved to a state that cannot end in FREE is left alone
+	if (!Trip.Obj->TransitionDriver(Trip.DriverIndex, DriverState::Free))
+		return false;
+	if (OnRelease)
+		OnRelease(*Trip.Obj, Trip.DriverIndex);
+	return true;
+}
+
+void TripScheduler::Cascade(int Level)
+{
+	std::uint32_t Bucket = static_cast<std::uint32_t>(Level) * SLOTS
+		+ static_cast<std::uint32_t>((Now >> (SLOT_BITS * Level)) & (SLOTS - 1));
+	std::uint32_t Node;
+	while ((Node = Heads[Bucket]) != NIL)
+	{
+		Unlink(Node);
+		Link(Node);
+	}
+}
+
+int TripScheduler::Advance(std::uint64_t Ticks)
+{
+	int Released = 0;
+	std::uint64_t End = Now + Ticks;
+	while (Now < End)
+	{
+		if (ActiveTrips == 0)
+		{
+			// nothing to expire, jump straight to the end
+			Now = End;
+			break;
+		}
+		// with the lowest levels empty, nothing happens before the level above cascades
+		int EmptyLevels = 0;
+		while (LevelCounts[EmptyLevels] == 0)
+			EmptyLevels++;
+		if (EmptyLevels > 0)
+		{
+			std::uint64_t LastIdle = Now | ((std::uint64_t(1) << (SLOT_BITS * EmptyLevels)) - 1);
+			Now = LastIdle < End ? LastIdle : End;
+			if (Now == End)
+				break;
+		}
+		Now++;
+		// when a level wraps, the next slot of the level above is spread over the lower ones
+		for (int Level = 1; Level < LEVELS; Level++)
+		{
+			if ((Now & ((std::uint64_t(1) << (SLOT_BITS * Level)) - 1)) != 0)
+				break;
+			Cascade(Level);
+		}
+
+		// one node at a time, the release callback may schedule or cancel trips
+		std::uint32_t Bucket = static_cast<std::uint32_t>(Now & (SLOTS - 1));
+		std::uint32_t Node;
+		while ((Node = Heads[Bucket]) != NIL)
+		{
+			Unlink(Node);
+			TripNode Ended = Nodes[Node];
+			FreeNode(Node);
+			ActiveTrips--;
+			if (Release(Ended))
+				Released++;
+		}
+	}
+	return Released;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Taxi.h"
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Identifies a scheduled trip, 0 is never used
+using TripId = std::uint64_t;
+const TripId INVALID_TRIP_ID = 0;
+
+// Releases drivers back to FREE when their trips end, using a hierarchical timing
+// wheel: 4 levels of 256 slots, so a trip can last up to 2^32 ticks. Scheduling and
+// cancelling are O(1), and every tick costs O(1) plus the trips that end in it;
+// stretches of ticks with nothing to do are skipped.
+// Trips live in one node pool, there is no allocation per trip once it has grown.
+// What a tick means (a second, a minute) is up to the caller.
+// The taxis must outlive their trips. Not thread-safe.
+class TripScheduler
+{
+public:
+	explicit TripScheduler(std::uint64_t StartTick = 0);
+
+	// Orders a free driver of Obj to InAddress and releases it after Duration ticks.
+	// Returns INVALID_TRIP_ID if the taxi could not take the order.
+	TripId StartTrip(Taxi& Obj, const char* InAddress, std::uint32_t Duration);
+	// Releases a driver that is already on a trip after Duration ticks
+	TripId Schedule(Taxi& Obj, int DriverIndex, std::uint32_t Duration);
+
+	// Forgets the trip, the driver stays in its state
+	bool Cancel(TripId Trip);
+	// Ends the trip now and releases the driver
+	bool Complete(TripId Trip);
+
+	// Moves the clock forward, releasing the drivers whose trips ended.
+	// Returns the number of drivers released.
+	int Advance(std::uint64_t Ticks);
+
+	std::uint64_t GetNow() const { return Now; }
+	int GetActiveTrips() const { return ActiveTrips; }
+
+	// Called after every driver released by a trip end, e.g. to give it a waiting order
+	void SetReleaseCallback(std::function<void(Taxi& Obj, int DriverIndex)> Callback) { OnRelease = std::move(Callback); }
+
+private:
+	static constexpr int LEVELS = 4;
+	static constexpr int SLOT_BITS = 8;
+	static constexpr int SLOTS = 1 << SLOT_BITS;
+	static constexpr std::uint32_t NIL = 0xFFFFFFFFu;
+
+	struct TripNode
+	{
+		std::uint64_t Expiry;
+		Taxi* Obj;
+		int DriverIndex;
+		// Bumped every time the node is reused, so old ids stop matching
+		std::uint32_t Generation;
+		std::uint32_t Prev;
+		std::uint32_t Next;
+		// Level * SLOTS + slot of the list holding the node, NIL when free
+		std::uint32_t Bucket;
+	};
+
+	std::uint32_t AllocateNode();
+	void FreeNode(std::uint32_t Node);
+	void Link(std::uint32_t Node);
+	void Unlink(std::uint32_t Node);
+	// Node of a live trip or NIL
+	std::uint32_t Find(TripId Trip) const;
+	// Re-files the trips of one higher level slot into the lower levels
+	void Cascade(int Level);
+	bool Release(TripNode& Trip);
+
+	std::vector<TripNode> Nodes;
+	std::uint32_t FreeList = NIL;
+	std::uint32_t Heads[LEVELS * SLOTS];
+	// Trips filed in every level, lets Advance skip ticks where nothing happens
+	int LevelCounts[LEVELS] = {};
+	std::uint64_t Now;
+	int ActiveTrips = 0;
+	std::function<void(Taxi&, int)> OnRelease;
+};